@@ -14,6 +14,7 @@ extern "C" {
 	#include "MacLearn/MacLearn.h"
 	#include "MacLearn/Classifier/Classifier.h"
 	#include "MacLearn/DataSet/Dataset.h"
+	#include "MacLearn/Util/Memory.h"		/* For MemoryPolicy */
 
 	/* Perceptron structure */
 	typedef struct Perceptron
@@ -23,6 +24,8 @@ extern "C" {
 		PRIVATE unsigned char largeMargin;		/* Determines if should use "Large Margin" mechanisms when training the Perceptron */
 		PRIVATE unsigned long WColumns;			/* Holds the number of columns in the weights matrix */
 		PRIVATE double * W;						/* Holds the "weights" matrix */
+		PRIVATE unsigned long inputFeatsCount;	/* Number of features of the records gathered through inputColumns */
+		PRIVATE unsigned long * inputColumns;	/* Feature of those records taken for each feature of the perceptron. NULL when there are none */
 		/* Doesn't need any specific function */
 	}Perceptron;
 
@@ -39,9 +42,28 @@ extern "C" {
 	/* Returns a new perceptron instance, or NULL on error. */
 	PUBLIC Perceptron * Perceptron_New (DataSet * dataset, unsigned char largeMargin, double alpha, int inducersCount, FeatInducer ** inducers);
 
+	/*	Same as Perceptron_New, with the weights matrix allocated as told by "policy" (may be NULL): i.e. backed by huge pages,
+		or placed on the NUMA node of the threads that will train it. Invalid policies return NULL, with errno set to EINVAL */
+	PUBLIC Perceptron * Perceptron_NewWithPolicy (DataSet * dataset, unsigned char largeMargin, double alpha, int inducersCount, FeatInducer ** inducers, const MemoryPolicy * policy);
+
 	/* Load a perceptron from a file and returns a new instance (or NULL) */
 	PUBLIC Perceptron * Perceptron_Load(char * srcPath);
 
+	/*	Write the weights matrix to a NumPy .npy file, as a float64 matrix with a row per class and a column per input
+		(the bias first, then the features and the features generated by the inducers) */
+	PUBLIC int Perceptron_SaveWeights (Perceptron * pcpt, char * dstPath);
+
+	/*	Makes the perceptron take records of "inputFeatsCount" features, and use only those on "columns" (featsCount of them,
+		zero based, in increasing order): i.e. the features a pruned dataset kept (see CSVDataSet_GetColumns). Datasets with
+		inputFeatsCount features given to test or batchLearn, and records given to Perceptron_PredictInput, are gathered to
+		the features of the perceptron. Datasets with featsCount features are still taken as they are. The columns are saved
+		with the perceptron. NULL columns remove them */
+	PUBLIC int Perceptron_SetInputColumns (Perceptron * pcpt, unsigned long inputFeatsCount, const unsigned long * columns);
+
+	/*	Same as predict, for a record of inputFeatsCount features (see Perceptron_SetInputColumns). Without input columns,
+		records are taken as they are */
+	PUBLIC int Perceptron_PredictInput (Perceptron * pcpt, EntryData * entry, unsigned long * predictedClass);
+
 
 #ifdef __cplusplus
 }
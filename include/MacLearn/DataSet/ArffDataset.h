@@ -1,6 +1,17 @@
 /*
 "Extends" CSVDataset (in a sense).
 This module implements the functions needed to read an ARFF file into a data set abstraction.
+Gzip compressed files are read as described on CSVDataset.h.
+
+NUMERIC (REAL, INTEGER) and nominal attributes are supported. The last attribute is the class, and must be nominal.
+Nominal values are interned into codes through a hash table while reading the header: features get the position of their
+value on the declaration (0, 1, ...), and classes that position plus 1. Missing features ('?') are read as 0.
+Both dense rows and sparse rows ("{index value, ...}", omitted values are 0) are read. When the first record is sparse
+and the storage option is BD_ST_DOUBLE, BD_ST_SPARSE is used instead, so FULL datasets take memory proportional to
+their non zero values. Sparse rows are parsed straight into that form, without being expanded first. Files that are
+transformed or pruned (options.transform, options.prune) stay dense, as both work on whole rows.
+With options.columns (see CSVDataset.h), feature columns are attribute positions, and sparse rows keep only the values of
+the loaded features.
 */
 
 #ifndef __ARFFDATASET_H__
@@ -17,7 +28,10 @@ extern "C" {
 	typedef struct ArffDataSet
 	{
 		CSVDataSet;					/* Holds all csv dataset vars and functions */
-		/* Don't need any specific vars or functions */
+		/* Declare arff specific vars */
+		PRIVATE unsigned long attributesCount;		/* Number of attributes declared on the header (featsCount + 1) */
+		PRIVATE struct StringTable ** nominals;		/* Values of each attribute (featsCount + 1, the last one is the class). NULL on numeric attributes */
+		/* Doesn't need any specific function */
 	}ArffDataSet;
 
 #ifdef EXTEND_ARFFDATASET
@@ -30,10 +44,13 @@ extern "C" {
 	PROTECTED void ArffDataSet_Init (ArffDataSet * arffDataset);
 #endif
 
-	/*	Returns a new Arff dataset instance, or NULL on error */
+	/*	Returns a new Arff dataset instance, or NULL on error. STRING, DATE and RELATIONAL attributes are an error (ENOSYS) */
 	PUBLIC ArffDataSet * ArffDataSet_New (BatchReadMode readMode, char * srcPath);
 
-	/* Write a dataset to an ARFF formatted file */
+	/* Returns a new Arff dataset instance, or NULL on error. "options" may be NULL to use the defaults */
+	PUBLIC ArffDataSet * ArffDataSet_NewWithOptions (BatchReadMode readMode, char * srcPath, BatchOptions * options);
+
+	/* Write a dataset to an ARFF formatted file. Records are written as CSVDataSet_Save does (see CSVDataset.h) */
 	PUBLIC int ArffDataSet_Save (DataSet * dataset, char * outPath);
 
 #ifdef __cplusplus
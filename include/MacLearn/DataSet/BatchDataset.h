@@ -16,6 +16,9 @@ extern "C" {
 	#include <stdio.h>			/* For FILE */
 	#include "MacLearn/MacLearn.h"
 	#include "Dataset.h"		/* For DataSet definitions */
+	#include "MacLearn/Util/Random.h"	/* For Random */
+	#include "MacLearn/Util/Memory.h"	/* For MemoryPolicy */
+	#include "FeatsTransform.h"		/* For FeatsTransformOptions */
 
 	/* Modes for reading a dataset */
 	typedef enum{
@@ -23,6 +26,74 @@ extern "C" {
 		BD_RM_INCREMENTAL
 	}BatchReadMode;
 
+	/* Ways of storing the features of a dataset in memory */
+	typedef enum{
+		BD_ST_DOUBLE = 0,			/* Dense array of doubles (default) */
+		BD_ST_SPARSE,				/* Only the non zero values and their columns, in a single CSR block - used only on FULL datasets */
+		BD_ST_FLOAT,				/* Dense array of floats - used only on FULL datasets */
+		BD_ST_UINT8,				/* Dense array of bytes, for integer features from 0 to 255 - used only on FULL datasets */
+		BD_ST_BIT					/* Dense array of bits, for 0/1 features - used only on FULL datasets */
+	}BatchStorage;
+
+	/* Use of a sidecar index file (the dataset path plus ".mlidx") - used only on INCREMENTAL datasets, and to sample records */
+	typedef enum{
+		BD_IX_NONE = 0,				/* Scan the whole file to find the records (default) */
+		BD_IX_USE					/* Take the records from the index if it's valid for the file. Otherwise scan it, and write a new index */
+	}BatchIndex;
+
+	/* Sharing of the records of FULL datasets between processes, through POSIX shared memory (see CSVDataset.h) */
+	typedef enum{
+		BD_SH_NONE = 0,				/* Each dataset keeps its own copy of the records (default) */
+		BD_SH_USE					/* Attach to the records another process published for the same file and options. Otherwise load them, and publish them */
+	}BatchShare;
+
+	/* Layout of the records of FULL datasets with dense storage */
+	typedef enum{
+		BD_LY_ROWS = 0,				/* Rows one after the other, with a record struct (features pointer and class) for each one (default) */
+		BD_LY_ALIGNED				/* Rows starting on cache line (64 bytes) boundaries, padded to a multiple of 64 bytes, and classes on their own array */
+	}BatchLayout;
+
+	/* Dropping of constant (or almost constant) features, found while loading the records (see CSVDataset.h) */
+	typedef enum{
+		BD_PR_NONE = 0,				/* Every feature is kept (default) */
+		BD_PR_USE					/* Features whose variance isn't above pruneVariance are dropped, and the records compacted to the others */
+	}BatchPrune;
+
+	/* How the labels of a file become classes (from 1) - used by svmlight datasets */
+	typedef enum{
+		BD_LB_CLASSES = 0,			/* Labels are the classes, so they must be 1 or above (default) */
+		BD_LB_ZERO,					/* Labels start at 0: each class is its label plus 1 */
+		BD_LB_MAP					/* Label labelMap[i] is class i + 1 (i.e. -1 and +1 are classes 1 and 2) */
+	}BatchLabels;
+
+	/* Index of the first feature of a file - used by svmlight datasets */
+	typedef enum{
+		BD_IB_ONE = 0,				/* Indexes start at 1, as on LIBSVM files (default) */
+		BD_IB_ZERO					/* Indexes start at 0 */
+	}BatchIndexBase;
+
+	/* Options used when loading a dataset. A zeroed structure (or a NULL pointer, where accepted) selects the default of every option */
+	typedef struct
+	{
+		BatchStorage storage;		/* How features are stored in memory */
+		BatchIndex index;			/* Use of an index file */
+		const unsigned long * columns;	/* Features of the file to load (zero based, in increasing order). NULL loads all of them - used by CSV and ARFF datasets */
+		unsigned long columnsCount;	/* Number of features on "columns" */
+		double sample;				/* Fraction (from 0 to 1) of the records to load, picked at random. 0 or 1 load all of them - used by CSV and ARFF datasets */
+		unsigned long long sampleSeed;	/* Seed of the sample. The same seed always picks the same records. 0 picks different ones on every load */
+		BatchShare share;			/* Sharing of the records with other processes - used only on FULL datasets */
+		BatchLayout layout;			/* Layout of the records in memory - used only on FULL datasets with dense storage */
+		MemoryPolicy memory;		/* Huge pages and NUMA placement of the records (see Memory.h) - used only on FULL datasets */
+		FeatsTransformOptions transform;	/* Transform applied to the features while loading (see FeatsTransform.h) - used by CSV and ARFF datasets */
+		BatchPrune prune;			/* Dropping of constant features - used by CSV and ARFF datasets with dense storage */
+		double pruneVariance;		/* Highest variance of the features dropped. 0 drops only constant ones */
+		BatchLabels labels;			/* How labels become classes - used by svmlight datasets */
+		const int * labelMap;		/* BD_LB_MAP only: label of each class, in increasing order. NULL maps the distinct labels of the file */
+		unsigned long labelMapCount;	/* Number of labels on "labelMap" */
+		BatchIndexBase indexBase;	/* Index of the first feature - used by svmlight datasets */
+		unsigned long featsCount;	/* Number of features of the dataset. 0 takes it from the highest index of the file - used by svmlight datasets */
+	}BatchOptions;
+
 	/* The structure representation of a Batch Dataset */
 	typedef struct BatchDataSet
 	{
@@ -30,10 +101,13 @@ extern "C" {
 		/* Declare batch specific vars */
 		PUBLIC unsigned long entriesCount;				/* Size (in records) of the Dataset */
 		PUBLIC BatchReadMode readMode;					/* Dataset read mode - BD_RM_FULL to read all records to memory, BD_RM_INCREMENTAL to read one record at a time */
+		PUBLIC BatchOptions options;					/* Options used when loading the dataset */
 		PROTECTED EntryData * entries;					/* Buffer where the records are stored. Shouldn't be accessed directly by external calls. Use NextEntry() */
-		PROTECTED off_t * readOrder;					/* Buffer to store the order in which the records are read. */
+		PROTECTED off_t * readOrder;					/* Buffer to store the order in which the records are read (record indexes on FULL datasets, file offsets on INCREMENTAL ones) */
 		PROTECTED unsigned long currentPos;				/* Holds the current position on the "readOrder" vector. */
 		PROTECTED FILE * file;							/* Pointer to the file that stores the data - used only on INCREMENTAL datasets */
+		PROTECTED Random random;						/* Sequence that seeds each shuffle */
+		PROTECTED unsigned long shuffleBlock;			/* Number of records on each block shuffled together. 0 or 1 shuffles single records */
 		/* Declare specific functions*/
 		PUBLIC int (*reset)(struct BatchDataSet * batchDataset);					/* Reset the dataset back to the first record */
 		PUBLIC int (*shuffle)(struct BatchDataSet * batchDataset);					/* Shuffle the records in the dataset */
@@ -51,6 +125,15 @@ extern "C" {
 	PROTECTED void BatchDataSet_Init (BatchDataSet * batchDataset);
 #endif
 
+	/*	Sets the seed of the shuffles. After it, the same sequence of calls to shuffle always gives the same read orders.
+		Datasets are created with a seed based on the clock, so their shuffles aren't reproducible by default */
+	PUBLIC void BatchDataSet_SetSeed (BatchDataSet * batchDataset, unsigned long long seed);
+
+	/*	Makes shuffle permute blocks of "blockSize" consecutive records (in the original order) instead of single records, and then
+		shuffle the records inside each block. Records of a block are read together, so INCREMENTAL datasets read the file mostly
+		in sequence instead of seeking for every record. 0 (the default) or 1 shuffles single records */
+	PUBLIC void BatchDataSet_SetShuffleBlock (BatchDataSet * batchDataset, unsigned long blockSize);
+
 #ifdef __cplusplus
 }
 #endif
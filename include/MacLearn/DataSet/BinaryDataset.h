@@ -0,0 +1,68 @@
+/*
+"Extends" BatchDataset (in a sense).
+This module implements a native binary data set format, meant to be written once (usually converting a CSV or ARFF file)
+and read many times.
+
+The file is memory mapped when loaded and the entries returned by nextEntry point straight into the mapping, so opening
+a data set costs almost nothing, no matter its size, and the page cache is shared by all processes reading the same file.
+
+File layout (all values in the byte order of the machine that wrote the file):
+	Header (64 bytes)		- Magic "MLBINDS", version, byte order mark, element type, featsCount, classesCount, entriesCount
+							  and the offsets of the two following sections
+	Features				- entriesCount x featsCount matrix, row major, starting on a 64 bytes aligned offset
+	Classes					- entriesCount 32 bits integers, starting on a 64 bytes aligned offset
+*/
+
+#ifndef __BINARYDATASET_H__
+#define __BINARYDATASET_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	#include <stdint.h>				/* For int32_t */
+	#include "MacLearn/MacLearn.h"
+	#include "MacLearn/Util/FileMap.h"	/* For FileMap */
+	#include "BatchDataset.h"		/* For BatchDataSet definitions */
+
+	#define BINARYDATASET_VERSION		1			/* Current version of the file format */
+
+	/* Types of the elements stored on the features matrix */
+	typedef enum
+	{
+		BIN_ET_DOUBLE = 1				/* 64 bits IEEE 754 floating point */
+	}BinaryElementType;
+
+	/* The structure representation of a Binary Dataset */
+	typedef struct BinaryDataSet
+	{
+		BatchDataSet;									/* Holds all batch dataset vars and functions */
+		/* Declare binary specific vars */
+		PRIVATE FileMap map;							/* The memory mapped file */
+		PRIVATE const double * features;				/* Features matrix, inside the mapping */
+		PRIVATE const int32_t * classes;				/* Classes array, inside the mapping */
+		/* Doesn't need any specific function */
+	}BinaryDataSet;
+
+#ifdef EXTEND_BINARYDATASET
+	/************************
+	* "Protected" Functions	*
+	************************/
+
+	/*	Initializes the struct's variables and function pointers.
+	NOTE: This function does NOT allocate memory for a BinaryDataSet struct. */
+	PROTECTED void BinaryDataSet_Init (BinaryDataSet * binDataset);
+#endif
+
+	/*	Returns a new binary data set instance, or NULL on error.
+		The data is never copied, so both read modes behave the same. The mode only changes how the OS is told the file will be read */
+	PUBLIC BinaryDataSet * BinaryDataSet_New (BatchReadMode readMode, char * srcPath);
+
+	/* Write a dataset to a binary formatted file */
+	PUBLIC int BinaryDataSet_Save (DataSet * dataset, char * outPath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
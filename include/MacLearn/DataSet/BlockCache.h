@@ -0,0 +1,54 @@
+/*
+This module keeps parsed records of a text file in memory, so datasets that read their records from the file on demand
+(INCREMENTAL ones) don't read and parse them again on every epoch.
+
+Records are cached in blocks: block "b" holds the records that start on the "b"-th region of BLOCKCACHE_BLOCK_SIZE bytes
+of data, so the block of any record is known from its offset. Blocks are evicted with the CLOCK algorithm, but the hand only
+moves one block for every block's worth of records read from the file. Datasets read in the same order (or block shuffled)
+on every epoch keep the same blocks cached, and only the ones that don't fit are read and parsed again. A block that doesn't
+fit isn't cached: its records are read one by one by the caller.
+*/
+
+#ifndef __BLOCKCACHE_H__
+#define __BLOCKCACHE_H__
+
+#include <sys/types.h>						/* For off_t and ssize_t */
+#include "MacLearn/DataSet/Dataset.h"		/* For EntryData */
+
+/* Size (in bytes) of the region of the file whose records make up each block of the cache */
+#define BLOCKCACHE_BLOCK_SIZE		(256 << 10)
+
+/* A cache of parsed blocks of records */
+typedef struct BlockCache BlockCache;
+
+/* The file a cache takes its records from, and how they're read and parsed */
+typedef struct
+{
+	off_t dataStart;				/* Offset of the first record on the file */
+	off_t dataEnd;					/* Offset of the end of the records */
+	size_t maxLineLength;			/* Length of the longest record, including its '\n' */
+	unsigned long entriesCount;		/* Number of records on the file */
+	unsigned long featsCount;		/* Number of features of each record */
+	ssize_t (*read) (void * context, char * buffer, size_t size, off_t offset);	/* Reads from the file like pread. Must be thread safe */
+	int (*parse) (void * context, const char * line, const char * lineEnd, EntryData * entry);	/* Parses a record into dense features */
+	void * context;					/* Passed to "read" and "parse" */
+}BlockCacheSource;
+
+/*	Returns a new cache of up to "budget" bytes of parsed records of "source" (which is copied), or NULL on error. A budget
+	smaller than one parsed block is rounded up to it, so at least one block is always cached */
+BlockCache * BlockCache_New (const BlockCacheSource * source, size_t budget);
+
+/* Changes the budget of the cache (rounded up as in BlockCache_New), evicting blocks until they fit. Counters are kept */
+void BlockCache_SetBudget (BlockCache * cache, size_t budget);
+
+/*	Copies the class and features of the record at "offset" to "entry" (entry->features must have room for all of them),
+	loading its block if it fits. Thread safe. Returns 1 if the record was copied, or 0 if the caller must read it */
+unsigned char BlockCache_Read (BlockCache * cache, off_t offset, EntryData * entry);
+
+/* Returns the number of records found on the cache ("hits") and read from the file ("misses") since it was created */
+void BlockCache_GetStats (BlockCache * cache, unsigned long * hits, unsigned long * misses);
+
+/* Frees the cache and all of its blocks */
+void BlockCache_Free (BlockCache * cache);
+
+#endif
@@ -2,6 +2,9 @@
 "Extends" BatchDataset (in a sense).
 This module implements the functions needed to read a CSV file into a data set abstraction.
 The file may or may not have a header with column names.
+Gzip compressed files are detected and decompressed on the fly, in both read modes. INCREMENTAL datasets read each record
+by inflating the span of the file (about 1 MB) that holds it, so fully shuffled reads of a compressed file are slow. Use
+BatchDataSet_SetShuffleBlock with blocks of a few hundred records (or more) to read them span by span.
 */
 
 #ifndef __CSVDATASET_H__
@@ -12,6 +15,7 @@ extern "C" {
 #endif
 
 	#include "MacLearn/MacLearn.h"
+	#include "MacLearn/Util/SharedMem.h"	/* For SharedMem */
 	#include "BatchDataset.h"		/* For BatchDataSet definitions */
 
 	/* The structure representation of a CSV Dataset */
@@ -21,9 +25,20 @@ extern "C" {
 		/* Declare batch specific vars */
 		PUBLIC unsigned char hasLabels;				/* Determines if the original file had column labels */
 		PUBLIC char delimiter;							/* Character that represents the separation between records. Default vaule is ',' */
+		PRIVATE struct CSVReadAhead * readAhead;		/* State of the background reading of records - used only on INCREMENTAL datasets */
+		PRIVATE struct GzipFile * gzip;				/* Compressed file that "file" decompresses. NULL on plain files */
+		PRIVATE struct BlockCache * cache;				/* Parsed blocks of records kept in memory - used only on INCREMENTAL datasets */
+		PROTECTED unsigned long * columns;				/* Features of the file that are loaded, in increasing order (a copy of options.columns). NULL when all of them are */
+		PROTECTED unsigned long fileFeatsCount;			/* Number of features on the file. featsCount is the number of loaded ones */
+		PRIVATE SharedMem shared;						/* Shared memory block that holds the records (see options.share). Zeroed when they're private */
+		PROTECTED size_t rowStride;						/* Distance (in bytes) between the features of consecutive records of dense FULL datasets */
+		PROTECTED unsigned char * rows;					/* BD_LY_ALIGNED only: features of all records, "rowStride" bytes apart. "entries" holds a single record */
+		PROTECTED int * classes;						/* BD_LY_ALIGNED only: class of every record */
+		PUBLIC FeatsTransform * transform;				/* Transform applied to the features (see options.transform), with the statistics it uses. NULL when there's none */
 		/* Declare specific functions*/
 		PROTECTED int (*loadHeader) (struct CSVDataSet * csvDataset);	/* Load header info (Column names, column count and class count) from dataset - used internally, treat as "protected" */
 		PROTECTED int (*loadData) (struct CSVDataSet * csvDataset);		/* Prepare/Load the data from a dataset file - used internally, treat as "protected" */
+		PROTECTED int (*parseLine) (struct CSVDataSet * csvDataset, const char * line, const char * lineEnd, EntryData * entry);	/* Parse one record line into entry (see CSVDataSet_ParseLine) - used internally, treat as "protected" */
 	}CSVDataSet;
 
 #ifdef EXTEND_CSVDATASET
@@ -34,6 +49,25 @@ extern "C" {
 	/* Reads on line of the CSV file into entry. The file must be positioned on the begining of the record line (no check is made to verify that this is true!) */
 	PROTECTED int CSVDataSet_ReadLine (CSVDataSet * csvDataset, EntryData * entry);
 
+	/*	Parses one line of CSV text, stored in memory at [line, lineEnd), into entry. entry->features must have room for all features.
+		Callers that can store sparse records pass entry->indexes with room for all features too: formats with sparse rows may then
+		return the record sparse (setting entry->nnz). Dense records are returned with entry->indexes set to NULL */
+	PROTECTED int CSVDataSet_ParseLine (CSVDataSet * csvDataset, const char * line, const char * lineEnd, EntryData * entry);
+
+	/*	Returns the position (on the loaded features) of the feature on column "column" of the file, or -1 if that feature isn't
+		loaded. Parsers of formats that address features by column (i.e. sparse rows) use it to honor options.columns */
+	PROTECTED long CSVDataSet_FeaturePosition (CSVDataSet * csvDataset, unsigned long column);
+
+	/*	Prepares an INCREMENTAL dataset whose readOrder (and entriesCount and featsCount) the loader already filled with the
+		offset of each record: starts the read ahead state, so records are read from the file on demand. "maxLineLength" is
+		the size of the longest record (with its line break), and [dataStart, dataEnd) the part of the file holding them */
+	PROTECTED int CSVDataSet_PrepareIncremental (CSVDataSet * csvDataset, size_t maxLineLength, off_t dataStart, off_t dataEnd);
+
+	/*	Writes the records of "dataset" (from its current position to its end) to "file", one per line: each feature followed by
+		"delimiter", and then the class. Records are read with nextBatch, and formatted on several threads with the shortest text
+		that reads back to the same value. Used by the CSV and ARFF writers */
+	PROTECTED int CSVDataSet_WriteRecords (DataSet * dataset, FILE * file, char delimiter);
+
 	/*	Initializes the struct's variables and function pointers. 
 	NOTE: This function does NOT allocate memory for a BatchDataSet struct. */
 	PROTECTED void CSVDataSet_Init (CSVDataSet * csvDataset);
@@ -42,7 +76,71 @@ extern "C" {
 	/* Returns a new CSV data set instance, or NULL on error */
 	PUBLIC CSVDataSet * CSVDataSet_New (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char * srcPath);
 
-	/* Write a dataset to a CSV formatted file */
+	/*	Returns a new CSV data set instance, or NULL on error. "options" may be NULL to use the defaults.
+		Storage options other than BD_ST_DOUBLE only apply to FULL datasets. INCREMENTAL datasets always return dense doubles.
+		With BD_IX_USE, INCREMENTAL datasets of plain (not compressed) files keep the offsets of their records on "srcPath.mlidx".
+		Opening the file again takes them from there instead of scanning the whole file, as long as the file didn't change (its
+		size, modification time and a hash of some pieces of it are checked). The index is rewritten whenever it's not valid.
+		With options.columns, only those features are loaded (featsCount is options.columnsCount): the other fields of each line
+		are skipped without being converted, and take no memory.
+		With options.sample, only that fraction of the records is loaded, without reading the whole file: random byte offsets of
+		the data are taken to the begining of the next record, and only those records are parsed. Records that follow long ones
+		are a bit more likely to be picked, so the sample is only approximately uniform (and its size approximate too). With
+		BD_IX_USE and a valid index, records are picked from the index instead, as an exact uniform sample. Either way, the
+		records keep their order on the file. Compressed files can't be sampled (ENOSYS).
+		With BD_SH_USE, FULL datasets are shared by all the processes of the machine: the first one to load a file publishes its
+		records on a POSIX shared memory block (named after the path of the file and the options that change the records), and
+		the next ones attach to it read only, without parsing the file. The block is only used while the file keeps its size,
+		modification time and contents (as the index). Otherwise it's replaced, as is a block left incomplete by a process that's
+		gone. If the block can't be created or attached to (i.e. there's not enough shared memory, or another process is still
+		publishing it), the dataset keeps its own copy. Samples without a seed are never shared.
+		With BD_LY_ALIGNED (FULL datasets with dense storage only, EINVAL with BD_ST_SPARSE), the features of every record start on
+		a 64 bytes boundary, and are padded to a multiple of 64 bytes (i.e. 784 doubles take 6272 bytes, and 785 take 6336). The
+		classes are kept on their own array, and records are pointed to when returned by nextEntry instead of having a struct
+		each, so the pointer returned is only valid until the next call.
+		options.memory sets how the block of records is allocated: i.e. MEM_PG_TRANSPARENT to have it backed by huge pages (less
+		TLB misses when records are shuffled), and MEM_NM_INTERLEAVE to spread it over the NUMA nodes of the machine, so threads
+		of every node read it at the same speed. Blocks are placed before the parsing threads write them. Records attached from
+		a shared memory block don't follow it.
+		options.transform clips, logs and scales the features (see FeatsTransform.h) as they're loaded. FULL datasets (with
+		BD_ST_DOUBLE or BD_ST_FLOAT storage only, EINVAL otherwise) collect the statistics of the features while parsing them,
+		and scale all records at once. INCREMENTAL datasets parse their records once at load to collect the statistics (only
+		if they're needed), and transform each record as it's read. Either way the statistics are kept on "transform", so
+		they can be the source of the transform of another dataset (i.e. a test set scaled as its training set). Transformed
+		datasets aren't shared (options.share is ignored).
+		With BD_PR_USE, the features whose variance (over the records loaded, after clipping and log) isn't above
+		options.pruneVariance are dropped: i.e. the pixels that are 0 on every image. FULL datasets (with dense storage only,
+		EINVAL with BD_ST_SPARSE) find them while parsing the records, and then compact the records to the remaining features.
+		INCREMENTAL datasets parse their records once at load to find them, and skip them on every record read. The remaining
+		features become the selected columns (see CSVDataSet_GetColumns), so featsCount shrinks, and a test set may load the
+		same ones with options.columns. Pruned datasets aren't shared either */
+	PUBLIC CSVDataSet * CSVDataSet_NewWithOptions (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char * srcPath, BatchOptions * options);
+
+	/*	Configure the background reading of an INCREMENTAL dataset. Up to "readAhead" records are read in advance (0 disables it), and
+		the last "window" records returned by nextEntry remain valid. Defaults to 64 records read in advance and a window of 1 */
+	PUBLIC int CSVDataSet_SetReadAhead (CSVDataSet * csvDataset, unsigned long readAhead, unsigned long window);
+
+	/*	Keep up to "cacheSize" bytes of parsed records of an INCREMENTAL dataset in memory (0 removes the cache), so epochs
+		after the first one don't read and parse them again. Records are cached in blocks (those on each 256 KB of the file),
+		evicted with a CLOCK policy that keeps the same blocks cached from epoch to epoch: only the records that don't fit are
+		read from the file again. Works best when the read order is the file order or block shuffled (BatchDataSet_SetShuffleBlock).
+		A cacheSize smaller than one parsed block is rounded up to it, so at least one block is always cached */
+	PUBLIC int CSVDataSet_SetCache (CSVDataSet * csvDataset, size_t cacheSize);
+
+	/* Returns the number of records found on the cache ("hits") and read from the file ("misses") since it was created */
+	PUBLIC int CSVDataSet_GetCacheStats (CSVDataSet * csvDataset, unsigned long * hits, unsigned long * misses);
+
+	/*	Returns the columns of the file (zero based, in increasing order) of the features loaded, or NULL when all of them are.
+		"fileFeatsCount" (may be NULL) receives the number of features of the file. Used to take the features selected, or
+		left by BD_PR_USE, to other datasets (options.columns) or to a Perceptron (Perceptron_SetInputColumns) */
+	PUBLIC const unsigned long * CSVDataSet_GetColumns (CSVDataSet * csvDataset, unsigned long * fileFeatsCount);
+
+	/*	Removes the shared memory block a dataset loaded with BD_SH_USE is attached to, so the next datasets load the file again.
+		Datasets already attached keep using it: its memory is released once all of them are freed */
+	PUBLIC int CSVDataSet_RemoveShared (CSVDataSet * csvDataset);
+
+	/*	Write a dataset to a CSV formatted file. Records are streamed from the dataset (which may be INCREMENTAL) in batches,
+		and formatted on several threads. Values are written with the fewest digits that read back exactly */
 	PUBLIC int CSVDataSet_Save (DataSet * dataset, unsigned char hasLabels, char delimiter, char * outPath);
 
 
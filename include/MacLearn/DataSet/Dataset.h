@@ -18,11 +18,33 @@ extern "C" {
 
 	#include "MacLearn/MacLearn.h"
 
-	/* Struct that represents one record of a Data Set */
+	/* Types of the values stored on the features of a dense record */
+	typedef enum
+	{
+		DS_ET_DOUBLE = 0,			/* double (default) */
+		DS_ET_FLOAT,				/* float */
+		DS_ET_UINT8,				/* unsigned char, for integer values from 0 to 255 */
+		DS_ET_BIT					/* A single bit per value (0 or 1), packed in bytes. Each record starts on a new byte */
+	}EntryType;
+
+	/*	Struct that represents one record of a Data Set.
+		Records may be dense (all featsCount values are stored in "features") or sparse (only the "nnz" non zero values are
+		stored in "features", and "indexes" holds the zero based column of each one). Dense records always have indexes == NULL,
+		so records built outside a DataSet must set it (a memset is enough).
+		Dense records may store their values with a smaller type than double (see "type"). Use EntryData_ToDense to read them
+		as doubles. Sparse records always store doubles. */
 	typedef struct
 	{
-		double * features;
+		union
+		{
+			double * features;		/* DS_ET_DOUBLE values, and the values of sparse records */
+			float * floatFeatures;	/* DS_ET_FLOAT values */
+			unsigned char * byteFeatures;	/* DS_ET_UINT8 and DS_ET_BIT values */
+		};
 		int class;
+		unsigned int * indexes;		/* Column of each value of a sparse record. NULL on dense records */
+		unsigned long nnz;			/* Number of values stored on a sparse record. Unused on dense records */
+		EntryType type;				/* Type of the values of a dense record */
 	}EntryData;
 
 	/* Data Set representation */
@@ -31,11 +53,20 @@ extern "C" {
 		/* Variables */
 		PUBLIC unsigned long featsCount;											/* Number of features in a record */
 		PUBLIC unsigned long classesCount;											/* Total number of classes in the Data Set */
+		PROTECTED double * batchFeatures;											/* Buffer where nextBatch copies the features of the records */
+		PROTECTED int * batchClasses;												/* Buffer where nextBatch copies the classes of the records */
+		PROTECTED unsigned long batchCapacity;										/* Number of records that fit on the batch buffers */
 		/* Functions */
 		/*	Returns a pointer to the next entry to be used. The pointer must not be freed by the calling function.  
 			This functions returns a pointer instead of copying the data to achieve better performance. It's unsafe to
 			assume anything about the returned pointer's position in memory or its neibourghs. */
 		PUBLIC int (*nextEntry)(struct DataSet * dataset, EntryData ** entry);		/* Read above. */
+		/*	Returns up to "maxCount" records at once, as a row major block of featsCount doubles per record ("features") and an array
+			with their classes ("classes"). "count" receives the number of records returned (ML_WARN_EOF is returned when there are
+			none left). Records of any storage type are returned as dense doubles. Both arrays belong to the dataset and must not be
+			modified. They remain valid until the next call to nextBatch or nextEntry.
+			Shares the read position with nextEntry, so both may be mixed. */
+		PUBLIC int (*nextBatch)(struct DataSet * dataset, unsigned long maxCount, double ** features, int ** classes, unsigned long * count);
 		PUBLIC void (*free)(struct DataSet * dataset);					/* Free all pointers allocated by this data set */
 	}DataSet;
 
@@ -47,8 +78,21 @@ extern "C" {
 	/*	Initializes the struct's variables and function pointers. 
 		NOTE: This function does NOT allocate memory for a DataSet struct. */
 	PROTECTED void DataSet_Init (DataSet * dataset);
+
+	/* Makes sure the batch buffers can hold at least "count" records */
+	PROTECTED int DataSet_ReserveBatch (DataSet * dataset, unsigned long count);
 #endif
 
+	/************************
+	* "Public" Functions	*
+	************************/
+
+	/* Copies the features of a record (dense or sparse, of any type) to "dst", an array of featsCount doubles */
+	PUBLIC void EntryData_ToDense (EntryData * entry, unsigned long featsCount, double * dst);
+
+	/* Returns the size (in bytes) of the features of a dense record of "featsCount" values stored as "type" */
+	PUBLIC size_t EntryData_RowSize (EntryType type, unsigned long featsCount);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,111 @@
+/*
+This module transforms the features of the records of a dataset while it's loaded, so they don't need a separate
+preprocessing pass (and a transformed copy of the file). Each value goes through these steps, any of them optional:
+	1.	Clipped to [clipMin, clipMax].
+	2.	Mapped through log(1 + x), to compress long tailed features. Values must be above -1 by then.
+	3.	Scaled with the statistics of its feature: standardized (minus the mean, divided by the standard deviation) or mapped
+		from [minimum, maximum] to [0, 1]. Constant features become 0.
+
+The statistics (FeatsStats) are those of the values after the first two steps. Loaders collect them from the records as
+they parse them, one FeatsStats per thread, merged at the end, and then build the FeatsTransform that scales the records.
+Scaling runs over whole rows, with loops the compiler vectorizes.
+*/
+
+#ifndef __FEATSTRANSFORM_H__
+#define __FEATSTRANSFORM_H__
+
+#include "MacLearn/DataSet/Dataset.h"	/* For EntryType */
+
+/* Scaling of each feature (the last step) */
+typedef enum{
+	FT_SC_NONE = 0,				/* Values aren't scaled (default) */
+	FT_SC_STANDARDIZE,			/* Zero mean and unit standard deviation */
+	FT_SC_MINMAX				/* From 0 (the minimum) to 1 (the maximum) */
+}FeatsScaling;
+
+/* Steps of a transform. A zeroed structure leaves the features as they are */
+typedef struct
+{
+	unsigned char clip;			/* Clip values to [clipMin, clipMax] */
+	double clipMin;
+	double clipMax;
+	unsigned char log;			/* Map values through log(1 + x) */
+	FeatsScaling scaling;		/* Scaling of each feature */
+	const struct FeatsTransform * source;	/* Scale with the statistics of another transform (i.e. the one of the training set) instead of collecting them. May be NULL */
+}FeatsTransformOptions;
+
+/* Running statistics of each feature. Values are accumulated relative to the first record, so variances don't lose precision */
+typedef struct
+{
+	unsigned long featsCount;
+	unsigned long long count;	/* Number of records added */
+	double * shift;				/* Values of the first record */
+	double * sum;				/* Sum of the values minus their shift */
+	double * sumSq;				/* Sum of the squares of the values minus their shift */
+	double * min;
+	double * max;
+}FeatsStats;
+
+/* A transform ready to be applied to the records of a dataset */
+typedef struct FeatsTransform
+{
+	FeatsTransformOptions options;	/* Steps of the transform ("source" is always NULL) */
+	unsigned long featsCount;
+	double * mean;				/* Statistics of each feature, after clipping and log. NULL without scaling */
+	double * std;
+	double * min;
+	double * max;
+	double * offset;			/* Scaling of each feature: (value - offset) * scale. NULL without scaling */
+	double * scale;
+}FeatsTransform;
+
+/* Determines if "options" change the features at all */
+#define FeatsTransform_IsSet(options)		((options)->clip || (options)->log || (options)->scaling != FT_SC_NONE)
+/* Determines if the statistics of the features must be collected to build the transform */
+#define FeatsTransform_NeedsStats(options)	((options)->scaling != FT_SC_NONE && (options)->source == NULL)
+
+/*	Returns ML_OK if "options" are valid for records of "featsCount" features, or ML_ERR_PARAM (EINVAL) if they aren't
+	(i.e. clipMin > clipMax, or a source with a different number of features or scaling) */
+int FeatsTransform_Check (const FeatsTransformOptions * options, unsigned long featsCount);
+
+/*	Clips the "count" values and maps them through log(1 + x), as told by "options" (the first two steps). Returns ML_OK,
+	or ML_ERR_PARAM (EINVAL) if a value is -1 or less when its log is taken */
+int FeatsTransform_Map (const FeatsTransformOptions * options, double * values, unsigned long count);
+
+/* Initializes empty statistics for "featsCount" features. Returns ML_OK, or ML_ERR_OUTOFMEMORY */
+int FeatsStats_Init (FeatsStats * stats, unsigned long featsCount);
+
+/* Releases the statistics. Safe to call on zeroed structures */
+void FeatsStats_Free (FeatsStats * stats);
+
+/* Adds the values of a record (a dense array of doubles) to the statistics */
+void FeatsStats_Add (FeatsStats * stats, const double * values);
+
+/* Adds the records of "src" to "dst". Empty (or zeroed) "src" statistics change nothing */
+void FeatsStats_Merge (FeatsStats * dst, const FeatsStats * src);
+
+/* Returns the (population) variance of "feature", or 0 if no records were added */
+double FeatsStats_Variance (const FeatsStats * stats, unsigned long feature);
+
+/*	Keeps only the statistics of the "count" features on "features" (in increasing order), so they match records compacted
+	to those features */
+void FeatsStats_Select (FeatsStats * stats, const unsigned long * features, unsigned long count);
+
+/*	Returns a new transform for records of "featsCount" features, or NULL on error. "stats" are only needed when
+	FeatsTransform_NeedsStats (options) */
+FeatsTransform * FeatsTransform_New (const FeatsTransformOptions * options, unsigned long featsCount, const FeatsStats * stats);
+
+/* Releases a transform. Does nothing with NULL */
+void FeatsTransform_Free (FeatsTransform * transform);
+
+/* Applies the last step to a record (a dense array of featsCount doubles) */
+void FeatsTransform_Scale (const FeatsTransform * transform, double * values);
+
+/*	Applies the last step to "rowsCount" rows of DS_ET_DOUBLE or DS_ET_FLOAT values, "rowStride" bytes apart, in parallel.
+	Rows of other types are left as they are */
+void FeatsTransform_ScaleRows (const FeatsTransform * transform, unsigned char * rows, EntryType type, size_t rowStride, unsigned long rowsCount);
+
+/* Applies every step to a record (a dense array of featsCount doubles). Returns ML_OK, or ML_ERR_PARAM as FeatsTransform_Map */
+int FeatsTransform_Apply (const FeatsTransform * transform, double * values);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+"Extends" BatchDataset (in a sense).
+This module reads NumPy arrays (.npy files) as a data set: a 2 dimensional, row major (C order) features matrix, with a row
+per record, and optionally a 1 dimensional labels array (or a single column matrix) with the label of each record.
+
+Like BinaryDataSet, the features file is memory mapped and the entries returned by nextEntry point straight into the
+mapping, so opening a data set costs almost nothing, no matter its size. Features may be float64 ("f8", read as
+DS_ET_DOUBLE records), float32 ("f4", DS_ET_FLOAT) or uint8 ("u1", DS_ET_UINT8). Labels may be uint8, int32 or int64, and
+are read to memory when loaded, to find out the number of classes. Labels always start at 0 (as usually found on NumPy
+arrays), no matter the labels a file happens to have, so each class is its label plus 1 (classesCount is the highest label
+plus 1). Negative labels aren't valid.
+*/
+
+#ifndef __NPYDATASET_H__
+#define __NPYDATASET_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	#include "MacLearn/MacLearn.h"
+	#include "MacLearn/Util/FileMap.h"	/* For FileMap */
+	#include "BatchDataset.h"		/* For BatchDataSet definitions */
+
+	/* The structure representation of a NumPy Dataset */
+	typedef struct NpyDataSet
+	{
+		BatchDataSet;									/* Holds all batch dataset vars and functions */
+		/* Declare npy specific vars */
+		PRIVATE FileMap map;							/* The memory mapped features file */
+		PRIVATE const void * features;					/* Features matrix, inside the mapping */
+		PRIVATE EntryType type;							/* Type of the elements of the features matrix */
+		PRIVATE size_t rowSize;							/* Size of each row of the features matrix, in bytes */
+		PRIVATE int * classes;							/* Class of each record. NULL for data sets without labels (all classes are 0) */
+		/* Doesn't need any specific function */
+	}NpyDataSet;
+
+#ifdef EXTEND_NPYDATASET
+	/************************
+	* "Protected" Functions	*
+	************************/
+
+	/*	Initializes the struct's variables and function pointers.
+	NOTE: This function does NOT allocate memory for a NpyDataSet struct. */
+	PROTECTED void NpyDataSet_Init (NpyDataSet * npyDataset);
+#endif
+
+	/*	Returns a new NumPy data set instance, or NULL on error. "labelsPath" may be NULL for data sets without labels.
+		The features are never copied, so both read modes behave the same. The mode only changes how the OS is told the file will be read */
+	PUBLIC NpyDataSet * NpyDataSet_New (BatchReadMode readMode, char * featuresPath, char * labelsPath);
+
+	/*	Write a dataset as a float64 features matrix and an int32 array with the label of each record (its class minus 1, so
+		it reads back as the same class). "labelsPath" may be NULL to write only the features */
+	PUBLIC int NpyDataSet_Save (DataSet * dataset, char * featuresPath, char * labelsPath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
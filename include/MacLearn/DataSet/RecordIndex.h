@@ -0,0 +1,51 @@
+/*
+This module keeps the offsets of the records of a text file on an index file, next to it ("path.mlidx"), so opening the
+file again doesn't need to scan it.
+
+An index is only used while the file is the one it was written for: its size, modification time and a hash of some pieces
+spread over it (a FileStamp) must be the same, and so must be the parameters it's read with. Offsets are stored as the
+length of each record (variable length integers), so indexes take about a byte or two per record.
+*/
+
+#ifndef __RECORDINDEX_H__
+#define __RECORDINDEX_H__
+
+#include <stdint.h>			/* For uint64_t */
+#include <sys/types.h>		/* For off_t */
+
+/* Identity of a file. Changes whenever its contents do */
+typedef struct
+{
+	uint64_t fileSize;				/* Size of the file */
+	int64_t fileTime;				/* Modification time of the file */
+	uint64_t checksum;				/* Hash of some pieces of the file */
+}FileStamp;
+
+/*	What an index holds besides the offsets: the parameters the file is read with (which must match to use it), and what the
+	scan of the file found */
+typedef struct
+{
+	unsigned char hasLabels;		/* Parameters the file is read with */
+	char delimiter;
+	unsigned long featsCount;		/* Number of features on the file */
+	off_t dataStart;				/* Offset of the first record */
+	unsigned long classesCount;		/* Found by the scan */
+	unsigned long entriesCount;
+	size_t maxLineLength;			/* Length of the longest record, with its line break */
+	off_t dataEnd;					/* Offset of the end of the records */
+}RecordIndexInfo;
+
+/* Fills "stamp" with the identity of the file on "path" as it is now. A file that can't be read gets a zeroed stamp */
+void RecordIndex_Stamp (const char * path, FileStamp * stamp);
+
+/*	Loads the index of the file on "srcPath", as long as it was written for the file as it is now and for the parameters
+	on "info" (hasLabels, delimiter, featsCount and dataStart). The rest of "info" is filled from the index, and "offsets"
+	receives the offset of every record (to be freed by the caller). Returns ML_OK, or ML_ERR_FILE (ENOENT) when there's no
+	valid index */
+int RecordIndex_Load (const char * srcPath, RecordIndexInfo * info, off_t ** offsets);
+
+/*	Writes the index of the file on "srcPath": "info" and the offsets of its info->entriesCount records. The index is written
+	to a temporary file and renamed when complete, so readers never see a partial one. Returns ML_OK or an error code */
+int RecordIndex_Save (const char * srcPath, const RecordIndexInfo * info, const off_t * offsets);
+
+#endif
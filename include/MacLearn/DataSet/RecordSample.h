@@ -0,0 +1,41 @@
+/*
+This module picks a random sample of the records (lines) of a text file, without reading the whole file.
+
+Without the offsets of the records, random byte offsets of the data are taken to the begining of the next record, so only
+the pages of the records picked need to be read. Records that follow long ones are a bit more likely to be picked, so the
+sample is only approximately uniform, and its size is approximate too (it's estimated from the lines of some pieces of the
+data). With the offsets of all the records (i.e. from an index, see RecordIndex.h) the sample is exactly uniform.
+Either way, the records picked keep their order on the file.
+*/
+
+#ifndef __RECORDSAMPLE_H__
+#define __RECORDSAMPLE_H__
+
+#include <sys/types.h>				/* For off_t */
+#include "MacLearn/Util/Random.h"	/* For Random */
+
+/* Records picked from a file */
+typedef struct
+{
+	off_t * offsets;				/* Offset of each record picked, in increasing order */
+	unsigned long count;			/* Number of records picked */
+	size_t length;					/* Length of all the records picked, with a line break each */
+	size_t maxLineLength;			/* Length of the longest record picked, with its line break */
+}RecordSample;
+
+/*	Picks about "fraction" of the records of [start, end), the data of a file loaded (or mapped) on "data". Empty lines aren't
+	records. Returns ML_OK (with no records picked when there's no data) or an error code */
+int RecordSample_FromText (RecordSample * sample, const char * data, const char * start, const char * end, double fraction, Random * random);
+
+/*	Picks "fraction" of the "count" records whose offsets (on the file on "data", which ends on "end") are "offsets". The
+	sample takes ownership of "offsets", and keeps the records picked on it. Returns ML_OK or an error code */
+int RecordSample_FromOffsets (RecordSample * sample, const char * data, const char * end, off_t * offsets, unsigned long count, double fraction, Random * random);
+
+/*	Returns the records picked, one after the other with a '\n' each (sample->length bytes), or NULL on error. The text must
+	be freed by the caller */
+char * RecordSample_Text (const RecordSample * sample, const char * data, const char * end);
+
+/* Frees the offsets of the sample */
+void RecordSample_Free (RecordSample * sample);
+
+#endif
@@ -0,0 +1,67 @@
+/*
+"Extends" BatchDataset (in a sense).
+This module presents many files (shards) as a single data set. Each shard is opened as the data set its name calls for:
+".mlbin" files as BinaryDataSet, ".arff" (or ".arff.gz") files as ArffDataSet, and anything else as CSVDataSet. Shards are
+loaded (or indexed, on INCREMENTAL datasets) concurrently, and must all have the same number of features.
+
+Records are numbered shard after shard, on the order of the shards. The read order is a single sequence of those numbers,
+so shuffle, sort and BatchDataSet_SetShuffleBlock mix the records of all shards. On reset, each shard is given the part of
+the sequence that belongs to it as its own read order, so records are still read by the shards (with their read ahead,
+cache and batch fast paths), and nextEntry / nextBatch just take them from the right shard.
+
+Shards declaring their classes (ARFF and binary ones) must agree on their number. CSV shards only find out their highest
+class, which must not be greater than that. Without any declaring shard, the highest class of all shards is used.
+
+Each shard is loaded on its own, so options that need the statistics of the records fail with EINVAL: options.prune (which
+would drop different features on each shard) and a scaling without a source transform (which would scale each shard
+differently). A transform given as options.transform.source (i.e. the "transform" of a CSVDataSet) is the same for all of
+them, so it can be used.
+*/
+
+#ifndef __SHARDEDDATASET_H__
+#define __SHARDEDDATASET_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	#include "MacLearn/MacLearn.h"
+	#include "BatchDataset.h"		/* For BatchDataSet definitions */
+
+	/* The structure representation of a Sharded Dataset */
+	typedef struct ShardedDataSet
+	{
+		BatchDataSet;									/* Holds all batch dataset vars and functions */
+		/* Declare sharded specific vars */
+		PUBLIC unsigned char hasLabels;					/* Determines if the CSV shards have column labels */
+		PUBLIC char delimiter;							/* Character that separates the values of the CSV shards */
+		PUBLIC unsigned long shardsCount;				/* Number of files of the dataset */
+		PRIVATE BatchDataSet ** shards;					/* The dataset of each file */
+		PRIVATE unsigned long * firstEntries;			/* Number of the first record of each shard (and the total number of records, at the end) */
+		PRIVATE off_t * shardOrders;					/* Original readOrder of every shard, one after the other (indexed by record number) */
+		/* Doesn't need any specific function */
+	}ShardedDataSet;
+
+#ifdef EXTEND_SHARDEDDATASET
+	/************************
+	* "Protected" Functions	*
+	************************/
+
+	/*	Initializes the struct's variables and function pointers.
+	NOTE: This function does NOT allocate memory for a ShardedDataSet struct. */
+	PROTECTED void ShardedDataSet_Init (ShardedDataSet * shardedDataset);
+#endif
+
+	/*	Returns a new sharded data set instance with the files matching "pattern" (a glob, like "data/part-*.csv"), on
+		alphabetical order, or NULL on error. "hasLabels" and "delimiter" apply to CSV shards. "options" (may be NULL to use
+		the defaults) is passed to every CSV and ARFF shard */
+	PUBLIC ShardedDataSet * ShardedDataSet_New (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char * pattern, BatchOptions * options);
+
+	/* Returns a new sharded data set instance with the "pathsCount" files on "paths", on that order, or NULL on error */
+	PUBLIC ShardedDataSet * ShardedDataSet_NewFromList (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char ** paths, unsigned long pathsCount, BatchOptions * options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
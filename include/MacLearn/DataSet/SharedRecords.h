@@ -0,0 +1,49 @@
+/*
+This module shares the records of a dataset with all the processes of the machine, on a shared memory block (see SharedMem.h).
+
+The first process to load a file publishes its records on a block named after a key: the path of the file and everything
+else that changes the records (how it's read, and the options). The next ones attach to the block read only, and point
+their records into it, without parsing the file. A block is only attached to while the file keeps its FileStamp. A block
+that's out of date is replaced when the records are published again, and so is one left incomplete by a process that's gone.
+*/
+
+#ifndef __SHAREDRECORDS_H__
+#define __SHAREDRECORDS_H__
+
+#include <stdint.h>								/* For uint64_t */
+#include "MacLearn/DataSet/Dataset.h"			/* For EntryData */
+#include "MacLearn/DataSet/RecordIndex.h"		/* For FileStamp */
+#include "MacLearn/Util/SharedMem.h"			/* For SharedMem */
+
+/* Records held by a shared block (or about to be published on one) */
+typedef struct
+{
+	unsigned long featsCount;
+	unsigned long classesCount;
+	unsigned long entriesCount;
+	unsigned char sparse;			/* Records are kept as their values and columns. Otherwise as dense rows */
+	size_t rowStride;				/* Dense records only: distance (in bytes) between the rows of consecutive records */
+	int * classes;					/* Class of every record */
+	unsigned char * rows;			/* Dense records only: rows of every record, "rowStride" bytes apart */
+	uint64_t * starts;				/* Sparse records only: position of the first value of every record (and the end of the last one) */
+	double * values;				/* Sparse records only: values of every record */
+	unsigned int * indexes;			/* Sparse records only: column of every value */
+	SharedMem shm;					/* Block the records are attached from. Zeroed when they aren't */
+}SharedRecords;
+
+/*	Returns the key of the records of the file on "srcPath", read with "params" (a text with everything else that changes
+	them), and fills "name" (SHAREDMEM_NAME_SIZE characters) with the name of their block. The key must be freed by the
+	caller. Returns NULL on error, or when blocks aren't supported */
+char * SharedRecords_Key (const char * srcPath, const char * params, char * name);
+
+/*	Attaches to the block "name", as long as it's complete and holds the records of "key", loaded from a file with "stamp".
+	featsCount, sparse and rowStride must be set: they must match the block. The rest of "records" is filled, pointing into
+	the block. Returns ML_OK, or ML_ERR_FILE (ENOENT) if there's no such block or it can't be used */
+int SharedRecords_Attach (SharedRecords * records, const char * name, const char * key, const FileStamp * stamp);
+
+/*	Publishes "records" on the block "name", for the next processes to attach to it. The class and features of each record
+	are taken from "entries", or from classes and rows when it's NULL (dense records only). Only one process publishes
+	each block: fails with EEXIST while another one is doing it. Returns ML_OK or an error code */
+int SharedRecords_Publish (const SharedRecords * records, const EntryData * entries, const char * name, const char * key, const FileStamp * stamp);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+"Extends" Dataset.
+This module implements a data set that reads CSV records from any file descriptor (stdin, a pipe, a FIFO, a socket),
+as they arrive. The source doesn't need to be seekable nor to have a known size, so it can't be reset or shuffled.
+
+The descriptor is read in blocks into a bounded buffer, and each record is parsed as soon as its line is complete.
+The number of features is taken from the first line (header or record), so creating the data set waits for it.
+classesCount starts with the value given by the caller and grows whenever a record with a higher class is read.
+*/
+
+#ifndef __STREAMDATASET_H__
+#define __STREAMDATASET_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	#include "MacLearn/MacLearn.h"
+	#include "Dataset.h"			/* For DataSet definitions */
+
+	#define STREAMDATASET_BUFFER_SIZE		(1 << 16)		/* Default size (in bytes) of the read buffer */
+	#define STREAMDATASET_MAX_LINE			(1 << 24)		/* The buffer never grows past this size. Longer lines are an error */
+
+	/* The structure representation of a Stream Dataset */
+	typedef struct StreamDataSet
+	{
+		DataSet;									/* Holds all dataset vars and functions */
+		/* Declare stream specific vars */
+		PUBLIC unsigned char hasLabels;				/* Determines if the stream starts with a line of column labels */
+		PUBLIC char delimiter;						/* Character that separates the values of a record */
+		PUBLIC unsigned long entriesRead;			/* Number of records returned so far */
+		PRIVATE int fd;								/* Descriptor the records are read from. Not owned by the data set */
+		PRIVATE char * buffer;						/* Bytes read from fd and not yet parsed are in [buffer + start, buffer + end) */
+		PRIVATE size_t bufferSize;					/* Size of the buffer */
+		PRIVATE size_t start;						/* Position of the first byte not yet parsed */
+		PRIVATE size_t end;							/* Position after the last byte read */
+		PRIVATE unsigned char eof;					/* Determines if the end of the stream was reached */
+		PRIVATE EntryData entry;					/* Holds the last record returned by nextEntry */
+		/* Doesn't need any specific function */
+	}StreamDataSet;
+
+#ifdef EXTEND_STREAMDATASET
+	/************************
+	* "Protected" Functions	*
+	************************/
+
+	/*	Initializes the struct's variables and function pointers.
+	NOTE: This function does NOT allocate memory for a StreamDataSet struct. */
+	PROTECTED void StreamDataSet_Init (StreamDataSet * streamDataset);
+#endif
+
+	/*	Returns a new stream data set reading from "fd", or NULL on error. Blocks until the first line is available.
+		"classesCount" is the number of classes expected at first (may be 0). "bufferSize" is the initial size of the read
+		buffer (0 for the default). It only grows to fit a longer line, up to STREAMDATASET_MAX_LINE.
+		nextEntry blocks until a whole record is available, and nextBatch until "maxCount" records are (or the stream ends).
+		The descriptor is not closed by free. */
+	PUBLIC StreamDataSet * StreamDataSet_New (int fd, unsigned char hasLabels, char delimiter, unsigned long classesCount, size_t bufferSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+/*
+"Extends" CSVDataset (in a sense).
+This module implements the functions needed to read an svmlight (LIBSVM) file into a data set abstraction.
+
+Each line holds a record: its label, followed by "index:value" pairs for the non zero features ("qid:n" pairs and
+anything after a '#' are ignored). Indexes start at 1, as on LIBSVM files, or at 0 with options.indexBase = BD_IB_ZERO.
+Lower indexes are an invalid file (EIO). The number of features is options.featsCount, and files with higher indexes are
+invalid (EIO). When it's 0 (the default), it's taken from the highest index of the file, so a test file missing the last
+features of its training file gets fewer of them: give the featsCount of the training file to avoid it.
+Labels must be integers. They become classes as told by options.labels, never depending on the labels a file happens to
+have, so a training and a test file always agree:
+	BD_LB_CLASSES (the default): labels are the classes (like CSV classes). Labels below 1 are an invalid file (EIO).
+	BD_LB_ZERO: labels start at 0, and each class is its label plus 1. Negative labels are an invalid file (EIO).
+	BD_LB_MAP: options.labelMap lists the label of each class, in increasing order (i.e. {-1, 1} makes -1 class 1 and
+		+1 class 2), and classesCount is its size. Labels that aren't on it are an invalid file (EIO). Without a labelMap,
+		the distinct labels of the file are mapped, and SvmLightDataSet_GetLabels returns them, so they can be the
+		labelMap of the other files of the same problem.
+Both are found in a single pass over the file, while parsing (or indexing) it.
+
+FULL datasets are always stored sparse (BD_ST_SPARSE), in a single CSR block. The file is memory mapped and split in one
+chunk per processor, each one parsed to its own buffers and then merged. INCREMENTAL datasets only find the offset of each
+record (they don't parse the values) and read them as CSVDataSet does, as dense records. Gzip compressed files are read
+as described on CSVDataset.h. The index option (BD_IX_USE) isn't used, as the features and labels are only known after a
+full pass. For the same reason, options.columns can't select features, options.sample can't pick records and
+options.prune can't drop features (EINVAL).
+Records aren't shared between processes (BD_SH_USE is ignored), and as they're sparse, BD_LY_ALIGNED is ignored too. The
+values block of FULL datasets follows the memory policy (options.memory). Sparse records can't be transformed, so
+options.transform is only used by INCREMENTAL datasets (EINVAL on FULL ones).
+*/
+
+#ifndef __SVMLIGHTDATASET_H__
+#define __SVMLIGHTDATASET_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	#include "MacLearn/MacLearn.h"
+	#include "CSVDataset.h"		/* For CSVDataSet definitions */
+
+	/* The structure representation of an svmlight Dataset */
+	typedef struct SvmLightDataSet
+	{
+		CSVDataSet;					/* Holds all csv dataset vars and functions */
+		/* Declare svmlight specific vars */
+		PRIVATE int * labels;						/* BD_LB_MAP only: labels of the classes, in increasing order. Label labels[i] is class i + 1 */
+		PRIVATE unsigned long labelsCount;			/* Number of labels */
+		PRIVATE int labelShift;						/* Added to labels to get their class when there's no map (0 or 1) */
+		PRIVATE unsigned char indexBase;			/* Index of the first feature on the file (0 or 1, from options.indexBase) */
+		/* Doesn't need any specific function */
+	}SvmLightDataSet;
+
+#ifdef EXTEND_SVMLIGHTDATASET
+	/************************
+	* "Protected" Functions	*
+	************************/
+
+	/*	Initializes the struct's variables and function pointers.
+	NOTE: This function does NOT allocate memory for a SvmLightDataSet struct. */
+	PROTECTED void SvmLightDataSet_Init (SvmLightDataSet * svmDataset);
+#endif
+
+	/* Returns a new svmlight dataset instance, or NULL on error */
+	PUBLIC SvmLightDataSet * SvmLightDataSet_New (BatchReadMode readMode, char * srcPath);
+
+	/*	Returns a new svmlight dataset instance, or NULL on error. "options" may be NULL to use the defaults. Only the
+		BD_ST_DOUBLE (the default) and BD_ST_SPARSE storage options are valid, and both store FULL datasets sparse */
+	PUBLIC SvmLightDataSet * SvmLightDataSet_NewWithOptions (BatchReadMode readMode, char * srcPath, BatchOptions * options);
+
+	/*	Returns the label of each class (label i is class i + 1) of a BD_LB_MAP dataset, or NULL on other datasets.
+		"labelsCount" receives the number of labels */
+	PUBLIC const int * SvmLightDataSet_GetLabels (SvmLightDataSet * svmDataset, unsigned long * labelsCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+/*
+This module provides a read only view of a whole file in memory.
+
+On POSIX systems the file is memory mapped, so pages are loaded on demand and shared through the page cache.
+On systems without mmap (i.e. Windows) the file is read into a malloc'd buffer, which behaves the same for the caller.
+*/
+
+#ifndef __FILEMAP_H__
+#define __FILEMAP_H__
+
+#include <stdio.h>			/* For FILE */
+#include <stddef.h>			/* For size_t */
+
+/* Expected access pattern to a mapped file. Used as a hint to the OS paging mechanisms */
+typedef enum
+{
+	FM_ACCESS_SEQUENTIAL = 1,		/* The file will be read once, from the begining to the end */
+	FM_ACCESS_RANDOM,				/* The file will be read in no particular order */
+	FM_ACCESS_WILLNEED				/* The whole file will be needed soon. Start reading it right away */
+}FileMapAccess;
+
+/* A file mapped into memory */
+typedef struct
+{
+	const char * data;		/* First byte of the file */
+	size_t size;			/* Size of the file, in bytes */
+	unsigned char mapped;	/* Determines if "data" is a mapping (1) or a malloc'd copy (0) */
+}FileMap;
+
+/* Maps the whole content of an already open file. Returns ML_OK or an error code */
+int FileMap_Open (FileMap * map, FILE * file, FileMapAccess access);
+
+/* Release the memory used by the map. Safe to call on a zeroed FileMap */
+void FileMap_Close (FileMap * map);
+
+#endif
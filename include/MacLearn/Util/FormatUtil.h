@@ -0,0 +1,23 @@
+/*
+This module provides locale independent number formatting routines used by the dataset writers.
+
+Functions write to a caller supplied buffer (without a terminating null) and return a pointer to the first character after
+the written text, so many values can be appended to the same buffer without any length bookkeeping.
+Doubles are written with the fewest digits that read back to the same value (Grisu2, by Florian Loitsch), in plain notation
+when it's short and in exponent notation otherwise. Integral values are written without a decimal point.
+*/
+
+#ifndef __FORMATUTIL_H__
+#define __FORMATUTIL_H__
+
+/* Maximum number of characters written by formatDouble (i.e. "-2.2250738585072014e-308") */
+#define FORMAT_DOUBLE_MAX		25
+/* Maximum number of characters written by formatLong */
+#define FORMAT_LONG_MAX			20
+
+/* Writes "value" at "pos", with the shortest text that parseDouble (or strtod) reads back exactly. Returns the end of the text */
+char * formatDouble (char * pos, double value);
+/* Writes "value" at "pos" in decimal. Returns the end of the text */
+char * formatLong (char * pos, long value);
+
+#endif
@@ -0,0 +1,38 @@
+/*
+This module reads gzip compressed files as if they were plain ones.
+
+The decompressed contents are exposed as a regular FILE * (so fgetc, fread, ftello and fseeko work as usual). A background
+thread inflates the file ahead of the reader, so decompression overlaps with whatever the reader does with the data.
+While inflating, a seek index is built: every GZIP_SPAN decompressed bytes (at the end of a deflate block) the position on
+the compressed file and the last 32 KB of history are saved. Seeks and random reads restart inflating from the closest
+checkpoint, instead of from the begining of the file. Files made of many gzip members (i.e. concatenated) are supported.
+
+Needs zlib, and fopencookie (glibc) or funopen (BSD) to create the stream.
+*/
+
+#ifndef __GZIPFILE_H__
+#define __GZIPFILE_H__
+
+#include <stdio.h>			/* For FILE */
+#include <stdint.h>			/* For uint64_t */
+#include <sys/types.h>		/* For ssize_t */
+
+/* A gzip compressed file, opened for reading */
+typedef struct GzipFile GzipFile;
+
+/* Determines if "file" is gzip compressed (1) or not (0), by looking at its first bytes. The file position is kept */
+int GzipFile_IsCompressed (FILE * file);
+
+/*	Opens an already open compressed file for reading. Returns NULL on error (and "file" must still be closed by the caller).
+	On success, the GzipFile owns "file": both are closed, and the GzipFile freed, when the stream is closed with fclose */
+GzipFile * GzipFile_Open (FILE * file);
+
+/* Returns the stream with the decompressed contents of the file */
+FILE * GzipFile_Stream (GzipFile * gzip);
+
+/*	Reads up to "size" bytes at position "offset" of the decompressed contents, like pread. Thread safe, and independent from
+	the stream position. Needs the whole file to have been read through the stream once (so the seek index is complete).
+	Returns the number of bytes read (0 past the end), or -1 on error */
+ssize_t GzipFile_PRead (GzipFile * gzip, void * buffer, size_t size, uint64_t offset);
+
+#endif
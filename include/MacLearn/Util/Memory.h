@@ -0,0 +1,63 @@
+/*
+This module allocates memory with a given alignment, so vectorized code can use aligned loads and whole cache lines.
+
+Large blocks (the records of a dataset, the weights of a classifier) can also be allocated following a policy: backed by huge
+pages, to cut down TLB misses when they're read in random order, and placed on the NUMA nodes of the threads that will read
+them. Policies are hints. Whatever the system doesn't support (or has no room for) falls back to regular pages and the
+default placement, so allocations only fail when there's no memory at all.
+*/
+
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <stddef.h>			/* For size_t */
+
+/* Size (in bytes) of a cache line. Also enough for the widest vector registers (AVX-512) */
+#define MEMORY_CACHE_LINE		64
+/* Size (in bytes) of the huge pages asked for (the usual size on x86-64 and ARM64) */
+#define MEMORY_HUGE_PAGE		(2 * 1024 * 1024)
+
+/* Pages backing a block */
+typedef enum{
+	MEM_PG_DEFAULT = 0,			/* Regular pages (default) */
+	MEM_PG_TRANSPARENT,			/* Transparent huge pages: the kernel backs the block with huge pages when it can */
+	MEM_PG_EXPLICIT				/* Huge pages reserved by the administrator (vm.nr_hugepages). Transparent ones if there are none left */
+}MemoryPages;
+
+/* Placement of a block on the NUMA nodes of the machine */
+typedef enum{
+	MEM_NM_DEFAULT = 0,			/* Each page goes to the node of the thread that first writes it (default) */
+	MEM_NM_INTERLEAVE,			/* Pages spread round robin over all nodes, for blocks read by threads on every node */
+	MEM_NM_BIND					/* Pages only on "node", for blocks read by threads running on that node */
+}MemoryNuma;
+
+/* How a block is allocated. A zeroed structure (or a NULL pointer) selects a plain allocation */
+typedef struct
+{
+	MemoryPages pages;			/* Pages backing the block */
+	MemoryNuma numa;			/* Placement of the block */
+	unsigned int node;			/* Node of MEM_NM_BIND (from 0 to Memory_NodesCount() - 1) */
+}MemoryPolicy;
+
+/*	Returns "size" bytes of memory starting on a multiple of "alignment" (a power of two, multiple of sizeof(void *)), or NULL
+	(with errno set to ENOMEM) on error. The memory must be released with Memory_AlignedFree, never with free */
+void * Memory_AlignedAlloc (size_t size, size_t alignment);
+
+/* Releases memory returned by Memory_AlignedAlloc. Does nothing with NULL */
+void Memory_AlignedFree (void * ptr);
+
+/*	Returns "size" bytes of memory, aligned to MEMORY_CACHE_LINE, allocated as told by "policy" (may be NULL), or NULL on
+	error (with errno set to EINVAL if the policy isn't valid, or ENOMEM). Blocks are untouched, so the pages are placed as
+	soon as they're written. The memory must be released with Memory_Free */
+void * Memory_Alloc (size_t size, const MemoryPolicy * policy);
+
+/* Releases memory returned by Memory_Alloc. Does nothing with NULL */
+void Memory_Free (void * ptr);
+
+/* Returns the number of NUMA nodes of the machine (1 if it isn't a NUMA machine, or it can't be found out) */
+unsigned int Memory_NodesCount (void);
+
+/* Returns "size" rounded up to a multiple of "alignment" (a power of two) */
+#define Memory_AlignSize(size, alignment)	(((size) + (alignment) - 1) & ~(size_t) ((alignment) - 1))
+
+#endif
@@ -0,0 +1,56 @@
+/*
+This module reads and writes the header of NumPy .npy files, so arrays can be exchanged with NumPy without any conversion.
+
+A .npy file starts with the magic "\x93NUMPY", the format version, the length of the header and the header itself: the text
+of a Python dictionary with the element type ("descr"), the order of the elements ("fortran_order") and the shape of the
+array. The elements follow the header, with no padding between them. Only the element types below, in the byte order of
+this machine, are supported.
+
+Headers written by this module always take NPY_HEADER_SIZE bytes, no matter the shape, so a writer that doesn't know the
+number of rows beforehand can write the header again once the array is complete.
+*/
+
+#ifndef __NPYFILE_H__
+#define __NPYFILE_H__
+
+#include <stdio.h>			/* For FILE */
+#include <stddef.h>			/* For size_t */
+#include <stdint.h>			/* For uint64_t */
+
+/* Size (in bytes) of the headers written by NpyFile_WriteHeader. A multiple of 64, so the elements are aligned */
+#define NPY_HEADER_SIZE			128
+/* Maximum number of dimensions of the arrays read */
+#define NPY_MAX_DIMS			8
+
+/* Types of the elements of an array */
+typedef enum
+{
+	NPY_ET_FLOAT64 = 1,				/* "f8": 64 bits IEEE 754 floating point */
+	NPY_ET_FLOAT32,					/* "f4": 32 bits IEEE 754 floating point */
+	NPY_ET_UINT8,					/* "u1": unsigned 8 bits integer */
+	NPY_ET_INT32,					/* "i4": signed 32 bits integer */
+	NPY_ET_INT64					/* "i8": signed 64 bits integer */
+}NpyElementType;
+
+/* The description of an array, read from its header */
+typedef struct
+{
+	NpyElementType type;			/* Type of the elements */
+	size_t elementSize;				/* Size of each element, in bytes */
+	unsigned char fortranOrder;		/* Determines if the elements are stored column major (1) or row major (0) */
+	unsigned char dimsCount;		/* Number of dimensions of the array (0 for a scalar) */
+	uint64_t shape[NPY_MAX_DIMS];	/* Size of each dimension */
+	uint64_t elementsCount;			/* Number of elements of the array (the product of the shape) */
+	size_t dataOffset;				/* Position of the first element on the file */
+}NpyHeader;
+
+/*	Reads the header of the "size" bytes long .npy file at "data" (usually a FileMap). Returns ML_OK, or an error code if the
+	file isn't a valid .npy file, its element type isn't supported or the elements don't fit in the file */
+int NpyFile_ReadHeader (const char * data, size_t size, NpyHeader * header);
+
+/*	Writes a NPY_HEADER_SIZE bytes header at the current position of "file", for an array of "dimsCount" dimensions (up to
+	NPY_MAX_DIMS) with the sizes on "shape". Returns ML_OK, or an error code if the shape doesn't fit in the header (never
+	happens with up to 2 dimensions) */
+int NpyFile_WriteHeader (FILE * file, NpyElementType type, unsigned char dimsCount, const uint64_t * shape);
+
+#endif
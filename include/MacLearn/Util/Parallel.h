@@ -0,0 +1,20 @@
+/*
+This module provides a minimal fork/join mechanism over POSIX threads.
+
+Work is described by an array of "task" structures, one per worker. Parallel_Run starts one thread per task (the calling
+thread runs the first task itself) and only returns after all of them finished, so callers never deal with threads directly.
+*/
+
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <stddef.h>		/* For size_t */
+
+/* Returns the number of processors available to run worker threads (at least 1) */
+unsigned int Parallel_CpuCount (void);
+
+/*	Runs "function" once for each of the "tasksCount" elements of the "tasks" array (each element has "taskSize" bytes), in parallel.
+	If threads can't be created, the remaining tasks are run on the calling thread, so all tasks are always run. */
+void Parallel_Run (void (*function)(void * task), void * tasks, size_t taskSize, unsigned int tasksCount);
+
+#endif
@@ -0,0 +1,24 @@
+/*
+This module provides locale independent text scanning and number parsing routines used by the dataset loaders.
+
+All functions work over a memory range [pos, end) instead of a FILE *, so they can be used on memory mapped files and
+on buffers that aren't null terminated. Parsing functions return a pointer to the first character after the parsed
+value, or NULL if no valid value was found.
+*/
+
+#ifndef __PARSEUTIL_H__
+#define __PARSEUTIL_H__
+
+#include <stddef.h>		/* For size_t */
+
+/* Returns a pointer to the first occurrence of "c" in [pos, end), or "end" if it isn't found */
+const char * findChar (const char * pos, const char * end, char c);
+/* Returns the number of occurrences of "c" in [pos, end) */
+size_t countChar (const char * pos, const char * end, char c);
+/*	Parses a decimal floating point value (with optional sign, fraction and exponent), or an infinity or NaN as strtod
+	reads them ("inf", "infinity", "nan" or "nan(chars)", in any case, with optional sign). Leading blanks are skipped */
+const char * parseDouble (const char * pos, const char * end, double * value);
+/* Parses a decimal integer value (with optional sign). Leading blanks are skipped */
+const char * parseLong (const char * pos, const char * end, long * value);
+
+#endif
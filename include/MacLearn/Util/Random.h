@@ -0,0 +1,46 @@
+/*
+This module provides a fast, seedable pseudo random number generator and the shuffling functions built over it.
+
+The generator is counter based (SplitMix64): the n-th number of a sequence is a hash of the seed and n, so any position of
+a sequence can be computed directly. This lets many threads draw from the same sequence without sharing any state, and
+keeps the results reproducible no matter how many threads are used.
+*/
+
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include <stdint.h>			/* For uint64_t */
+#include <stddef.h>			/* For size_t */
+#include <sys/types.h>		/* For off_t */
+
+/* A sequence of random numbers */
+typedef struct
+{
+	uint64_t seed;			/* Identifies the sequence */
+	uint64_t counter;		/* Position of the next number on the sequence */
+}Random;
+
+/* Starts the sequence identified by "seed" */
+void Random_Seed (Random * random, uint64_t seed);
+
+/* Returns a seed that changes on every call (based on the clock), for callers that don't need reproducible results */
+uint64_t Random_TimeSeed (void);
+
+/* Returns the "counter"-th number of the sequence identified by "seed" */
+uint64_t Random_At (uint64_t seed, uint64_t counter);
+
+/* Returns the next number of the sequence */
+uint64_t Random_Next (Random * random);
+
+/* Returns the next number of the sequence, uniformly distributed from 0 to bound - 1 (without the bias of a plain modulo) */
+uint64_t Random_Below (Random * random, uint64_t bound);
+
+/*	Shuffles an array of "count" off_t values (i.e. a readOrder vector). All permutations are equally likely, and the
+	same seed always gives the same permutation. Large arrays are shuffled in parallel.
+	Returns ML_OK or an error code */
+int Random_ShuffleOffsets (off_t * v, size_t count, uint64_t seed);
+
+/* Same as Random_ShuffleOffsets, for an array of elements of any size. Always runs on the calling thread */
+void Random_Shuffle (void * v, size_t elementSize, size_t count, uint64_t seed);
+
+#endif
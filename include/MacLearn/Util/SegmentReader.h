@@ -0,0 +1,34 @@
+/*
+This module parses a text file in pieces ("segments") of whole lines, as they're read.
+
+It's meant for files that can't be mapped (i.e. a GzipFile stream, being decompressed by another thread): one segment per
+processor is read and parsed in parallel, while the following ones are still being decompressed. Each segment starts with
+the incomplete line left by the previous one, and ends after its last line break, so no line is split between two of them.
+*/
+
+#ifndef __SEGMENTREADER_H__
+#define __SEGMENTREADER_H__
+
+#include <stdio.h>			/* For FILE */
+#include <stddef.h>			/* For size_t */
+#include <sys/types.h>		/* For off_t */
+
+/*	A piece of a text file, holding whole lines. The structures that describe the pieces a file is parsed in ("chunks")
+	start with it */
+typedef struct
+{
+	const char * start;				/* First byte of the segment. Always at the begining of a line */
+	const char * end;				/* Byte after the last one of the segment. Always after a '\n' or at the end of the file */
+	off_t offset;					/* Position of "start" on the file */
+	size_t size;					/* Number of bytes of the segment */
+	int ret;						/* Result of parsing the segment */
+}TextSegment;
+
+/*	Reads "file" to its end in segments, and parses them with "parse", in parallel. Each segment gets a chunk of "chunkSize"
+	bytes, a copy of "chunk" with its TextSegment filled, on the "chunks" array (to be freed by the caller, with its
+	"chunksCount" chunks). The text of the segments is freed once they're parsed, so start and end are NULL after it.
+	Reading stops after a segment fails to parse. Returns ML_OK, the "ret" of the first segment that failed (with errno set
+	to match it), or an error code */
+int SegmentReader_Parse (FILE * file, const void * chunk, size_t chunkSize, void ** chunks, unsigned long * chunksCount, void (*parse)(void * chunk));
+
+#endif
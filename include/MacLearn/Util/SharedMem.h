@@ -0,0 +1,40 @@
+/*
+This module provides named blocks of memory shared by all the processes of a machine (POSIX shared memory).
+
+A block is created (and filled) by a single process, and then opened read only by any other, which maps the very same pages:
+the contents are stored once per machine, no matter how many processes use them. Blocks outlive the processes that use
+them, until they're removed. Removing a block only removes its name: processes that have it open keep using it.
+On systems without POSIX shared memory (i.e. Windows) every function fails with ML_ERR_NOTIMPLEMENTED (ENOSYS).
+*/
+
+#ifndef __SHAREDMEM_H__
+#define __SHAREDMEM_H__
+
+#include <stddef.h>			/* For size_t */
+
+/* Maximum length of the name of a block, including the '\0' */
+#define SHAREDMEM_NAME_SIZE		64
+
+/* A shared block of memory, mapped into this process */
+typedef struct
+{
+	void * data;						/* First byte of the block */
+	size_t size;						/* Size of the block, in bytes */
+	char name[SHAREDMEM_NAME_SIZE];		/* Name of the block. It must start with '/' and have no other '/' */
+}SharedMem;
+
+/*	Creates the block "name" of "size" bytes (zero filled), and maps it for writing. Fails with EEXIST if the block already
+	exists. All the memory is reserved here, so running out of it is an error (ENOMEM) instead of a crash when writing.
+	Returns ML_OK or an error code */
+int SharedMem_Create (SharedMem * shm, const char * name, size_t size);
+
+/* Maps the existing block "name", read only. Fails with ENOENT if there's no such block. Returns ML_OK or an error code */
+int SharedMem_Open (SharedMem * shm, const char * name);
+
+/* Unmaps the block from this process. Safe to call on a zeroed SharedMem */
+void SharedMem_Close (SharedMem * shm);
+
+/* Removes the name of the block. Its memory is released once no process has it open. Returns ML_OK or an error code */
+int SharedMem_Remove (const char * name);
+
+#endif
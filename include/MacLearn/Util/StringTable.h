@@ -0,0 +1,51 @@
+/*
+This module provides a hash table that interns strings into dense integer codes.
+
+Each distinct string gets the next code (0, 1, 2, ...) the first time it's interned, so codes can index arrays directly.
+Keys are copied into a pool owned by the table, and may hold any bytes (they don't need to be null terminated).
+Lookups don't change the table, so any number of threads may call StringTable_Find at the same time, as long as no
+thread is interning strings.
+*/
+
+#ifndef __STRINGTABLE_H__
+#define __STRINGTABLE_H__
+
+#include <stddef.h>			/* For size_t */
+#include <stdint.h>			/* For uint32_t */
+
+/* A string interned by the table */
+typedef struct
+{
+	size_t offset;			/* Position of the string on the pool */
+	size_t length;			/* Length of the string, in bytes */
+	uint32_t hash;			/* Hash of the string, to skip most comparisons */
+}StringTableKey;
+
+/* A set of strings, each one with its code */
+typedef struct StringTable
+{
+	StringTableKey * keys;	/* Interned strings, indexed by code */
+	unsigned long count;	/* Number of interned strings (the next code) */
+	unsigned long * slots;	/* Open addressing table. Holds code + 1 for each used slot, 0 for empty ones */
+	size_t slotsCount;		/* Number of slots. Always a power of 2, and at least twice "count" */
+	char * pool;			/* Bytes of all interned strings, one after the other */
+	size_t poolSize;		/* Number of bytes used on the pool */
+	size_t poolCapacity;	/* Size of the pool */
+}StringTable;
+
+/* Initializes an empty table. Returns ML_OK or an error code */
+int StringTable_Init (StringTable * table);
+
+/* Release the memory used by the table. Safe to call on a zeroed StringTable */
+void StringTable_Free (StringTable * table);
+
+/* Returns the code of the "length" bytes at "key", giving them the next code if they weren't interned yet. Returns -1 on error */
+long StringTable_Intern (StringTable * table, const char * key, size_t length);
+
+/* Returns the code of the "length" bytes at "key", or -1 if they were never interned */
+long StringTable_Find (const StringTable * table, const char * key, size_t length);
+
+/* Returns the string with the given code, and its length on "length". The string isn't null terminated */
+const char * StringTable_Key (const StringTable * table, unsigned long code, size_t * length);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "MacLearn/DataSet/CSVDataset.h"
 #include "MacLearn/DataSet/ArffDataset.h"
+#include "MacLearn/DataSet/BinaryDataset.h"
 
 #ifndef TRUE
 #define TRUE	1
@@ -11,9 +12,9 @@ int main (int argc, char ** argv)
 {
 	CSVDataSet * csvDataset;			/* Structures that will hold the CSV data sets */
 
-	/* Load the training data set */
-	puts ("Loading training data set");
-	csvDataset = CSVDataSet_New(FALSE, ',', BD_RM_FULL, "datasets/digits_train.data");
+	/* Open the training data set. The writers stream the records, so they don't need to be loaded to memory first */
+	puts ("Opening training data set");
+	csvDataset = CSVDataSet_New(FALSE, ',', BD_RM_INCREMENTAL, "datasets/digits_train.data");
 	if (csvDataset == NULL)
 	{
 		puts ("Error opening training file");
@@ -24,12 +25,17 @@ int main (int argc, char ** argv)
 	puts ("Writing Arff file");
 	ArffDataSet_Save((DataSet *) csvDataset, "datasets/digits_train.arff");
 
+	/* Save the Data set as a binary file, so it can be loaded without parsing */
+	puts ("Writing binary file");
+	csvDataset->reset((BatchDataSet *) csvDataset);
+	BinaryDataSet_Save((DataSet *) csvDataset, "datasets/digits_train.mlbin");
+
 	/* Free memory */
 	csvDataset->free((DataSet *) csvDataset);
 
-	/* Load the cross validation data set */
-	puts ("Loading test data set");
-	csvDataset = CSVDataSet_New(TRUE, ';', BD_RM_FULL, "datasets/digits_test.csv");
+	/* Open the cross validation data set */
+	puts ("Opening test data set");
+	csvDataset = CSVDataSet_New(TRUE, ';', BD_RM_INCREMENTAL, "datasets/digits_test.csv");
 	if (csvDataset == NULL)
 	{
 		puts ("Error opening cross validation file");
@@ -41,6 +47,11 @@ int main (int argc, char ** argv)
 	csvDataset->reset((BatchDataSet *) csvDataset);
 	ArffDataSet_Save((DataSet *) csvDataset, "datasets/digits_test.arff");
 
+	/* Save the Data set as a binary file, so it can be loaded without parsing */
+	puts ("Writing binary file");
+	csvDataset->reset((BatchDataSet *) csvDataset);
+	BinaryDataSet_Save((DataSet *) csvDataset, "datasets/digits_test.mlbin");
+
 	/* Free memory */
 	csvDataset->free((DataSet *) csvDataset);
 
@@ -1,5 +1,6 @@
 #define EXTEND_CLASSIFIER
 #include <stdlib.h>				/* For malloc/free */
+#include <pthread.h>			/* For pthread_once */
 
 #include "MacLearn/Classifier/Classifier.h"
 #include "MacLearn/Classifier/Committee.h"
@@ -8,11 +9,17 @@
 
 /* Create a local var to save references to "super class" functions */
 static Classifier super;
-static unsigned char superInitialized = 0;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
 
 /************************
 * "Private" Functions	*
 ************************/
+static void Committee_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	Classifier_Init(&super);
+}
+
 static __inline int Committee_InternalPredict (Committee * comt, EntryData * entry, unsigned long * prediction)
 {
 	int ret;
@@ -109,14 +116,44 @@ static int Committee_Predict(Committee * comt, EntryData * entry, unsigned long
 
 #define REPORT_INTERVAL				10000
 
+/*	Define the number of records read at once by Committee_Test, and the most memory (in bytes) their features may take, so
+	batches of records with a lot of features hold less of them */
+#define BATCH_SIZE					256
+#define BATCH_MAX_BYTES				(4 * 1024 * 1024)
+
+static __inline int Committee_Count (Committee * comt, EntryData * entry, unsigned long * errorCount, unsigned long * confMatrix)
+{
+	unsigned long prediction;
+	int ret;
+
+	/* Predict the class - Stops on error */
+	ret = Committee_InternalPredict(comt, entry, &prediction);
+	if (ret != ML_OK)
+		return ret;
+
+	/* If the prediction is incorrect, increase error counter */
+	if (prediction != entry->class)
+		(*errorCount)++;
+
+	/* If the caller requested a confusion matrix, update the data */
+	if (confMatrix != NULL)
+		confMatrix[(entry->class - 1) * comt->classesCount + (prediction - 1)]++;
+
+	return ML_OK;
+}
+
 static int Committee_Test(Committee * comt, DataSet * dataset, unsigned long * testErrors, unsigned long * confMatrix)
 {
 	unsigned long auxErrorCount;
 	unsigned long currItem;
-	unsigned long report;
+	unsigned long batchSize;
+	unsigned long count;
+	unsigned long i;
 	EntryData * entry;
+	EntryData row;
+	double * feats;
+	int * classes;
 	int ret;
-	unsigned long prediction;
 	
 	/* Check that the DataSet is compatible with this committee */
 	if (comt->featsCount != dataset->featsCount || comt->classesCount != dataset->classesCount)
@@ -132,39 +169,63 @@ static int Committee_Test(Committee * comt, DataSet * dataset, unsigned long * t
 	if (confMatrix != NULL)
 		memset (confMatrix, 0, sizeof(unsigned long) * comt->classesCount * comt->classesCount);
 
-	/* Init reporting variables */
+	/*	The first record tells how the dataset stores them. Sparse records are read one by one, so the classifiers get them
+		as they are (without expanding them to all their features) */
 	currItem = 0;
-	report = REPORT_INTERVAL;
+	ret = dataset->nextEntry((DataSet *) dataset, &entry);
+	if (ret == ML_OK && entry->indexes != NULL)
+	{
+		do
+		{
+			ret = Committee_Count (comt, entry, &auxErrorCount, confMatrix);
+			if (ret != ML_OK)
+				return ret;
 
-	/* Run until the dataset entries end */
-	while (dataset->nextEntry((DataSet *) dataset, &entry) == ML_OK)
+			/* Give some feedback of current line being processed (update every 10k lines) */
+			if (++currItem % REPORT_INTERVAL == 0)
+			{
+				printf("Processed %lu entries so far\r", currItem);
+				fflush(stdout);
+			}
+		}while ((ret = dataset->nextEntry((DataSet *) dataset, &entry)) == ML_OK);
+	}
+	else if (ret == ML_OK)
 	{
-		/* Predict the class - Stops on error */
-		ret = Committee_InternalPredict(comt, entry, &prediction);
+		/* Dense records are read a whole batch at a time. The first one was already read */
+		ret = Committee_Count (comt, entry, &auxErrorCount, confMatrix);
 		if (ret != ML_OK)
 			return ret;
+		currItem = 1;
 
-		/* If the prediction is incorrect, increase error counter */
-		if (prediction != entry->class)
-			auxErrorCount++;
-
-		/* If the caller requested a confusion matrix, update the data */
-		if (confMatrix != NULL)
-			confMatrix[(entry->class - 1) * comt->classesCount + (prediction - 1)]++;
-
-		/* Update report variables */
-		currItem++;
-		report--;
-
-		/* Give some feedback of current line being processed (update every 10k lines) */
-		if (!report)
+		batchSize = BATCH_MAX_BYTES / (sizeof(double) * max (dataset->featsCount, 1UL));
+		batchSize = (batchSize < 1) ? 1 : (batchSize > BATCH_SIZE) ? BATCH_SIZE : batchSize;
+		memset (&row, 0, sizeof(EntryData));
+		row.type = DS_ET_DOUBLE;
+		while ((ret = dataset->nextBatch(dataset, batchSize, &feats, &classes, &count)) == ML_OK)
 		{
-			printf("Processed %lu entries so far\r", currItem);
-			fflush(stdout);
-			report = REPORT_INTERVAL;
+			for (i=0;i<count;i++)
+			{
+				row.features = &feats[dataset->featsCount * i];
+				row.class = classes[i];
+				ret = Committee_Count (comt, &row, &auxErrorCount, confMatrix);
+				if (ret != ML_OK)
+					return ret;
+			}
+
+			/* Give some feedback of current line being processed (update every 10k lines) */
+			if ((currItem + count) / REPORT_INTERVAL != currItem / REPORT_INTERVAL)
+			{
+				printf("Processed %lu entries so far\r", currItem + count);
+				fflush(stdout);
+			}
+			currItem += count;
 		}
 	}
 
+	/* Anything but the end of the dataset is an error */
+	if (ret != ML_WARN_EOF)
+		return ret;
+
 	/* If the caller requested an error count, save it */
 	if (testErrors != NULL)
 		*testErrors = auxErrorCount;
@@ -200,12 +261,8 @@ static void Committee_Free (Committee * comt)
 ************************/
 int Committee_Init (Committee * comt)
 {
-	/* If the local "super" isn't initialized, init it */
-	if (!superInitialized)
-	{
-		Classifier_Init(&super);
-		superInitialized = 1;
-	}
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, Committee_InitSuper);
 
 	/* Call the initializer for the "superclass" */
 	Classifier_Init((Classifier *) comt);
@@ -1,5 +1,7 @@
 #define EXTEND_CLASSIFIER
 #include <stdlib.h>				/* For malloc/free */
+#include <pthread.h>			/* For pthread_once */
+#include <stddef.h>				/* For offsetof */
 #include <limits.h>				/* For DBL_MAX */
 #ifndef WIN32
 #include <unistd.h>				/* For unlink */
@@ -14,6 +16,8 @@
 #include "MacLearn/DataSet/BatchDataset.h"
 #include "MacLearn/Classifier/Perceptron.h"
 #include "MacLearn/Util/MatrixUtil.h"			/* For Matrix multiplication functions */
+#include "MacLearn/Util/NpyFile.h"			/* For NpyFile_WriteHeader */
+#include "MacLearn/Util/Memory.h"			/* For Memory_Alloc */
 #include "MacLearn/Util/Profiler.h"
 
 /* This is stupid, but it's just to compile under VC */
@@ -21,9 +25,15 @@
 #define DBL_MAX		1000000
 #endif
 
+/*	Saved models start with the Perceptron structure up to W, the same bytes as before the input columns were added, so
+	models saved before them are still read. The input columns follow the inducers, as a tagged trailer */
+#define PERCEPTRON_SAVED_SIZE		offsetof(Perceptron, inputFeatsCount)
+#define PERCEPTRON_COLUMNS_TAG		"MLPCOLS1"
+#define PERCEPTRON_TAG_SIZE			8
+
 /* Create a local var to save references to "super class" functions */
 static Classifier super;
-static unsigned char superInitialized = 0;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
 
 /* TODO: I've removed the normalization of induced features. It is a much needed mechanism for some kind of feature induction, 
 but not for all of them, so it should be done in the InductionMechanism itself, not here */
@@ -31,6 +41,12 @@ but not for all of them, so it should be done in the InductionMechanism itself,
 /************************
 * "Private" Functions	*
 ************************/
+static void Perceptron_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	Classifier_Init(&super);
+}
+
 static __inline void SumMultVector (double * dst, double * src, double alpha, size_t len)
 {
 	size_t i;
@@ -41,6 +57,33 @@ static __inline void SumMultVector (double * dst, double * src, double alpha, si
 
 }
 
+static __inline double SparseDotProduct (double * weights, EntryData * entry, double * feats, unsigned long inducedStart, unsigned long len)
+{
+	double result;
+	unsigned long i;
+
+	/* Bias, then the non zero values of the record, and then the induced features (which are always dense) */
+	result = weights[0];
+	for (i=0;i<entry->nnz;i++)
+		result += weights[1 + entry->indexes[i]] * entry->features[i];
+	for (i=inducedStart;i<len;i++)
+		result += weights[i] * feats[i];
+
+	return result;
+}
+
+static __inline void SparseSumMultVector (double * dst, EntryData * entry, double * feats, double alpha, unsigned long inducedStart, unsigned long len)
+{
+	unsigned long i;
+
+	/* Only the weights of the bias, the non zero values and the induced features can change */
+	dst[0] += alpha;
+	for (i=0;i<entry->nnz;i++)
+		dst[1 + entry->indexes[i]] += entry->features[i] * alpha;
+	for (i=inducedStart;i<len;i++)
+		dst[i] += feats[i] * alpha;
+}
+
 static __inline int Perceptron_InternalPredict (Perceptron * pcpt, EntryData * entry, double * feats, double * predictArray, unsigned char learn, unsigned long * confMatrix)
 {
 	gsl_matrix_view WMatrix;
@@ -52,8 +95,17 @@ static __inline int Perceptron_InternalPredict (Perceptron * pcpt, EntryData * e
 	double auxValue;
 	unsigned long baseIndex;
 
-	/* Copy the entry data to the lineIn array, skipping the first position that holds the bias */
-	memcpy (&feats[1], entry->features, sizeof(double) * pcpt->featsCount);
+	/* Copy the entry data to the lineIn array, skipping the first position that holds the bias.
+	Typed records are widened to double here, so the W*X product and the W update always work over doubles.
+	Sparse records are only expanded if there are inducers, as they work over the whole record. The sparse
+	kernels below read the values straight from the entry */
+	if (entry->indexes == NULL)
+		EntryData_ToDense (entry, pcpt->featsCount, &feats[1]);
+	else if (pcpt->inducersCount > 0)
+	{
+		for (i=0;i<entry->nnz;i++)
+			feats[1 + entry->indexes[i]] = entry->features[i];
+	}
 
 	/* Set the position of the first generated feature */
 	baseIndex = pcpt->featsCount + 1;
@@ -67,17 +119,26 @@ static __inline int Perceptron_InternalPredict (Perceptron * pcpt, EntryData * e
 	}
 	Profiler_Stop ("Feat Inducing");
 
-	/* Initialize matrixes and vectors for the GSL */
-	WMatrix = gsl_matrix_view_array(pcpt->W, pcpt->classesCount, pcpt->WColumns);
-	featsVect = gsl_vector_view_array(feats, pcpt->WColumns);
-	predictVect = gsl_vector_view_array(predictArray, pcpt->classesCount);
-
 	/* Calc W * X to get the prediction array (X = feats) */
 	Profiler_Start ("W*X Calc");
-	if (gsl_blas_dgemv (CblasNoTrans, 1, &WMatrix.matrix, &featsVect.vector, 0, &predictVect.vector) != 0)
+	if (entry->indexes == NULL)
 	{
-		puts ("GSL ERROR!");
-		exit(-1);
+		/* Initialize matrixes and vectors for the GSL */
+		WMatrix = gsl_matrix_view_array(pcpt->W, pcpt->classesCount, pcpt->WColumns);
+		featsVect = gsl_vector_view_array(feats, pcpt->WColumns);
+		predictVect = gsl_vector_view_array(predictArray, pcpt->classesCount);
+
+		if (gsl_blas_dgemv (CblasNoTrans, 1, &WMatrix.matrix, &featsVect.vector, 0, &predictVect.vector) != 0)
+		{
+			puts ("GSL ERROR!");
+			exit(-1);
+		}
+	}
+	else
+	{
+		/* Only touch the columns of W that match the non zero values */
+		for (i=0;i<pcpt->classesCount;i++)
+			predictArray[i] = SparseDotProduct (&pcpt->W[pcpt->WColumns * i], entry, feats, pcpt->featsCount + 1, pcpt->WColumns);
 	}
 	Profiler_Stop ("W*X Calc");
 
@@ -111,29 +172,65 @@ static __inline int Perceptron_InternalPredict (Perceptron * pcpt, EntryData * e
 	{
 		/* Sum values on the correct class weights, and subtract from the incorrectly predicted one */
 		Profiler_Start("W update");
-		SumMultVector(&pcpt->W[pcpt->WColumns * (entry->class - 1)],feats, pcpt->alpha, pcpt->WColumns);
-		SumMultVector(&pcpt->W[pcpt->WColumns * (prediction - 1)],feats, pcpt->alpha * (-1), pcpt->WColumns);
+		if (entry->indexes == NULL)
+		{
+			SumMultVector(&pcpt->W[pcpt->WColumns * (entry->class - 1)],feats, pcpt->alpha, pcpt->WColumns);
+			SumMultVector(&pcpt->W[pcpt->WColumns * (prediction - 1)],feats, pcpt->alpha * (-1), pcpt->WColumns);
+		}
+		else
+		{
+			SparseSumMultVector(&pcpt->W[pcpt->WColumns * (entry->class - 1)], entry, feats, pcpt->alpha, pcpt->featsCount + 1, pcpt->WColumns);
+			SparseSumMultVector(&pcpt->W[pcpt->WColumns * (prediction - 1)], entry, feats, pcpt->alpha * (-1), pcpt->featsCount + 1, pcpt->WColumns);
+		}
 		Profiler_Stop("W update");
 	}
 
+	/* Clear the expanded sparse record, so lineIn is all zeros again for the next one */
+	if (entry->indexes != NULL && pcpt->inducersCount > 0)
+	{
+		for (i=0;i<entry->nnz;i++)
+			feats[1 + entry->indexes[i]] = 0;
+	}
+
 	/* Return the predicted class */
 	return prediction;
 }
 
+/* Determines if the records of "dataset" have to be gathered through the input columns */
+#define Perceptron_GathersInput(pcpt, dataset)	((pcpt)->inputColumns != NULL && (dataset)->featsCount == (pcpt)->inputFeatsCount && (dataset)->featsCount != (pcpt)->featsCount)
+
+static void Perceptron_Gather (Perceptron * pcpt, EntryData * entry, double * input, double * dst)
+{
+	unsigned long i;
+
+	/* Dense double records are read as they are. Others are expanded to all of their features first */
+	if (entry->indexes == NULL && entry->type == DS_ET_DOUBLE)
+		input = entry->features;
+	else
+		EntryData_ToDense (entry, pcpt->inputFeatsCount, input);
+
+	for (i=0;i<pcpt->featsCount;i++)
+		dst[i] = input[pcpt->inputColumns[i]];
+}
+
 /* Define the interval between status report */
 #define REPORT_INTERVAL 10000
 static int Perceptron_Run (Perceptron * pcpt, DataSet * dataset, unsigned long * errorCount, unsigned long * confMatrix, unsigned char learn)
 {
 	double * lineIn;
 	double * predictArray;
+	double * input = NULL;
 	unsigned long auxErrorCount = 1;
 	EntryData * entry;
+	EntryData gathered;
+	unsigned char gather;
 	int prediction;
 	unsigned long currItem;
 	unsigned long report;
 
 	/* Check that the DataSet is compatible with this perceptron */
-	if (pcpt->featsCount != dataset->featsCount || pcpt->classesCount != dataset->classesCount)
+	gather = Perceptron_GathersInput (pcpt, dataset);
+	if ((!gather && pcpt->featsCount != dataset->featsCount) || pcpt->classesCount != dataset->classesCount)
 	{
 		errno = EINVAL;
 		return ML_ERR_PARAM;
@@ -156,6 +253,25 @@ static int Perceptron_Run (Perceptron * pcpt, DataSet * dataset, unsigned long *
 		return ML_ERR_OUTOFMEMORY;
 	}
 
+	/* Records gathered through the input columns are expanded to "input", and their features taken to "gathered" */
+	if (gather)
+	{
+		input = (double *) malloc (sizeof(double) * (pcpt->inputFeatsCount + pcpt->featsCount));
+		if (input == NULL)
+		{
+			free (lineIn);
+			free (predictArray);
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		memset (&gathered, 0, sizeof(EntryData));
+		gathered.features = input + pcpt->inputFeatsCount;
+		gathered.type = DS_ET_DOUBLE;
+	}
+
+	/* Zero the line, so sparse records only have to write their non zero values */
+	memset (lineIn, 0, sizeof(double) * pcpt->WColumns);
+
 	/* Initialize bias to 1 - the bias won't ever change, its weight is changed independently for each class */
 	lineIn[0] = 1;
 
@@ -173,6 +289,14 @@ static int Perceptron_Run (Perceptron * pcpt, DataSet * dataset, unsigned long *
 	/* Run until the dataset entries end */
 	while (dataset->nextEntry(dataset, &entry) == ML_OK)
 	{
+		/* Take only the features of the perceptron from records of the input width */
+		if (gather)
+		{
+			Perceptron_Gather (pcpt, entry, input, gathered.features);
+			gathered.class = entry->class;
+			entry = &gathered;
+		}
+
 		/* Predict the class based on current weights vector */
 		prediction = Perceptron_InternalPredict(pcpt, entry, lineIn, predictArray, learn, confMatrix);
 
@@ -200,12 +324,216 @@ static int Perceptron_Run (Perceptron * pcpt, DataSet * dataset, unsigned long *
 	/* Free allocated memory */
 	free (lineIn);
 	free (predictArray);
+	free (input);
 
 	/* Return OK */
 	return ML_OK;
 }
 
 
+/*	Define the number of records predicted at once by Perceptron_RunBatch, and the most memory (in bytes) their features may
+	take, so batches of records with a lot of features hold less of them */
+#define BATCH_SIZE 256
+#define BATCH_MAX_BYTES (4 * 1024 * 1024)
+static unsigned long Perceptron_PredictBatch (Perceptron * pcpt, double * feats, int * classes, unsigned long count, double * predictArray, unsigned long * confMatrix)
+{
+	gsl_matrix_view WMatrix;
+	gsl_matrix_view featsMatrix;
+	gsl_matrix_view predictMatrix;
+	unsigned long errorCount = 0;
+	unsigned long i;
+	unsigned long c;
+	double max;
+	double auxValue;
+	int prediction;
+
+	/* Calc X * W' to get the prediction array of every record of the batch at once. W is taken without the bias column, whose weight is added to each prediction afterwards */
+	Profiler_Start ("W*X Calc");
+	WMatrix = gsl_matrix_view_array_with_tda(&pcpt->W[1], pcpt->classesCount, pcpt->featsCount, pcpt->WColumns);
+	featsMatrix = gsl_matrix_view_array(feats, count, pcpt->featsCount);
+	predictMatrix = gsl_matrix_view_array(predictArray, count, pcpt->classesCount);
+	if (gsl_blas_dgemm (CblasNoTrans, CblasTrans, 1, &featsMatrix.matrix, &WMatrix.matrix, 0, &predictMatrix.matrix) != 0)
+	{
+		puts ("GSL ERROR!");
+		exit(-1);
+	}
+	Profiler_Stop ("W*X Calc");
+
+	/* Find the prediction with the highest value for each record */
+	Profiler_Start ("Find Prediction");
+	for (i=0;i<count;i++)
+	{
+		max = -DBL_MAX;
+		prediction = 1;
+		for (c=0;c<pcpt->classesCount;c++)
+		{
+			auxValue = predictArray[i * pcpt->classesCount + c] + pcpt->W[pcpt->WColumns * c];
+			if (auxValue > max)
+			{
+				max = auxValue;
+				prediction = c + 1;
+			}
+		}
+
+		/* Update the error count and the confusion matrix */
+		if (prediction != classes[i])
+			errorCount++;
+		if (confMatrix != NULL)
+			confMatrix[(classes[i] - 1) * pcpt->classesCount + (prediction - 1)]++;
+	}
+	Profiler_Stop ("Find Prediction");
+
+	return errorCount;
+}
+
+static int Perceptron_RunBatch (Perceptron * pcpt, DataSet * dataset, unsigned long * errorCount, unsigned long * confMatrix)
+{
+	double * predictArray;
+	double * batchFeats;
+	double * lineIn;
+	double * input = NULL;
+	double * feats;
+	int * batchClasses;
+	int * classes;
+	EntryData * entry;
+	EntryData row;
+	unsigned char gather;
+	unsigned long batchSize;
+	unsigned long count = 0;
+	unsigned long auxErrorCount = 0;
+	unsigned long currItem = 0;
+	unsigned long i;
+	int ret;
+
+	/* Check that the DataSet is compatible with this perceptron */
+	gather = Perceptron_GathersInput (pcpt, dataset);
+	if ((!gather && pcpt->featsCount != dataset->featsCount) || pcpt->classesCount != dataset->classesCount)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/*	Get storage for the features, classes and predictions of a whole batch, for a single record line (of sparse records)
+		and for the records gathered through the input columns. Batches are as big as the features of the records read (the
+		width of the dataset) allow */
+	batchSize = BATCH_MAX_BYTES / (sizeof(double) * max (dataset->featsCount, pcpt->featsCount));
+	batchSize = (batchSize < 1) ? 1 : (batchSize > BATCH_SIZE) ? BATCH_SIZE : batchSize;
+	predictArray = (double *) malloc (sizeof(double) * pcpt->classesCount * batchSize);
+	batchFeats = (double *) malloc (sizeof(double) * pcpt->featsCount * batchSize);
+	batchClasses = (int *) malloc (sizeof(int) * batchSize);
+	lineIn = (double *) malloc (sizeof(double) * pcpt->WColumns);
+	if (gather)
+		input = (double *) malloc (sizeof(double) * pcpt->inputFeatsCount);
+	if (predictArray == NULL || batchFeats == NULL || batchClasses == NULL || lineIn == NULL || (gather && input == NULL))
+	{
+		free (predictArray);
+		free (batchFeats);
+		free (batchClasses);
+		free (lineIn);
+		free (input);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Zero the line, so sparse records only have to write their non zero values, and set the bias */
+	memset (lineIn, 0, sizeof(double) * pcpt->WColumns);
+	lineIn[0] = 1;
+
+	/* If the caller requested a confusion matrix, zero all the values - the values will later be incremented, not directly written */
+	if (confMatrix != NULL)
+		memset (confMatrix, 0, sizeof(unsigned long) * pcpt->classesCount * pcpt->classesCount);
+
+	/*	The first record tells how the dataset stores them. Sparse records are read one by one, and predicted with the sparse
+		kernels (so they're never expanded to all their features), unless they're gathered through the input columns */
+	ret = dataset->nextEntry(dataset, &entry);
+	if (ret == ML_OK && entry->indexes != NULL)
+	{
+		do
+		{
+			if (!gather)
+			{
+				if (Perceptron_InternalPredict(pcpt, entry, lineIn, predictArray, 0, confMatrix) != entry->class)
+					auxErrorCount++;
+			}
+			else
+			{
+				Perceptron_Gather (pcpt, entry, input, &batchFeats[pcpt->featsCount * count]);
+				batchClasses[count++] = entry->class;
+				if (count == batchSize)
+				{
+					auxErrorCount += Perceptron_PredictBatch (pcpt, batchFeats, batchClasses, count, predictArray, confMatrix);
+					count = 0;
+				}
+			}
+
+			/* Give some feedback of current line being processed (update every 10k lines) */
+			if (++currItem % REPORT_INTERVAL == 0)
+			{
+				printf("Processed %lu entries so far\r", currItem);
+				fflush(stdout);
+			}
+		}while ((ret = dataset->nextEntry(dataset, &entry)) == ML_OK);
+
+		/* Predict the last batch */
+		if (ret == ML_WARN_EOF && count > 0)
+			auxErrorCount += Perceptron_PredictBatch (pcpt, batchFeats, batchClasses, count, predictArray, confMatrix);
+	}
+	else if (ret == ML_OK)
+	{
+		/* Dense records are read a whole batch at a time, and predicted with a single matrix product. The first one was already read */
+		if (gather)
+			Perceptron_Gather (pcpt, entry, input, batchFeats);
+		else
+			EntryData_ToDense (entry, pcpt->featsCount, batchFeats);
+		batchClasses[0] = entry->class;
+		auxErrorCount += Perceptron_PredictBatch (pcpt, batchFeats, batchClasses, 1, predictArray, confMatrix);
+		currItem = 1;
+
+		memset (&row, 0, sizeof(EntryData));
+		row.type = DS_ET_DOUBLE;
+		while ((ret = dataset->nextBatch(dataset, batchSize, &feats, &classes, &count)) == ML_OK)
+		{
+			/* Records of the input width only give the perceptron its own features */
+			if (gather)
+			{
+				for (i=0;i<count;i++)
+				{
+					row.features = &feats[dataset->featsCount * i];
+					Perceptron_Gather (pcpt, &row, input, &batchFeats[pcpt->featsCount * i]);
+				}
+				feats = batchFeats;
+			}
+			auxErrorCount += Perceptron_PredictBatch (pcpt, feats, classes, count, predictArray, confMatrix);
+
+			/* Give some feedback of current line being processed (update every 10k lines) */
+			if ((currItem + count) / REPORT_INTERVAL != currItem / REPORT_INTERVAL)
+			{
+				printf("Processed %lu entries so far\r", currItem + count);
+				fflush(stdout);
+			}
+			currItem += count;
+		}
+	}
+
+	/* Free allocated memory */
+	free (predictArray);
+	free (batchFeats);
+	free (batchClasses);
+	free (lineIn);
+	free (input);
+
+	/* Anything but the end of the dataset is an error */
+	if (ret != ML_WARN_EOF)
+		return ret;
+
+	/* If the caller requested an error count, save it */
+	if (errorCount != NULL)
+		*errorCount = auxErrorCount;
+
+	/* Return OK */
+	return ML_OK;
+}
+
 static int Perceptron_BatchLearn(Perceptron * pcpt, BatchDataSet * dataset, unsigned long maxIterations, unsigned long * trainErrors, unsigned long * confMatrix)
 {
 	int ret;
@@ -249,6 +577,13 @@ static __inline int Perceptron_SingleStep(Perceptron * pcpt, EntryData * entry,
 	double * predictArray;
 	int prediction;
 
+	/* Learning (and the confusion matrix) index W by the entry's class. Streamed data sets may have found classes this perceptron doesn't know */
+	if ((learn || confMatrix != NULL) && (entry->class < 1 || (unsigned long) entry->class > pcpt->classesCount))
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
 	/* Get storage for a single entry line, considering bias and induced features */
 	lineIn = (double *) malloc (sizeof(double) * pcpt->WColumns);
 	if (lineIn == NULL)
@@ -266,6 +601,9 @@ static __inline int Perceptron_SingleStep(Perceptron * pcpt, EntryData * entry,
 		return ML_ERR_OUTOFMEMORY;
 	}
 
+	/* Zero the line, so sparse records only have to write their non zero values */
+	memset (lineIn, 0, sizeof(double) * pcpt->WColumns);
+
 	/* Initialize bias to 1 - the bias won't ever change, its weight is changed independently for each class */
 	lineIn[0] = 1;
 
@@ -296,6 +634,10 @@ static int Perceptron_Predict(Perceptron * pcpt, EntryData * entry, unsigned lon
 
 static int Perceptron_Test(Perceptron * pcpt, DataSet * dataset, unsigned long * testErrors, unsigned long * confMatrix)
 {
+	/* Without inducers, dense records are predicted in batches with a single matrix product */
+	if (pcpt->inducersCount == 0)
+		return Perceptron_RunBatch(pcpt, dataset, testErrors, confMatrix);
+
 	/* Process the DataSet in testing (not learning) mode */
 	return Perceptron_Run(pcpt, dataset, testErrors, confMatrix, 0);
 }
@@ -313,8 +655,8 @@ static int Perceptron_Save(Perceptron * pcpt, char * dstPath)
 		return ML_ERR_FILE;
 	}
 
-	/* Write Perceptron structure data */
-	fwrite (pcpt, sizeof(Perceptron), 1, out);
+	/* Write Perceptron structure data (without the input columns) */
+	fwrite (pcpt, PERCEPTRON_SAVED_SIZE, 1, out);
 
 	/* Write W data */
 	fwrite (pcpt->W, sizeof(double), pcpt->classesCount * pcpt->WColumns, out);
@@ -326,6 +668,14 @@ static int Perceptron_Save(Perceptron * pcpt, char * dstPath)
 			break;
 	}
 
+	/* Write the input columns, if there are any: the tag, the number of input features and the column of each feature */
+	if (i == pcpt->inducersCount && pcpt->inputColumns != NULL)
+	{
+		fwrite (PERCEPTRON_COLUMNS_TAG, 1, PERCEPTRON_TAG_SIZE, out);
+		fwrite (&pcpt->inputFeatsCount, sizeof(unsigned long), 1, out);
+		fwrite (pcpt->inputColumns, sizeof(unsigned long), pcpt->featsCount, out);
+	}
+
 	/* If anything went wrong, delete the file and return error */
 	if (i != pcpt->inducersCount || ferror(out))
 	{
@@ -374,11 +724,14 @@ static void Perceptron_Free (Perceptron * pcpt)
 {
 	/* Free the weights matrix */
 	if (pcpt->W != NULL)
-		free (pcpt->W);
+		Memory_Free (pcpt->W);
 
 	/* Free the inducers array */
 	Perceptron_FreeInducers (pcpt);
 
+	/* Free the input columns */
+	free (pcpt->inputColumns);
+
 	/* Call the "super class" free */
 	super.free((Classifier *) pcpt);
 }
@@ -442,12 +795,8 @@ static int Perceptron_CopyInducers (Perceptron * pcpt, int inducersCount, FeatIn
 ************************/
 int Perceptron_Init (Perceptron * pcpt)
 {
-	/* If the local "super" isn't initialized, init it */
-	if (!superInitialized)
-	{
-		Classifier_Init(&super);
-		superInitialized = 1;
-	}
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, Perceptron_InitSuper);
 
 	/* Call the initializer for the "superclass" */
 	Classifier_Init((Classifier *) pcpt);
@@ -469,6 +818,11 @@ int Perceptron_Init (Perceptron * pcpt)
 * "Public" Functions	*
 ************************/
 Perceptron * Perceptron_New (DataSet * dataset, unsigned char largeMargin, double alpha, int inducersCount, FeatInducer ** inducers)
+{
+	return Perceptron_NewWithPolicy (dataset, largeMargin, alpha, inducersCount, inducers, NULL);
+}
+
+Perceptron * Perceptron_NewWithPolicy (DataSet * dataset, unsigned char largeMargin, double alpha, int inducersCount, FeatInducer ** inducers, const MemoryPolicy * policy)
 {
 	Perceptron * pcpt;
 
@@ -502,8 +856,8 @@ Perceptron * Perceptron_New (DataSet * dataset, unsigned char largeMargin, doubl
 	/* Save the type of the perceptron */
 	pcpt->largeMargin = (largeMargin != 0);
 
-	/* malloc memory for the weights Matrix */
-	pcpt->W = (double *) malloc (sizeof(double) * pcpt->classesCount * pcpt->WColumns);
+	/* Alloc memory for the weights Matrix, following the memory policy */
+	pcpt->W = (double *) Memory_Alloc (sizeof(double) * pcpt->classesCount * pcpt->WColumns, policy);
 	if (pcpt->W == NULL)
 	{
 		Perceptron_Free (pcpt);
@@ -518,10 +872,57 @@ Perceptron * Perceptron_New (DataSet * dataset, unsigned char largeMargin, doubl
 }
 
 /* TODO: Save and load have issues when saving on one environment and then loading in a different one (32 bit -> 64 bit for instance) */
+static int Perceptron_ReadColumns (Perceptron * pcpt, FILE * in)
+{
+	char tag[PERCEPTRON_TAG_SIZE];
+	unsigned long inputFeatsCount;
+	unsigned long * columns;
+	size_t size;
+	int ret;
+
+	/* Models without input columns end after the inducers */
+	size = fread (tag, 1, PERCEPTRON_TAG_SIZE, in);
+	if (size == 0 && feof (in))
+		return ML_OK;
+
+	/* Anything else must be the input columns trailer, and nothing may follow it */
+	if (size != PERCEPTRON_TAG_SIZE || memcmp (tag, PERCEPTRON_COLUMNS_TAG, PERCEPTRON_TAG_SIZE) != 0 ||
+		fread (&inputFeatsCount, sizeof(unsigned long), 1, in) != 1)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	columns = (unsigned long *) malloc (sizeof(unsigned long) * max (pcpt->featsCount, 1));
+	if (columns == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	if (fread (columns, sizeof(unsigned long), pcpt->featsCount, in) != pcpt->featsCount || fgetc (in) != EOF)
+	{
+		free (columns);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* The columns are checked as when they're set */
+	ret = Perceptron_SetInputColumns (pcpt, inputFeatsCount, columns);
+	free (columns);
+	if (ret != ML_OK)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
 Perceptron * Perceptron_Load(char * srcPath)
 {
 	FILE * in;
 	int i;
+	unsigned long generatedFeatsCount;
 	Perceptron * pcpt;
 
 	/* Open the input file */
@@ -537,19 +938,23 @@ Perceptron * Perceptron_Load(char * srcPath)
 		return NULL;
 	}
 
-	/* Read Perceptron structure data */
-	if (fread (pcpt, sizeof(Perceptron), 1, in) != 1)
+	/*	Read Perceptron structure data, and check it's one this module could have written: every W column is the bias, a
+		feature or a generated feature */
+	memset (pcpt, 0, sizeof(Perceptron));
+	if (fread (pcpt, PERCEPTRON_SAVED_SIZE, 1, in) != 1 || pcpt->featsCount == 0 || pcpt->classesCount == 0 ||
+		pcpt->inducersCount < 0 || pcpt->WColumns <= pcpt->featsCount || pcpt->classesCount > ULONG_MAX / sizeof(double) / pcpt->WColumns)
 	{
 		fclose(in);
 		free(pcpt);
+		errno = EIO;
 		return NULL;
 	}
 
 	/* Run init to update function pointers */
 	Perceptron_Init (pcpt);
 
-	/* malloc memory for the weights Matrix */
-	pcpt->W = (double *) malloc (sizeof(double) * pcpt->classesCount * pcpt->WColumns);
+	/* Alloc memory for the weights Matrix (always freed with Memory_Free) */
+	pcpt->W = (double *) Memory_Alloc (sizeof(double) * pcpt->classesCount * pcpt->WColumns, NULL);
 	if (pcpt->W == NULL)
 	{
 		fclose(in);
@@ -562,11 +967,12 @@ Perceptron * Perceptron_Load(char * srcPath)
 	{
 		/* NOTE: The reason for not simply calling Perceptron_Free is that the inducers array may have invalid non-NULL values */
 		fclose(in);
-		free(pcpt->W);
+		Memory_Free(pcpt->W);
 		free(pcpt);
 		return NULL;
 	}
 
+
 	/* Malloc memory for the inducers array */
 	pcpt->inducers = (FeatInducer **) malloc (sizeof(FeatInducer *) * pcpt->inducersCount);
 	if (pcpt->inducers == NULL)
@@ -580,19 +986,23 @@ Perceptron * Perceptron_Load(char * srcPath)
 	memset (pcpt->inducers, 0 , sizeof(FeatInducer *) * pcpt->inducersCount);
 
 	/* Read Inducers data */
+	generatedFeatsCount = 0;
 	for (i=0;i<pcpt->inducersCount;i++)
 	{
 		/* Read each inducer instance - NOTE: We don't really care about the type of the inducer in this context */
 		pcpt->inducers[i] = FeatInducer_ReadData(in);
 		if (pcpt->inducers[i] == NULL)
 			break;
+		generatedFeatsCount += pcpt->inducers[i]->generatedFeatsCount;
 	}
 
-	/* If anything went wrong, return error */
-	if (i != pcpt->inducersCount || ferror(in))
+	/* If anything went wrong (or the inducers don't match W), return error. Then read the input columns, if it was saved with them */
+	if (i != pcpt->inducersCount || ferror(in) || pcpt->WColumns != pcpt->featsCount + 1 + generatedFeatsCount ||
+		Perceptron_ReadColumns (pcpt, in) != ML_OK)
 	{
 		fclose(in);
 		Perceptron_Free(pcpt);
+		errno = EIO;
 		return NULL;
 	}
 
@@ -603,3 +1013,103 @@ Perceptron * Perceptron_Load(char * srcPath)
 	return pcpt;
 }
 
+int Perceptron_SaveWeights (Perceptron * pcpt, char * dstPath)
+{
+	uint64_t shape[2];
+	FILE * out;
+	int ret;
+
+	/* Open the output file */
+	out = fopen (dstPath, "wb");
+	if (out == NULL)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* W is already a row major matrix, so it's written as it is */
+	shape[0] = pcpt->classesCount;
+	shape[1] = pcpt->WColumns;
+	ret = NpyFile_WriteHeader (out, NPY_ET_FLOAT64, 2, shape);
+	if (ret == ML_OK)
+		fwrite (pcpt->W, sizeof(double), pcpt->classesCount * pcpt->WColumns, out);
+
+	/* If anything went wrong, delete the file and return error */
+	if (ret != ML_OK || ferror(out))
+	{
+		fclose(out);
+		unlink(dstPath);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Close the output file */
+	fclose(out);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int Perceptron_SetInputColumns (Perceptron * pcpt, unsigned long inputFeatsCount, const unsigned long * columns)
+{
+	unsigned long * auxColumns = NULL;
+	unsigned long i;
+
+	if (columns != NULL)
+	{
+		/* The columns must exist on the input records, in increasing order and without repeats */
+		for (i=0;i<pcpt->featsCount;i++)
+		{
+			if (columns[i] >= inputFeatsCount || (i > 0 && columns[i] <= columns[i - 1]))
+			{
+				errno = EINVAL;
+				return ML_ERR_PARAM;
+			}
+		}
+
+		/* Keep a copy of them */
+		auxColumns = (unsigned long *) malloc (sizeof(unsigned long) * max (pcpt->featsCount, 1));
+		if (auxColumns == NULL)
+		{
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		memcpy (auxColumns, columns, sizeof(unsigned long) * pcpt->featsCount);
+	}
+
+	free (pcpt->inputColumns);
+	pcpt->inputColumns = auxColumns;
+	pcpt->inputFeatsCount = (columns != NULL) ? inputFeatsCount : 0;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int Perceptron_PredictInput (Perceptron * pcpt, EntryData * entry, unsigned long * predictedClass)
+{
+	EntryData gathered;
+	double * input;
+	int ret;
+
+	/* Without input columns, records already have the features of the perceptron */
+	if (pcpt->inputColumns == NULL)
+		return Perceptron_Predict (pcpt, entry, predictedClass);
+
+	/* Expand the record to "input", and take the features of the perceptron to "gathered" */
+	input = (double *) malloc (sizeof(double) * (pcpt->inputFeatsCount + pcpt->featsCount));
+	if (input == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	memset (&gathered, 0, sizeof(EntryData));
+	gathered.features = input + pcpt->inputFeatsCount;
+	gathered.type = DS_ET_DOUBLE;
+	gathered.class = entry->class;
+	Perceptron_Gather (pcpt, entry, input, gathered.features);
+
+	ret = Perceptron_Predict (pcpt, &gathered, predictedClass);
+
+	free (input);
+	return ret;
+}
@@ -1,118 +1,497 @@
 #define EXTEND_CSVDATASET		
 #include <stdlib.h>
+#include <pthread.h>			/* For pthread_once */
 #include <string.h>
+#include <ctype.h>				/* For isalnum */
 
 #include "MacLearn/DataSet/ArffDataset.h"
+#include "MacLearn/Util/ParseUtil.h"		/* For parseDouble and parseLong */
+#include "MacLearn/Util/StringTable.h"		/* For StringTable */
+
+/* Initial size (in bytes) of the buffer header lines are read to. It grows to fit longer lines */
+#define HEADER_LINE_SIZE		256
+/* Size (in bytes) of the buffer of the files written */
+#define WRITE_BUFFER_SIZE		(1 << 20)
 
 /* Create a local var to save references to "super class" functions */
 static CSVDataSet super;
-static unsigned char superInitialized = 0;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
 
 /************************
 * "Private" Functions	*
 ************************/
-static int ArffDataSet_LoadHeader (ArffDataSet * arffDataSet)
+static void ArffDataSet_InitSuper (void)
 {
-	char auxTxt[11];
-	off_t dataStartPos;
-	off_t lastAttributePos = 0;
-	unsigned long featsCount;				/* Just to reduce clutter in the code */
-	unsigned long classesCount;				/* Just to reduce clutter in the code */
-	FILE * datasetFile;						/* Just to reduce clutter in the code */
-	int ret;
+	/* Init the local "super" to get pointers to "super" functions */
+	CSVDataSet_Init(&super);
+}
 
-	/* Initialize some vars */
-	featsCount = 0;
-	classesCount = 0;
-	datasetFile = arffDataSet->file;
+static __inline const char * ArffDataSet_SkipBlanks (const char * pos, const char * end)
+{
+	while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+		pos++;
 
-	/* NOTE: Can only handle attributes of type NUMBER */
-	while (fgets (auxTxt, sizeof(auxTxt), datasetFile))
+	return pos;
+}
+
+static unsigned char ArffDataSet_IsKeyword (const char * pos, const char * end, const char * keyword)
+{
+	size_t length;
+
+	/* Keywords are case insensitive, and must not be followed by other letters or digits */
+	length = strlen (keyword);
+	return ((size_t) (end - pos) >= length && strncasecmp (pos, keyword, length) == 0 &&
+		(pos + length == end || !isalnum ((unsigned char) pos[length])));
+}
+
+static const char * ArffDataSet_Token (const char * pos, const char * end, const char * stops, const char ** token, size_t * length)
+{
+	const char * tokenEnd;
+	char quote;
+
+	/*	Quoted tokens end at the matching quote. Escaped characters are kept as they are: the header and the data escape
+		them the same way, so values still match */
+	pos = ArffDataSet_SkipBlanks (pos, end);
+	if (pos < end && (*pos == '\'' || *pos == '"'))
 	{
-		/* If read an "attribute" tag, increment the featsCount and continue */
-		if (strncasecmp (auxTxt, "@ATTRIBUTE", 10) == 0)
+		quote = *pos++;
+		*token = pos;
+		while (pos < end && *pos != quote)
 		{
-			featsCount++;
-			lastAttributePos = ftello (datasetFile);
-			continue;
+			if (*pos == '\\' && pos + 1 < end)
+				pos++;
+			pos++;
 		}
-		/* If read an @data tag, the header is over */
-		if (strncasecmp (auxTxt, "@DATA", 5) == 0)
-			break;
+		if (pos >= end)
+			return NULL;
+
+		*length = (size_t) (pos - *token);
+		return ArffDataSet_SkipBlanks (pos + 1, end);
 	}
 
-	/* Check if any error happened (or an unexpected file format) */
-	if (feof(datasetFile) || ferror(datasetFile) || featsCount == 0)
+	/* Unquoted ones end at any of the "stops" characters, without their trailing blanks */
+	*token = pos;
+	while (pos < end && strchr (stops, *pos) == NULL)
+		pos++;
+	for (tokenEnd=pos;tokenEnd > *token && (tokenEnd[-1] == ' ' || tokenEnd[-1] == '\t' || tokenEnd[-1] == '\r');tokenEnd--);
+
+	*length = (size_t) (tokenEnd - *token);
+	return pos;
+}
+
+static const char * ArffDataSet_ParseValue (ArffDataSet * arffDataset, unsigned long attribute, const char * pos, const char * end, double * value)
+{
+	const char * token;
+	size_t length;
+	long code;
+
+	/* Missing values are read as 0 */
+	pos = ArffDataSet_SkipBlanks (pos, end);
+	if (pos < end && *pos == '?')
+	{
+		*value = 0;
+		return ArffDataSet_SkipBlanks (pos + 1, end);
+	}
+
+	/* Numeric attributes hold the value itself */
+	if (arffDataset->nominals[attribute] == NULL)
+	{
+		pos = parseDouble (pos, end, value);
+		return (pos != NULL) ? ArffDataSet_SkipBlanks (pos, end) : NULL;
+	}
+
+	/* Nominal ones hold the code of one of the values declared on the header */
+	pos = ArffDataSet_Token (pos, end, ",}", &token, &length);
+	if (pos == NULL || (code = StringTable_Find (arffDataset->nominals[attribute], token, length)) < 0)
+		return NULL;
+
+	*value = (double) code;
+	return pos;
+}
+
+static const char * ArffDataSet_ParseClass (ArffDataSet * arffDataset, const char * pos, const char * end, int * class)
+{
+	double code;
+
+	/* Every record must have a class, so a missing one is an error. Classes start at 1 */
+	pos = ArffDataSet_SkipBlanks (pos, end);
+	if (pos >= end || *pos == '?')
+		return NULL;
+
+	pos = ArffDataSet_ParseValue (arffDataset, arffDataset->attributesCount - 1, pos, end, &code);
+	*class = (int) code + 1;
+	return pos;
+}
+
+static int ArffDataSet_ParseSparseLine (ArffDataSet * arffDataset, const char * line, const char * lineEnd, EntryData * entry)
+{
+	unsigned long featsCount;
+	const char * token;
+	size_t length;
+	long index;
+	long position;
+	double value;
+
+	featsCount = arffDataset->featsCount;
+
+	/* Omitted values are 0, and an omitted class is the first one declared */
+	entry->class = 1;
+	entry->nnz = 0;
+	if (entry->indexes == NULL)
+		memset (entry->features, 0, sizeof(double) * featsCount);
+
+	/* Read each "index value" pair. Callers that gave room for indexes get the record sparse, others get it expanded */
+	line = ArffDataSet_SkipBlanks (line, lineEnd);
+	while (line < lineEnd && *line != '}')
+	{
+		line = parseLong (line, lineEnd, &index);
+		if (line == NULL || index < 0 || (unsigned long) index > arffDataset->fileFeatsCount)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+
+		/* Indexes are columns of the file. Values of features that aren't loaded are skipped */
+		position = CSVDataSet_FeaturePosition ((CSVDataSet *) arffDataset, (unsigned long) index);
+		if ((unsigned long) index == arffDataset->fileFeatsCount)
+			line = ArffDataSet_ParseClass (arffDataset, line, lineEnd, &entry->class);
+		else if (position < 0)
+			line = ArffDataSet_Token (line, lineEnd, ",}", &token, &length);
+		else
+		{
+			line = ArffDataSet_ParseValue (arffDataset, (unsigned long) index, line, lineEnd, &value);
+			if (entry->indexes == NULL)
+				entry->features[position] = value;
+			else if (value != 0)
+			{
+				/* Only repeated indexes could make a record have more values than features */
+				if (entry->nnz == featsCount)
+				{
+					errno = EIO;
+					return ML_ERR_FILE;
+				}
+				entry->features[entry->nnz] = value;
+				entry->indexes[entry->nnz] = (unsigned int) position;
+				entry->nnz++;
+			}
+		}
+
+		/* Pairs are separated by commas */
+		if (line == NULL || line >= lineEnd || (*line != ',' && *line != '}'))
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		if (*line == ',')
+			line = ArffDataSet_SkipBlanks (line + 1, lineEnd);
+	}
+
+	/* Anything after the closing brace (i.e. an instance weight) is ignored */
+	if (line >= lineEnd)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int ArffDataSet_ParseLine (ArffDataSet * arffDataset, const char * line, const char * lineEnd, EntryData * entry)
+{
+	unsigned long i;
+	unsigned long selected;
+	const char * token;
+	size_t length;
+
+	/* Sparse rows are enclosed in braces */
+	line = ArffDataSet_SkipBlanks (line, lineEnd);
+	if (line < lineEnd && *line == '{')
+		return ArffDataSet_ParseSparseLine (arffDataset, line + 1, lineEnd, entry);
+
+	/* Dense rows have all features, each one followed by a comma. Those that aren't loaded are skipped, without being converted */
+	entry->indexes = NULL;
+	for (i=0,selected=0;i<arffDataset->fileFeatsCount;i++)
+	{
+		if (arffDataset->columns != NULL && (selected == arffDataset->featsCount || arffDataset->columns[selected] != i))
+			line = ArffDataSet_Token (line, lineEnd, ",", &token, &length);
+		else
+			line = ArffDataSet_ParseValue (arffDataset, i, line, lineEnd, &entry->features[selected++]);
+		if (line == NULL || line >= lineEnd || *line != ',')
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		/* Skip the delimiter */
+		line++;
+	}
+
+	/* And then the class. Anything after it (i.e. an instance weight) is ignored */
+	if (ArffDataSet_ParseClass (arffDataset, line, lineEnd, &entry->class) == NULL)
 	{
-		/* Something went wrong. Return the error */
 		errno = EIO;
 		return ML_ERR_FILE;
 	}
 
-	/* Decrement featsCount by 1, because the last "@ATTRIBUTE" is actually the "class" attribute */
-	featsCount--;
+	/* Return OK */
+	return ML_OK;
+}
 
-	/* Check if the new line after @data is already consumed. Consume it if needed */
-	if (auxTxt[strlen(auxTxt) - 1] != '\n')
-		while (fgetc(datasetFile) != '\n');
+static int ArffDataSet_ReadHeaderLine (FILE * file, char ** line, size_t * capacity, size_t * length)
+{
+	char * auxLine;
 
-	/* Save the position of the begining of the data */
-	dataStartPos = ftello (datasetFile);
+	/* fgets stops at the end of the buffer, so long lines are read in pieces, doubling the buffer each time */
+	*length = 0;
+	while (fgets (*line + *length, (int) (*capacity - *length), file) != NULL)
+	{
+		*length += strlen (*line + *length);
+		if ((*line)[*length - 1] == '\n')
+			return ML_OK;
 
-	/* Go back to the last attribute position to count the number of classes */
-	fseeko (datasetFile, lastAttributePos, SEEK_SET);
-	
-	/* Find the '{' to begin counting classes */
-	while (fgetc(datasetFile) != '{');
+		if (*length + 1 == *capacity)
+		{
+			auxLine = (char *) realloc (*line, *capacity * 2);
+			if (auxLine == NULL)
+			{
+				errno = ENOMEM;
+				return ML_ERR_OUTOFMEMORY;
+			}
+			*line = auxLine;
+			*capacity *= 2;
+		}
+	}
 
-	classesCount = 0;
-	/* Count the number of classes */
-	while (1)
+	if (ferror (file))
 	{
-		ret = fgetc(datasetFile);
-		if (ret == ',' || ret == '}')
-			classesCount++;
-		if (ret == '}')
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* The last line of the file may not have a '\n' */
+	return (*length > 0) ? ML_OK : ML_WARN_EOF;
+}
+
+static int ArffDataSet_ParseAttribute (ArffDataSet * arffDataset, const char * pos, const char * end, unsigned long * capacity)
+{
+	struct StringTable ** auxNominals;
+	StringTable * table;
+	const char * token;
+	size_t length;
+
+	/* Skip the attribute name. It may be quoted */
+	pos = ArffDataSet_Token (pos, end, " \t{", &token, &length);
+	if (pos == NULL || length == 0)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	pos = ArffDataSet_SkipBlanks (pos, end);
+
+	/* Make room for the attribute, doubling the array when it's full */
+	if (arffDataset->attributesCount == *capacity)
+	{
+		auxNominals = (struct StringTable **) realloc (arffDataset->nominals, sizeof(struct StringTable *) * max (*capacity * 2, 16));
+		if (auxNominals == NULL)
+		{
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		arffDataset->nominals = auxNominals;
+		*capacity = max (*capacity * 2, 16);
+	}
+	arffDataset->nominals[arffDataset->attributesCount++] = NULL;
+
+	/* Numeric attributes don't need anything else */
+	if (ArffDataSet_IsKeyword (pos, end, "NUMERIC") || ArffDataSet_IsKeyword (pos, end, "REAL") || ArffDataSet_IsKeyword (pos, end, "INTEGER"))
+		return ML_OK;
+
+	/* STRING, DATE and RELATIONAL attributes can't be used as features */
+	if (pos >= end || *pos != '{')
+	{
+		errno = ENOSYS;
+		return ML_ERR_NOTIMPLEMENTED;
+	}
+
+	/* Nominal ones intern their values, in the order they're declared, so each one gets its position as code */
+	table = (StringTable *) malloc (sizeof(StringTable));
+	if (table == NULL || StringTable_Init (table) != ML_OK)
+	{
+		free (table);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	arffDataset->nominals[arffDataset->attributesCount - 1] = table;
+
+	do
+	{
+		pos = ArffDataSet_Token (pos + 1, end, ",}", &token, &length);
+		if (pos == NULL || pos >= end || length == 0)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		if (StringTable_Intern (table, token, length) < 0)
+			return ML_ERR_OUTOFMEMORY;
+	}while (*pos == ',');
+
+	/* The list must be closed */
+	if (*pos != '}')
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int ArffDataSet_LoadHeader (ArffDataSet * arffDataset)
+{
+	char * line;
+	const char * pos;
+	const char * end;
+	size_t capacity;
+	size_t length;
+	unsigned long nominalsCapacity;
+	off_t dataStartPos;
+	FILE * datasetFile;						/* Just to reduce clutter in the code */
+	int ret;
+
+	datasetFile = arffDataset->file;
+	nominalsCapacity = 0;
+
+	capacity = HEADER_LINE_SIZE;
+	line = (char *) malloc (capacity);
+	if (line == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Read the declarations, up to the @data tag. Empty lines and comments are skipped */
+	for (;;)
+	{
+		ret = ArffDataSet_ReadHeaderLine (datasetFile, &line, &capacity, &length);
+		if (ret != ML_OK)
+			break;
+
+		pos = ArffDataSet_SkipBlanks (line, line + length);
+		end = (length > 0 && line[length - 1] == '\n') ? &line[length - 1] : &line[length];
+		if (pos >= end || *pos == '%')
+			continue;
+
+		if (ArffDataSet_IsKeyword (pos, end, "@ATTRIBUTE"))
+			ret = ArffDataSet_ParseAttribute (arffDataset, pos + 10, end, &nominalsCapacity);
+		else if (ArffDataSet_IsKeyword (pos, end, "@DATA"))
 			break;
+		else if (!ArffDataSet_IsKeyword (pos, end, "@RELATION"))
+		{
+			errno = EIO;
+			ret = ML_ERR_FILE;
+		}
+
+		if (ret != ML_OK)
+			break;
+	}
+
+	/* The header must end with @data, and declare at least one feature and a nominal class (the last attribute) */
+	if (ret == ML_OK && (arffDataset->attributesCount < 2 || arffDataset->nominals[arffDataset->attributesCount - 1] == NULL))
+	{
+		errno = EIO;
+		ret = ML_ERR_FILE;
+	}
+	if (ret != ML_OK)
+	{
+		free (line);
+		if (ret == ML_WARN_EOF)
+		{
+			errno = EIO;
+			ret = ML_ERR_FILE;
+		}
+		return ret;
 	}
 
-	/* Go back to the position of the begining of data */
+	/* Find the first record. Empty lines and comments before it are skipped */
+	do
+	{
+		dataStartPos = ftello (datasetFile);
+		ret = ArffDataSet_ReadHeaderLine (datasetFile, &line, &capacity, &length);
+		pos = ArffDataSet_SkipBlanks (line, line + length);
+	}while (ret == ML_OK && (pos >= line + length || *pos == '\n' || *pos == '%'));
+
+	/*	Files of sparse records are kept sparse, unless the caller chose a specific storage, or the records are transformed or
+		pruned (which needs them dense) */
+	if (ret == ML_OK && *pos == '{' && arffDataset->readMode == BD_RM_FULL && arffDataset->options.storage == BD_ST_DOUBLE &&
+		!FeatsTransform_IsSet (&arffDataset->options.transform) && arffDataset->options.prune == BD_PR_NONE)
+		arffDataset->options.storage = BD_ST_SPARSE;
+	free (line);
+	if (ret < ML_OK)
+		return ret;
+
+	/* Go back to the begining of the data */
 	fseeko (datasetFile, dataStartPos, SEEK_SET);
 
-	/* Update the structure variables */
-	arffDataSet->featsCount = featsCount;
-	arffDataSet->classesCount = classesCount;
+	/* Update the structure variables. The last attribute is the class */
+	arffDataset->featsCount = arffDataset->attributesCount - 1;
+	arffDataset->classesCount = arffDataset->nominals[arffDataset->featsCount]->count;
 
 	/* Return OK */
 	return ML_OK;
 }
 
+static void ArffDataSet_Free (ArffDataSet * arffDataset)
+{
+	unsigned long i;
+
+	/* Free the values of the nominal attributes */
+	if (arffDataset->nominals != NULL)
+	{
+		for (i=0;i<arffDataset->attributesCount;i++)
+		{
+			if (arffDataset->nominals[i] != NULL)
+			{
+				StringTable_Free (arffDataset->nominals[i]);
+				free (arffDataset->nominals[i]);
+			}
+		}
+		free (arffDataset->nominals);
+		arffDataset->nominals = NULL;
+	}
+
+	/* Call the "superclass" free function */
+	super.free((DataSet *) arffDataset);
+}
+
 /************************
 * "Protected" Functions	*
 ************************/
 void ArffDataSet_Init (ArffDataSet * arffDataset)
 {
-	/* If the local "super" isn't initialized, init it to get pointers to "super" functions */
-	if (!superInitialized)
-	{
-		CSVDataSet_Init(&super);
-		superInitialized = 1;
-	}
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, ArffDataSet_InitSuper);
 
 	/* Call the initializer for the "superclass" */
 	CSVDataSet_Init((CSVDataSet *) arffDataset);
 
 	/* Initialize the function pointers. */
 	arffDataset->loadHeader = (int (*) (struct CSVDataSet *))ArffDataSet_LoadHeader;
+	arffDataset->parseLine = (int (*) (struct CSVDataSet *, const char *, const char *, EntryData *))ArffDataSet_ParseLine;
 	//csvDataset->batchDataset.save = (int (*)(BatchDataSet *, char *)) CSVDataSet_Save;
 
-	/* No need to override free - nothing special to be done here */		
+	/* Overrides the default free method, to release the nominal values */
+	arffDataset->free = (void(*)(DataSet *)) ArffDataSet_Free;
 }
 
 /************************
 * "Public" Functions	*
 ************************/
 ArffDataSet * ArffDataSet_New (BatchReadMode readMode, char * srcPath)
+{
+	return ArffDataSet_NewWithOptions (readMode, srcPath, NULL);
+}
+
+ArffDataSet * ArffDataSet_NewWithOptions (BatchReadMode readMode, char * srcPath, BatchOptions * options)
 {
 	ArffDataSet * arffDataset;
 
@@ -131,6 +510,8 @@ ArffDataSet * ArffDataSet_New (BatchReadMode readMode, char * srcPath)
 	arffDataset->hasLabels = 1;				/* Arff files always have feature labels */
 	arffDataset->delimiter = ',';			/* Arff files always use commas as delimiter */
 	arffDataset->readMode = readMode;
+	if (options != NULL)
+		arffDataset->options = *options;
 
 	/* Load data from srcPath */
 	if (arffDataset->load((BatchDataSet *) arffDataset, srcPath) != ML_OK)
@@ -145,9 +526,9 @@ ArffDataSet * ArffDataSet_New (BatchReadMode readMode, char * srcPath)
 
 int ArffDataSet_Save (DataSet * dataset, char * outPath)
 {
-	EntryData * entry;
 	FILE * file;
 	unsigned long i;
+	int ret;
 
 	/* Open the output file */
 	file = fopen (outPath, "wb");
@@ -156,6 +537,7 @@ int ArffDataSet_Save (DataSet * dataset, char * outPath)
 		errno = EIO;
 		return ML_ERR_FILE;
 	}
+	setvbuf (file, NULL, _IOFBF, WRITE_BUFFER_SIZE);
 
 	/* Write ARFF Headers */
 	/* TODO: Require a name for the relation? */
@@ -175,20 +557,15 @@ int ArffDataSet_Save (DataSet * dataset, char * outPath)
 	/* Mark the beginning of data on the arff file */
 	fprintf(file, "@DATA\n");
 
-	/* Write all entries */
-	while (dataset->nextEntry(dataset, &entry) == ML_OK)
-	{
-		/* Write feature values */
-		for (i=0;i<dataset->featsCount;i++)
-			fprintf(file, "%lf,", entry->features[i]);
+	/* Write all entries. Dense ARFF rows are just like CSV records, with commas and the class at the end */
+	ret = CSVDataSet_WriteRecords (dataset, file, ',');
 
-		/* Write class value */
-		fprintf(file, "%d\n", entry->class);
+	/* Close the file. Buffered data is only written now, so it may fail too */
+	if (fclose (file) != 0 && ret == ML_OK)
+	{
+		errno = EIO;
+		ret = ML_ERR_FILE;
 	}
 
-	/* Close the file */
-	fclose (file);
-
-	/* Return OK */
-	return ML_OK;
+	return ret;
 }
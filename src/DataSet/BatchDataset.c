@@ -1,14 +1,22 @@
 #define EXTEND_DATASET
+#include <stdlib.h>				/* For malloc/free and qsort */
+#include <pthread.h>			/* For pthread_once */
 #include "MacLearn/DataSet/BatchDataset.h"
-#include "MacLearn/Util/MatrixUtil.h"			/* For ShuffleVector */
+#include "MacLearn/Util/Random.h"				/* For Random_ShuffleOffsets */
 
 /* Create a local var to save references to "super class" functions */
 static DataSet super;
-static unsigned char superInitialized = 0;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
 
 /************************
 * "Private" Functions	*
 ************************/
+static void BatchDataSet_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	DataSet_Init(&super);
+}
+
 static int BatchDataSet_Stub (BatchDataSet * dataset, char * path)
 {
 	/* This function should never be called. See this as an "abstract class". */
@@ -16,13 +24,60 @@ static int BatchDataSet_Stub (BatchDataSet * dataset, char * path)
 	return ML_ERR_NOTIMPLEMENTED;
 }
 
-static int BatchDataSet_ulongCompare (const void * a, const void * b)
+static int BatchDataSet_OffsetCompare (const void * a, const void * b)
 {
-	/* if a > b, returns a negative number */
-	return (*(unsigned long *)a - *(unsigned long *)b);
+	/* Compare instead of subtracting, as the difference between two offsets doesn't fit on an int */
+	if (*(off_t *)a < *(off_t *)b)
+		return -1;
+	return (*(off_t *)a > *(off_t *)b);
 }
 
-static int BatchDataSet_Sort (BatchDataSet * batchDataset)
+static void BatchDataSet_RadixSort (off_t * v, off_t * aux, size_t count)
+{
+	size_t histogram[256];
+	size_t position;
+	size_t size;
+	size_t i;
+	off_t maxValue = 0;
+	off_t * swap;
+	off_t * src = v;
+	off_t * dst = aux;
+	unsigned int shift;
+
+	/* Only the bytes used by the highest offset need to be sorted */
+	for (i=0;i<count;i++)
+		if (v[i] > maxValue)
+			maxValue = v[i];
+
+	/* Least significant digit first. Each pass is a stable counting sort over one byte of the offsets */
+	for (shift=0;shift < sizeof(off_t) * 8 && (maxValue >> shift) != 0;shift+=8)
+	{
+		memset (histogram, 0, sizeof(histogram));
+		for (i=0;i<count;i++)
+			histogram[(src[i] >> shift) & 0xFF]++;
+
+		position = 0;
+		for (i=0;i<256;i++)
+		{
+			size = histogram[i];
+			histogram[i] = position;
+			position += size;
+		}
+
+		for (i=0;i<count;i++)
+			dst[histogram[(src[i] >> shift) & 0xFF]++] = src[i];
+
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	/* After an odd number of passes the result is on "aux" */
+	if (src != v)
+		memcpy (v, src, sizeof(off_t) * count);
+}
+
+static void BatchDataSet_Restore (BatchDataSet * batchDataset, off_t * aux)
 {
 	unsigned long i;
 
@@ -33,11 +88,28 @@ static int BatchDataSet_Sort (BatchDataSet * batchDataset)
 		for (i=0;i<batchDataset->entriesCount;i++)
 			batchDataset->readOrder[i] = i;
 	}
+	else if (aux != NULL)
+	{
+		/* For "INCREMENTAL" datasets, the original order is the order of the offsets. Radix sort them in linear time */
+		BatchDataSet_RadixSort (batchDataset->readOrder, aux, batchDataset->entriesCount);
+	}
 	else
 	{
-		/* For "INCREMENTAL" datasets, the fastest way is to do a quicksort on the readOrder array */
-		qsort(batchDataset->readOrder, batchDataset->entriesCount, sizeof(batchDataset->readOrder[0]), BatchDataSet_ulongCompare);
+		/* Without memory for the radix sort, fall back to a quicksort */
+		qsort(batchDataset->readOrder, batchDataset->entriesCount, sizeof(batchDataset->readOrder[0]), BatchDataSet_OffsetCompare);
 	}
+}
+
+static int BatchDataSet_Sort (BatchDataSet * batchDataset)
+{
+	off_t * aux = NULL;
+
+	/* The radix sort needs a buffer as big as the readOrder */
+	if (batchDataset->readMode != BD_RM_FULL)
+		aux = (off_t *) malloc (sizeof(off_t) * batchDataset->entriesCount);
+
+	BatchDataSet_Restore (batchDataset, aux);
+	free (aux);
 
 	/* Resets the reading position after sorting */
 	batchDataset->reset(batchDataset);
@@ -46,10 +118,68 @@ static int BatchDataSet_Sort (BatchDataSet * batchDataset)
 	return ML_OK;
 }
 
+static int BatchDataSet_ShuffleBlocks (BatchDataSet * batchDataset, uint64_t seed)
+{
+	off_t * blocks;
+	off_t * aux;
+	unsigned long blocksCount;
+	unsigned long blockSize;
+	unsigned long first;
+	unsigned long size;
+	unsigned long position;
+	unsigned long i;
+	int ret = ML_OK;
+
+	blockSize = batchDataset->shuffleBlock;
+	blocksCount = (batchDataset->entriesCount + blockSize - 1) / blockSize;
+
+	blocks = (off_t *) malloc (sizeof(off_t) * blocksCount);
+	aux = (off_t *) malloc (sizeof(off_t) * batchDataset->entriesCount);
+	if (blocks == NULL || aux == NULL)
+	{
+		free (blocks);
+		free (aux);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Blocks are made of records that are consecutive on the original order, so restore it (keeping a copy) */
+	BatchDataSet_Restore (batchDataset, aux);
+	memcpy (aux, batchDataset->readOrder, sizeof(off_t) * batchDataset->entriesCount);
+
+	/* Shuffle the order of the blocks */
+	for (i=0;i<blocksCount;i++)
+		blocks[i] = i;
+	ret = Random_ShuffleOffsets (blocks, blocksCount, seed);
+
+	/* Copy each block to its new position, and shuffle the records inside it */
+	position = 0;
+	for (i=0;i<blocksCount && ret == ML_OK;i++)
+	{
+		first = blocks[i] * blockSize;
+		size = min (blockSize, batchDataset->entriesCount - first);
+		memcpy (&batchDataset->readOrder[position], &aux[first], sizeof(off_t) * size);
+		ret = Random_ShuffleOffsets (&batchDataset->readOrder[position], size, Random_At (seed, i));
+		position += size;
+	}
+
+	free (blocks);
+	free (aux);
+
+	return ret;
+}
+
 static int BatchDataSet_Shuffle (BatchDataSet * batchDataset)
 {
+	int ret;
+
 	/* No matter what read mode we're using, shuffling the read order will act the same as shuffling the actual records */
-	shuffleVector(batchDataset->readOrder, sizeof(batchDataset->readOrder[0]), batchDataset->entriesCount);
+	if (batchDataset->shuffleBlock > 1)
+		ret = BatchDataSet_ShuffleBlocks (batchDataset, Random_Next (&batchDataset->random));
+	else
+		ret = Random_ShuffleOffsets (batchDataset->readOrder, batchDataset->entriesCount, Random_Next (&batchDataset->random));
+	if (ret != ML_OK)
+		return ret;
 
 	/* Resets the reading position after shuffling */
 	batchDataset->reset(batchDataset);
@@ -58,6 +188,60 @@ static int BatchDataSet_Shuffle (BatchDataSet * batchDataset)
 	return ML_OK;
 }
 
+static int BatchDataSet_NextBatch (BatchDataSet * batchDataset, unsigned long maxCount, double ** features, int ** classes, unsigned long * count)
+{
+	EntryData * first;
+	EntryData * entry;
+	unsigned long i;
+	unsigned char contiguous;
+	int ret;
+
+	/* Only "FULL" datasets have all their records on the entries array. The others gather them through nextEntry */
+	if (batchDataset->readMode != BD_RM_FULL)
+		return super.nextBatch ((DataSet *) batchDataset, maxCount, features, classes, count);
+
+	/* Get room for the whole batch */
+	*count = 0;
+	ret = DataSet_ReserveBatch ((DataSet *) batchDataset, maxCount);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Check that the dataset hasn't been fully read yet */
+	if (batchDataset->currentPos >= batchDataset->entriesCount)
+		return ML_WARN_EOF;
+	*count = min (maxCount, batchDataset->entriesCount - batchDataset->currentPos);
+
+	/* Gather the classes, checking if the features of all records are already laid out as a single block of doubles */
+	first = &batchDataset->entries[batchDataset->readOrder[batchDataset->currentPos]];
+	contiguous = (first->indexes == NULL && first->type == DS_ET_DOUBLE);
+	for (i=0;i<*count;i++)
+	{
+		entry = &batchDataset->entries[batchDataset->readOrder[batchDataset->currentPos + i]];
+		batchDataset->batchClasses[i] = entry->class;
+		if (contiguous && (entry->indexes != NULL || entry->type != DS_ET_DOUBLE || entry->features != first->features + batchDataset->featsCount * i))
+			contiguous = 0;
+	}
+
+	/* If they are, the block is returned as is. If not (shuffled, sparse or typed records), copy them to the batch buffer */
+	if (contiguous)
+		*features = first->features;
+	else
+	{
+		for (i=0;i<*count;i++)
+		{
+			entry = &batchDataset->entries[batchDataset->readOrder[batchDataset->currentPos + i]];
+			EntryData_ToDense (entry, batchDataset->featsCount, &batchDataset->batchFeatures[batchDataset->featsCount * i]);
+		}
+		*features = batchDataset->batchFeatures;
+	}
+	*classes = batchDataset->batchClasses;
+
+	batchDataset->currentPos += *count;
+
+	/* Return OK */
+	return ML_OK;
+}
+
 static int BatchDataSet_Reset (BatchDataSet * batchDataset)
 {
 	/* Resets the current position to the first record */
@@ -72,12 +256,8 @@ static int BatchDataSet_Reset (BatchDataSet * batchDataset)
 ************************/
 void BatchDataSet_Init (BatchDataSet * batchDataset)
 {
-	/* If the local "super" isn't initialized, init it */
-	if (!superInitialized)
-	{
-		DataSet_Init(&super);
-		superInitialized = 1;
-	}
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, BatchDataSet_InitSuper);
 
 	/* Call the initializer for the "superclass" */
 	DataSet_Init((DataSet *) batchDataset);
@@ -91,5 +271,21 @@ void BatchDataSet_Init (BatchDataSet * batchDataset)
 	batchDataset->shuffle = BatchDataSet_Shuffle;
 	batchDataset->reset = BatchDataSet_Reset;
 
+	/* Shuffles aren't reproducible unless the caller sets a seed */
+	Random_Seed (&batchDataset->random, Random_TimeSeed ());
+
+	/* Read batches straight from the entries array */
+	batchDataset->nextBatch = (int(*)(DataSet *, unsigned long, double **, int **, unsigned long *)) BatchDataSet_NextBatch;
+
 	/* No need to override the default free method, since this class doesn't need any cleanup procedures */
 }
+
+void BatchDataSet_SetSeed (BatchDataSet * batchDataset, unsigned long long seed)
+{
+	Random_Seed (&batchDataset->random, (uint64_t) seed);
+}
+
+void BatchDataSet_SetShuffleBlock (BatchDataSet * batchDataset, unsigned long blockSize)
+{
+	batchDataset->shuffleBlock = blockSize;
+}
@@ -0,0 +1,405 @@
+#define EXTEND_DATASET
+#define EXTEND_BATCHDATASET
+#define EXTEND_BINARYDATASET		/* To get "PROTECTED" function prototypes */
+#include <stdlib.h>
+#include <pthread.h>			/* For pthread_once */
+#ifndef WIN32
+#include <unistd.h>				/* For unlink */
+#endif
+
+#include "MacLearn/DataSet/BinaryDataset.h"
+
+#define BINARY_MAGIC			"MLBINDS"		/* Identifies a binary data set file (8 bytes, including \0) */
+#define BINARY_BYTE_ORDER		0x01020304		/* Written as a native integer. Reads differently on machines with another byte order */
+#define BINARY_ALIGNMENT		64				/* Alignment (in bytes) of each section of the file */
+
+/* Rounds "offset" up to the next multiple of BINARY_ALIGNMENT */
+#define BINARY_ALIGN(offset)	(((offset) + BINARY_ALIGNMENT - 1) & ~((uint64_t) BINARY_ALIGNMENT - 1))
+
+/* File header. Must be exactly BINARY_ALIGNMENT bytes long */
+typedef struct
+{
+	char magic[8];					/* BINARY_MAGIC */
+	uint32_t version;				/* BINARYDATASET_VERSION of the writer */
+	uint32_t byteOrder;				/* BINARY_BYTE_ORDER */
+	uint32_t elementType;			/* One of BinaryElementType */
+	uint32_t reserved;				/* Always zero */
+	uint64_t featsCount;
+	uint64_t classesCount;
+	uint64_t entriesCount;
+	uint64_t featuresOffset;		/* Position of the features matrix on the file */
+	uint64_t classesOffset;			/* Position of the classes array on the file */
+}BinaryHeader;
+
+/* Create a local var to save references to "super class" functions */
+static BatchDataSet super;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
+
+/************************
+* "Private" Functions	*
+************************/
+static void BinaryDataSet_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	BatchDataSet_Init(&super);
+}
+
+static int BinaryDataSet_NextEntry (BinaryDataSet * binDataset, EntryData ** entry)
+{
+	off_t nextPos;
+
+	/* Check that the dataset hasn't been fully read yet */
+	if (binDataset->currentPos >= binDataset->entriesCount)
+		return ML_WARN_EOF;
+
+	/* Point the single entry straight into the mapping. Nothing is copied but the class */
+	nextPos = binDataset->readOrder[binDataset->currentPos++];
+	binDataset->entries->features = (double *) binDataset->features + (binDataset->featsCount * nextPos);
+	binDataset->entries->class = binDataset->classes[nextPos];
+	binDataset->entries->indexes = NULL;
+	binDataset->entries->type = DS_ET_DOUBLE;
+
+	*entry = binDataset->entries;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int BinaryDataSet_NextBatch (BinaryDataSet * binDataset, unsigned long maxCount, double ** features, int ** classes, unsigned long * count)
+{
+	off_t first;
+	unsigned long i;
+	unsigned char contiguous = 1;
+	int ret;
+
+	/* Get room for the whole batch */
+	*count = 0;
+	ret = DataSet_ReserveBatch ((DataSet *) binDataset, maxCount);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Check that the dataset hasn't been fully read yet */
+	if (binDataset->currentPos >= binDataset->entriesCount)
+		return ML_WARN_EOF;
+	*count = min (maxCount, binDataset->entriesCount - binDataset->currentPos);
+
+	/* Gather the classes, checking if the records are consecutive on the file */
+	first = binDataset->readOrder[binDataset->currentPos];
+	for (i=0;i<*count;i++)
+	{
+		binDataset->batchClasses[i] = binDataset->classes[binDataset->readOrder[binDataset->currentPos + i]];
+		if (binDataset->readOrder[binDataset->currentPos + i] != first + (off_t) i)
+			contiguous = 0;
+	}
+
+	/* Consecutive records are returned straight from the mapping. Otherwise, copy them to the batch buffer */
+	if (contiguous)
+		*features = (double *) binDataset->features + (binDataset->featsCount * first);
+	else
+	{
+		for (i=0;i<*count;i++)
+			memcpy (&binDataset->batchFeatures[binDataset->featsCount * i],
+					binDataset->features + (binDataset->featsCount * binDataset->readOrder[binDataset->currentPos + i]),
+					sizeof(double) * binDataset->featsCount);
+		*features = binDataset->batchFeatures;
+	}
+	*classes = binDataset->batchClasses;
+
+	binDataset->currentPos += *count;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int BinaryDataSet_CheckHeader (BinaryHeader * header, size_t fileSize)
+{
+	/* Check that the file was written by a compatible writer */
+	if (memcmp (header->magic, BINARY_MAGIC, sizeof(header->magic)) != 0	||
+		header->version != BINARYDATASET_VERSION								||
+		header->byteOrder != BINARY_BYTE_ORDER									||
+		header->elementType != BIN_ET_DOUBLE)
+		return 0;
+
+	/* Check the sections alignment */
+	if (header->featuresOffset % BINARY_ALIGNMENT != 0 || header->classesOffset % BINARY_ALIGNMENT != 0)
+		return 0;
+
+	/*	Check that both sections fit in the file (avoiding overflows on corrupted headers), in order and without overlapping:
+		the features after the header, and the classes after the features */
+	if (header->featsCount == 0 || header->featuresOffset < sizeof(BinaryHeader) || header->featuresOffset > fileSize || header->classesOffset > fileSize)
+		return 0;
+	if (header->entriesCount > (fileSize - header->featuresOffset) / sizeof(double) / header->featsCount)
+		return 0;
+	if (header->classesOffset < header->featuresOffset + header->entriesCount * header->featsCount * sizeof(double))
+		return 0;
+	if (header->entriesCount > (fileSize - header->classesOffset) / sizeof(int32_t))
+		return 0;
+
+	return 1;
+}
+
+static int BinaryDataSet_Load (BinaryDataSet * binDataset, char * srcPath)
+{
+	BinaryHeader * header;
+	FileMapAccess access;
+	unsigned long i;
+	int ret;
+
+	/* Check the read mode. It only determines how the file will be accessed */
+	if (binDataset->readMode == BD_RM_FULL)
+		access = FM_ACCESS_WILLNEED;
+	else if (binDataset->readMode == BD_RM_INCREMENTAL)
+		access = FM_ACCESS_RANDOM;
+	else
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Open the dataset file */
+	binDataset->file = fopen (srcPath, "rb");
+	if (binDataset->file == NULL)
+	{
+		errno = ENOENT;
+		return ML_ERR_FILENOTFOUND;
+	}
+
+	/* Map the whole file. The mapping stays valid after the file is closed */
+	ret = FileMap_Open (&binDataset->map, binDataset->file, access);
+	fclose (binDataset->file);
+	binDataset->file = NULL;
+	if (ret != ML_OK)
+		return ret;
+
+	/* Validate the header */
+	header = (BinaryHeader *) binDataset->map.data;
+	if (binDataset->map.size < sizeof(BinaryHeader) || !BinaryDataSet_CheckHeader (header, binDataset->map.size))
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Point to the sections of the file */
+	binDataset->featsCount = (unsigned long) header->featsCount;
+	binDataset->classesCount = (unsigned long) header->classesCount;
+	binDataset->entriesCount = (unsigned long) header->entriesCount;
+	binDataset->features = (const double *) (binDataset->map.data + header->featuresOffset);
+	binDataset->classes = (const int32_t *) (binDataset->map.data + header->classesOffset);
+
+	/* The readOrder stores the index of each record, no matter the read mode */
+	binDataset->readOrder = (off_t *) malloc (sizeof(off_t) * binDataset->entriesCount);
+	if (binDataset->readOrder == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	for (i=0;i<binDataset->entriesCount;i++)
+		binDataset->readOrder[i] = i;
+
+	/* A single entry is used to return all records. Its features pointer is updated on each call */
+	binDataset->entries = (EntryData *) malloc (sizeof(EntryData));
+	if (binDataset->entries == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void BinaryDataSet_Free (BinaryDataSet * binDataset)
+{
+	/* Unmap the file */
+	FileMap_Close (&binDataset->map);
+
+	/* Free the readOrder array */
+	if (binDataset->readOrder != NULL)
+	{
+		free (binDataset->readOrder);
+		binDataset->readOrder = NULL;
+	}
+
+	/* Free the entry. Its features point into the mapping, so they must NOT be freed */
+	if (binDataset->entries != NULL)
+	{
+		free (binDataset->entries);
+		binDataset->entries = NULL;
+	}
+
+	/* Call the "superclass" free function */
+	super.free((DataSet *) binDataset);
+}
+
+/************************
+* "Protected" Functions	*
+************************/
+void BinaryDataSet_Init (BinaryDataSet * binDataset)
+{
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, BinaryDataSet_InitSuper);
+
+	/* Call the initializer for the "superclass" */
+	BatchDataSet_Init((BatchDataSet *) binDataset);
+
+	/* Initialize the function pointers. */
+	binDataset->load = (int (*)(BatchDataSet *, char *)) BinaryDataSet_Load;
+	binDataset->nextEntry = (int(*)(DataSet *, EntryData **)) BinaryDataSet_NextEntry;
+	binDataset->nextBatch = (int(*)(DataSet *, unsigned long, double **, int **, unsigned long *)) BinaryDataSet_NextBatch;
+
+	/* Overrides the default free method */
+	binDataset->free = (void(*)(DataSet *)) BinaryDataSet_Free;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+BinaryDataSet * BinaryDataSet_New (BatchReadMode readMode, char * srcPath)
+{
+	BinaryDataSet * binDataset;
+
+	/* malloc memory to store the structure */
+	binDataset = (BinaryDataSet *) malloc (sizeof(BinaryDataSet));
+	if (binDataset == NULL)
+		return NULL;
+
+	/* Zero memory */
+	memset (binDataset, 0, sizeof(BinaryDataSet));
+
+	/* Initialize the structure data and pointers */
+	BinaryDataSet_Init(binDataset);
+
+	/* Initialize instance data */
+	binDataset->readMode = readMode;
+
+	/* Load data from srcPath */
+	if (binDataset->load((BatchDataSet *) binDataset, srcPath) != ML_OK)
+	{
+		binDataset->free((DataSet *) binDataset);
+		return NULL;
+	}
+
+	/* Return the new instance */
+	return binDataset;
+}
+
+int BinaryDataSet_Save (DataSet * dataset, char * outPath)
+{
+	static const char padding[BINARY_ALIGNMENT] = {0};
+	BinaryHeader header;
+	EntryData * entry;
+	FILE * file;
+	int32_t * classes;
+	int32_t * auxClasses;
+	unsigned long capacity;
+	uint64_t featuresEnd;
+	double * dense;
+	int ret = ML_OK;
+
+	/* Get a buffer to expand sparse records */
+	dense = (double *) malloc (sizeof(double) * dataset->featsCount);
+	if (dense == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Open the output file */
+	file = fopen (outPath, "wb");
+	if (file == NULL)
+	{
+		free (dense);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* The classes are written after all features, so keep them in memory while writing the features */
+	capacity = 1024;
+	classes = (int32_t *) malloc (sizeof(int32_t) * capacity);
+	if (classes == NULL)
+	{
+		free (dense);
+		fclose (file);
+		unlink (outPath);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Fill the header. The number of records and the classes offset are only known at the end */
+	memset (&header, 0, sizeof(BinaryHeader));
+	memcpy (header.magic, BINARY_MAGIC, sizeof(header.magic));
+	header.version = BINARYDATASET_VERSION;
+	header.byteOrder = BINARY_BYTE_ORDER;
+	header.elementType = BIN_ET_DOUBLE;
+	header.featsCount = dataset->featsCount;
+	header.classesCount = dataset->classesCount;
+	header.featuresOffset = BINARY_ALIGN(sizeof(BinaryHeader));
+
+	/* Reserve space for the header */
+	fwrite (padding, 1, header.featuresOffset, file);
+
+	/* Write all entries' features */
+	while (dataset->nextEntry(dataset, &entry) == ML_OK)
+	{
+		/* Grow the classes array if needed */
+		if (header.entriesCount == capacity)
+		{
+			capacity *= 2;
+			auxClasses = (int32_t *) realloc (classes, sizeof(int32_t) * capacity);
+			if (auxClasses == NULL)
+			{
+				ret = ML_ERR_OUTOFMEMORY;
+				break;
+			}
+			classes = auxClasses;
+		}
+
+		/* Sparse and typed records must be expanded before being written */
+		if (entry->indexes != NULL || entry->type != DS_ET_DOUBLE)
+		{
+			EntryData_ToDense (entry, dataset->featsCount, dense);
+			fwrite (dense, sizeof(double), dataset->featsCount, file);
+		}
+		else
+			fwrite (entry->features, sizeof(double), dataset->featsCount, file);
+		classes[header.entriesCount++] = entry->class;
+	}
+
+	/* Without room for the classes, the file can't be completed */
+	if (ret != ML_OK)
+	{
+		free (classes);
+		free (dense);
+		fclose (file);
+		unlink (outPath);
+		errno = ENOMEM;
+		return ret;
+	}
+
+	/* Write the classes on the next aligned position */
+	featuresEnd = header.featuresOffset + header.entriesCount * dataset->featsCount * sizeof(double);
+	header.classesOffset = BINARY_ALIGN(featuresEnd);
+	fwrite (padding, 1, header.classesOffset - featuresEnd, file);
+	fwrite (classes, sizeof(int32_t), header.entriesCount, file);
+	free (classes);
+	free (dense);
+
+	/* Now the header is complete. Write it at the begining of the file */
+	fseeko (file, 0, SEEK_SET);
+	fwrite (&header, sizeof(BinaryHeader), 1, file);
+
+	/* If anything went wrong, delete the file and return error */
+	if (ferror(file))
+	{
+		fclose (file);
+		unlink (outPath);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Close the file */
+	fclose (file);
+
+	/* Return OK */
+	return ML_OK;
+}
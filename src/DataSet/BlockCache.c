@@ -0,0 +1,278 @@
+#include <stdlib.h>				/* For malloc/free */
+#include <string.h>				/* For memcpy and memset */
+#include <pthread.h>
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/DataSet/BlockCache.h"
+#include "MacLearn/Util/ParseUtil.h"		/* For findChar */
+
+/* Records of a region of the file, already parsed */
+typedef struct
+{
+	off_t * offsets;				/* Offset of each record on the file, in increasing order */
+	double * features;				/* featsCount features of each record */
+	int * classes;					/* Class of each record */
+	unsigned long entriesCount;		/* Number of records of the block */
+	size_t size;					/* Memory used by the block, in bytes */
+	unsigned char referenced;		/* Determines if the block was used since the CLOCK hand last passed over it */
+}BlockCacheBlock;
+
+struct BlockCache
+{
+	BlockCacheSource source;		/* File the records come from */
+	pthread_mutex_t lock;			/* Protects the whole cache */
+	BlockCacheBlock ** blocks;		/* Cached blocks, by block number. NULL if the block isn't cached */
+	unsigned long blocksCount;		/* Number of blocks of the file */
+	unsigned long hand;				/* Block the CLOCK hand points to */
+	unsigned long credit;			/* Records read from the file since the hand last moved */
+	unsigned long blockEntries;		/* Average number of records on a block */
+	size_t budget;					/* Maximum memory used by the cached blocks, in bytes */
+	size_t used;					/* Memory used by the cached blocks, in bytes */
+	unsigned long hits;				/* Number of records found on the cache */
+	unsigned long misses;			/* Number of records that had to be read from the file */
+};
+
+static void BlockCache_FreeBlock (BlockCacheBlock * block)
+{
+	free (block->offsets);
+	free (block->features);
+	free (block->classes);
+	free (block);
+}
+
+static void BlockCache_MoveHand (BlockCache * cache, unsigned char evictAll)
+{
+	BlockCacheBlock * block;
+	unsigned long steps;
+
+	/* Go to the next cached block. Evict it if it wasn't used since the last visit (or always, if "evictAll" is set) */
+	for (steps=0;steps<cache->blocksCount;steps++)
+	{
+		block = cache->blocks[cache->hand];
+		cache->hand = (cache->hand + 1) % cache->blocksCount;
+		if (block == NULL)
+			continue;
+
+		if (block->referenced && !evictAll)
+			block->referenced = 0;
+		else
+		{
+			cache->used -= block->size;
+			cache->blocks[(cache->hand + cache->blocksCount - 1) % cache->blocksCount] = NULL;
+			BlockCache_FreeBlock (block);
+		}
+		return;
+	}
+}
+
+static BlockCacheBlock * BlockCache_LoadBlock (BlockCache * cache, unsigned long number)
+{
+	const BlockCacheSource * source = &cache->source;
+	BlockCacheBlock * block;
+	EntryData entry;
+	off_t start;
+	off_t end;
+	off_t readStart;
+	char * text;
+	const char * textEnd;
+	const char * blockEnd;
+	const char * pos;
+	const char * lineEnd;
+	ssize_t size;
+	unsigned long i;
+
+	/*	Read the block and the rest of its last record. The byte before it is read too: if it's a '\n', a record starts
+		right at the begining of the block */
+	start = source->dataStart + (off_t) number * BLOCKCACHE_BLOCK_SIZE;
+	end = min (start + BLOCKCACHE_BLOCK_SIZE, source->dataEnd);
+	readStart = (start > source->dataStart) ? start - 1 : start;
+	text = (char *) malloc ((size_t) (end - readStart) + source->maxLineLength);
+	if (text == NULL)
+		return NULL;
+	size = source->read (source->context, text, (size_t) (end - readStart) + source->maxLineLength, readStart);
+	if (size <= 0)
+	{
+		free (text);
+		return NULL;
+	}
+	textEnd = text + size;
+	blockEnd = text + (end - readStart);
+
+	/* Find the first record, and count the records that start on the block */
+	pos = text + (start - readStart);
+	if (start > readStart && *text != '\n')
+		pos = findChar (pos, textEnd, '\n') + 1;
+	block = (BlockCacheBlock *) calloc (1, sizeof(BlockCacheBlock));
+	if (block == NULL)
+	{
+		free (text);
+		return NULL;
+	}
+	for (lineEnd=pos - 1;lineEnd + 1 < blockEnd && lineEnd + 1 < textEnd;lineEnd=findChar (lineEnd + 1, textEnd, '\n'))
+		block->entriesCount++;
+
+	block->offsets = (off_t *) malloc (sizeof(off_t) * block->entriesCount);
+	block->features = (double *) malloc (sizeof(double) * source->featsCount * block->entriesCount);
+	block->classes = (int *) malloc (sizeof(int) * block->entriesCount);
+	if (block->offsets == NULL || block->features == NULL || block->classes == NULL)
+	{
+		BlockCache_FreeBlock (block);
+		free (text);
+		return NULL;
+	}
+	block->size = sizeof(BlockCacheBlock) + (sizeof(off_t) + sizeof(double) * source->featsCount + sizeof(int)) * block->entriesCount;
+
+	/* Parse them all. Any error drops the block, and its records are read one by one (so errors are reported by record) */
+	memset (&entry, 0, sizeof(EntryData));
+	for (i=0;i<block->entriesCount;i++)
+	{
+		lineEnd = findChar (pos, textEnd, '\n');
+		entry.features = &block->features[source->featsCount * i];
+		entry.indexes = NULL;
+		if (source->parse (source->context, pos, lineEnd, &entry) != ML_OK)
+		{
+			BlockCache_FreeBlock (block);
+			free (text);
+			return NULL;
+		}
+		block->offsets[i] = readStart + (pos - text);
+		block->classes[i] = entry.class;
+		pos = lineEnd + 1;
+	}
+
+	free (text);
+	return block;
+}
+
+static size_t BlockCache_EstimateBlock (BlockCache * cache)
+{
+	/* Memory used by a parsed block with the average number of records */
+	return sizeof(BlockCacheBlock) + (sizeof(off_t) + sizeof(double) * cache->source.featsCount + sizeof(int)) * cache->blockEntries;
+}
+
+BlockCache * BlockCache_New (const BlockCacheSource * source, size_t budget)
+{
+	BlockCache * cache;
+
+	/* Create the cache, with room for a pointer to every block of the file */
+	cache = (BlockCache *) calloc (1, sizeof(BlockCache));
+	if (cache == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	cache->source = *source;
+	cache->blocksCount = (unsigned long) ((source->dataEnd - source->dataStart) / BLOCKCACHE_BLOCK_SIZE) + 1;
+	cache->blocks = (BlockCacheBlock **) calloc (cache->blocksCount, sizeof(BlockCacheBlock *));
+	if (cache->blocks == NULL)
+	{
+		free (cache);
+		errno = ENOMEM;
+		return NULL;
+	}
+	pthread_mutex_init (&cache->lock, NULL);
+	cache->blockEntries = max (source->entriesCount / cache->blocksCount, 1UL);
+
+	/* A smaller budget would never cache a block. Round it up to one */
+	cache->budget = max (budget, BlockCache_EstimateBlock (cache));
+
+	/* Return the new cache */
+	return cache;
+}
+
+void BlockCache_SetBudget (BlockCache * cache, size_t budget)
+{
+	pthread_mutex_lock (&cache->lock);
+	cache->budget = max (budget, BlockCache_EstimateBlock (cache));
+	while (cache->used > cache->budget)
+		BlockCache_MoveHand (cache, 1);
+	pthread_mutex_unlock (&cache->lock);
+}
+
+unsigned char BlockCache_Read (BlockCache * cache, off_t offset, EntryData * entry)
+{
+	BlockCacheBlock * block;
+	unsigned long number;
+	unsigned long first;
+	unsigned long last;
+	unsigned long middle;
+	size_t estimate;
+
+	pthread_mutex_lock (&cache->lock);
+	number = (unsigned long) ((offset - cache->source.dataStart) / BLOCKCACHE_BLOCK_SIZE);
+	block = cache->blocks[number];
+	if (block != NULL)
+		cache->hits++;
+	else
+	{
+		cache->misses++;
+
+		/* Every block's worth of records read from the file lets the hand move once, to make room for new blocks */
+		estimate = BlockCache_EstimateBlock (cache);
+		if (++cache->credit >= cache->blockEntries && cache->used + estimate > cache->budget)
+		{
+			cache->credit = 0;
+			BlockCache_MoveHand (cache, 0);
+		}
+
+		/* Blocks that don't fit aren't cached */
+		if (cache->used + estimate <= cache->budget)
+		{
+			block = BlockCache_LoadBlock (cache, number);
+			if (block != NULL)
+			{
+				cache->blocks[number] = block;
+				cache->used += block->size;
+			}
+		}
+	}
+
+	/* Find the record on the block */
+	if (block != NULL)
+	{
+		first = 0;
+		last = block->entriesCount;
+		while (first < last)
+		{
+			middle = first + (last - first) / 2;
+			if (block->offsets[middle] < offset)
+				first = middle + 1;
+			else
+				last = middle;
+		}
+		if (first < block->entriesCount && block->offsets[first] == offset)
+		{
+			memcpy (entry->features, &block->features[cache->source.featsCount * first], sizeof(double) * cache->source.featsCount);
+			entry->class = block->classes[first];
+			entry->indexes = NULL;
+			block->referenced = 1;
+			pthread_mutex_unlock (&cache->lock);
+			return 1;
+		}
+	}
+	pthread_mutex_unlock (&cache->lock);
+
+	return 0;
+}
+
+void BlockCache_GetStats (BlockCache * cache, unsigned long * hits, unsigned long * misses)
+{
+	pthread_mutex_lock (&cache->lock);
+	*hits = cache->hits;
+	*misses = cache->misses;
+	pthread_mutex_unlock (&cache->lock);
+}
+
+void BlockCache_Free (BlockCache * cache)
+{
+	unsigned long i;
+
+	for (i=0;i<cache->blocksCount;i++)
+	{
+		if (cache->blocks[i] != NULL)
+			BlockCache_FreeBlock (cache->blocks[i]);
+	}
+	pthread_mutex_destroy (&cache->lock);
+	free (cache->blocks);
+	free (cache);
+}
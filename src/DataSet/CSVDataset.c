@@ -1,47 +1,130 @@
+#define EXTEND_DATASET
 #define EXTEND_BATCHDATASET
 #define EXTEND_CSVDATASET		/* To get "PROTECTED" function prototypes */
 #include <stdlib.h>
+#include <pthread.h>
+#ifndef WIN32
+#include <unistd.h>				/* For pread */
+#include <fcntl.h>				/* For posix_fadvise */
+#endif
 
 #include "MacLearn/DataSet/CSVDataset.h"
+#include "MacLearn/Util/FileMap.h"			/* For FileMap */
+#include "MacLearn/Util/ParseUtil.h"		/* For parseDouble, parseLong and findChar */
+#include "MacLearn/Util/Parallel.h"			/* For Parallel_Run */
+#include "MacLearn/Util/GzipFile.h"			/* For GzipFile */
+#include "MacLearn/Util/SegmentReader.h"	/* For SegmentReader_Parse */
+#include "MacLearn/Util/FormatUtil.h"		/* For formatDouble and formatLong */
+#include "MacLearn/Util/Random.h"			/* For Random_Below */
+#include "MacLearn/Util/Memory.h"			/* For Memory_Alloc */
+#include "MacLearn/DataSet/FeatsTransform.h"	/* For FeatsTransform */
+#include "MacLearn/DataSet/RecordIndex.h"		/* For RecordIndex_Load and RecordIndex_Save */
+#include "MacLearn/DataSet/SharedRecords.h"	/* For SharedRecords_Attach and SharedRecords_Publish */
+#include "MacLearn/DataSet/BlockCache.h"		/* For BlockCache */
+#include "MacLearn/DataSet/RecordSample.h"		/* For RecordSample */
+
+/* Minimum size (in bytes) of a chunk of the file parsed by a single thread. Smaller files don't benefit from threading */
+#define MIN_CHUNK_SIZE			(1 << 20)
+
+/* Size (in bytes) of the features of the records formatted at once by the writers. Each thread formats a slice of them */
+#define WRITE_BATCH_SIZE		(16 << 20)
+/* Size (in bytes) of the buffer of the files written */
+#define WRITE_BUFFER_SIZE		(1 << 20)
+
+/* A chunk of a memory mapped file (or a segment of a compressed one), parsed by a single thread */
+typedef struct
+{
+	TextSegment;					/* Piece of the file parsed, and the result of parsing it */
+	CSVDataSet * csvDataset;		/* Dataset being loaded */
+	unsigned long firstEntry;		/* Index of the first record of this chunk on the whole dataset */
+	unsigned long entriesCount;		/* Number of records on this chunk */
+	unsigned char * data;			/* Contiguous block that stores the features of all records */
+	unsigned int * dataIndexes;		/* Sparse storage only: contiguous block that stores the columns of all values */
+	EntryData * entries;			/* Array that stores all records */
+	double * values;				/* Sparse storage only: non zero values of this chunk, before being copied to "data" */
+	unsigned int * indexes;			/* Sparse storage only: column of each value of this chunk */
+	unsigned long nnz;				/* Sparse storage only: number of values of this chunk */
+	unsigned long nnzOffset;		/* Sparse storage only: position of the first value of this chunk on "data" */
+	unsigned long capacity;			/* Sparse storage only: number of values that fit in "values" and "indexes" */
+	int maxClass;					/* Highest class found on this chunk */
+	FeatsStats stats;				/* Statistics of the features of this chunk, when the transform or the pruning need them */
+}CSVChunk;
+
+/* A slice of the records of an INCREMENTAL dataset, whose features statistics are collected by a single thread */
+typedef struct
+{
+	CSVDataSet * csvDataset;		/* Dataset being loaded */
+	unsigned long first;			/* Position (on readOrder) of the first record of the slice */
+	unsigned long entriesCount;		/* Number of records on the slice */
+	FeatsStats stats;				/* Statistics of the features of the slice */
+	int ret;						/* Result of reading the slice */
+}CSVStatsTask;
+
+/* A slice of a batch of records, formatted to text by a single thread */
+typedef struct
+{
+	const double * features;		/* Features of the first record of the slice */
+	const int * classes;			/* Class of the first record of the slice */
+	unsigned long entriesCount;		/* Number of records on the slice */
+	unsigned long featsCount;		/* Number of features of each record */
+	char delimiter;					/* Character written after each feature */
+	char * text;					/* Formatted records */
+	size_t size;					/* Number of bytes of "text" used */
+	size_t capacity;				/* Size of "text". Kept from batch to batch */
+	int ret;						/* Result of formatting the slice */
+}CSVWriteTask;
+
+/* Type of the records stored with each BatchStorage option */
+static const EntryType storageTypes[] = { DS_ET_DOUBLE, DS_ET_DOUBLE, DS_ET_FLOAT, DS_ET_UINT8, DS_ET_BIT };
+
+/* Default number of records read in advance on "INCREMENTAL" datasets, and of returned records that stay valid */
+#define DEFAULT_READAHEAD		64
+#define DEFAULT_WINDOW			1
+
+/*	Read ahead state of an "INCREMENTAL" dataset. A background thread reads the records that are about to be requested
+	into a ring of entries (csvDataset->entries), while the caller consumes the ones already read.
+	The ring has "readAhead + window" slots, so the last "window" returned records are never overwritten. */
+typedef struct CSVReadAhead
+{
+	pthread_t thread;				/* Thread that reads the records */
+	pthread_mutex_t lock;			/* Protects readPos, currentPos and stop */
+	pthread_cond_t filled;			/* Signaled by the thread when a record is ready */
+	pthread_cond_t consumed;		/* Signaled by the caller when a record is returned, or when the thread must stop */
+	unsigned long readAhead;		/* Maximum number of records read in advance. 0 reads them on the calling thread */
+	unsigned long window;			/* Number of returned records that remain valid */
+	unsigned long ringSize;			/* Number of entries on the ring */
+	unsigned long readPos;			/* Next position on readOrder to be read by the thread */
+	int * status;					/* Result of reading each slot of the ring */
+	size_t maxLineLength;			/* Length of the longest line of the file, including the '\n' */
+	off_t dataStart;				/* Offset of the first record on the file */
+	off_t dataEnd;					/* Offset of the end of the file */
+	char * threadBuffer;			/* Buffer used by the thread to read one line */
+	char * callerBuffer;			/* Buffer used to read lines on the calling thread (when readAhead is 0) */
+	unsigned char running;			/* Determines if the thread was started */
+	unsigned char stop;				/* Asks the thread to stop */
+	unsigned char threadWaiting;	/* Determines if the thread is waiting for a slot. Avoids useless signals */
+	unsigned char callerWaiting;	/* Determines if the caller is waiting for a record. Avoids useless signals */
+}CSVReadAhead;
 
 /* Create a local var to save references to "super class" functions */
 static BatchDataSet super;
-static unsigned char superInitialized = 0;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
 
 /************************
 * "Private" Functions	*
 ************************/
-static int CSVDataSet_Load (CSVDataSet * csvDataset, char * srcPath)
+static void CSVDataSet_InitSuper (void)
 {
-	int ret;
-
-	/* Open the dataset file */
-	csvDataset->file = fopen (srcPath, "rb");
-	if (csvDataset->file == NULL)
-	{
-		errno = ENOENT;
-		return ML_ERR_FILENOTFOUND;
-	}
-
-	/* Load the header of the file */
-	ret = csvDataset->loadHeader(csvDataset);
-	if (ret != ML_OK)
-		return ret;
-
-	/* Load (or prepare) the data of the file */
-	ret = csvDataset->loadData(csvDataset);
-	if (ret != ML_OK)
-		return ret;
-
-	/* If readMode == FULL, and the file is still open, close the file pointer */
-	if (csvDataset->readMode == BD_RM_FULL && csvDataset->file != NULL)
-	{
-		fclose (csvDataset->file);
-		csvDataset->file = NULL;
-	}
+	/* Init the local "super" to get pointers to "super" functions */
+	BatchDataSet_Init(&super);
+}
 
-	/* Return OK */
-	return ML_OK;
+static void CSVDataSet_CloseFile (CSVDataSet * csvDataset)
+{
+	/* Closing the stream of a compressed file also closes the compressed file, and frees the GzipFile */
+	fclose (csvDataset->file);
+	csvDataset->file = NULL;
+	csvDataset->gzip = NULL;
 }
 
 static int CSVDataSet_LoadHeader (CSVDataSet * csvDataset)
@@ -49,8 +132,6 @@ static int CSVDataSet_LoadHeader (CSVDataSet * csvDataset)
 	off_t dataStartPos = 0;			/* If there's no header, the begining of the data is at the begining of the file */
 	int ret;
 	unsigned long featsCount;		/* Just to keep code simpler. Should be "optimized" out by the compiler anyway */
-	unsigned long currentClass;
-	unsigned long maxClass = 0;
 
 	/* TODO: Read the feature labels, when available */
 	/* Count the number of features */
@@ -95,6 +176,21 @@ static int CSVDataSet_LoadHeader (CSVDataSet * csvDataset)
 	/* Set the file at the begining of the data */
 	fseeko(csvDataset->file, dataStartPos, SEEK_SET);
 
+	/* Return OK */
+	return ML_OK;
+}
+
+static int CSVDataSet_CountClasses (CSVDataSet * csvDataset)
+{
+	off_t dataStartPos;
+	int ret;
+	unsigned long featsCount;
+	unsigned long currentClass;
+	unsigned long maxClass = 0;
+
+	/* Save the position of the begining of the data */
+	dataStartPos = ftello (csvDataset->file);
+
 	/* Find out the number of classes - NOTE: This will consider the higher class value as total ammount of classes */
 	while (!feof(csvDataset->file))
 	{
@@ -107,8 +203,8 @@ static int CSVDataSet_LoadHeader (CSVDataSet * csvDataset)
 			if (fgetc(csvDataset->file) == csvDataset->delimiter)
 			{
 				featsCount++;
-				/* If all feats have been read, break this loop */
-				if (featsCount == csvDataset->featsCount)
+				/* If all feats of the file have been read, break this loop */
+				if (featsCount == csvDataset->fileFeatsCount)
 					break;
 			}
 		}
@@ -167,304 +263,2277 @@ static int CSVDataSet_NextEntry_Full (CSVDataSet * csvDataset, EntryData ** entr
 	return ML_OK;
 }
 
-static int CSVDataSet_NextEntry_Incremental (CSVDataSet * csvDataset, EntryData ** entry)
+static int CSVDataSet_NextEntry_Aligned (CSVDataSet * csvDataset, EntryData ** entry)
 {
-	int ret;
-	
+	off_t nextPos;
+
 	/* Check that the dataset hasn't been fully read yet */
 	if (csvDataset->currentPos >= csvDataset->entriesCount)
 		return ML_WARN_EOF;
 
-	/* Position the file based on the readOrder array */
-	fseeko (csvDataset->file, csvDataset->readOrder[csvDataset->currentPos++], SEEK_SET);
-
-	/* Read one line from the file */
-	ret = CSVDataSet_ReadLine(csvDataset, csvDataset->entries);
-
-	/* If anything went wrong, return the error */
-	if (ret != ML_OK)
-		return ret;
+	/* Point the single record struct to the row of the next record. Its address comes from its position */
+	nextPos = csvDataset->readOrder[csvDataset->currentPos++];
+	csvDataset->entries->byteFeatures = csvDataset->rows + (csvDataset->rowStride * nextPos);
+	csvDataset->entries->class = csvDataset->classes[nextPos];
+	csvDataset->entries->indexes = NULL;
+	csvDataset->entries->type = storageTypes[csvDataset->options.storage];
 
-	/* Set the returning pointer */
 	*entry = csvDataset->entries;
 
-	/* Return ok */
+	/* Return OK */
 	return ML_OK;
 }
 
-static int CSVDataSet_LoadData_Full (CSVDataSet * csvDataset)
+static ssize_t CSVDataSet_PRead (CSVDataSet * csvDataset, char * buffer, size_t size, off_t offset)
+{
+	/* pread doesn't move the file position, so it's safe to use from any thread */
+	if (csvDataset->gzip != NULL)
+		return GzipFile_PRead (csvDataset->gzip, buffer, size, (uint64_t) offset);
+	else
+		return pread (fileno(csvDataset->file), buffer, size, offset);
+}
+
+static int CSVDataSet_ParseRecord (CSVDataSet * csvDataset, const char * line, const char * lineEnd, EntryData * entry)
 {
-	unsigned long i;
-	double * data;
-	EntryData * auxEntries;
 	int ret;
 
-	/* Initialize the readOrder vector - For fully loaded datasets, the readOrder will contain the indexes of the entries array */
-	for (i=0;i<csvDataset->entriesCount;i++)
-		csvDataset->readOrder[i] = i;
+	/* Parse the line, and transform its features */
+	ret = csvDataset->parseLine (csvDataset, line, lineEnd, entry);
+	if (ret == ML_OK && csvDataset->transform != NULL)
+		ret = FeatsTransform_Apply (csvDataset->transform, entry->features);
 
-	/* Store the dataset in a contiguous block. Useful for "recasting" this as a Matrix if needed */
-	data = (double *) malloc (sizeof(double) * (csvDataset->entriesCount * csvDataset->featsCount));
-	if (data == NULL)
-	{
-		errno = ENOMEM;
-		return ML_ERR_OUTOFMEMORY;
-	}
+	return ret;
+}
 
-	/* Malloc an array to store the entries */
-	auxEntries = (EntryData *) malloc (sizeof(EntryData) * csvDataset->entriesCount);
-	if (auxEntries == NULL)
-	{
-		free (data);
-		errno = ENOMEM;
-		return ML_ERR_OUTOFMEMORY;
-	}
+static int CSVDataSet_ReadRecord (CSVDataSet * csvDataset, off_t offset, char * buffer, EntryData * entry)
+{
+	ssize_t size;
 
-	/* Do NOT initialize the allocated memory, since it'll be written with valid data directly */
+	/* Records of cached blocks are copied, without reading nor parsing them again. They were transformed when their block was parsed */
+	if (csvDataset->cache != NULL && BlockCache_Read (csvDataset->cache, offset, entry))
+		return ML_OK;
 
-	/* Read all records */
-	for (i=0;i<csvDataset->entriesCount;i++)
+	/* Read the whole line at once */
+	size = CSVDataSet_PRead (csvDataset, buffer, csvDataset->readAhead->maxLineLength, offset);
+	if (size <= 0)
 	{
-		/* Set this entry's pointer to the right address within the data buffer */
-		auxEntries[i].features = data + (csvDataset->featsCount * i);
-
-		/* Read one dataset line */
-		ret = CSVDataSet_ReadLine (csvDataset, &auxEntries[i]);
-		if (ret != ML_OK)
-		{
-			free (data);
-			free (auxEntries);
-			return ret;
-		}
+		errno = EIO;
+		return ML_ERR_FILE;
 	}
 
-	/* Save the entries array on the dataset struct */
-	csvDataset->entries = auxEntries;
-
-	/* Update the "nextEntry" pointer to point to the function that handles "full" datasets */
-	csvDataset->nextEntry = (int(*)(DataSet *, EntryData **)) CSVDataSet_NextEntry_Full;
-
-	/* Return OK */
-	return ML_OK;
+	return CSVDataSet_ParseRecord (csvDataset, buffer, findChar (buffer, buffer + size, '\n'), entry);
 }
 
-static int CSVDataSet_LoadData_Incremental (CSVDataSet * csvDataset)
+static void CSVDataSet_AdviseBlocks (CSVDataSet * csvDataset, unsigned long pos)
 {
+#ifdef POSIX_FADV_WILLNEED
+	unsigned long blockSize;
+	unsigned long blockEnd;
+	unsigned long end;
 	unsigned long i;
-	/* Initialize the readOrder array. On incrementally read datasets we must store the start position of each record */
-	/* Find "newlines" to find the start position of each record */
-	i = 0;
-	csvDataset->readOrder[i++] = ftello(csvDataset->file);
-	while (i < csvDataset->entriesCount && !feof(csvDataset->file) && !ferror(csvDataset->file))
+	off_t first;
+	off_t last;
+
+	/* Only block shuffled plain files benefit from it, and only at the begining of each block */
+	blockSize = csvDataset->shuffleBlock;
+	if (blockSize <= 1 || pos % blockSize != 0 || csvDataset->gzip != NULL)
+		return;
+
+	/*	The records of a block come from a single region of the file. Ask the OS to read this block and the next one
+		at once, so the records are found in the page cache instead of being read one by one */
+	end = min (pos + 2 * blockSize, csvDataset->entriesCount);
+	for (;pos<end;pos=blockEnd)
 	{
-		if (fgetc(csvDataset->file) == '\n')
-			csvDataset->readOrder[i++] = ftello(csvDataset->file);
+		blockEnd = min (pos + blockSize, end);
+		first = last = csvDataset->readOrder[pos];
+		for (i=pos + 1;i<blockEnd;i++)
+		{
+			if (csvDataset->readOrder[i] < first)
+				first = csvDataset->readOrder[i];
+			if (csvDataset->readOrder[i] > last)
+				last = csvDataset->readOrder[i];
+		}
+		posix_fadvise (fileno(csvDataset->file), first, (last - first) + csvDataset->readAhead->maxLineLength, POSIX_FADV_WILLNEED);
 	}
+#endif
+}
 
-	/* An "incremental" dataset must have one entry to avoid multiple allocations when reading the dataset */
-	csvDataset->entries = (EntryData *) malloc (sizeof(EntryData));
-	if (csvDataset->entries == NULL)
-	{
-		errno = ENOMEM;
-		return ML_ERR_OUTOFMEMORY;
-	}
+static void * CSVDataSet_ReadAheadMain (CSVDataSet * csvDataset)
+{
+	CSVReadAhead * readAhead = csvDataset->readAhead;
+	unsigned long pos;
+	unsigned long slot;
+	int ret;
 
-	/* This entry must have enough space to store one record */
-	csvDataset->entries[0].features = (double *) malloc (sizeof(double) * csvDataset->featsCount);
-	if (csvDataset->entries[0].features == NULL)
+	pthread_mutex_lock (&readAhead->lock);
+	while (!readAhead->stop && readAhead->readPos < csvDataset->entriesCount)
 	{
-		free (csvDataset->entries);
-		csvDataset->entries = NULL;
-		errno = ENOMEM;
-		return ML_ERR_OUTOFMEMORY;
-	}
+		/* Wait until the caller releases a slot */
+		if (readAhead->readPos - csvDataset->currentPos >= readAhead->readAhead)
+		{
+			readAhead->threadWaiting = 1;
+			pthread_cond_wait (&readAhead->consumed, &readAhead->lock);
+			readAhead->threadWaiting = 0;
+			continue;
+		}
 
-	/* Update the "nextEntry" pointer to point to the function that handles "full" datasets */
-	csvDataset->nextEntry = (int(*)(DataSet *, EntryData **)) CSVDataSet_NextEntry_Incremental;
+		/* Read the next record without holding the lock, so the caller can consume the ones already read */
+		pos = readAhead->readPos;
+		pthread_mutex_unlock (&readAhead->lock);
 
-	/* Return OK */
-	return ML_OK;
+		slot = pos % readAhead->ringSize;
+		CSVDataSet_AdviseBlocks (csvDataset, pos);
+		ret = CSVDataSet_ReadRecord (csvDataset, csvDataset->readOrder[pos], readAhead->threadBuffer, &csvDataset->entries[slot]);
+
+		/* Publish the record */
+		pthread_mutex_lock (&readAhead->lock);
+		readAhead->status[slot] = ret;
+		readAhead->readPos++;
+		if (readAhead->callerWaiting)
+			pthread_cond_signal (&readAhead->filled);
+	}
+	pthread_mutex_unlock (&readAhead->lock);
+
+	return NULL;
 }
 
-static int CSVDataSet_LoadData (CSVDataSet * csvDataset)
+static void CSVDataSet_StopReadAhead (CSVDataSet * csvDataset)
 {
-	off_t dataStartPos;
-	int ret;
+	CSVReadAhead * readAhead = csvDataset->readAhead;
 
-	/* Save the position of the begining of the data */
-	dataStartPos = ftello (csvDataset->file);
+	/* Nothing to be done if the thread isn't running */
+	if (readAhead == NULL || !readAhead->running)
+		return;
 
-	/* Count "newlines" to find the number of records */
-	csvDataset->entriesCount = 0;
-	while (!feof(csvDataset->file) && !ferror(csvDataset->file))
-	{
-		if (fgetc(csvDataset->file) == '\n')
-			csvDataset->entriesCount++;
-	}
+	/* Ask the thread to stop and wait for it */
+	pthread_mutex_lock (&readAhead->lock);
+	readAhead->stop = 1;
+	pthread_cond_signal (&readAhead->consumed);
+	pthread_mutex_unlock (&readAhead->lock);
+	pthread_join (readAhead->thread, NULL);
 
-	/* Reset the file to the begining of the data */
-	fseeko (csvDataset->file, dataStartPos, SEEK_SET);
+	readAhead->running = 0;
+	readAhead->stop = 0;
+}
 
-	/* Malloc an area to store the readOrder vector */
-	csvDataset->readOrder = (off_t *) malloc (sizeof(off_t) * csvDataset->entriesCount);
-	if (csvDataset->readOrder == NULL)
+static int CSVDataSet_NextEntry_Incremental (CSVDataSet * csvDataset, EntryData ** entry)
+{
+	CSVReadAhead * readAhead = csvDataset->readAhead;
+	unsigned long slot;
+	int ret;
+	
+	/* Check that the dataset hasn't been fully read yet */
+	if (csvDataset->currentPos >= csvDataset->entriesCount)
+		return ML_WARN_EOF;
+
+	/* Without read ahead, read the record on the calling thread */
+	if (readAhead->readAhead == 0)
 	{
-		fclose(csvDataset->file);
-		csvDataset->file = NULL;
-		errno = ENOMEM;
-		return ML_ERR_OUTOFMEMORY;
+		slot = csvDataset->currentPos % readAhead->ringSize;
+		CSVDataSet_AdviseBlocks (csvDataset, csvDataset->currentPos);
+		ret = CSVDataSet_ReadRecord (csvDataset, csvDataset->readOrder[csvDataset->currentPos++], readAhead->callerBuffer, &csvDataset->entries[slot]);
 	}
-
-	/* Process the rest of the file according to the readMode */
-	if (csvDataset->readMode == BD_RM_FULL)
-		ret = CSVDataSet_LoadData_Full (csvDataset);
-	else if	(csvDataset->readMode == BD_RM_INCREMENTAL)
-		ret = CSVDataSet_LoadData_Incremental (csvDataset);
 	else
 	{
-		free (csvDataset->readOrder);
-		csvDataset->readOrder = NULL;
-		errno = EINVAL;
-		return ML_ERR_PARAM;
+		/* Start the reading thread on the first call after a reset */
+		if (!readAhead->running)
+		{
+			readAhead->readPos = csvDataset->currentPos;
+			if (pthread_create (&readAhead->thread, NULL, (void * (*)(void *)) CSVDataSet_ReadAheadMain, csvDataset) != 0)
+			{
+				errno = EAGAIN;
+				return ML_ERR_OUTOFMEMORY;
+			}
+			readAhead->running = 1;
+		}
+
+		/* Wait for the record to be read */
+		pthread_mutex_lock (&readAhead->lock);
+		while (readAhead->readPos <= csvDataset->currentPos)
+		{
+			readAhead->callerWaiting = 1;
+			pthread_cond_wait (&readAhead->filled, &readAhead->lock);
+			readAhead->callerWaiting = 0;
+		}
+
+		/* Return it, releasing a slot to the thread */
+		slot = csvDataset->currentPos % readAhead->ringSize;
+		ret = readAhead->status[slot];
+		csvDataset->currentPos++;
+		if (readAhead->threadWaiting)
+			pthread_cond_signal (&readAhead->consumed);
+		pthread_mutex_unlock (&readAhead->lock);
 	}
 
-	/* If something went wrong, free the readOrder array and return the error code */
+	/* If anything went wrong, return the error */
 	if (ret != ML_OK)
-	{
-		free (csvDataset->readOrder);
-		csvDataset->readOrder = NULL;
 		return ret;
-	}
 
-	/* Return OK */
+	/* Set the returning pointer */
+	*entry = &csvDataset->entries[slot];
+
+	/* Return ok */
 	return ML_OK;
 }
 
-static void CSVDataSet_Free (CSVDataSet * csvDataset)
+static int CSVDataSet_NextBatch_Aligned (CSVDataSet * csvDataset, unsigned long maxCount, double ** features, int ** classes, unsigned long * count)
 {
-	/* Close the file pointer if it's still open */
-	if (csvDataset->file != NULL)
-	{
-		fclose (csvDataset->file);
-		csvDataset->file = NULL;
-	}
+	EntryData entry;
+	off_t first;
+	off_t pos;
+	unsigned long i;
+	unsigned char contiguous;
+	int ret;
 
-	/* Free the readOrder array */
-	if (csvDataset->readOrder != NULL)
-	{
-		free (csvDataset->readOrder);
-		csvDataset->readOrder = NULL;
-	}
+	/* Get room for the whole batch */
+	*count = 0;
+	ret = DataSet_ReserveBatch ((DataSet *) csvDataset, maxCount);
+	if (ret != ML_OK)
+		return ret;
 
-	/* TODO: Free local copy of FeatsTransform */
-	/*
-	if (dataset->online.featsTransform != NULL)
-	{
-		Dataset_FreeTransform(dataset->online.featsTransform);
-		free (dataset->online.featsTransform);
-		dataset->online.featsTransform = NULL;
-	}
-	*/
+	/* Check that the dataset hasn't been fully read yet */
+	if (csvDataset->currentPos >= csvDataset->entriesCount)
+		return ML_WARN_EOF;
+	*count = min (maxCount, csvDataset->entriesCount - csvDataset->currentPos);
 
-	/* Free entries */
-	if (csvDataset->entries != NULL)
-	{
-		/* entries[0] points to the whole memory block. Free it */
-		if (csvDataset->entries[0].features != NULL)
-			free (csvDataset->entries[0].features);
+	/* Rows of doubles without any padding, read in order, are already laid out as a batch */
+	first = csvDataset->readOrder[csvDataset->currentPos];
+	contiguous = (storageTypes[csvDataset->options.storage] == DS_ET_DOUBLE && csvDataset->rowStride == sizeof(double) * csvDataset->featsCount);
+	for (i=0;i<*count && contiguous;i++)
+		contiguous = (csvDataset->readOrder[csvDataset->currentPos + i] == first + (off_t) i);
 
-		/* Free the array */
-		free (csvDataset->entries);
-		csvDataset->entries = NULL;
+	if (contiguous)
+	{
+		*features = (double *) (csvDataset->rows + (csvDataset->rowStride * first));
+		*classes = &csvDataset->classes[first];
 	}
-
-	/* Free readOrder */
-	if (csvDataset->readOrder != NULL)
+	else
 	{
-		free (csvDataset->readOrder);
-		csvDataset->readOrder = NULL;
+		/* Otherwise, copy them to the batch buffers */
+		memset (&entry, 0, sizeof(EntryData));
+		entry.type = storageTypes[csvDataset->options.storage];
+		for (i=0;i<*count;i++)
+		{
+			pos = csvDataset->readOrder[csvDataset->currentPos + i];
+			entry.byteFeatures = csvDataset->rows + (csvDataset->rowStride * pos);
+			EntryData_ToDense (&entry, csvDataset->featsCount, &csvDataset->batchFeatures[csvDataset->featsCount * i]);
+			csvDataset->batchClasses[i] = csvDataset->classes[pos];
+		}
+		*features = csvDataset->batchFeatures;
+		*classes = csvDataset->batchClasses;
 	}
 
-	/* Call the "superclass" free function */
-	super.free((DataSet *) csvDataset);
-}
+	csvDataset->currentPos += *count;
 
-/************************
-* "Protected" Functions	*
-************************/
+	/* Return OK */
+	return ML_OK;
+}
 
-int CSVDataSet_ReadLine (CSVDataSet * csvDataset, EntryData * entry)
+static int CSVDataSet_NextBatch (CSVDataSet * csvDataset, unsigned long maxCount, double ** features, int ** classes, unsigned long * count)
 {
+	EntryData entry;
 	unsigned long i;
-	unsigned long featsCount;
+	int ret;
 
-	/* TODO: If using featsTransform, the featsCount might be different */
-	/* Determine the number of features on the file */
-	featsCount = csvDataset->featsCount;
+	/* Aligned datasets have no record struct for the default implementation to gather */
+	if (csvDataset->rows != NULL)
+		return CSVDataSet_NextBatch_Aligned (csvDataset, maxCount, features, classes, count);
 
-	/* Read this record's feats */
-	for (i=0;i<featsCount;i++)
-	{
-		if (fscanf (csvDataset->file, "%lf", &entry->features[i]) == EOF)
-			return ML_WARN_EOF;
-		/* Skip the delimiter */
-		fgetc (csvDataset->file);
-	}
+	/*	"FULL" datasets use the default implementation, and so do "INCREMENTAL" ones reading ahead, as their records are
+		already being read into the ring */
+	if (csvDataset->readMode != BD_RM_INCREMENTAL || csvDataset->readAhead->readAhead != 0)
+		return super.nextBatch ((DataSet *) csvDataset, maxCount, features, classes, count);
 
-	/* Read this record's class */
-	if (fscanf (csvDataset->file, "%d", &entry->class) == EOF)
-		return ML_WARN_EOF;
-	/* Skip the newLine */
-	fgetc (csvDataset->file);
+	/* Get room for the whole batch */
+	*count = 0;
+	ret = DataSet_ReserveBatch ((DataSet *) csvDataset, maxCount);
+	if (ret != ML_OK)
+		return ret;
 
-	/* If found the EOF, return a warning */
-	if (feof (csvDataset->file))
+	/* Check that the dataset hasn't been fully read yet */
+	if (csvDataset->currentPos >= csvDataset->entriesCount)
 		return ML_WARN_EOF;
 
-	/* If there was an error, return the error */
-	if (ferror (csvDataset->file))
+	/* Without read ahead, parse the records straight into the batch buffer */
+	memset (&entry, 0, sizeof(EntryData));
+	for (i=0;i<maxCount && csvDataset->currentPos < csvDataset->entriesCount;i++)
 	{
-		errno = EIO;
-		return ML_ERR_FILE;
+		entry.features = &csvDataset->batchFeatures[csvDataset->featsCount * i];
+		CSVDataSet_AdviseBlocks (csvDataset, csvDataset->currentPos);
+		ret = CSVDataSet_ReadRecord (csvDataset, csvDataset->readOrder[csvDataset->currentPos++], csvDataset->readAhead->callerBuffer, &entry);
+		if (ret != ML_OK)
+			return ret;
+		csvDataset->batchClasses[i] = entry.class;
 	}
 
-	/* TODO: If there's a transformation set, process the features */
-	/*
-	if (csvDataset->batchDataset.featsTransform != NULL)
-		FeatsTransform_Process (...);
-	*/
+	*features = csvDataset->batchFeatures;
+	*classes = csvDataset->batchClasses;
+	*count = i;
 
 	/* Return OK */
 	return ML_OK;
 }
 
-void CSVDataSet_Init (CSVDataSet * csvDataset)
+static int CSVDataSet_Reset (CSVDataSet * csvDataset)
 {
-	/* If the local "super" isn't initialized, init it */
-	if (!superInitialized)
-	{
-		BatchDataSet_Init(&super);
-		superInitialized = 1;
-	}
+	/* The reading thread must not run while the read order or position change */
+	CSVDataSet_StopReadAhead (csvDataset);
 
-	/* Call the initializer for the "superclass" */
-	BatchDataSet_Init((BatchDataSet *) csvDataset);
+	return super.reset ((BatchDataSet *) csvDataset);
+}
 
-	/* Initialize the function pointers. */
-	csvDataset->load = (int (*)(BatchDataSet *, char *)) CSVDataSet_Load;
-	csvDataset->loadHeader = CSVDataSet_LoadHeader;
-	csvDataset->loadData = CSVDataSet_LoadData;
+static int CSVDataSet_Shuffle (CSVDataSet * csvDataset)
+{
+	CSVDataSet_StopReadAhead (csvDataset);
 
-	/* Overrides the default free method */
-	csvDataset->free = (void(*)(DataSet *))CSVDataSet_Free;
+	return super.shuffle ((BatchDataSet *) csvDataset);
 }
 
-/************************
-* "Public" Functions	*
-************************/
-CSVDataSet * CSVDataSet_New (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char * srcPath)
+static int CSVDataSet_Sort (CSVDataSet * csvDataset)
 {
-	CSVDataSet * csvDataset;
+	CSVDataSet_StopReadAhead (csvDataset);
+
+	return super.sort ((BatchDataSet *) csvDataset);
+}
+
+static int CSVDataSet_AllocRing (CSVDataSet * csvDataset, unsigned long ringSize)
+{
+	CSVReadAhead * readAhead = csvDataset->readAhead;
+	EntryData * auxEntries;
+	double * data;
+	int * status;
+	unsigned long i;
+
+	/* Malloc the new ring before releasing the current one, so nothing changes on error */
+	auxEntries = (EntryData *) malloc (sizeof(EntryData) * ringSize);
+	data = (double *) malloc (sizeof(double) * csvDataset->featsCount * ringSize);
+	status = (int *) malloc (sizeof(int) * ringSize);
+	if (auxEntries == NULL || data == NULL || status == NULL)
+	{
+		free (auxEntries);
+		free (data);
+		free (status);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* entries[0] points to the whole memory block, as on "FULL" datasets */
+	for (i=0;i<ringSize;i++)
+	{
+		auxEntries[i].features = data + (csvDataset->featsCount * i);
+		auxEntries[i].indexes = NULL;
+		auxEntries[i].type = DS_ET_DOUBLE;
+	}
+
+	/* Release the old ring */
+	if (csvDataset->entries != NULL)
+	{
+		free (csvDataset->entries[0].features);
+		free (csvDataset->entries);
+	}
+	free (readAhead->status);
+
+	csvDataset->entries = auxEntries;
+	readAhead->status = status;
+	readAhead->ringSize = ringSize;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static __inline unsigned char CSVDataSet_IsEmptyLine (const char * line, const char * lineEnd)
+{
+	/* A line is empty if it has no characters at all, or just the '\r' of a "\r\n" line break */
+	return (lineEnd == line || (lineEnd - line == 1 && *line == '\r'));
+}
+
+static void CSVDataSet_CountChunk (CSVChunk * chunk)
+{
+	const char * pos;
+	const char * lineEnd;
+
+	/* Count the number of non empty lines on the chunk */
+	chunk->entriesCount = 0;
+	for (pos=chunk->start;pos<chunk->end;pos=lineEnd + 1)
+	{
+		lineEnd = findChar (pos, chunk->end, '\n');
+		if (!CSVDataSet_IsEmptyLine (pos, lineEnd))
+			chunk->entriesCount++;
+	}
+}
+
+static int CSVDataSet_ReserveSparse (CSVChunk * chunk, unsigned long count)
+{
+	unsigned long capacity;
+	double * auxValues;
+	unsigned int * auxIndexes;
+
+	/* Make sure there's room for "count" more values. Grow the buffers by doubling their size */
+	if (chunk->values == NULL || chunk->nnz + count > chunk->capacity)
+	{
+		capacity = max (chunk->capacity * 2, chunk->nnz + count);
+		auxValues = (double *) realloc (chunk->values, sizeof(double) * capacity);
+		if (auxValues != NULL)
+			chunk->values = auxValues;
+		auxIndexes = (unsigned int *) realloc (chunk->indexes, sizeof(unsigned int) * capacity);
+		if (auxIndexes != NULL)
+			chunk->indexes = auxIndexes;
+		if (auxValues == NULL || auxIndexes == NULL)
+		{
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		chunk->capacity = capacity;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int CSVDataSet_AppendSparse (CSVChunk * chunk, EntryData * entry, double * row)
+{
+	unsigned long featsCount;
+	unsigned long i;
+	int ret;
+
+	featsCount = chunk->csvDataset->featsCount;
+
+	/* Make sure there's room for a whole record */
+	ret = CSVDataSet_ReserveSparse (chunk, featsCount);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Keep only the non zero values. The record's pointers are set once all chunks are merged */
+	entry->nnz = 0;
+	for (i=0;i<featsCount;i++)
+	{
+		if (row[i] != 0)
+		{
+			chunk->values[chunk->nnz + entry->nnz] = row[i];
+			chunk->indexes[chunk->nnz + entry->nnz] = (unsigned int) i;
+			entry->nnz++;
+		}
+	}
+	chunk->nnz += entry->nnz;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int CSVDataSet_AppendSparseValues (CSVChunk * chunk, EntryData * entry)
+{
+	int ret;
+
+	/* Records parsed sparse already hold just their non zero values, so they're copied as they are */
+	ret = CSVDataSet_ReserveSparse (chunk, entry->nnz);
+	if (ret != ML_OK)
+		return ret;
+
+	memcpy (&chunk->values[chunk->nnz], entry->features, sizeof(double) * entry->nnz);
+	memcpy (&chunk->indexes[chunk->nnz], entry->indexes, sizeof(unsigned int) * entry->nnz);
+	chunk->nnz += entry->nnz;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int CSVDataSet_StoreTyped (EntryData * entry, double * row, unsigned long featsCount)
+{
+	unsigned long i;
+
+	/* Narrow the parsed values to the record type. Values that can't be stored exactly are an error, not silently rounded */
+	switch (entry->type)
+	{
+		case DS_ET_FLOAT:
+			for (i=0;i<featsCount;i++)
+				entry->floatFeatures[i] = (float) row[i];
+			break;
+		case DS_ET_UINT8:
+			for (i=0;i<featsCount;i++)
+			{
+				if (!(row[i] >= 0 && row[i] <= 255) || row[i] != (unsigned char) row[i])
+				{
+					errno = EINVAL;
+					return ML_ERR_PARAM;
+				}
+				entry->byteFeatures[i] = (unsigned char) row[i];
+			}
+			break;
+		case DS_ET_BIT:
+			memset (entry->byteFeatures, 0, EntryData_RowSize (DS_ET_BIT, featsCount));
+			for (i=0;i<featsCount;i++)
+			{
+				if (row[i] != 0 && row[i] != 1)
+				{
+					errno = EINVAL;
+					return ML_ERR_PARAM;
+				}
+				entry->byteFeatures[i >> 3] |= (unsigned char) row[i] << (i & 7);
+			}
+			break;
+		default:
+			break;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void CSVDataSet_ParseChunk (CSVChunk * chunk)
+{
+	const char * pos;
+	const char * lineEnd;
+	unsigned long featsCount;
+	unsigned long i;
+	EntryData * entry;
+	double * row = NULL;
+	unsigned int * rowIndexes = NULL;
+	unsigned char sparse;
+	EntryType type;
+	size_t rowStride;
+
+	featsCount = chunk->csvDataset->featsCount;
+	sparse = (chunk->csvDataset->options.storage == BD_ST_SPARSE);
+	type = storageTypes[chunk->csvDataset->options.storage];
+	rowStride = chunk->csvDataset->rowStride;
+	chunk->maxClass = 0;
+	chunk->ret = ML_OK;
+
+	/* Collect the statistics of the features while parsing them, if the transform or the pruning need them */
+	if (FeatsTransform_NeedsStats (&chunk->csvDataset->options.transform) || chunk->csvDataset->options.prune == BD_PR_USE)
+	{
+		chunk->ret = FeatsStats_Init (&chunk->stats, featsCount);
+		if (chunk->ret != ML_OK)
+			return;
+	}
+
+	/* Sparse and typed records are parsed to a temporary row, and then only the non zero values are kept (sparse)
+	or all values are narrowed to their type (typed) */
+	if (sparse || type != DS_ET_DOUBLE)
+	{
+		row = (double *) malloc (sizeof(double) * featsCount);
+		if (sparse)
+			rowIndexes = (unsigned int *) malloc (sizeof(unsigned int) * featsCount);
+		if (row == NULL || (sparse && rowIndexes == NULL))
+		{
+			free (row);
+			errno = ENOMEM;
+			chunk->ret = ML_ERR_OUTOFMEMORY;
+			return;
+		}
+	}
+
+	/* Parse every record straight into its slice of the data block and entries array */
+	i = chunk->firstEntry;
+	for (pos=chunk->start;pos<chunk->end;pos=lineEnd + 1)
+	{
+		lineEnd = findChar (pos, chunk->end, '\n');
+		if (CSVDataSet_IsEmptyLine (pos, lineEnd))
+			continue;
+
+		entry = &chunk->entries[i];
+		entry->features = (row != NULL) ? row : (double *) (chunk->data + (rowStride * i));
+		entry->indexes = rowIndexes;
+		entry->type = DS_ET_DOUBLE;
+		chunk->ret = chunk->csvDataset->parseLine (chunk->csvDataset, pos, lineEnd, entry);
+
+		/*	Clip and log the values now. They're scaled once the statistics of the whole dataset are known. Both work on whole
+			rows, so records that came back sparse (only their non zero values) are left as they are */
+		if (chunk->ret == ML_OK && entry->indexes == NULL && FeatsTransform_IsSet (&chunk->csvDataset->options.transform))
+			chunk->ret = FeatsTransform_Map (&chunk->csvDataset->options.transform, entry->features, featsCount);
+		if (chunk->ret == ML_OK && entry->indexes == NULL && chunk->stats.featsCount > 0)
+			FeatsStats_Add (&chunk->stats, entry->features);
+
+		if (chunk->ret == ML_OK && sparse)
+		{
+			/* Records may come back already sparse (only on sparse storage, where rowIndexes was given) */
+			if (entry->indexes != NULL)
+				chunk->ret = CSVDataSet_AppendSparseValues (chunk, entry);
+			else
+				chunk->ret = CSVDataSet_AppendSparse (chunk, entry, row);
+		}
+		else if (chunk->ret == ML_OK && type != DS_ET_DOUBLE)
+		{
+			entry->byteFeatures = chunk->data + (rowStride * i);
+			entry->type = type;
+			chunk->ret = CSVDataSet_StoreTyped (entry, row, featsCount);
+		}
+		if (chunk->ret != ML_OK)
+			break;
+
+		/* Keep track of the highest class. It'll be used as the total ammount of classes */
+		if (entry->class > chunk->maxClass)
+			chunk->maxClass = entry->class;
+
+		i++;
+	}
+
+	free (row);
+	free (rowIndexes);
+}
+
+static void CSVDataSet_MergeSparseChunk (CSVChunk * chunk)
+{
+	unsigned long i;
+	unsigned long offset;
+
+	/* Copy the values of this chunk to their position on the dataset block */
+	memcpy ((double *) chunk->data + chunk->nnzOffset, chunk->values, sizeof(double) * chunk->nnz);
+	memcpy (chunk->dataIndexes + chunk->nnzOffset, chunk->indexes, sizeof(unsigned int) * chunk->nnz);
+
+	/* Point each record to its values */
+	offset = chunk->nnzOffset;
+	for (i=chunk->firstEntry;i<chunk->firstEntry + chunk->entriesCount;i++)
+	{
+		chunk->entries[i].features = (double *) chunk->data + offset;
+		chunk->entries[i].indexes = chunk->dataIndexes + offset;
+		offset += chunk->entries[i].nnz;
+	}
+
+	/* The chunk buffers aren't needed anymore */
+	free (chunk->values);
+	free (chunk->indexes);
+	chunk->values = NULL;
+	chunk->indexes = NULL;
+}
+
+static void * CSVDataSet_AllocRows (CSVDataSet * csvDataset, size_t size)
+{
+	/*	The records of FULL datasets follow the memory policy of the options. Their blocks are always aligned to cache lines,
+		so the rows of aligned datasets are aligned too */
+	if (csvDataset->readMode == BD_RM_FULL)
+		return Memory_Alloc (size, &csvDataset->options.memory);
+	return malloc (size);
+}
+
+static void CSVDataSet_FreeRows (CSVDataSet * csvDataset, void * rows)
+{
+	if (csvDataset->readMode == BD_RM_FULL)
+		Memory_Free (rows);
+	else
+		free (rows);
+}
+
+static int CSVDataSet_SetEntries (CSVDataSet * csvDataset, EntryData * entries, unsigned long entriesCount, int maxClass)
+{
+	EntryData * auxEntries;
+	unsigned long i;
+
+	/* Initialize the readOrder vector - For fully loaded datasets, the readOrder will contain the indexes of the entries array */
+	for (i=0;i<entriesCount;i++)
+		csvDataset->readOrder[i] = i;
+
+	/* Save the entries array and the records count on the dataset struct */
+	csvDataset->entries = entries;
+	csvDataset->entriesCount = entriesCount;
+
+	/* If the header didn't tell the number of classes, the highest class found is the total ammount of classes */
+	if (csvDataset->classesCount == 0)
+		csvDataset->classesCount = maxClass;
+
+	/* Update the "nextEntry" pointer to point to the function that handles "full" datasets */
+	csvDataset->nextEntry = (int(*)(DataSet *, EntryData **)) CSVDataSet_NextEntry_Full;
+
+	/*	Aligned datasets keep the classes on their own array, and the rows on their block. A single record struct is pointed
+		to each row returned, so the struct of every record isn't needed anymore */
+	if (csvDataset->options.layout == BD_LY_ALIGNED)
+	{
+		csvDataset->classes = (int *) malloc (sizeof(int) * entriesCount);
+		if (csvDataset->classes == NULL)
+		{
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		for (i=0;i<entriesCount;i++)
+			csvDataset->classes[i] = entries[i].class;
+		csvDataset->rows = entries[0].byteFeatures;
+		auxEntries = (EntryData *) realloc (entries, sizeof(EntryData));
+		if (auxEntries != NULL)
+			csvDataset->entries = auxEntries;
+		csvDataset->nextEntry = (int(*)(DataSet *, EntryData **)) CSVDataSet_NextEntry_Aligned;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int CSVDataSet_PruneColumns (CSVDataSet * csvDataset, FeatsStats * stats, unsigned long ** kept)
+{
+	unsigned long * columns;
+	unsigned long keptCount;
+	unsigned long i;
+
+	*kept = (unsigned long *) malloc (sizeof(unsigned long) * max (csvDataset->featsCount, 1));
+	if (*kept == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Keep the features whose variance is above the threshold. If none is, the first one is kept, so records still have a feature */
+	keptCount = 0;
+	for (i=0;i<csvDataset->featsCount;i++)
+	{
+		if (FeatsStats_Variance (stats, i) > csvDataset->options.pruneVariance)
+			(*kept)[keptCount++] = i;
+	}
+	if (keptCount == 0)
+		(*kept)[keptCount++] = 0;
+
+	/* Nothing to do if every feature is kept */
+	if (keptCount == csvDataset->featsCount)
+	{
+		free (*kept);
+		*kept = NULL;
+		return ML_OK;
+	}
+
+	/* The kept features become the selected columns of the file (some of the ones already selected, if there were any) */
+	columns = (unsigned long *) malloc (sizeof(unsigned long) * keptCount);
+	if (columns == NULL)
+	{
+		free (*kept);
+		*kept = NULL;
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	for (i=0;i<keptCount;i++)
+		columns[i] = (csvDataset->columns != NULL) ? csvDataset->columns[(*kept)[i]] : (*kept)[i];
+	free (csvDataset->columns);
+	csvDataset->columns = columns;
+	csvDataset->options.columns = columns;
+	csvDataset->options.columnsCount = keptCount;
+	csvDataset->featsCount = keptCount;
+
+	/* Records and statistics of the remaining features */
+	csvDataset->rowStride = EntryData_RowSize (storageTypes[csvDataset->options.storage], csvDataset->featsCount);
+	if (csvDataset->options.layout == BD_LY_ALIGNED)
+		csvDataset->rowStride = Memory_AlignSize (csvDataset->rowStride, MEMORY_CACHE_LINE);
+	FeatsStats_Select (stats, *kept, keptCount);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int CSVDataSet_CompactRows (CSVDataSet * csvDataset, unsigned char ** data, EntryData * entries, unsigned long entriesCount, const unsigned long * kept, size_t oldStride)
+{
+	unsigned long featsCount = csvDataset->featsCount;
+	unsigned char * newData;
+	const unsigned char * src;
+	unsigned char * dst;
+	unsigned long i;
+	unsigned long j;
+
+	newData = (unsigned char *) CSVDataSet_AllocRows (csvDataset, csvDataset->rowStride * entriesCount);
+	if (newData == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Gather the kept features of each row to the new block, and point its record there */
+	for (i=0;i<entriesCount;i++)
+	{
+		src = *data + oldStride * i;
+		dst = newData + csvDataset->rowStride * i;
+		switch (storageTypes[csvDataset->options.storage])
+		{
+			case DS_ET_FLOAT:
+				for (j=0;j<featsCount;j++)
+					((float *) dst)[j] = ((const float *) src)[kept[j]];
+				break;
+			case DS_ET_UINT8:
+				for (j=0;j<featsCount;j++)
+					dst[j] = src[kept[j]];
+				break;
+			case DS_ET_BIT:
+				memset (dst, 0, EntryData_RowSize (DS_ET_BIT, featsCount));
+				for (j=0;j<featsCount;j++)
+					dst[j >> 3] |= (unsigned char) (((src[kept[j] >> 3] >> (kept[j] & 7)) & 1) << (j & 7));
+				break;
+			default:
+				for (j=0;j<featsCount;j++)
+					((double *) dst)[j] = ((const double *) src)[kept[j]];
+				break;
+		}
+		entries[i].byteFeatures = dst;
+	}
+
+	/* The old block isn't needed anymore */
+	CSVDataSet_FreeRows (csvDataset, *data);
+	*data = newData;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int CSVDataSet_ProcessRows (CSVDataSet * csvDataset, CSVChunk * chunks, unsigned long chunksCount, unsigned char ** data, EntryData * entries, unsigned long entriesCount)
+{
+	FeatsStats stats;
+	unsigned long * kept;
+	size_t oldStride;
+	unsigned long i;
+	int ret = ML_OK;
+
+	/* Merge the statistics of every chunk */
+	memset (&stats, 0, sizeof(FeatsStats));
+	if (FeatsTransform_NeedsStats (&csvDataset->options.transform) || csvDataset->options.prune == BD_PR_USE)
+	{
+		ret = FeatsStats_Init (&stats, csvDataset->featsCount);
+		for (i=0;i<chunksCount && ret == ML_OK;i++)
+			FeatsStats_Merge (&stats, &chunks[i].stats);
+	}
+	for (i=0;i<chunksCount;i++)
+		FeatsStats_Free (&chunks[i].stats);
+
+	/* Drop the constant features, and move the records to a block with only the remaining ones */
+	if (ret == ML_OK && csvDataset->options.prune == BD_PR_USE)
+	{
+		oldStride = csvDataset->rowStride;
+		ret = CSVDataSet_PruneColumns (csvDataset, &stats, &kept);
+		if (ret == ML_OK && kept != NULL)
+			ret = CSVDataSet_CompactRows (csvDataset, data, entries, entriesCount, kept, oldStride);
+		free (kept);
+	}
+
+	/* Build the transform, and scale all the rows at once (values were already clipped and logged while parsing) */
+	if (ret == ML_OK && FeatsTransform_IsSet (&csvDataset->options.transform))
+	{
+		csvDataset->transform = FeatsTransform_New (&csvDataset->options.transform, csvDataset->featsCount, &stats);
+		if (csvDataset->transform == NULL)
+			ret = (errno == ENOMEM) ? ML_ERR_OUTOFMEMORY : ML_ERR_PARAM;
+		else
+			FeatsTransform_ScaleRows (csvDataset->transform, *data, storageTypes[csvDataset->options.storage], csvDataset->rowStride, entriesCount);
+	}
+	FeatsStats_Free (&stats);
+
+	return ret;
+}
+
+static void CSVDataSet_ParseSegment (CSVChunk * chunk)
+{
+	CSVDataSet * csvDataset = chunk->csvDataset;
+	unsigned char sparse;
+
+	/* The number of records before a segment isn't known while it's parsed, so each one is parsed to its own buffers */
+	CSVDataSet_CountChunk (chunk);
+	sparse = (csvDataset->options.storage == BD_ST_SPARSE);
+	chunk->firstEntry = 0;
+	chunk->entries = (EntryData *) malloc (sizeof(EntryData) * max (chunk->entriesCount, 1));
+	chunk->data = sparse ? NULL : (unsigned char *) malloc (csvDataset->rowStride * max (chunk->entriesCount, 1));
+	if (chunk->entries == NULL || (chunk->data == NULL && !sparse))
+	{
+		errno = ENOMEM;
+		chunk->ret = ML_ERR_OUTOFMEMORY;
+		return;
+	}
+
+	CSVDataSet_ParseChunk (chunk);
+}
+
+static void CSVDataSet_FreeSegments (CSVChunk * chunks, unsigned long chunksCount)
+{
+	unsigned long i;
+
+	for (i=0;i<chunksCount;i++)
+	{
+		free (chunks[i].entries);
+		free (chunks[i].data);
+		free (chunks[i].values);
+		free (chunks[i].indexes);
+		FeatsStats_Free (&chunks[i].stats);
+	}
+	free (chunks);
+}
+
+static int CSVDataSet_LoadData_Segments (CSVDataSet * csvDataset)
+{
+	CSVChunk chunk;
+	CSVChunk * chunks = NULL;
+	unsigned long chunksCount = 0;
+	unsigned long entriesCount;
+	unsigned long nnz;
+	unsigned long i;
+	unsigned long j;
+	int maxClass;
+	unsigned char sparse;
+	unsigned char * data = NULL;
+	unsigned int * dataIndexes = NULL;
+	EntryData * auxEntries;
+	int ret;
+
+	/*	The file has no descriptor to be mapped (i.e. it's being decompressed by another thread), so it's parsed in segments
+		as they're read, while the following ones are being decompressed */
+	memset (&chunk, 0, sizeof(CSVChunk));
+	chunk.csvDataset = csvDataset;
+	ret = SegmentReader_Parse (csvDataset->file, &chunk, sizeof(CSVChunk), (void **) &chunks, &chunksCount, (void (*)(void *)) CSVDataSet_ParseSegment);
+
+	/* A prefix sum over the records (and values) of each segment gives their position on the dataset */
+	entriesCount = 0;
+	nnz = 0;
+	maxClass = 0;
+	for (i=0;i<chunksCount && ret == ML_OK;i++)
+	{
+		chunks[i].firstEntry = entriesCount;
+		chunks[i].nnzOffset = nnz;
+		entriesCount += chunks[i].entriesCount;
+		nnz += chunks[i].nnz;
+		if (chunks[i].maxClass > maxClass)
+			maxClass = chunks[i].maxClass;
+	}
+
+	/* A dataset without records is considered an invalid file */
+	if (ret == ML_OK && entriesCount == 0)
+	{
+		errno = EIO;
+		ret = ML_ERR_FILE;
+	}
+
+	if (ret != ML_OK)
+	{
+		CSVDataSet_FreeSegments (chunks, chunksCount);
+		/* errno was set on the thread that failed, so set it again here */
+		errno = (ret == ML_ERR_OUTOFMEMORY) ? ENOMEM : (ret == ML_ERR_PARAM) ? EINVAL : EIO;
+		return ret;
+	}
+
+	/* Get the contiguous blocks of the dataset */
+	sparse = (csvDataset->options.storage == BD_ST_SPARSE);
+	if (sparse)
+	{
+		/* Malloc at least one value, so entries[0] always points to the block */
+		data = (unsigned char *) CSVDataSet_AllocRows (csvDataset, sizeof(double) * max (nnz, 1));
+		dataIndexes = (unsigned int *) malloc (sizeof(unsigned int) * max (nnz, 1));
+	}
+	else
+		data = (unsigned char *) CSVDataSet_AllocRows (csvDataset, csvDataset->rowStride * entriesCount);
+	auxEntries = (EntryData *) malloc (sizeof(EntryData) * entriesCount);
+	csvDataset->readOrder = (off_t *) malloc (sizeof(off_t) * entriesCount);
+	if (data == NULL || (sparse && dataIndexes == NULL) || auxEntries == NULL || csvDataset->readOrder == NULL)
+	{
+		CSVDataSet_FreeRows (csvDataset, data);
+		free (dataIndexes);
+		free (auxEntries);
+		free (csvDataset->readOrder);
+		csvDataset->readOrder = NULL;
+		CSVDataSet_FreeSegments (chunks, chunksCount);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Copy every segment to its position, and point its records to their new place */
+	for (i=0;i<chunksCount;i++)
+	{
+		memcpy (&auxEntries[chunks[i].firstEntry], chunks[i].entries, sizeof(EntryData) * chunks[i].entriesCount);
+		free (chunks[i].entries);
+		chunks[i].entries = auxEntries;
+		if (sparse)
+		{
+			chunks[i].data = data;
+			chunks[i].dataIndexes = dataIndexes;
+			CSVDataSet_MergeSparseChunk (&chunks[i]);
+		}
+		else
+		{
+			memcpy (&data[csvDataset->rowStride * chunks[i].firstEntry], chunks[i].data, csvDataset->rowStride * chunks[i].entriesCount);
+			for (j=chunks[i].firstEntry;j<chunks[i].firstEntry + chunks[i].entriesCount;j++)
+				auxEntries[j].byteFeatures = &data[csvDataset->rowStride * j];
+			free (chunks[i].data);
+		}
+		chunks[i].entries = NULL;
+		chunks[i].data = NULL;
+	}
+	if (FeatsTransform_IsSet (&csvDataset->options.transform) || csvDataset->options.prune == BD_PR_USE)
+		ret = CSVDataSet_ProcessRows (csvDataset, chunks, chunksCount, &data, auxEntries, entriesCount);
+	CSVDataSet_FreeSegments (chunks, chunksCount);
+	if (ret != ML_OK)
+	{
+		CSVDataSet_FreeRows (csvDataset, data);
+		free (auxEntries);
+		return ret;
+	}
+
+	/* Save the records on the dataset struct */
+	return CSVDataSet_SetEntries (csvDataset, auxEntries, entriesCount, maxClass);
+}
+
+static int CSVDataSet_ParseText (CSVDataSet * csvDataset, const char * pos, const char * end)
+{
+	unsigned long i;
+	unsigned long entriesCount;
+	unsigned long nnz;
+	unsigned int chunksCount;
+	int maxClass;
+	unsigned char * data;
+	unsigned int * dataIndexes = NULL;
+	EntryData * auxEntries;
+	CSVChunk * chunks;
+	unsigned char sparse;
+	int ret;
+
+	/* Split the data in one chunk per processor, as long as each chunk is big enough to be worth a thread */
+	chunksCount = Parallel_CpuCount ();
+	if ((unsigned long) (end - pos) / MIN_CHUNK_SIZE < chunksCount)
+		chunksCount = (unsigned int) ((end - pos) / MIN_CHUNK_SIZE) + 1;
+
+	chunks = (CSVChunk *) malloc (sizeof(CSVChunk) * chunksCount);
+	if (chunks == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	memset (chunks, 0, sizeof(CSVChunk) * chunksCount);
+
+	/* Chunks boundaries are moved forward to the next line break, so no record is split between two chunks */
+	for (i=0;i<chunksCount;i++)
+	{
+		chunks[i].csvDataset = csvDataset;
+		chunks[i].start = (i == 0) ? pos : chunks[i-1].end;
+		chunks[i].end = (i == chunksCount - 1) ? end : pos + ((end - pos) / chunksCount) * (i + 1);
+		if (chunks[i].end < chunks[i].start)
+			chunks[i].end = chunks[i].start;
+		if (chunks[i].end < end)
+			chunks[i].end = min (findChar (chunks[i].end, end, '\n') + 1, end);
+	}
+
+	/* Count the records of each chunk in parallel */
+	Parallel_Run ((void (*)(void *)) CSVDataSet_CountChunk, chunks, sizeof(CSVChunk), chunksCount);
+
+	/* A prefix sum over the counts gives the position of the first record of each chunk */
+	entriesCount = 0;
+	for (i=0;i<chunksCount;i++)
+	{
+		chunks[i].firstEntry = entriesCount;
+		entriesCount += chunks[i].entriesCount;
+	}
+
+	/* A dataset without records is considered an invalid file */
+	if (entriesCount == 0)
+	{
+		free (chunks);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Store the dataset in a contiguous block. Useful for "recasting" this as a Matrix if needed.
+	Sparse datasets only know the size of their block after parsing, so each chunk is parsed to its own buffers first */
+	sparse = (csvDataset->options.storage == BD_ST_SPARSE);
+	data = sparse ? NULL : (unsigned char *) CSVDataSet_AllocRows (csvDataset, csvDataset->rowStride * entriesCount);
+
+	/* Malloc an array to store the entries and another for the readOrder vector */
+	auxEntries = (EntryData *) malloc (sizeof(EntryData) * entriesCount);
+	csvDataset->readOrder = (off_t *) malloc (sizeof(off_t) * entriesCount);
+	if ((data == NULL && !sparse) || auxEntries == NULL || csvDataset->readOrder == NULL)
+	{
+		CSVDataSet_FreeRows (csvDataset, data);
+		free (auxEntries);
+		free (chunks);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Do NOT initialize the allocated memory, since it'll be written with valid data directly */
+
+	/* Parse all chunks in parallel, each one writing to its own slice of data and auxEntries */
+	for (i=0;i<chunksCount;i++)
+	{
+		chunks[i].data = data;
+		chunks[i].entries = auxEntries;
+	}
+	Parallel_Run ((void (*)(void *)) CSVDataSet_ParseChunk, chunks, sizeof(CSVChunk), chunksCount);
+
+	/* Merge the results of all chunks. A prefix sum over the number of values gives the position of each sparse chunk */
+	maxClass = 0;
+	nnz = 0;
+	ret = ML_OK;
+	for (i=0;i<chunksCount && ret == ML_OK;i++)
+	{
+		ret = chunks[i].ret;
+		if (chunks[i].maxClass > maxClass)
+			maxClass = chunks[i].maxClass;
+		chunks[i].nnzOffset = nnz;
+		nnz += chunks[i].nnz;
+	}
+
+	/* Copy the sparse chunks to a single block */
+	if (ret == ML_OK && sparse)
+	{
+		/* Malloc at least one value, so entries[0] always points to the block */
+		data = (unsigned char *) CSVDataSet_AllocRows (csvDataset, sizeof(double) * max (nnz, 1));
+		dataIndexes = (unsigned int *) malloc (sizeof(unsigned int) * max (nnz, 1));
+		if (data == NULL || dataIndexes == NULL)
+		{
+			errno = ENOMEM;
+			ret = ML_ERR_OUTOFMEMORY;
+		}
+		else
+		{
+			for (i=0;i<chunksCount;i++)
+			{
+				chunks[i].data = data;
+				chunks[i].dataIndexes = dataIndexes;
+			}
+			Parallel_Run ((void (*)(void *)) CSVDataSet_MergeSparseChunk, chunks, sizeof(CSVChunk), chunksCount);
+		}
+	}
+
+	/* Prune and scale the records with the statistics of the whole dataset */
+	if (ret == ML_OK && (FeatsTransform_IsSet (&csvDataset->options.transform) || csvDataset->options.prune == BD_PR_USE))
+		ret = CSVDataSet_ProcessRows (csvDataset, chunks, chunksCount, &data, auxEntries, entriesCount);
+
+	/* Free whatever is left of the chunks */
+	for (i=0;i<chunksCount;i++)
+	{
+		free (chunks[i].values);
+		free (chunks[i].indexes);
+		FeatsStats_Free (&chunks[i].stats);
+	}
+	free (chunks);
+
+	if (ret != ML_OK)
+	{
+		CSVDataSet_FreeRows (csvDataset, data);
+		free (dataIndexes);
+		free (auxEntries);
+		/* errno was set on the thread that failed, so set it again here */
+		errno = (ret == ML_ERR_OUTOFMEMORY) ? ENOMEM : (ret == ML_ERR_PARAM) ? EINVAL : EIO;
+		return ret;
+	}
+
+	/* Save the records on the dataset struct */
+	return CSVDataSet_SetEntries (csvDataset, auxEntries, entriesCount, maxClass);
+}
+
+static int CSVDataSet_LoadData_Full (CSVDataSet * csvDataset)
+{
+	FileMap map;
+	int ret;
+
+	/* Compressed files can't be mapped */
+	if (csvDataset->gzip != NULL)
+		return CSVDataSet_LoadData_Segments (csvDataset);
+
+	/* Map the whole file to memory. Parsing from memory is a lot faster than going through fscanf */
+	ret = FileMap_Open (&map, csvDataset->file, FM_ACCESS_SEQUENTIAL);
+	if (ret != ML_OK)
+		return ret;
+
+	/* The header was already consumed, so the data starts at the current file position */
+	ret = CSVDataSet_ParseText (csvDataset, map.data + ftello (csvDataset->file), map.data + map.size);
+
+	/* Don't need the file contents anymore */
+	FileMap_Close (&map);
+
+	return ret;
+}
+
+static int CSVDataSet_LoadData_Incremental (CSVDataSet * csvDataset)
+{
+	unsigned long i;
+	off_t pos;
+	off_t lineStart;
+	size_t maxLineLength;
+	int ret;
+
+	/* Initialize the readOrder array. On incrementally read datasets we must store the start position of each record */
+	/* Find "newlines" to find the start position of each record, keeping track of the longest line */
+	i = 0;
+	pos = lineStart = ftello(csvDataset->file);
+	maxLineLength = 0;
+	csvDataset->readOrder[i++] = pos;
+	while (!feof(csvDataset->file) && !ferror(csvDataset->file))
+	{
+		ret = fgetc(csvDataset->file);
+		pos++;
+		if (ret == '\n' || ret < 0)
+		{
+			if ((size_t) (pos - lineStart) > maxLineLength)
+				maxLineLength = (size_t) (pos - lineStart);
+			if (i < csvDataset->entriesCount)
+				csvDataset->readOrder[i++] = pos;
+			lineStart = pos;
+		}
+	}
+
+	/* Create the read ahead state. The file ends right before the last position read */
+	return CSVDataSet_PrepareIncremental (csvDataset, maxLineLength, csvDataset->readOrder[0], pos - 1);
+}
+
+static int CSVDataSet_LoadData (CSVDataSet * csvDataset)
+{
+	off_t dataStartPos;
+	size_t tailLength;
+	char lastChar = 0;
+	int c;
+	int ret;
+
+	/* "FULL" datasets find out the number of records while parsing them, in a single pass */
+	if (csvDataset->readMode == BD_RM_FULL)
+		return CSVDataSet_LoadData_Full (csvDataset);
+	else if (csvDataset->readMode != BD_RM_INCREMENTAL)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Formats that don't declare their classes take the highest class found as the number of classes */
+	if (csvDataset->classesCount == 0)
+	{
+		ret = CSVDataSet_CountClasses (csvDataset);
+		if (ret != ML_OK)
+			return ret;
+	}
+
+	/* Save the position of the begining of the data */
+	dataStartPos = ftello (csvDataset->file);
+
+	/* Count "newlines" to find the number of records */
+	csvDataset->entriesCount = 0;
+	tailLength = 0;
+	while ((c = fgetc(csvDataset->file)) >= 0)
+	{
+		if (c == '\n')
+		{
+			csvDataset->entriesCount++;
+			tailLength = 0;
+		}
+		else
+		{
+			lastChar = (char) c;
+			tailLength++;
+		}
+	}
+
+	/* The last line may have no "newline". It's a record too, unless it's empty (as on "FULL" datasets) */
+	if (tailLength > 1 || (tailLength == 1 && lastChar != '\r'))
+		csvDataset->entriesCount++;
+	if (ferror(csvDataset->file))
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Reset the file to the begining of the data */
+	fseeko (csvDataset->file, dataStartPos, SEEK_SET);
+
+	/* Malloc an area to store the readOrder vector */
+	csvDataset->readOrder = (off_t *) malloc (sizeof(off_t) * csvDataset->entriesCount);
+	if (csvDataset->readOrder == NULL)
+	{
+		CSVDataSet_CloseFile (csvDataset);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Prepare the offsets of each record on the file */
+	ret = CSVDataSet_LoadData_Incremental (csvDataset);
+
+	/* If something went wrong, free the readOrder array and return the error code */
+	if (ret != ML_OK)
+	{
+		free (csvDataset->readOrder);
+		csvDataset->readOrder = NULL;
+		return ret;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void CSVDataSet_IndexInfo (CSVDataSet * csvDataset, off_t dataStart, RecordIndexInfo * info)
+{
+	/* Parameters the file is read with. An index is only used with the same ones */
+	memset (info, 0, sizeof(RecordIndexInfo));
+	info->hasLabels = csvDataset->hasLabels;
+	info->delimiter = csvDataset->delimiter;
+	info->featsCount = csvDataset->fileFeatsCount;
+	info->dataStart = dataStart;
+}
+
+static int CSVDataSet_LoadData_Indexed (CSVDataSet * csvDataset, const char * srcPath)
+{
+	RecordIndexInfo index;
+	int ret;
+
+	/* Use a valid index. Otherwise scan the file and write a new one (the dataset works the same if that fails) */
+	CSVDataSet_IndexInfo (csvDataset, ftello (csvDataset->file), &index);
+	if (RecordIndex_Load (srcPath, &index, &csvDataset->readOrder) == ML_OK)
+	{
+		/* Formats that declare their classes already know them */
+		if (csvDataset->classesCount == 0)
+			csvDataset->classesCount = index.classesCount;
+		csvDataset->entriesCount = index.entriesCount;
+		ret = CSVDataSet_PrepareIncremental (csvDataset, index.maxLineLength, index.dataStart, index.dataEnd);
+	}
+	else
+	{
+		ret = csvDataset->loadData (csvDataset);
+		if (ret == ML_OK)
+		{
+			CSVDataSet_IndexInfo (csvDataset, csvDataset->readAhead->dataStart, &index);
+			index.classesCount = csvDataset->classesCount;
+			index.entriesCount = csvDataset->entriesCount;
+			index.maxLineLength = csvDataset->readAhead->maxLineLength;
+			index.dataEnd = csvDataset->readAhead->dataEnd;
+			RecordIndex_Save (srcPath, &index, csvDataset->readOrder);
+		}
+	}
+
+	return ret;
+}
+
+static int CSVDataSet_LoadData_Sampled (CSVDataSet * csvDataset, const char * srcPath)
+{
+	RecordIndexInfo index;
+	RecordSample sample;
+	FileMap map;
+	Random random;
+	EntryData entry;
+	const char * dataStart;
+	const char * end;
+	char * text;
+	double * row;
+	off_t * offsets;
+	unsigned long i;
+	int maxClass;
+	int ret;
+
+	/* Compressed files can't be read at random offsets without decompressing everything before them */
+	if (csvDataset->gzip != NULL)
+	{
+		errno = ENOSYS;
+		return ML_ERR_NOTIMPLEMENTED;
+	}
+
+	/* Map the whole file. Only the pages of the records picked (and those of the header) are actually read */
+	ret = FileMap_Open (&map, csvDataset->file, FM_ACCESS_RANDOM);
+	if (ret != ML_OK)
+		return ret;
+	dataStart = map.data + ftello (csvDataset->file);
+	end = map.data + map.size;
+	Random_Seed (&random, (csvDataset->options.sampleSeed != 0) ? (uint64_t) csvDataset->options.sampleSeed : Random_TimeSeed ());
+
+	/*	A valid index gives the offsets of all records, to pick an exact uniform sample. Otherwise records are picked at
+		random byte offsets */
+	CSVDataSet_IndexInfo (csvDataset, (off_t) (dataStart - map.data), &index);
+	if (csvDataset->options.index == BD_IX_USE && RecordIndex_Load (srcPath, &index, &offsets) == ML_OK)
+	{
+		/* Formats that declare their classes already know them */
+		if (csvDataset->classesCount == 0)
+			csvDataset->classesCount = index.classesCount;
+		ret = RecordSample_FromOffsets (&sample, map.data, end, offsets, index.entriesCount, csvDataset->options.sample, &random);
+	}
+	else
+		ret = RecordSample_FromText (&sample, map.data, dataStart, end, csvDataset->options.sample, &random);
+
+	/* A dataset without records is considered an invalid file */
+	if (ret == ML_OK && sample.count == 0)
+	{
+		errno = EIO;
+		ret = ML_ERR_FILE;
+	}
+	if (ret != ML_OK)
+	{
+		RecordSample_Free (&sample);
+		FileMap_Close (&map);
+		return ret;
+	}
+
+	if (csvDataset->readMode == BD_RM_FULL)
+	{
+		/* Put the records picked together, and parse them as a whole file */
+		text = RecordSample_Text (&sample, map.data, end);
+		RecordSample_Free (&sample);
+		FileMap_Close (&map);
+		if (text == NULL)
+			return ML_ERR_OUTOFMEMORY;
+
+		ret = CSVDataSet_ParseText (csvDataset, text, text + sample.length);
+		free (text);
+		return ret;
+	}
+	else if (csvDataset->readMode != BD_RM_INCREMENTAL)
+	{
+		RecordSample_Free (&sample);
+		FileMap_Close (&map);
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Formats that don't declare their classes (and weren't given them by the index) take the highest class picked */
+	if (csvDataset->classesCount == 0)
+	{
+		row = (double *) malloc (sizeof(double) * max (csvDataset->featsCount, 1));
+		if (row == NULL)
+		{
+			RecordSample_Free (&sample);
+			FileMap_Close (&map);
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		maxClass = 0;
+		memset (&entry, 0, sizeof(EntryData));
+		for (i=0;i<sample.count && ret == ML_OK;i++)
+		{
+			entry.features = row;
+			entry.indexes = NULL;
+			ret = csvDataset->parseLine (csvDataset, map.data + sample.offsets[i], findChar (map.data + sample.offsets[i], end, '\n'), &entry);
+			if (entry.class > maxClass)
+				maxClass = entry.class;
+		}
+		free (row);
+		if (ret != ML_OK)
+		{
+			RecordSample_Free (&sample);
+			FileMap_Close (&map);
+			return ret;
+		}
+		csvDataset->classesCount = maxClass;
+	}
+
+	/* The records picked are read as any other INCREMENTAL dataset's */
+	csvDataset->readOrder = sample.offsets;
+	csvDataset->entriesCount = sample.count;
+	ret = CSVDataSet_PrepareIncremental (csvDataset, sample.maxLineLength, (off_t) (dataStart - map.data), (off_t) map.size);
+	FileMap_Close (&map);
+
+	return ret;
+}
+
+static void CSVDataSet_FreeEntries (CSVDataSet * csvDataset)
+{
+	/*	Records of a shared block are just unmapped. Aligned datasets have their own blocks for the rows and the classes.
+		Otherwise entries[0] points to the whole memory block (and to the whole indexes block, on sparse datasets). Free it */
+	if (csvDataset->shared.data == NULL && csvDataset->rows != NULL)
+	{
+		CSVDataSet_FreeRows (csvDataset, csvDataset->rows);
+		free (csvDataset->classes);
+	}
+	else if (csvDataset->shared.data == NULL && csvDataset->entries != NULL)
+	{
+		if (csvDataset->entries[0].features != NULL)
+			CSVDataSet_FreeRows (csvDataset, csvDataset->entries[0].features);
+		if (csvDataset->entries[0].indexes != NULL)
+			free (csvDataset->entries[0].indexes);
+	}
+	csvDataset->rows = NULL;
+	csvDataset->classes = NULL;
+	SharedMem_Close (&csvDataset->shared);
+
+	/* Free the arrays */
+	free (csvDataset->entries);
+	csvDataset->entries = NULL;
+	free (csvDataset->readOrder);
+	csvDataset->readOrder = NULL;
+}
+
+static char * CSVDataSet_SharedKey (CSVDataSet * csvDataset, const char * srcPath, char * name)
+{
+	char * params;
+	char * pos;
+	char * key;
+	unsigned long i;
+
+	/* Everything (besides the file) that changes the records: how it's read, and the options */
+	params = (char *) malloc (128 + 21 * csvDataset->options.columnsCount);
+	if (params == NULL)
+		return NULL;
+	pos = params + sprintf (params, "%u %d %u %u %u %.17g %llu\n", (unsigned int) csvDataset->hasLabels, (int) csvDataset->delimiter,
+		(unsigned int) csvDataset->options.storage, (unsigned int) csvDataset->options.layout, (unsigned int) csvDataset->options.index,
+		csvDataset->options.sample, csvDataset->options.sampleSeed);
+	for (i=0;i<csvDataset->options.columnsCount && csvDataset->options.columns != NULL;i++)
+		pos += sprintf (pos, "%lu ", csvDataset->options.columns[i]);
+
+	key = SharedRecords_Key (srcPath, params, name);
+	free (params);
+	return key;
+}
+
+static void CSVDataSet_SharedRecords (CSVDataSet * csvDataset, SharedRecords * records)
+{
+	/* Shape of the records of the dataset */
+	memset (records, 0, sizeof(SharedRecords));
+	records->featsCount = csvDataset->featsCount;
+	records->classesCount = csvDataset->classesCount;
+	records->entriesCount = csvDataset->entriesCount;
+	records->sparse = (csvDataset->options.storage == BD_ST_SPARSE);
+	records->rowStride = csvDataset->rowStride;
+	records->classes = csvDataset->classes;
+	records->rows = csvDataset->rows;
+}
+
+static int CSVDataSet_AttachShared (CSVDataSet * csvDataset, const char * name, const char * key, const FileStamp * file)
+{
+	SharedRecords records;
+	EntryData * entries;
+	off_t * readOrder;
+	unsigned long i;
+	unsigned char aligned;
+
+	CSVDataSet_SharedRecords (csvDataset, &records);
+	if (SharedRecords_Attach (&records, name, key, file) != ML_OK)
+		return 0;
+
+	/*	Only the records are shared. Each process points its own entries into the block (and has its own read order).
+		Aligned datasets use the rows and classes of the block as they are, with a single record struct */
+	aligned = (csvDataset->options.layout == BD_LY_ALIGNED);
+	entries = (EntryData *) malloc (sizeof(EntryData) * (aligned ? 1 : records.entriesCount));
+	readOrder = (off_t *) malloc (sizeof(off_t) * records.entriesCount);
+	if (entries == NULL || readOrder == NULL)
+	{
+		free (entries);
+		free (readOrder);
+		SharedMem_Close (&records.shm);
+		return 0;
+	}
+	memset (entries, 0, sizeof(EntryData) * (aligned ? 1 : records.entriesCount));
+	for (i=0;i<records.entriesCount && !aligned;i++)
+	{
+		entries[i].class = records.classes[i];
+		if (records.sparse)
+		{
+			entries[i].features = records.values + records.starts[i];
+			entries[i].indexes = records.indexes + records.starts[i];
+			entries[i].nnz = (unsigned long) (records.starts[i + 1] - records.starts[i]);
+			entries[i].type = DS_ET_DOUBLE;
+		}
+		else
+		{
+			entries[i].byteFeatures = records.rows + csvDataset->rowStride * i;
+			entries[i].type = storageTypes[csvDataset->options.storage];
+		}
+	}
+
+	for (i=0;i<records.entriesCount;i++)
+		readOrder[i] = i;
+
+	/*	Drop the records loaded by this process (if any), and use the shared ones. Nothing can fail from here on, so the
+		dataset is never left without records */
+	CSVDataSet_FreeEntries (csvDataset);
+	csvDataset->shared = records.shm;
+	csvDataset->readOrder = readOrder;
+	csvDataset->entries = entries;
+	csvDataset->entriesCount = records.entriesCount;
+	csvDataset->classesCount = records.classesCount;
+	if (aligned)
+	{
+		csvDataset->rows = records.rows;
+		csvDataset->classes = records.classes;
+		csvDataset->nextEntry = (int(*)(DataSet *, EntryData **)) CSVDataSet_NextEntry_Aligned;
+	}
+	else
+		csvDataset->nextEntry = (int(*)(DataSet *, EntryData **)) CSVDataSet_NextEntry_Full;
+
+	return 1;
+}
+
+static void CSVDataSet_PublishShared (CSVDataSet * csvDataset, const char * name, const char * key, const FileStamp * file)
+{
+	SharedRecords records;
+
+	/*	Aligned rows are already a single block. Otherwise each record is copied from its entry. If another process is
+		still publishing the block, this process keeps its own records */
+	CSVDataSet_SharedRecords (csvDataset, &records);
+	if (SharedRecords_Publish (&records, (csvDataset->rows != NULL) ? NULL : csvDataset->entries, name, key, file) != ML_OK)
+		return;
+
+	/* Use the shared copy from now on, so the machine holds a single one. If that fails, the records loaded are kept */
+	CSVDataSet_AttachShared (csvDataset, name, key, file);
+}
+
+static int CSVDataSet_SelectColumns (CSVDataSet * csvDataset)
+{
+	unsigned long i;
+
+	/* All features of the file are loaded, unless the options select some of them */
+	csvDataset->fileFeatsCount = csvDataset->featsCount;
+	if (csvDataset->options.columns == NULL)
+		return ML_OK;
+
+	/* The selected columns must exist on the file, in increasing order and without repeats */
+	for (i=0;i<csvDataset->options.columnsCount;i++)
+	{
+		if (csvDataset->options.columns[i] >= csvDataset->fileFeatsCount || (i > 0 && csvDataset->options.columns[i] <= csvDataset->options.columns[i - 1]))
+			break;
+	}
+	if (csvDataset->options.columnsCount == 0 || i < csvDataset->options.columnsCount)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Keep a copy of them. The options point to it from now on, so they stay valid after the caller's array is gone */
+	csvDataset->columns = (unsigned long *) malloc (sizeof(unsigned long) * csvDataset->options.columnsCount);
+	if (csvDataset->columns == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	memcpy (csvDataset->columns, csvDataset->options.columns, sizeof(unsigned long) * csvDataset->options.columnsCount);
+	csvDataset->options.columns = csvDataset->columns;
+	csvDataset->featsCount = csvDataset->options.columnsCount;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int CSVDataSet_ParseColumns (CSVDataSet * csvDataset, const char * line, const char * lineEnd, EntryData * entry)
+{
+	unsigned long column = 0;
+	unsigned long i;
+	long class;
+
+	/* CSV records are always dense */
+	entry->indexes = NULL;
+
+	/* Read the selected feats. The fields before each one are skipped by finding their delimiters, without converting them */
+	for (i=0;i<=csvDataset->featsCount;i++)
+	{
+		for (;column<((i < csvDataset->featsCount) ? csvDataset->columns[i] : csvDataset->fileFeatsCount);column++)
+		{
+			line = findChar (line, lineEnd, csvDataset->delimiter);
+			if (line >= lineEnd)
+			{
+				errno = EIO;
+				return ML_ERR_FILE;
+			}
+			line++;
+		}
+
+		/* The class follows the last feature of the file */
+		if (i == csvDataset->featsCount)
+			break;
+
+		line = parseDouble (line, lineEnd, &entry->features[i]);
+		if (line == NULL || line >= lineEnd || *line != csvDataset->delimiter)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		/* Skip the delimiter */
+		line++;
+		column++;
+	}
+
+	/* Read this record's class */
+	if (parseLong (line, lineEnd, &class) == NULL)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	entry->class = (int) class;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void CSVDataSet_CollectStats (CSVStatsTask * task)
+{
+	CSVDataSet * csvDataset = task->csvDataset;
+	EntryData entry;
+	char * buffer;
+	double * row;
+	ssize_t size;
+	unsigned long i;
+
+	buffer = (char *) malloc (csvDataset->readAhead->maxLineLength);
+	row = (double *) malloc (sizeof(double) * max (csvDataset->featsCount, 1));
+	if (buffer == NULL || row == NULL)
+	{
+		free (buffer);
+		free (row);
+		errno = ENOMEM;
+		task->ret = ML_ERR_OUTOFMEMORY;
+		return;
+	}
+	task->ret = FeatsStats_Init (&task->stats, csvDataset->featsCount);
+
+	/* Read and parse every record of the slice as nextEntry would, and add its clipped and logged values to the statistics */
+	memset (&entry, 0, sizeof(EntryData));
+	for (i=task->first;i<task->first + task->entriesCount && task->ret == ML_OK;i++)
+	{
+		size = CSVDataSet_PRead (csvDataset, buffer, csvDataset->readAhead->maxLineLength, csvDataset->readOrder[i]);
+		if (size <= 0)
+		{
+			errno = EIO;
+			task->ret = ML_ERR_FILE;
+			break;
+		}
+		entry.features = row;
+		entry.indexes = NULL;
+		entry.type = DS_ET_DOUBLE;
+		task->ret = csvDataset->parseLine (csvDataset, buffer, findChar (buffer, buffer + size, '\n'), &entry);
+		if (task->ret == ML_OK)
+			task->ret = FeatsTransform_Map (&csvDataset->options.transform, row, csvDataset->featsCount);
+		if (task->ret == ML_OK)
+			FeatsStats_Add (&task->stats, row);
+	}
+
+	free (buffer);
+	free (row);
+}
+
+static int CSVDataSet_PrepareFeatures (CSVDataSet * csvDataset)
+{
+	CSVStatsTask * tasks;
+	FeatsStats stats;
+	unsigned long * kept;
+	unsigned int tasksCount;
+	unsigned long first;
+	unsigned int i;
+	int ret = ML_OK;
+
+	/*	Records of INCREMENTAL datasets are only parsed when they're read, so the statistics need a pass of their own over
+		them (split between the processors) */
+	memset (&stats, 0, sizeof(FeatsStats));
+	if (FeatsTransform_NeedsStats (&csvDataset->options.transform) || csvDataset->options.prune == BD_PR_USE)
+	{
+		tasksCount = Parallel_CpuCount ();
+		if (csvDataset->entriesCount < tasksCount)
+			tasksCount = (unsigned int) max (csvDataset->entriesCount, 1);
+		tasks = (CSVStatsTask *) malloc (sizeof(CSVStatsTask) * tasksCount);
+		if (tasks == NULL)
+		{
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		memset (tasks, 0, sizeof(CSVStatsTask) * tasksCount);
+		for (i=0,first=0;i<tasksCount;i++)
+		{
+			tasks[i].csvDataset = csvDataset;
+			tasks[i].first = first;
+			tasks[i].entriesCount = csvDataset->entriesCount / tasksCount + ((i < csvDataset->entriesCount % tasksCount) ? 1 : 0);
+			first += tasks[i].entriesCount;
+		}
+		Parallel_Run ((void (*)(void *)) CSVDataSet_CollectStats, tasks, sizeof(CSVStatsTask), tasksCount);
+
+		/* Merge the statistics of every slice */
+		ret = FeatsStats_Init (&stats, csvDataset->featsCount);
+		for (i=0;i<tasksCount;i++)
+		{
+			if (ret == ML_OK)
+				ret = tasks[i].ret;
+			if (ret == ML_OK)
+				FeatsStats_Merge (&stats, &tasks[i].stats);
+			FeatsStats_Free (&tasks[i].stats);
+		}
+		free (tasks);
+	}
+
+	/* Drop the constant features. Records are parsed with only the remaining ones from now on */
+	if (ret == ML_OK && csvDataset->options.prune == BD_PR_USE)
+	{
+		ret = CSVDataSet_PruneColumns (csvDataset, &stats, &kept);
+		free (kept);
+	}
+
+	if (ret == ML_OK && FeatsTransform_IsSet (&csvDataset->options.transform))
+	{
+		csvDataset->transform = FeatsTransform_New (&csvDataset->options.transform, csvDataset->featsCount, &stats);
+		if (csvDataset->transform == NULL)
+			ret = (errno == ENOMEM) ? ML_ERR_OUTOFMEMORY : ML_ERR_PARAM;
+	}
+	FeatsStats_Free (&stats);
+
+	/* errno may have been set on another thread, so set it again here */
+	if (ret != ML_OK)
+		errno = (ret == ML_ERR_OUTOFMEMORY) ? ENOMEM : (ret == ML_ERR_PARAM) ? EINVAL : EIO;
+	return ret;
+}
+
+static int CSVDataSet_CheckStorage (CSVDataSet * csvDataset)
+{
+	/*	Options that depend on the storage: aligned rows are dense, and FULL datasets only transform double or float records,
+		and only prune dense ones (the statistics and the compaction work on whole rows) */
+	if ((csvDataset->options.layout == BD_LY_ALIGNED && csvDataset->options.storage == BD_ST_SPARSE) ||
+		(FeatsTransform_IsSet (&csvDataset->options.transform) && csvDataset->readMode == BD_RM_FULL &&
+		csvDataset->options.storage != BD_ST_DOUBLE && csvDataset->options.storage != BD_ST_FLOAT) ||
+		(csvDataset->options.prune == BD_PR_USE && csvDataset->readMode == BD_RM_FULL && csvDataset->options.storage == BD_ST_SPARSE))
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	return ML_OK;
+}
+
+static int CSVDataSet_Load (CSVDataSet * csvDataset, char * srcPath)
+{
+	FileStamp sharedFile;
+	char name[SHAREDMEM_NAME_SIZE];
+	char * key;
+	unsigned char attached = 0;
+	int ret;
+
+	/* Check the options */
+	if (csvDataset->options.storage > BD_ST_BIT || csvDataset->options.index > BD_IX_USE || csvDataset->options.share > BD_SH_USE ||
+		csvDataset->options.layout > BD_LY_ALIGNED || csvDataset->options.memory.pages > MEM_PG_EXPLICIT || csvDataset->options.memory.numa > MEM_NM_BIND ||
+		(csvDataset->options.memory.numa == MEM_NM_BIND && csvDataset->options.memory.node >= Memory_NodesCount ()) ||
+		csvDataset->options.prune > BD_PR_USE || !(csvDataset->options.pruneVariance >= 0) ||
+		!(csvDataset->options.sample >= 0 && csvDataset->options.sample <= 1))
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+	ret = CSVDataSet_CheckStorage (csvDataset);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Open the dataset file */
+	csvDataset->file = fopen (srcPath, "rb");
+	if (csvDataset->file == NULL)
+	{
+		errno = ENOENT;
+		return ML_ERR_FILENOTFOUND;
+	}
+
+	/* Compressed files are read through a stream that decompresses them. Everything else works as with a plain file */
+	if (GzipFile_IsCompressed (csvDataset->file))
+	{
+		csvDataset->gzip = GzipFile_Open (csvDataset->file);
+		if (csvDataset->gzip == NULL)
+		{
+			ret = (errno == ENOMEM) ? ML_ERR_OUTOFMEMORY : (errno == ENOSYS) ? ML_ERR_NOTIMPLEMENTED : ML_ERR_FILE;
+			CSVDataSet_CloseFile (csvDataset);
+			return ret;
+		}
+		csvDataset->file = GzipFile_Stream (csvDataset->gzip);
+	}
+
+	/*	Only this thread reads the file while loading. Holding its lock spares the lock on every character read, which gets
+		expensive as soon as there are other threads (i.e. the one decompressing a compressed file) */
+	flockfile (csvDataset->file);
+
+	/* Load the header of the file, and keep only the selected features. The header may have changed the storage (i.e. sparse ARFF files) */
+	ret = csvDataset->loadHeader(csvDataset);
+	if (ret == ML_OK)
+		ret = CSVDataSet_CheckStorage (csvDataset);
+	if (ret == ML_OK)
+		ret = CSVDataSet_SelectColumns (csvDataset);
+
+	/*	Check the transform before parsing anything. Formats that only know their features once loaded (featsCount is 0 by now),
+		and pruned datasets (which only know them once the records are parsed), have it checked when it's built */
+	if (ret == ML_OK && FeatsTransform_IsSet (&csvDataset->options.transform) && csvDataset->featsCount > 0 && csvDataset->options.prune == BD_PR_NONE)
+		ret = FeatsTransform_Check (&csvDataset->options.transform, csvDataset->featsCount);
+
+	/* Dense records of FULL datasets are stored "rowStride" bytes apart. Aligned ones take whole cache lines */
+	csvDataset->rowStride = EntryData_RowSize (storageTypes[csvDataset->options.storage], csvDataset->featsCount);
+	if (csvDataset->options.layout == BD_LY_ALIGNED)
+		csvDataset->rowStride = Memory_AlignSize (csvDataset->rowStride, MEMORY_CACHE_LINE);
+
+	/*	FULL datasets may take their records from a shared block published by another process. The file is identified as
+		with the index: its size, modification time and a hash of some pieces of it. Samples without a seed are different
+		every time, so they're never shared. Neither are transformed or pruned records, as the transform and the columns kept aren't on the block */
+	key = NULL;
+	if (ret == ML_OK && csvDataset->readMode == BD_RM_FULL && csvDataset->options.share == BD_SH_USE &&
+		!(csvDataset->options.sample > 0 && csvDataset->options.sample < 1 && csvDataset->options.sampleSeed == 0) &&
+		!FeatsTransform_IsSet (&csvDataset->options.transform) && csvDataset->options.prune == BD_PR_NONE)
+	{
+		key = CSVDataSet_SharedKey (csvDataset, srcPath, name);
+		if (key != NULL)
+		{
+			RecordIndex_Stamp (srcPath, &sharedFile);
+			if (CSVDataSet_AttachShared (csvDataset, name, key, &sharedFile))
+			{
+				free (key);
+				key = NULL;
+				attached = 1;
+			}
+		}
+	}
+
+	/*	Load (or prepare) the data of the file. Incremental datasets can take the offsets of the records from an index, instead
+		of scanning the file. Compressed files are always scanned, as random reads need the seek index built while doing so.
+		Samples only read the records picked */
+	if (ret == ML_OK && !attached)
+	{
+		if (csvDataset->options.sample > 0 && csvDataset->options.sample < 1)
+			ret = CSVDataSet_LoadData_Sampled (csvDataset, srcPath);
+		else if (csvDataset->readMode == BD_RM_INCREMENTAL && csvDataset->options.index == BD_IX_USE && csvDataset->gzip == NULL)
+			ret = CSVDataSet_LoadData_Indexed (csvDataset, srcPath);
+		else
+			ret = csvDataset->loadData(csvDataset);
+
+		/* Publish the records for the next processes */
+		if (ret == ML_OK && key != NULL)
+			CSVDataSet_PublishShared (csvDataset, name, key, &sharedFile);
+	}
+	free (key);
+
+	/* The file may have been closed on errors */
+	if (csvDataset->file != NULL)
+		funlockfile (csvDataset->file);
+	if (ret != ML_OK)
+		return ret;
+
+	/*	INCREMENTAL datasets transform each record when it's read. Find the features to drop, and build the transform now,
+		from the statistics of all of them */
+	if (csvDataset->readMode == BD_RM_INCREMENTAL && (FeatsTransform_IsSet (&csvDataset->options.transform) || csvDataset->options.prune == BD_PR_USE))
+	{
+		ret = CSVDataSet_PrepareFeatures (csvDataset);
+		if (ret != ML_OK)
+			return ret;
+	}
+
+	/* If readMode == FULL, and the file is still open, close the file pointer */
+	if (csvDataset->readMode == BD_RM_FULL && csvDataset->file != NULL)
+		CSVDataSet_CloseFile (csvDataset);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void CSVDataSet_FormatRecords (CSVWriteTask * task)
+{
+	const double * features;
+	unsigned long i;
+	unsigned long j;
+	size_t capacity;
+	char * auxText;
+	char * pos;
+
+	/* Make sure the text of the longest possible records fits */
+	capacity = task->entriesCount * (task->featsCount * (FORMAT_DOUBLE_MAX + 1) + FORMAT_LONG_MAX + 1);
+	if (capacity > task->capacity)
+	{
+		auxText = (char *) realloc (task->text, capacity);
+		if (auxText == NULL)
+		{
+			errno = ENOMEM;
+			task->ret = ML_ERR_OUTOFMEMORY;
+			return;
+		}
+		task->text = auxText;
+		task->capacity = capacity;
+	}
+
+	/* Each record is a line with its features, each one followed by the delimiter, and then its class */
+	pos = task->text;
+	features = task->features;
+	for (i=0;i<task->entriesCount;i++)
+	{
+		for (j=0;j<task->featsCount;j++)
+		{
+			pos = formatDouble (pos, features[j]);
+			*pos++ = task->delimiter;
+		}
+		pos = formatLong (pos, task->classes[i]);
+		*pos++ = '\n';
+		features += task->featsCount;
+	}
+
+	task->size = (size_t) (pos - task->text);
+	task->ret = ML_OK;
+}
+
+static void CSVDataSet_Free (CSVDataSet * csvDataset)
+{
+	/* Stop and free the read ahead state, and the cache */
+	if (csvDataset->readAhead != NULL)
+	{
+		CSVDataSet_StopReadAhead (csvDataset);
+		if (csvDataset->cache != NULL)
+		{
+			BlockCache_Free (csvDataset->cache);
+			csvDataset->cache = NULL;
+		}
+		pthread_mutex_destroy (&csvDataset->readAhead->lock);
+		pthread_cond_destroy (&csvDataset->readAhead->filled);
+		pthread_cond_destroy (&csvDataset->readAhead->consumed);
+		free (csvDataset->readAhead->status);
+		free (csvDataset->readAhead->threadBuffer);
+		free (csvDataset->readAhead->callerBuffer);
+		free (csvDataset->readAhead);
+		csvDataset->readAhead = NULL;
+	}
+
+	/* Close the file pointer if it's still open */
+	if (csvDataset->file != NULL)
+		CSVDataSet_CloseFile (csvDataset);
+
+	/* Free the readOrder array */
+	if (csvDataset->readOrder != NULL)
+	{
+		free (csvDataset->readOrder);
+		csvDataset->readOrder = NULL;
+	}
+
+	/* Free the transform */
+	FeatsTransform_Free (csvDataset->transform);
+	csvDataset->transform = NULL;
+
+	/* Free entries (or detach from the shared block that holds them) */
+	CSVDataSet_FreeEntries (csvDataset);
+
+	/* Free the selected columns */
+	if (csvDataset->columns != NULL)
+	{
+		free (csvDataset->columns);
+		csvDataset->columns = NULL;
+		csvDataset->options.columns = NULL;
+	}
+
+	/* Call the "superclass" free function */
+	super.free((DataSet *) csvDataset);
+}
+
+/************************
+* "Protected" Functions	*
+************************/
+
+long CSVDataSet_FeaturePosition (CSVDataSet * csvDataset, unsigned long column)
+{
+	unsigned long first = 0;
+	unsigned long last;
+	unsigned long middle;
+
+	/* Without a selection, every column is loaded at its own position */
+	if (csvDataset->columns == NULL)
+		return (column < csvDataset->featsCount) ? (long) column : -1;
+
+	/* Binary search for the column on the selected ones */
+	last = csvDataset->featsCount;
+	while (first < last)
+	{
+		middle = first + (last - first) / 2;
+		if (csvDataset->columns[middle] == column)
+			return (long) middle;
+		if (csvDataset->columns[middle] < column)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return -1;
+}
+
+int CSVDataSet_PrepareIncremental (CSVDataSet * csvDataset, size_t maxLineLength, off_t dataStart, off_t dataEnd)
+{
+	int ret;
+
+	/* Create the read ahead state */
+	csvDataset->readAhead = (CSVReadAhead *) malloc (sizeof(CSVReadAhead));
+	if (csvDataset->readAhead == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	memset (csvDataset->readAhead, 0, sizeof(CSVReadAhead));
+	pthread_mutex_init (&csvDataset->readAhead->lock, NULL);
+	pthread_cond_init (&csvDataset->readAhead->filled, NULL);
+	pthread_cond_init (&csvDataset->readAhead->consumed, NULL);
+	csvDataset->readAhead->maxLineLength = maxLineLength;
+	csvDataset->readAhead->dataStart = dataStart;
+	csvDataset->readAhead->dataEnd = dataEnd;
+
+	/* Get buffers big enough to read any line of the file */
+	csvDataset->readAhead->threadBuffer = (char *) malloc (maxLineLength);
+	csvDataset->readAhead->callerBuffer = (char *) malloc (maxLineLength);
+	if (csvDataset->readAhead->threadBuffer == NULL || csvDataset->readAhead->callerBuffer == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Create the ring of entries where records are read to */
+	ret = CSVDataSet_SetReadAhead (csvDataset, DEFAULT_READAHEAD, DEFAULT_WINDOW);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Update the "nextEntry" pointer to point to the function that handles "incremental" datasets */
+	csvDataset->nextEntry = (int(*)(DataSet *, EntryData **)) CSVDataSet_NextEntry_Incremental;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int CSVDataSet_ReadLine (CSVDataSet * csvDataset, EntryData * entry)
+{
+	unsigned long i;
+	unsigned long selected;
+	unsigned long featsCount;
+	int c;
+
+	/* Determine the number of features on the file */
+	featsCount = csvDataset->fileFeatsCount;
+
+	/* Read this record's feats. Those not selected are skipped up to their delimiter, without being converted */
+	for (i=0,selected=0;i<featsCount;i++)
+	{
+		if (csvDataset->columns != NULL && (selected == csvDataset->featsCount || csvDataset->columns[selected] != i))
+		{
+			do {
+				c = fgetc (csvDataset->file);
+			} while (c != csvDataset->delimiter && c >= 0);
+			if (c < 0)
+				return ML_WARN_EOF;
+			continue;
+		}
+		if (fscanf (csvDataset->file, "%lf", &entry->features[selected++]) == EOF)
+			return ML_WARN_EOF;
+		/* Skip the delimiter */
+		fgetc (csvDataset->file);
+	}
+
+	/* Read this record's class */
+	if (fscanf (csvDataset->file, "%d", &entry->class) == EOF)
+		return ML_WARN_EOF;
+	/* Skip the newLine. The last record may have none: the EOF is returned by the next call */
+	fgetc (csvDataset->file);
+
+	/* If there was an error, return the error */
+	if (ferror (csvDataset->file))
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* If there's a transform, process the features */
+	if (csvDataset->transform != NULL)
+		return FeatsTransform_Apply (csvDataset->transform, entry->features);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int CSVDataSet_ParseLine (CSVDataSet * csvDataset, const char * line, const char * lineEnd, EntryData * entry)
+{
+	unsigned long i;
+	long class;
+
+	/* When only some features are loaded, the fields of the others are skipped */
+	if (csvDataset->columns != NULL)
+		return CSVDataSet_ParseColumns (csvDataset, line, lineEnd, entry);
+
+	/* CSV records are always dense */
+	entry->indexes = NULL;
+
+	/* Read this record's feats, each one followed by a delimiter */
+	for (i=0;i<csvDataset->featsCount;i++)
+	{
+		line = parseDouble (line, lineEnd, &entry->features[i]);
+		if (line == NULL || line >= lineEnd || *line != csvDataset->delimiter)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		/* Skip the delimiter */
+		line++;
+	}
+
+	/* Read this record's class */
+	if (parseLong (line, lineEnd, &class) == NULL)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	entry->class = (int) class;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int CSVDataSet_WriteRecords (DataSet * dataset, FILE * file, char delimiter)
+{
+	CSVWriteTask * tasks;
+	double * features;
+	int * classes;
+	unsigned long batchSize;
+	unsigned long count;
+	unsigned long first;
+	unsigned int tasksCount;
+	unsigned int t;
+	int ret;
+
+	/* Each batch has about WRITE_BATCH_SIZE bytes of features, so records with many features are written a few at a time */
+	batchSize = max (WRITE_BATCH_SIZE / (sizeof(double) * max (dataset->featsCount, 1UL)), 1UL);
+	tasksCount = Parallel_CpuCount ();
+	tasks = (CSVWriteTask *) calloc (tasksCount, sizeof(CSVWriteTask));
+	if (tasks == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Records are read in batches (as dense doubles), so the source may be an INCREMENTAL dataset of any size */
+	for (;;)
+	{
+		ret = dataset->nextBatch (dataset, batchSize, &features, &classes, &count);
+		if (ret != ML_OK)
+			break;
+
+		/* Split the batch into contiguous slices, and format them in parallel */
+		first = 0;
+		for (t=0;t<tasksCount;t++)
+		{
+			tasks[t].features = &features[first * dataset->featsCount];
+			tasks[t].classes = &classes[first];
+			tasks[t].entriesCount = count / tasksCount + (t < count % tasksCount ? 1 : 0);
+			tasks[t].featsCount = dataset->featsCount;
+			tasks[t].delimiter = delimiter;
+			first += tasks[t].entriesCount;
+		}
+		Parallel_Run ((void (*)(void *)) CSVDataSet_FormatRecords, tasks, sizeof(CSVWriteTask), min (tasksCount, (unsigned int) count));
+
+		/* Write the slices in order */
+		for (t=0;t<tasksCount && t < count && ret == ML_OK;t++)
+		{
+			ret = tasks[t].ret;
+			if (ret == ML_OK && fwrite (tasks[t].text, 1, tasks[t].size, file) != tasks[t].size)
+			{
+				errno = EIO;
+				ret = ML_ERR_FILE;
+			}
+		}
+		if (ret != ML_OK)
+			break;
+	}
+
+	for (t=0;t<tasksCount;t++)
+		free (tasks[t].text);
+	free (tasks);
+
+	/* Reaching the end of the dataset means all records were written */
+	return (ret == ML_WARN_EOF) ? ML_OK : ret;
+}
+
+void CSVDataSet_Init (CSVDataSet * csvDataset)
+{
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, CSVDataSet_InitSuper);
+
+	/* Call the initializer for the "superclass" */
+	BatchDataSet_Init((BatchDataSet *) csvDataset);
+
+	/* Initialize the function pointers. */
+	csvDataset->load = (int (*)(BatchDataSet *, char *)) CSVDataSet_Load;
+	csvDataset->loadHeader = CSVDataSet_LoadHeader;
+	csvDataset->loadData = CSVDataSet_LoadData;
+	csvDataset->parseLine = CSVDataSet_ParseLine;
+
+	/* Override Reset, Shuffle and Sort, to keep the read ahead thread from running while the read order changes */
+	csvDataset->reset = (int (*)(BatchDataSet *)) CSVDataSet_Reset;
+	csvDataset->shuffle = (int (*)(BatchDataSet *)) CSVDataSet_Shuffle;
+	csvDataset->sort = (int (*)(BatchDataSet *)) CSVDataSet_Sort;
+
+	/* Override nextBatch, to parse INCREMENTAL records straight into the batch */
+	csvDataset->nextBatch = (int(*)(DataSet *, unsigned long, double **, int **, unsigned long *)) CSVDataSet_NextBatch;
+
+	/* Overrides the default free method */
+	csvDataset->free = (void(*)(DataSet *))CSVDataSet_Free;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+CSVDataSet * CSVDataSet_New (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char * srcPath)
+{
+	return CSVDataSet_NewWithOptions (hasLabels, delimiter, readMode, srcPath, NULL);
+}
+
+CSVDataSet * CSVDataSet_NewWithOptions (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char * srcPath, BatchOptions * options)
+{
+	CSVDataSet * csvDataset;
 
 	/* malloc memory to store the structure */
 	csvDataset = (CSVDataSet *) malloc (sizeof(CSVDataSet));
@@ -481,6 +2550,8 @@ CSVDataSet * CSVDataSet_New (unsigned char hasLabels, char delimiter, BatchReadM
 	csvDataset->hasLabels = hasLabels;
 	csvDataset->delimiter = delimiter;
 	csvDataset->readMode = readMode;
+	if (options != NULL)
+		csvDataset->options = *options;
 
 	/* Load data from srcPath */
 	if (csvDataset->load((BatchDataSet *) csvDataset, srcPath) != ML_OK)
@@ -493,11 +2564,120 @@ CSVDataSet * CSVDataSet_New (unsigned char hasLabels, char delimiter, BatchReadM
 	return csvDataset;
 }
 
+int CSVDataSet_SetReadAhead (CSVDataSet * csvDataset, unsigned long readAhead, unsigned long window)
+{
+	int ret;
+
+	/* Only "INCREMENTAL" datasets read records on demand. A window must hold at least the last returned record */
+	if (csvDataset->readAhead == NULL || window == 0)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* The ring will be replaced, so the thread must be stopped. It restarts from the current position on the next call */
+	CSVDataSet_StopReadAhead (csvDataset);
+
+	/* Resize the ring */
+	ret = CSVDataSet_AllocRing (csvDataset, readAhead + window);
+	if (ret != ML_OK)
+		return ret;
+
+	csvDataset->readAhead->readAhead = readAhead;
+	csvDataset->readAhead->window = window;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int CSVDataSet_SetCache (CSVDataSet * csvDataset, size_t cacheSize)
+{
+	BlockCacheSource source;
+
+	/* Only "INCREMENTAL" datasets read records on demand */
+	if (csvDataset->readAhead == NULL)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* The thread must not be reading records while the cache changes. It restarts from the current position on the next call */
+	CSVDataSet_StopReadAhead (csvDataset);
+
+	/* A size of 0 removes the cache */
+	if (cacheSize == 0)
+	{
+		if (csvDataset->cache != NULL)
+			BlockCache_Free (csvDataset->cache);
+		csvDataset->cache = NULL;
+		return ML_OK;
+	}
+
+	/* An existing cache keeps its blocks (as many as fit) and counters */
+	if (csvDataset->cache != NULL)
+	{
+		BlockCache_SetBudget (csvDataset->cache, cacheSize);
+		return ML_OK;
+	}
+
+	/* Blocks are read and parsed the same way as single records */
+	memset (&source, 0, sizeof(BlockCacheSource));
+	source.dataStart = csvDataset->readAhead->dataStart;
+	source.dataEnd = csvDataset->readAhead->dataEnd;
+	source.maxLineLength = csvDataset->readAhead->maxLineLength;
+	source.entriesCount = csvDataset->entriesCount;
+	source.featsCount = csvDataset->featsCount;
+	source.read = (ssize_t (*)(void *, char *, size_t, off_t)) CSVDataSet_PRead;
+	source.parse = (int (*)(void *, const char *, const char *, EntryData *)) CSVDataSet_ParseRecord;
+	source.context = csvDataset;
+	csvDataset->cache = BlockCache_New (&source, cacheSize);
+	if (csvDataset->cache == NULL)
+		return ML_ERR_OUTOFMEMORY;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int CSVDataSet_GetCacheStats (CSVDataSet * csvDataset, unsigned long * hits, unsigned long * misses)
+{
+	/* Only "INCREMENTAL" datasets with a cache have counters */
+	if (csvDataset->cache == NULL)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	BlockCache_GetStats (csvDataset->cache, hits, misses);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int CSVDataSet_RemoveShared (CSVDataSet * csvDataset)
+{
+	/* Only datasets attached to a shared block have one to remove */
+	if (csvDataset->shared.data == NULL)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	return SharedMem_Remove (csvDataset->shared.name);
+}
+
+const unsigned long * CSVDataSet_GetColumns (CSVDataSet * csvDataset, unsigned long * fileFeatsCount)
+{
+	if (fileFeatsCount != NULL)
+		*fileFeatsCount = csvDataset->fileFeatsCount;
+
+	return csvDataset->columns;
+}
+
 int CSVDataSet_Save (DataSet * dataset, unsigned char hasLabels, char delimiter, char * outPath)
 {
-	EntryData * entry;
 	FILE * file;
 	unsigned long i;
+	int ret;
 
 	/* Open the output file */
 	file = fopen (outPath, "wb");
@@ -506,6 +2686,7 @@ int CSVDataSet_Save (DataSet * dataset, unsigned char hasLabels, char delimiter,
 		errno = EIO;
 		return ML_ERR_FILE;
 	}
+	setvbuf (file, NULL, _IOFBF, WRITE_BUFFER_SIZE);
 
 	/* If headers are requested, write a line containing column labels */
 	if (hasLabels)
@@ -520,19 +2701,14 @@ int CSVDataSet_Save (DataSet * dataset, unsigned char hasLabels, char delimiter,
 	}
 
 	/* Write all entries */
-	while (dataset->nextEntry(dataset, &entry) == ML_OK)
-	{
-		/* Write feature values */
-		for (i=0;i<dataset->featsCount;i++)
-			fprintf(file, "%lf%c", entry->features[i], delimiter);
+	ret = CSVDataSet_WriteRecords (dataset, file, delimiter);
 
-		/* Write class value */
-		fprintf(file, "%d\n", entry->class);
+	/* Close the file. Buffered data is only written now, so it may fail too */
+	if (fclose (file) != 0 && ret == ML_OK)
+	{
+		errno = EIO;
+		ret = ML_ERR_FILE;
 	}
 
-	/* Close the file */
-	fclose (file);
-
-	/* Return OK */
-	return ML_OK;
+	return ret;
 }
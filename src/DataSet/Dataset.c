@@ -1,3 +1,4 @@
+#define EXTEND_DATASET
 #include <stdlib.h>		/* For free() */
 
 #include "MacLearn/DataSet/Dataset.h"
@@ -12,14 +13,52 @@ static int DataSet_NextEntry (DataSet * dataset, EntryData ** entry)
 	return ML_ERR_NOTIMPLEMENTED;
 }
 
+static int DataSet_NextBatch (DataSet * dataset, unsigned long maxCount, double ** features, int ** classes, unsigned long * count)
+{
+	EntryData * entry;
+	unsigned long i;
+	int ret = ML_OK;
+
+	/* Get room for the whole batch */
+	*count = 0;
+	ret = DataSet_ReserveBatch (dataset, maxCount);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Gather the records one at a time. It works on any dataset that implements nextEntry */
+	for (i=0;i<maxCount;i++)
+	{
+		ret = dataset->nextEntry (dataset, &entry);
+		if (ret != ML_OK)
+			break;
+
+		EntryData_ToDense (entry, dataset->featsCount, &dataset->batchFeatures[dataset->featsCount * i]);
+		dataset->batchClasses[i] = entry->class;
+	}
+
+	*features = dataset->batchFeatures;
+	*classes = dataset->batchClasses;
+	*count = i;
+
+	/* Reaching the end of the dataset is only reported if there weren't any records left */
+	if (ret == ML_WARN_EOF && i > 0)
+		return ML_OK;
+
+	return ret;
+}
+
 /************************
 * "Protected" Functions	*
 ************************/
 void DataSet_Free (DataSet * dataset)
 {
-	/* As this is the base class' free, it'll be the last to be called, so free the structure pointer */
+	/* As this is the base class' free, it'll be the last to be called, so free the batch buffers and the structure pointer */
 	if (dataset != NULL)
+	{
+		free (dataset->batchFeatures);
+		free (dataset->batchClasses);
 		free (dataset);
+	}
 }
 
 void DataSet_Init (DataSet * dataset)
@@ -27,8 +66,92 @@ void DataSet_Init (DataSet * dataset)
 	/* Initialize the function pointers */
 	dataset->free = DataSet_Free;
 	dataset->nextEntry = DataSet_NextEntry;
+	dataset->nextBatch = DataSet_NextBatch;
+}
+
+int DataSet_ReserveBatch (DataSet * dataset, unsigned long count)
+{
+	double * auxFeatures;
+	int * auxClasses;
+
+	/* A batch must have at least one record */
+	if (count == 0)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Nothing to be done if the buffers are big enough */
+	if (count <= dataset->batchCapacity)
+		return ML_OK;
+
+	/* Grow both buffers. If only one of them could be grown, it's kept, but the capacity remains the same */
+	auxFeatures = (double *) realloc (dataset->batchFeatures, sizeof(double) * dataset->featsCount * count);
+	if (auxFeatures != NULL)
+		dataset->batchFeatures = auxFeatures;
+	auxClasses = (int *) realloc (dataset->batchClasses, sizeof(int) * count);
+	if (auxClasses != NULL)
+		dataset->batchClasses = auxClasses;
+	if (auxFeatures == NULL || auxClasses == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	dataset->batchCapacity = count;
+
+	/* Return OK */
+	return ML_OK;
 }
 
 /************************
 * "Public" Functions	*
 ************************/
+void EntryData_ToDense (EntryData * entry, unsigned long featsCount, double * dst)
+{
+	unsigned long i;
+
+	/* Sparse records have zeros on every column that isn't stored */
+	if (entry->indexes != NULL)
+	{
+		memset (dst, 0, sizeof(double) * featsCount);
+		for (i=0;i<entry->nnz;i++)
+			dst[entry->indexes[i]] = entry->features[i];
+		return;
+	}
+
+	/* Dense records are widened to double (or just copied, if they're already doubles) */
+	switch (entry->type)
+	{
+		case DS_ET_FLOAT:
+			for (i=0;i<featsCount;i++)
+				dst[i] = entry->floatFeatures[i];
+			break;
+		case DS_ET_UINT8:
+			for (i=0;i<featsCount;i++)
+				dst[i] = entry->byteFeatures[i];
+			break;
+		case DS_ET_BIT:
+			for (i=0;i<featsCount;i++)
+				dst[i] = (entry->byteFeatures[i >> 3] >> (i & 7)) & 1;
+			break;
+		default:
+			memcpy (dst, entry->features, sizeof(double) * featsCount);
+			break;
+	}
+}
+
+size_t EntryData_RowSize (EntryType type, unsigned long featsCount)
+{
+	switch (type)
+	{
+		case DS_ET_FLOAT:
+			return sizeof(float) * featsCount;
+		case DS_ET_UINT8:
+			return featsCount;
+		case DS_ET_BIT:
+			return (featsCount + 7) / 8;
+		default:
+			return sizeof(double) * featsCount;
+	}
+}
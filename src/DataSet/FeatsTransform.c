@@ -0,0 +1,354 @@
+#include <stdlib.h>				/* For malloc/free */
+#include <string.h>				/* For memcpy and memset */
+#include <math.h>				/* For log1p and sqrt */
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/DataSet/FeatsTransform.h"
+#include "MacLearn/Util/Parallel.h"			/* For Parallel_Run */
+
+/* Minimum number of rows scaled by each thread, so small datasets don't pay for the threads */
+#define MIN_SCALE_ROWS			1024
+
+/* Rows scaled by each thread */
+typedef struct
+{
+	const FeatsTransform * transform;
+	unsigned char * rows;
+	EntryType type;
+	size_t rowStride;
+	unsigned long rowsCount;
+}FeatsScaleTask;
+
+/************************
+* "Private" Functions	*
+************************/
+static void FeatsTransform_ScaleTask (FeatsScaleTask * task)
+{
+	const double * offset = task->transform->offset;
+	const double * scale = task->transform->scale;
+	unsigned long featsCount = task->transform->featsCount;
+	unsigned long i;
+	unsigned long j;
+	float * floatRow;
+
+	if (task->type == DS_ET_DOUBLE)
+	{
+		for (i=0;i<task->rowsCount;i++)
+			FeatsTransform_Scale (task->transform, (double *) (task->rows + task->rowStride * i));
+	}
+	else
+	{
+		for (i=0;i<task->rowsCount;i++)
+		{
+			floatRow = (float *) (task->rows + task->rowStride * i);
+			for (j=0;j<featsCount;j++)
+				floatRow[j] = (float) ((floatRow[j] - offset[j]) * scale[j]);
+		}
+	}
+}
+
+/************************
+* "Public" Functions	*
+************************/
+int FeatsTransform_Check (const FeatsTransformOptions * options, unsigned long featsCount)
+{
+	if (options->scaling > FT_SC_MINMAX || (options->clip && !(options->clipMin <= options->clipMax)) ||
+		(options->source != NULL && (options->source->featsCount != featsCount || options->source->options.scaling != options->scaling)))
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int FeatsTransform_Map (const FeatsTransformOptions * options, double * values, unsigned long count)
+{
+	unsigned long i;
+
+	if (options->clip)
+	{
+		for (i=0;i<count;i++)
+			values[i] = (values[i] < options->clipMin) ? options->clipMin : (values[i] > options->clipMax) ? options->clipMax : values[i];
+	}
+
+	if (options->log)
+	{
+		for (i=0;i<count;i++)
+		{
+			if (!(values[i] > -1))
+			{
+				errno = EINVAL;
+				return ML_ERR_PARAM;
+			}
+			values[i] = log1p (values[i]);
+		}
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int FeatsStats_Init (FeatsStats * stats, unsigned long featsCount)
+{
+	memset (stats, 0, sizeof(FeatsStats));
+
+	/* A single block holds the five arrays */
+	stats->shift = (double *) malloc (sizeof(double) * 5 * max (featsCount, 1));
+	if (stats->shift == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	stats->featsCount = featsCount;
+	stats->sum = stats->shift + featsCount;
+	stats->sumSq = stats->sum + featsCount;
+	stats->min = stats->sumSq + featsCount;
+	stats->max = stats->min + featsCount;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+void FeatsStats_Free (FeatsStats * stats)
+{
+	free (stats->shift);
+	memset (stats, 0, sizeof(FeatsStats));
+}
+
+void FeatsStats_Add (FeatsStats * stats, const double * values)
+{
+	unsigned long i;
+	double delta;
+
+	/* The first record sets the shift, the minimum and the maximum */
+	if (stats->count++ == 0)
+	{
+		memcpy (stats->shift, values, sizeof(double) * stats->featsCount);
+		memcpy (stats->min, values, sizeof(double) * stats->featsCount);
+		memcpy (stats->max, values, sizeof(double) * stats->featsCount);
+		memset (stats->sum, 0, sizeof(double) * stats->featsCount);
+		memset (stats->sumSq, 0, sizeof(double) * stats->featsCount);
+		return;
+	}
+
+	for (i=0;i<stats->featsCount;i++)
+	{
+		delta = values[i] - stats->shift[i];
+		stats->sum[i] += delta;
+		stats->sumSq[i] += delta * delta;
+		stats->min[i] = (values[i] < stats->min[i]) ? values[i] : stats->min[i];
+		stats->max[i] = (values[i] > stats->max[i]) ? values[i] : stats->max[i];
+	}
+}
+
+void FeatsStats_Merge (FeatsStats * dst, const FeatsStats * src)
+{
+	unsigned long i;
+	double delta;
+	double n;
+
+	if (src->count == 0)
+		return;
+	if (dst->count == 0)
+	{
+		memcpy (dst->shift, src->shift, sizeof(double) * 5 * dst->featsCount);
+		dst->count = src->count;
+		return;
+	}
+
+	/* Move the sums of "src" to the shift of "dst": sum(x - a) = sum(x - b) + n(b - a), and the same for the squares */
+	n = (double) src->count;
+	for (i=0;i<dst->featsCount;i++)
+	{
+		delta = src->shift[i] - dst->shift[i];
+		dst->sumSq[i] += src->sumSq[i] + 2 * delta * src->sum[i] + n * delta * delta;
+		dst->sum[i] += src->sum[i] + n * delta;
+		dst->min[i] = (src->min[i] < dst->min[i]) ? src->min[i] : dst->min[i];
+		dst->max[i] = (src->max[i] > dst->max[i]) ? src->max[i] : dst->max[i];
+	}
+	dst->count += src->count;
+}
+
+double FeatsStats_Variance (const FeatsStats * stats, unsigned long feature)
+{
+	double mean;
+	double variance;
+
+	if (stats->count == 0)
+		return 0;
+
+	/* Shifted values have the same variance. Rounding may leave it a bit under 0 on constant features */
+	mean = stats->sum[feature] / (double) stats->count;
+	variance = stats->sumSq[feature] / (double) stats->count - mean * mean;
+	return (variance > 0) ? variance : 0;
+}
+
+void FeatsStats_Select (FeatsStats * stats, const unsigned long * features, unsigned long count)
+{
+	double * arrays[5];
+	unsigned long i;
+	unsigned long j;
+
+	/* Move each array to its new place on the block. Features are in increasing order, so nothing is overwritten before it's read */
+	arrays[0] = stats->shift;
+	arrays[1] = stats->sum;
+	arrays[2] = stats->sumSq;
+	arrays[3] = stats->min;
+	arrays[4] = stats->max;
+	for (i=0;i<5;i++)
+	{
+		for (j=0;j<count;j++)
+			stats->shift[count * i + j] = arrays[i][features[j]];
+	}
+
+	stats->featsCount = count;
+	stats->sum = stats->shift + count;
+	stats->sumSq = stats->sum + count;
+	stats->min = stats->sumSq + count;
+	stats->max = stats->min + count;
+}
+
+FeatsTransform * FeatsTransform_New (const FeatsTransformOptions * options, unsigned long featsCount, const FeatsStats * stats)
+{
+	FeatsTransform * transform;
+	const FeatsTransform * source = options->source;
+	double n;
+	double mean;
+	double variance;
+	unsigned long i;
+
+	if (FeatsTransform_Check (options, featsCount) != ML_OK || (FeatsTransform_NeedsStats (options) && (stats == NULL || stats->featsCount != featsCount)))
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	transform = (FeatsTransform *) malloc (sizeof(FeatsTransform));
+	if (transform == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset (transform, 0, sizeof(FeatsTransform));
+	transform->options = *options;
+	transform->options.source = NULL;
+	transform->featsCount = featsCount;
+
+	/* Nothing else to keep without scaling */
+	if (options->scaling == FT_SC_NONE)
+		return transform;
+
+	/* A single block holds the six arrays */
+	transform->mean = (double *) malloc (sizeof(double) * 6 * max (featsCount, 1));
+	if (transform->mean == NULL)
+	{
+		free (transform);
+		errno = ENOMEM;
+		return NULL;
+	}
+	transform->std = transform->mean + featsCount;
+	transform->min = transform->std + featsCount;
+	transform->max = transform->min + featsCount;
+	transform->offset = transform->max + featsCount;
+	transform->scale = transform->offset + featsCount;
+
+	/* Take everything from the source, or find it out from the statistics. Features without records are left as they are */
+	if (source != NULL)
+	{
+		memcpy (transform->mean, source->mean, sizeof(double) * 6 * featsCount);
+		return transform;
+	}
+	n = (double) stats->count;
+	for (i=0;i<featsCount;i++)
+	{
+		if (stats->count == 0)
+		{
+			transform->mean[i] = transform->std[i] = transform->min[i] = transform->max[i] = 0;
+			continue;
+		}
+		mean = stats->sum[i] / n;
+		variance = FeatsStats_Variance (stats, i);
+		transform->mean[i] = stats->shift[i] + mean;
+		transform->std[i] = sqrt (variance);
+		transform->min[i] = stats->min[i];
+		transform->max[i] = stats->max[i];
+	}
+
+	/* Constant features keep a scale of 1, so they become 0 */
+	for (i=0;i<featsCount;i++)
+	{
+		if (options->scaling == FT_SC_STANDARDIZE)
+		{
+			transform->offset[i] = transform->mean[i];
+			transform->scale[i] = (transform->std[i] > 0) ? 1 / transform->std[i] : 1;
+		}
+		else
+		{
+			transform->offset[i] = transform->min[i];
+			transform->scale[i] = (transform->max[i] > transform->min[i]) ? 1 / (transform->max[i] - transform->min[i]) : 1;
+		}
+	}
+
+	return transform;
+}
+
+void FeatsTransform_Free (FeatsTransform * transform)
+{
+	if (transform == NULL)
+		return;
+	free (transform->mean);
+	free (transform);
+}
+
+void FeatsTransform_Scale (const FeatsTransform * transform, double * values)
+{
+	const double * offset = transform->offset;
+	const double * scale = transform->scale;
+	unsigned long i;
+
+	if (scale == NULL)
+		return;
+	for (i=0;i<transform->featsCount;i++)
+		values[i] = (values[i] - offset[i]) * scale[i];
+}
+
+void FeatsTransform_ScaleRows (const FeatsTransform * transform, unsigned char * rows, EntryType type, size_t rowStride, unsigned long rowsCount)
+{
+	FeatsScaleTask tasks[64];
+	unsigned int tasksCount;
+	unsigned long first;
+	unsigned int i;
+
+	if (transform->scale == NULL || (type != DS_ET_DOUBLE && type != DS_ET_FLOAT) || rowsCount == 0)
+		return;
+
+	/* Split the rows between the processors, as long as each thread gets enough of them */
+	tasksCount = min (Parallel_CpuCount (), 64);
+	if (rowsCount / MIN_SCALE_ROWS < tasksCount)
+		tasksCount = (unsigned int) (rowsCount / MIN_SCALE_ROWS) + 1;
+	for (i=0,first=0;i<tasksCount;i++)
+	{
+		tasks[i].transform = transform;
+		tasks[i].type = type;
+		tasks[i].rowStride = rowStride;
+		tasks[i].rows = rows + rowStride * first;
+		tasks[i].rowsCount = rowsCount / tasksCount + ((i < rowsCount % tasksCount) ? 1 : 0);
+		first += tasks[i].rowsCount;
+	}
+	Parallel_Run ((void (*)(void *)) FeatsTransform_ScaleTask, tasks, sizeof(FeatsScaleTask), tasksCount);
+}
+
+int FeatsTransform_Apply (const FeatsTransform * transform, double * values)
+{
+	int ret;
+
+	ret = FeatsTransform_Map (&transform->options, values, transform->featsCount);
+	if (ret != ML_OK)
+		return ret;
+	FeatsTransform_Scale (transform, values);
+
+	/* Return OK */
+	return ML_OK;
+}
@@ -0,0 +1,464 @@
+#define EXTEND_DATASET
+#define EXTEND_BATCHDATASET
+#define EXTEND_NPYDATASET			/* To get "PROTECTED" function prototypes */
+#include <stdlib.h>
+#include <pthread.h>			/* For pthread_once */
+#include <limits.h>				/* For INT_MAX */
+#ifndef WIN32
+#include <unistd.h>				/* For unlink */
+#endif
+
+#include "MacLearn/DataSet/NpyDataset.h"
+#include "MacLearn/Util/NpyFile.h"		/* For NpyHeader */
+
+/* Create a local var to save references to "super class" functions */
+static BatchDataSet super;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
+
+/************************
+* "Private" Functions	*
+************************/
+static void NpyDataSet_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	BatchDataSet_Init(&super);
+}
+
+static int NpyDataSet_NextEntry (NpyDataSet * npyDataset, EntryData ** entry)
+{
+	off_t nextPos;
+
+	/* Check that the dataset hasn't been fully read yet */
+	if (npyDataset->currentPos >= npyDataset->entriesCount)
+		return ML_WARN_EOF;
+
+	/* Point the single entry straight into the mapping. Nothing is copied but the class */
+	nextPos = npyDataset->readOrder[npyDataset->currentPos++];
+	npyDataset->entries->byteFeatures = (unsigned char *) npyDataset->features + (npyDataset->rowSize * nextPos);
+	npyDataset->entries->class = (npyDataset->classes != NULL) ? npyDataset->classes[nextPos] : 0;
+	npyDataset->entries->indexes = NULL;
+	npyDataset->entries->type = npyDataset->type;
+
+	*entry = npyDataset->entries;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int NpyDataSet_NextBatch (NpyDataSet * npyDataset, unsigned long maxCount, double ** features, int ** classes, unsigned long * count)
+{
+	EntryData entry;
+	off_t first;
+	off_t pos;
+	unsigned long i;
+	unsigned char contiguous = 1;
+	int ret;
+
+	/* Get room for the whole batch */
+	*count = 0;
+	ret = DataSet_ReserveBatch ((DataSet *) npyDataset, maxCount);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Check that the dataset hasn't been fully read yet */
+	if (npyDataset->currentPos >= npyDataset->entriesCount)
+		return ML_WARN_EOF;
+	*count = min (maxCount, npyDataset->entriesCount - npyDataset->currentPos);
+
+	/* Gather the classes, checking if the records are consecutive on the file */
+	first = npyDataset->readOrder[npyDataset->currentPos];
+	for (i=0;i<*count;i++)
+	{
+		pos = npyDataset->readOrder[npyDataset->currentPos + i];
+		npyDataset->batchClasses[i] = (npyDataset->classes != NULL) ? npyDataset->classes[pos] : 0;
+		if (pos != first + (off_t) i)
+			contiguous = 0;
+	}
+
+	/* Consecutive float64 records are returned straight from the mapping. Otherwise, widen them to the batch buffer */
+	if (contiguous && npyDataset->type == DS_ET_DOUBLE)
+		*features = (double *) ((const char *) npyDataset->features + (npyDataset->rowSize * first));
+	else
+	{
+		memset (&entry, 0, sizeof(EntryData));
+		entry.type = npyDataset->type;
+		for (i=0;i<*count;i++)
+		{
+			entry.byteFeatures = (unsigned char *) npyDataset->features + (npyDataset->rowSize * npyDataset->readOrder[npyDataset->currentPos + i]);
+			EntryData_ToDense (&entry, npyDataset->featsCount, &npyDataset->batchFeatures[npyDataset->featsCount * i]);
+		}
+		*features = npyDataset->batchFeatures;
+	}
+	*classes = npyDataset->batchClasses;
+
+	npyDataset->currentPos += *count;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int NpyDataSet_Load (NpyDataSet * npyDataset, char * srcPath)
+{
+	NpyHeader header;
+	FileMapAccess access;
+	unsigned long i;
+	int ret;
+
+	/* Check the read mode. It only determines how the file will be accessed */
+	if (npyDataset->readMode == BD_RM_FULL)
+		access = FM_ACCESS_WILLNEED;
+	else if (npyDataset->readMode == BD_RM_INCREMENTAL)
+		access = FM_ACCESS_RANDOM;
+	else
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Open the features file */
+	npyDataset->file = fopen (srcPath, "rb");
+	if (npyDataset->file == NULL)
+	{
+		errno = ENOENT;
+		return ML_ERR_FILENOTFOUND;
+	}
+
+	/* Map the whole file. The mapping stays valid after the file is closed */
+	ret = FileMap_Open (&npyDataset->map, npyDataset->file, access);
+	fclose (npyDataset->file);
+	npyDataset->file = NULL;
+	if (ret != ML_OK)
+		return ret;
+
+	/* The features must be a row major matrix, with a supported element type */
+	ret = NpyFile_ReadHeader (npyDataset->map.data, npyDataset->map.size, &header);
+	if (ret != ML_OK)
+		return ret;
+	if (header.dimsCount != 2 || header.fortranOrder || header.shape[1] == 0)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	if (header.type == NPY_ET_FLOAT64)
+		npyDataset->type = DS_ET_DOUBLE;
+	else if (header.type == NPY_ET_FLOAT32)
+		npyDataset->type = DS_ET_FLOAT;
+	else if (header.type == NPY_ET_UINT8)
+		npyDataset->type = DS_ET_UINT8;
+	else
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Point to the features matrix */
+	npyDataset->featsCount = (unsigned long) header.shape[1];
+	npyDataset->entriesCount = (unsigned long) header.shape[0];
+	npyDataset->rowSize = header.elementSize * npyDataset->featsCount;
+	npyDataset->features = npyDataset->map.data + header.dataOffset;
+
+	/* The readOrder stores the index of each record, no matter the read mode */
+	npyDataset->readOrder = (off_t *) malloc (sizeof(off_t) * max (npyDataset->entriesCount, 1));
+	if (npyDataset->readOrder == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	for (i=0;i<npyDataset->entriesCount;i++)
+		npyDataset->readOrder[i] = i;
+
+	/* A single entry is used to return all records. Its features pointer is updated on each call */
+	npyDataset->entries = (EntryData *) malloc (sizeof(EntryData));
+	if (npyDataset->entries == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int NpyDataSet_LoadLabels (NpyDataSet * npyDataset, char * labelsPath)
+{
+	NpyHeader header;
+	FileMap map;
+	FILE * file;
+	const char * data;
+	int64_t label;
+	int64_t minLabel = 0;
+	int64_t maxLabel = 0;
+	unsigned long i;
+	int ret;
+
+	/* Open and map the labels file. They're only read once, to convert them to classes */
+	file = fopen (labelsPath, "rb");
+	if (file == NULL)
+	{
+		errno = ENOENT;
+		return ML_ERR_FILENOTFOUND;
+	}
+	ret = FileMap_Open (&map, file, FM_ACCESS_SEQUENTIAL);
+	fclose (file);
+	if (ret != ML_OK)
+		return ret;
+
+	/* The labels must be a vector (or a single column matrix) of integers, with a label for each record */
+	ret = NpyFile_ReadHeader (map.data, map.size, &header);
+	if (ret == ML_OK && ((header.dimsCount != 1 && (header.dimsCount != 2 || header.shape[1] != 1)) ||
+		header.shape[0] != npyDataset->entriesCount || header.type == NPY_ET_FLOAT64 || header.type == NPY_ET_FLOAT32))
+	{
+		errno = EIO;
+		ret = ML_ERR_FILE;
+	}
+	if (ret == ML_OK)
+	{
+		npyDataset->classes = (int *) malloc (sizeof(int) * max (npyDataset->entriesCount, 1));
+		if (npyDataset->classes == NULL)
+		{
+			errno = ENOMEM;
+			ret = ML_ERR_OUTOFMEMORY;
+		}
+	}
+	if (ret != ML_OK)
+	{
+		FileMap_Close (&map);
+		return ret;
+	}
+
+	/* Widen the labels, finding out their range. Labels start at 0 (as usually on NumPy arrays), so each class is its label plus 1 */
+	data = map.data + header.dataOffset;
+	for (i=0;i<npyDataset->entriesCount;i++)
+	{
+		if (header.type == NPY_ET_UINT8)
+			label = ((const unsigned char *) data)[i];
+		else if (header.type == NPY_ET_INT32)
+			label = ((const int32_t *) data)[i];
+		else
+			label = ((const int64_t *) data)[i];
+
+		if (i == 0 || label < minLabel)
+			minLabel = label;
+		if (i == 0 || label > maxLabel)
+			maxLabel = label;
+		npyDataset->classes[i] = (int) (label + 1);
+	}
+	FileMap_Close (&map);
+
+	/* Negative labels aren't valid, and classes must fit an int */
+	if (minLabel < 0 || maxLabel >= INT_MAX)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	npyDataset->classesCount = (unsigned long) maxLabel + 1;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void NpyDataSet_Free (NpyDataSet * npyDataset)
+{
+	/* Unmap the file */
+	FileMap_Close (&npyDataset->map);
+
+	/* Free the readOrder and classes arrays */
+	if (npyDataset->readOrder != NULL)
+	{
+		free (npyDataset->readOrder);
+		npyDataset->readOrder = NULL;
+	}
+	if (npyDataset->classes != NULL)
+	{
+		free (npyDataset->classes);
+		npyDataset->classes = NULL;
+	}
+
+	/* Free the entry. Its features point into the mapping, so they must NOT be freed */
+	if (npyDataset->entries != NULL)
+	{
+		free (npyDataset->entries);
+		npyDataset->entries = NULL;
+	}
+
+	/* Call the "superclass" free function */
+	super.free((DataSet *) npyDataset);
+}
+
+/************************
+* "Protected" Functions	*
+************************/
+void NpyDataSet_Init (NpyDataSet * npyDataset)
+{
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, NpyDataSet_InitSuper);
+
+	/* Call the initializer for the "superclass" */
+	BatchDataSet_Init((BatchDataSet *) npyDataset);
+
+	/* Initialize the function pointers. */
+	npyDataset->load = (int (*)(BatchDataSet *, char *)) NpyDataSet_Load;
+	npyDataset->nextEntry = (int(*)(DataSet *, EntryData **)) NpyDataSet_NextEntry;
+	npyDataset->nextBatch = (int(*)(DataSet *, unsigned long, double **, int **, unsigned long *)) NpyDataSet_NextBatch;
+
+	/* Overrides the default free method */
+	npyDataset->free = (void(*)(DataSet *)) NpyDataSet_Free;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+NpyDataSet * NpyDataSet_New (BatchReadMode readMode, char * featuresPath, char * labelsPath)
+{
+	NpyDataSet * npyDataset;
+
+	/* malloc memory to store the structure */
+	npyDataset = (NpyDataSet *) malloc (sizeof(NpyDataSet));
+	if (npyDataset == NULL)
+		return NULL;
+
+	/* Zero memory */
+	memset (npyDataset, 0, sizeof(NpyDataSet));
+
+	/* Initialize the structure data and pointers */
+	NpyDataSet_Init(npyDataset);
+
+	/* Initialize instance data */
+	npyDataset->readMode = readMode;
+
+	/* Load the features from featuresPath, and the labels from labelsPath */
+	if (npyDataset->load((BatchDataSet *) npyDataset, featuresPath) != ML_OK ||
+		(labelsPath != NULL && NpyDataSet_LoadLabels (npyDataset, labelsPath) != ML_OK))
+	{
+		npyDataset->free((DataSet *) npyDataset);
+		return NULL;
+	}
+
+	/* Return the new instance */
+	return npyDataset;
+}
+
+int NpyDataSet_Save (DataSet * dataset, char * featuresPath, char * labelsPath)
+{
+	EntryData * entry;
+	FILE * file;
+	FILE * labelsFile = NULL;
+	int32_t * classes;
+	int32_t * auxClasses;
+	unsigned long capacity;
+	uint64_t shape[2];
+	double * dense;
+	int ret = ML_OK;
+
+	/* Get a buffer to expand sparse records */
+	dense = (double *) malloc (sizeof(double) * dataset->featsCount);
+	if (dense == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Open the output files */
+	file = fopen (featuresPath, "wb");
+	if (labelsPath != NULL && file != NULL)
+	{
+		labelsFile = fopen (labelsPath, "wb");
+		if (labelsFile == NULL)
+		{
+			fclose (file);
+			unlink (featuresPath);
+			file = NULL;
+		}
+	}
+	if (file == NULL)
+	{
+		free (dense);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* The classes are written to their own file, so keep them in memory while writing the features */
+	capacity = 1024;
+	classes = (int32_t *) malloc (sizeof(int32_t) * capacity);
+	if (classes == NULL)
+	{
+		free (dense);
+		fclose (file);
+		unlink (featuresPath);
+		if (labelsFile != NULL)
+		{
+			fclose (labelsFile);
+			unlink (labelsPath);
+		}
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Reserve space for the header. The number of records is only known at the end */
+	shape[0] = 0;
+	shape[1] = dataset->featsCount;
+	NpyFile_WriteHeader (file, NPY_ET_FLOAT64, 2, shape);
+
+	/* Write all entries' features */
+	while (dataset->nextEntry(dataset, &entry) == ML_OK)
+	{
+		/* Grow the classes array if needed */
+		if (shape[0] == capacity)
+		{
+			capacity *= 2;
+			auxClasses = (int32_t *) realloc (classes, sizeof(int32_t) * capacity);
+			if (auxClasses == NULL)
+			{
+				ret = ML_ERR_OUTOFMEMORY;
+				break;
+			}
+			classes = auxClasses;
+		}
+
+		/* Sparse and typed records must be expanded before being written */
+		if (entry->indexes != NULL || entry->type != DS_ET_DOUBLE)
+		{
+			EntryData_ToDense (entry, dataset->featsCount, dense);
+			fwrite (dense, sizeof(double), dataset->featsCount, file);
+		}
+		else
+			fwrite (entry->features, sizeof(double), dataset->featsCount, file);
+		classes[shape[0]++] = entry->class - 1;
+	}
+	free (dense);
+
+	/* Now the header is complete. Write it at the begining of the file */
+	fseeko (file, 0, SEEK_SET);
+	if (ret == ML_OK)
+		ret = NpyFile_WriteHeader (file, NPY_ET_FLOAT64, 2, shape);
+
+	/* Write the labels (the classes minus 1), as a vector */
+	if (labelsFile != NULL && ret == ML_OK)
+	{
+		ret = NpyFile_WriteHeader (labelsFile, NPY_ET_INT32, 1, shape);
+		fwrite (classes, sizeof(int32_t), shape[0], labelsFile);
+	}
+	free (classes);
+
+	/* If anything went wrong, delete the files and return error */
+	if (ret != ML_OK || ferror(file) || (labelsFile != NULL && ferror(labelsFile)))
+	{
+		fclose (file);
+		unlink (featuresPath);
+		if (labelsFile != NULL)
+		{
+			fclose (labelsFile);
+			unlink (labelsPath);
+		}
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Close the files */
+	fclose (file);
+	if (labelsFile != NULL)
+		fclose (labelsFile);
+
+	/* Return OK */
+	return ML_OK;
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>				/* For FILE */
+#include <stdlib.h>				/* For malloc/free */
+#include <string.h>				/* For memcmp and memcpy */
+#include <sys/stat.h>			/* For stat */
+#ifndef WIN32
+#include <fcntl.h>				/* For open */
+#include <unistd.h>				/* For pread */
+#endif
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/DataSet/RecordIndex.h"
+
+/* Identifies index files (and their version), and the byte order they were written with */
+#define INDEX_MAGIC				"MLIDX02"
+#define INDEX_BYTE_ORDER		0x0102030405060708ULL
+/* Number of pieces of the file (of INDEX_SAMPLE_SIZE bytes each) hashed to check that an index still matches it */
+#define INDEX_SAMPLES			16
+#define INDEX_SAMPLE_SIZE		4096
+
+/*	Header of an index file. It's followed by the length of every record but the last one (the distance from its offset to the
+	next one), as variable length integers (7 bits per byte, the high bit set on all but the last byte) */
+typedef struct
+{
+	char magic[8];					/* INDEX_MAGIC */
+	uint64_t byteOrder;				/* INDEX_BYTE_ORDER, as written by the machine that wrote the index */
+	uint64_t fileSize;				/* Size of the indexed file */
+	int64_t fileTime;				/* Modification time of the indexed file */
+	uint64_t checksum;				/* Hash of some pieces of the indexed file */
+	uint64_t hasLabels;				/* Parameters the file was read with */
+	uint64_t delimiter;
+	uint64_t featsCount;			/* Contents of the file */
+	uint64_t classesCount;
+	uint64_t entriesCount;
+	uint64_t maxLineLength;
+	uint64_t dataStart;
+	uint64_t dataEnd;
+}RecordIndexHeader;
+
+static uint64_t RecordIndex_Checksum (const char * path, uint64_t fileSize)
+{
+	unsigned char sample[INDEX_SAMPLE_SIZE];
+	uint64_t hash;
+	off_t offset;
+	ssize_t size;
+	ssize_t j;
+	int fd;
+	int i;
+
+	/* Hash (FNV-1a) pieces spread over the whole file, including its first and last bytes */
+	hash = 14695981039346656037ULL ^ fileSize;
+	fd = open (path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	for (i=0;i<INDEX_SAMPLES;i++)
+	{
+		offset = (fileSize > INDEX_SAMPLE_SIZE) ? (off_t) (((fileSize - INDEX_SAMPLE_SIZE) / (INDEX_SAMPLES - 1)) * i) : 0;
+		size = pread (fd, sample, INDEX_SAMPLE_SIZE, offset);
+		for (j=0;j<size;j++)
+		{
+			hash ^= sample[j];
+			hash *= 1099511628211ULL;
+		}
+	}
+	close (fd);
+
+	return hash;
+}
+
+static void RecordIndex_Header (const char * srcPath, const RecordIndexInfo * info, RecordIndexHeader * header)
+{
+	FileStamp stamp;
+
+	/* Describe the file as it is now, and the parameters it's read with */
+	RecordIndex_Stamp (srcPath, &stamp);
+	memset (header, 0, sizeof(RecordIndexHeader));
+	memcpy (header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header->byteOrder = INDEX_BYTE_ORDER;
+	header->fileSize = stamp.fileSize;
+	header->fileTime = stamp.fileTime;
+	header->checksum = stamp.checksum;
+	header->hasLabels = info->hasLabels;
+	header->delimiter = (unsigned char) info->delimiter;
+	header->featsCount = info->featsCount;
+	header->dataStart = (uint64_t) info->dataStart;
+}
+
+static char * RecordIndex_Path (const char * srcPath, const char * suffix)
+{
+	char * path;
+
+	/* The index is on the same directory, with the same name plus ".mlidx" */
+	path = (char *) malloc (strlen (srcPath) + strlen (suffix) + 7);
+	if (path != NULL)
+		sprintf (path, "%s.mlidx%s", srcPath, suffix);
+
+	return path;
+}
+
+void RecordIndex_Stamp (const char * path, FileStamp * stamp)
+{
+	struct stat fileStat;
+
+	memset (stamp, 0, sizeof(FileStamp));
+	if (stat (path, &fileStat) == 0)
+	{
+		stamp->fileSize = (uint64_t) fileStat.st_size;
+		stamp->fileTime = (int64_t) fileStat.st_mtime;
+		stamp->checksum = RecordIndex_Checksum (path, stamp->fileSize);
+	}
+}
+
+int RecordIndex_Load (const char * srcPath, RecordIndexInfo * info, off_t ** offsets)
+{
+	RecordIndexHeader header;
+	RecordIndexHeader expected;
+	FILE * file;
+	char * indexPath;
+	uint64_t length;
+	unsigned long i;
+	unsigned int shift;
+	off_t pos;
+	int c;
+
+	/* The index must have been written for this very file (same contents, and read with the same parameters) */
+	indexPath = RecordIndex_Path (srcPath, "");
+	if (indexPath == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	file = fopen (indexPath, "rb");
+	free (indexPath);
+	if (file == NULL)
+	{
+		errno = ENOENT;
+		return ML_ERR_FILE;
+	}
+	RecordIndex_Header (srcPath, info, &expected);
+	if (fread (&header, sizeof(RecordIndexHeader), 1, file) != 1 || memcmp (header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+		header.byteOrder != expected.byteOrder || header.fileSize != expected.fileSize || header.fileTime != expected.fileTime ||
+		header.checksum != expected.checksum || header.hasLabels != expected.hasLabels || header.delimiter != expected.delimiter ||
+		header.featsCount != expected.featsCount || header.dataStart != expected.dataStart || header.entriesCount == 0)
+	{
+		fclose (file);
+		errno = ENOENT;
+		return ML_ERR_FILE;
+	}
+
+	*offsets = (off_t *) malloc (sizeof(off_t) * header.entriesCount);
+	if (*offsets == NULL)
+	{
+		fclose (file);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Rebuild the offsets from the lengths of the records */
+	pos = (off_t) header.dataStart;
+	(*offsets)[0] = pos;
+	for (i=1;i<header.entriesCount;i++)
+	{
+		length = 0;
+		shift = 0;
+		do
+		{
+			c = getc (file);
+			length |= (uint64_t) (c & 0x7F) << shift;
+			shift += 7;
+		}while (c >= 0x80 && shift < 64);
+
+		pos += (off_t) length;
+		(*offsets)[i] = pos;
+		if (c < 0)
+			break;
+	}
+	fclose (file);
+
+	/* A truncated index (or one that doesn't add up to the data) is ignored */
+	if (i < header.entriesCount || pos > (off_t) header.dataEnd || header.maxLineLength == 0)
+	{
+		free (*offsets);
+		*offsets = NULL;
+		errno = ENOENT;
+		return ML_ERR_FILE;
+	}
+
+	info->classesCount = (unsigned long) header.classesCount;
+	info->entriesCount = (unsigned long) header.entriesCount;
+	info->maxLineLength = (size_t) header.maxLineLength;
+	info->dataEnd = (off_t) header.dataEnd;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int RecordIndex_Save (const char * srcPath, const RecordIndexInfo * info, const off_t * offsets)
+{
+	RecordIndexHeader header;
+	FILE * file;
+	unsigned char buffer[10];
+	uint64_t length;
+	unsigned long i;
+	size_t size;
+	char * indexPath;
+	char * tmpPath;
+	int ok;
+
+	/* Describe the file, and the records found by the scan */
+	RecordIndex_Header (srcPath, info, &header);
+	header.classesCount = info->classesCount;
+	header.entriesCount = info->entriesCount;
+	header.maxLineLength = info->maxLineLength;
+	header.dataEnd = (uint64_t) info->dataEnd;
+
+	/* Write to a temporary file, and rename it when complete */
+	indexPath = RecordIndex_Path (srcPath, "");
+	tmpPath = RecordIndex_Path (srcPath, ".tmp");
+	if (indexPath == NULL || tmpPath == NULL)
+	{
+		free (indexPath);
+		free (tmpPath);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	file = fopen (tmpPath, "wb");
+	if (file == NULL)
+	{
+		free (indexPath);
+		free (tmpPath);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	ok = (fwrite (&header, sizeof(RecordIndexHeader), 1, file) == 1);
+	for (i=1;i<info->entriesCount && ok;i++)
+	{
+		length = (uint64_t) (offsets[i] - offsets[i - 1]);
+		size = 0;
+		do
+		{
+			buffer[size++] = (unsigned char) ((length & 0x7F) | (length >= 0x80 ? 0x80 : 0));
+			length >>= 7;
+		}while (length != 0);
+		ok = (fwrite (buffer, 1, size, file) == size);
+	}
+
+	/* A failed index is just removed */
+	if (fclose (file) != 0 || !ok || rename (tmpPath, indexPath) != 0)
+	{
+		remove (tmpPath);
+		ok = 0;
+	}
+	free (indexPath);
+	free (tmpPath);
+	if (!ok)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
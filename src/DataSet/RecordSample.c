@@ -0,0 +1,198 @@
+#include <stdlib.h>				/* For malloc/free and qsort */
+#include <string.h>				/* For memcpy and memset */
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/DataSet/RecordSample.h"
+#include "MacLearn/Util/ParseUtil.h"		/* For findChar */
+
+/* Number of pieces of the data (of SAMPLE_PROBE_SIZE bytes each) whose lines are counted to estimate the records of a file */
+#define SAMPLE_PROBES			16
+#define SAMPLE_PROBE_SIZE		(64 << 10)
+/* Maximum number of times more records are drawn to replace those picked more than once */
+#define SAMPLE_ROUNDS			8
+
+static __inline unsigned char RecordSample_IsEmptyLine (const char * line, const char * lineEnd)
+{
+	/* A line is empty if it has no characters at all, or just the '\r' of a "\r\n" line break */
+	return (lineEnd == line || (lineEnd - line == 1 && *line == '\r'));
+}
+
+static int RecordSample_OffsetCompare (const void * a, const void * b)
+{
+	off_t offsetA = *(const off_t *) a;
+	off_t offsetB = *(const off_t *) b;
+
+	return (offsetA > offsetB) - (offsetA < offsetB);
+}
+
+static unsigned long RecordSample_EstimateRecords (const char * start, const char * end)
+{
+	const char * pos;
+	const char * probeEnd;
+	size_t size;
+	size_t bytes;
+	unsigned long lines;
+	unsigned long i;
+
+	/* Count the line breaks of some evenly spaced pieces of the data (or all of it, when it's small) */
+	size = (size_t) (end - start);
+	bytes = 0;
+	lines = 0;
+	for (i=0;i<SAMPLE_PROBES && bytes < size;i++)
+	{
+		if (size <= SAMPLE_PROBES * SAMPLE_PROBE_SIZE)
+		{
+			pos = start;
+			probeEnd = end;
+		}
+		else
+		{
+			pos = start + ((size - SAMPLE_PROBE_SIZE) / (SAMPLE_PROBES - 1)) * i;
+			probeEnd = pos + SAMPLE_PROBE_SIZE;
+		}
+		bytes += (size_t) (probeEnd - pos);
+		for (;(pos = findChar (pos, probeEnd, '\n')) < probeEnd;pos++)
+			lines++;
+	}
+
+	/* The average length of those lines gives the number of records */
+	if (lines == 0)
+		return 1;
+	return (unsigned long) ((double) size * lines / bytes + 0.5);
+}
+
+static void RecordSample_Measure (RecordSample * sample, const char * data, const char * end)
+{
+	const char * lineEnd;
+	unsigned long i;
+
+	/* Find the length of the records picked */
+	sample->length = 0;
+	sample->maxLineLength = 0;
+	for (i=0;i<sample->count;i++)
+	{
+		lineEnd = findChar (data + sample->offsets[i], end, '\n');
+		sample->length += (size_t) (lineEnd - (data + sample->offsets[i])) + 1;
+		sample->maxLineLength = max (sample->maxLineLength, (size_t) (lineEnd - (data + sample->offsets[i])) + 1);
+	}
+}
+
+int RecordSample_FromText (RecordSample * sample, const char * data, const char * start, const char * end, double fraction, Random * random)
+{
+	const char * pos;
+	const char * lineEnd;
+	off_t * offsets;
+	unsigned long target;
+	unsigned long count;
+	unsigned long drawn;
+	unsigned long round;
+	unsigned long i;
+	unsigned long j;
+
+	memset (sample, 0, sizeof(RecordSample));
+	if (start >= end)
+		return ML_OK;
+
+	/* As many records as the sample should have are picked */
+	target = max ((unsigned long) (fraction * RecordSample_EstimateRecords (start, end) + 0.5), 1);
+	offsets = (off_t *) malloc (sizeof(off_t) * target);
+	if (offsets == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/*	Each random byte of the data picks the record that starts after the first line break at or before it (the byte before the
+		data is the end of the header, so its first byte picks the first record). The bytes of the last record pick the first
+		one. Records picked twice are dropped, and more bytes are drawn for them, a few times at most */
+	count = 0;
+	for (round=0;round<SAMPLE_ROUNDS && count < target;round++)
+	{
+		drawn = target - count;
+		for (i=0;i<drawn;i++)
+		{
+			pos = start + Random_Below (random, (uint64_t) (end - start));
+			if (pos > start)
+				pos = findChar (pos - 1, end, '\n') + 1;
+
+			/* Empty lines aren't records */
+			while (pos < end && RecordSample_IsEmptyLine (pos, lineEnd = findChar (pos, end, '\n')))
+				pos = lineEnd + 1;
+			if (pos >= end)
+			{
+				for (pos=start;pos < end && RecordSample_IsEmptyLine (pos, lineEnd = findChar (pos, end, '\n'));pos=lineEnd + 1);
+			}
+			if (pos < end)
+				offsets[count++] = (off_t) (pos - data);
+		}
+
+		/* Keep the records in file order, without repetitions */
+		qsort (offsets, count, sizeof(off_t), RecordSample_OffsetCompare);
+		for (i=j=0;i<count;i++)
+		{
+			if (j == 0 || offsets[i] != offsets[j - 1])
+				offsets[j++] = offsets[i];
+		}
+		count = j;
+	}
+
+	sample->offsets = offsets;
+	sample->count = count;
+	RecordSample_Measure (sample, data, end);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int RecordSample_FromOffsets (RecordSample * sample, const char * data, const char * end, off_t * offsets, unsigned long count, double fraction, Random * random)
+{
+	unsigned long target;
+	unsigned long i;
+
+	/* Each record is picked with the probability that leaves exactly "target" of them (selection sampling), keeping them in order */
+	memset (sample, 0, sizeof(RecordSample));
+	sample->offsets = offsets;
+	target = max ((unsigned long) (fraction * count + 0.5), 1);
+	for (i=0;i<count && sample->count < target;i++)
+	{
+		if (Random_Below (random, count - i) < target - sample->count)
+			offsets[sample->count++] = offsets[i];
+	}
+	RecordSample_Measure (sample, data, end);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+char * RecordSample_Text (const RecordSample * sample, const char * data, const char * end)
+{
+	const char * lineEnd;
+	char * text;
+	char * pos;
+	unsigned long i;
+
+	/* Put the records picked together */
+	text = (char *) malloc (max (sample->length, 1));
+	if (text == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	pos = text;
+	for (i=0;i<sample->count;i++)
+	{
+		lineEnd = findChar (data + sample->offsets[i], end, '\n');
+		memcpy (pos, data + sample->offsets[i], (size_t) (lineEnd - (data + sample->offsets[i])));
+		pos += lineEnd - (data + sample->offsets[i]);
+		*pos++ = '\n';
+	}
+
+	return text;
+}
+
+void RecordSample_Free (RecordSample * sample)
+{
+	free (sample->offsets);
+	sample->offsets = NULL;
+	sample->count = 0;
+}
@@ -0,0 +1,492 @@
+#define EXTEND_DATASET
+#define EXTEND_BATCHDATASET
+#define EXTEND_SHARDEDDATASET		/* To get "PROTECTED" function prototypes */
+#include <stdlib.h>
+#include <pthread.h>
+#ifndef WIN32
+#include <glob.h>				/* For glob */
+#endif
+
+#include "MacLearn/DataSet/ShardedDataset.h"
+#include "MacLearn/DataSet/CSVDataset.h"
+#include "MacLearn/DataSet/ArffDataset.h"
+#include "MacLearn/DataSet/BinaryDataset.h"
+#include "MacLearn/Util/Parallel.h"			/* For Parallel_Run */
+
+/* State shared by the threads loading the shards. Each thread takes the next shard not yet taken, until there are none left */
+typedef struct
+{
+	ShardedDataSet * shardedDataset;	/* Dataset being loaded */
+	char ** paths;						/* File of each shard */
+	unsigned char * declaresClasses;	/* Whether each shard got its number of classes from its header */
+	int * errors;						/* errno of each shard that failed to load, 0 for the others */
+	unsigned long next;					/* Next shard to be loaded */
+	pthread_mutex_t lock;				/* Protects "next" */
+}ShardedLoader;
+
+/* Create a local var to save references to "super class" functions */
+static BatchDataSet super;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
+
+/************************
+* "Private" Functions	*
+************************/
+static void ShardedDataSet_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	BatchDataSet_Init(&super);
+}
+
+static unsigned char ShardedDataSet_HasSuffix (const char * path, const char * suffix)
+{
+	size_t pathLength = strlen (path);
+	size_t suffixLength = strlen (suffix);
+
+	return pathLength >= suffixLength && strcmp (&path[pathLength - suffixLength], suffix) == 0;
+}
+
+static __inline unsigned long ShardedDataSet_ShardOf (ShardedDataSet * shardedDataset, off_t record)
+{
+	unsigned long first = 0;
+	unsigned long last = shardedDataset->shardsCount;
+	unsigned long middle;
+
+	/* Binary search for the last shard starting at or before the record */
+	while (last - first > 1)
+	{
+		middle = first + (last - first) / 2;
+		if (shardedDataset->firstEntries[middle] <= (unsigned long) record)
+			first = middle;
+		else
+			last = middle;
+	}
+
+	return first;
+}
+
+static void ShardedDataSet_LoadShards (ShardedLoader ** task)
+{
+	ShardedLoader * loader = *task;
+	ShardedDataSet * shardedDataset = loader->shardedDataset;
+	BatchDataSet * shard;
+	char * path;
+	unsigned long i;
+
+	for (;;)
+	{
+		/* Take the next shard */
+		pthread_mutex_lock (&loader->lock);
+		i = loader->next++;
+		pthread_mutex_unlock (&loader->lock);
+		if (i >= shardedDataset->shardsCount)
+			break;
+
+		/* Open it as the data set its name calls for */
+		path = loader->paths[i];
+		errno = 0;
+		if (ShardedDataSet_HasSuffix (path, ".mlbin"))
+		{
+			shard = (BatchDataSet *) BinaryDataSet_New (shardedDataset->readMode, path);
+			loader->declaresClasses[i] = 1;
+		}
+		else if (ShardedDataSet_HasSuffix (path, ".arff") || ShardedDataSet_HasSuffix (path, ".arff.gz"))
+		{
+			shard = (BatchDataSet *) ArffDataSet_NewWithOptions (shardedDataset->readMode, path, &shardedDataset->options);
+			loader->declaresClasses[i] = 1;
+		}
+		else
+			shard = (BatchDataSet *) CSVDataSet_NewWithOptions (shardedDataset->hasLabels, shardedDataset->delimiter, shardedDataset->readMode, path, &shardedDataset->options);
+
+		/* errno belongs to this thread. Keep it for the caller */
+		shardedDataset->shards[i] = shard;
+		if (shard == NULL)
+			loader->errors[i] = (errno != 0) ? errno : EIO;
+	}
+}
+
+static int ShardedDataSet_CheckShards (ShardedDataSet * shardedDataset, ShardedLoader * loader)
+{
+	BatchDataSet * shard;
+	unsigned long declaredClasses = 0;
+	unsigned long maxClasses = 0;
+	unsigned long i;
+
+	shardedDataset->featsCount = shardedDataset->shards[0]->featsCount;
+	for (i=0;i<shardedDataset->shardsCount;i++)
+	{
+		shard = shardedDataset->shards[i];
+
+		/* All shards must hold the same features */
+		if (shard->featsCount != shardedDataset->featsCount)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+
+		/* Shards declaring their classes must agree on them */
+		if (loader->declaresClasses[i])
+		{
+			if (declaredClasses != 0 && shard->classesCount != declaredClasses)
+			{
+				errno = EIO;
+				return ML_ERR_FILE;
+			}
+			declaredClasses = shard->classesCount;
+		}
+		maxClasses = max (maxClasses, shard->classesCount);
+	}
+
+	/* The others must fit in them */
+	if (declaredClasses != 0 && maxClasses > declaredClasses)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	shardedDataset->classesCount = maxClasses;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int ShardedDataSet_LoadList (ShardedDataSet * shardedDataset, char ** paths, unsigned long pathsCount)
+{
+	ShardedLoader loader;
+	ShardedLoader ** tasks;
+	BatchDataSet * shard;
+	unsigned long threadsCount;
+	unsigned long i;
+	unsigned long j;
+	int ret = ML_OK;
+
+	/*	Check the parameters. Each shard would prune and scale the features by its own statistics (dropping different ones, or
+		giving the same value different scaled values), so neither is supported. A scaling taken from a source transform is */
+	if (pathsCount == 0 || (shardedDataset->readMode != BD_RM_FULL && shardedDataset->readMode != BD_RM_INCREMENTAL) ||
+		shardedDataset->options.prune != BD_PR_NONE || FeatsTransform_NeedsStats (&shardedDataset->options.transform))
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Get room for the shards, and for the state of the loading threads */
+	shardedDataset->shardsCount = pathsCount;
+	shardedDataset->shards = (BatchDataSet **) calloc (pathsCount, sizeof(BatchDataSet *));
+	shardedDataset->firstEntries = (unsigned long *) malloc (sizeof(unsigned long) * (pathsCount + 1));
+	memset (&loader, 0, sizeof(ShardedLoader));
+	loader.shardedDataset = shardedDataset;
+	loader.paths = paths;
+	loader.declaresClasses = (unsigned char *) calloc (pathsCount, sizeof(unsigned char));
+	loader.errors = (int *) calloc (pathsCount, sizeof(int));
+	threadsCount = min ((unsigned long) Parallel_CpuCount (), pathsCount);
+	tasks = (ShardedLoader **) malloc (sizeof(ShardedLoader *) * threadsCount);
+	if (shardedDataset->shards == NULL || shardedDataset->firstEntries == NULL || loader.declaresClasses == NULL || loader.errors == NULL || tasks == NULL)
+	{
+		free (loader.declaresClasses);
+		free (loader.errors);
+		free (tasks);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Load the shards, one per thread at a time. Every task points to the same loader */
+	pthread_mutex_init (&loader.lock, NULL);
+	for (i=0;i<threadsCount;i++)
+		tasks[i] = &loader;
+	Parallel_Run ((void (*)(void *)) ShardedDataSet_LoadShards, tasks, sizeof(ShardedLoader *), (unsigned int) threadsCount);
+	pthread_mutex_destroy (&loader.lock);
+	free (tasks);
+
+	/* Report the error of the first shard that failed */
+	for (i=0;i<pathsCount && ret == ML_OK;i++)
+	{
+		if (loader.errors[i] != 0)
+		{
+			errno = loader.errors[i];
+			ret = (errno == ENOMEM) ? ML_ERR_OUTOFMEMORY : (errno == ENOENT) ? ML_ERR_FILENOTFOUND : (errno == EINVAL) ? ML_ERR_PARAM :
+				  (errno == ENOSYS) ? ML_ERR_NOTIMPLEMENTED : ML_ERR_FILE;
+		}
+	}
+
+	/* Check that all shards hold the same kind of records */
+	if (ret == ML_OK)
+		ret = ShardedDataSet_CheckShards (shardedDataset, &loader);
+	free (loader.declaresClasses);
+	free (loader.errors);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Number the records, shard after shard */
+	shardedDataset->entriesCount = 0;
+	for (i=0;i<pathsCount;i++)
+	{
+		shardedDataset->firstEntries[i] = shardedDataset->entriesCount;
+		shardedDataset->entriesCount += shardedDataset->shards[i]->entriesCount;
+	}
+	shardedDataset->firstEntries[pathsCount] = shardedDataset->entriesCount;
+
+	/* Keep the original order of each shard, and start reading all records on that order */
+	shardedDataset->shardOrders = (off_t *) malloc (sizeof(off_t) * shardedDataset->entriesCount);
+	shardedDataset->readOrder = (off_t *) malloc (sizeof(off_t) * shardedDataset->entriesCount);
+	if (shardedDataset->shardOrders == NULL || shardedDataset->readOrder == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	for (i=0;i<pathsCount;i++)
+	{
+		shard = shardedDataset->shards[i];
+		memcpy (&shardedDataset->shardOrders[shardedDataset->firstEntries[i]], shard->readOrder, sizeof(off_t) * shard->entriesCount);
+	}
+	for (j=0;j<shardedDataset->entriesCount;j++)
+		shardedDataset->readOrder[j] = j;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int ShardedDataSet_Load (ShardedDataSet * shardedDataset, char * pattern)
+{
+#ifndef WIN32
+	glob_t matches;
+	int ret;
+
+	/* Find the files. glob sorts them alphabetically */
+	ret = glob (pattern, 0, NULL, &matches);
+	if (ret != 0)
+	{
+		errno = (ret == GLOB_NOSPACE) ? ENOMEM : ENOENT;
+		return (ret == GLOB_NOSPACE) ? ML_ERR_OUTOFMEMORY : ML_ERR_FILENOTFOUND;
+	}
+
+	ret = ShardedDataSet_LoadList (shardedDataset, matches.gl_pathv, (unsigned long) matches.gl_pathc);
+	globfree (&matches);
+
+	return ret;
+#else
+	/* TODO: Find the files with FindFirstFile. Use ShardedDataSet_NewFromList meanwhile */
+	errno = ENOSYS;
+	return ML_ERR_NOTIMPLEMENTED;
+#endif
+}
+
+static int ShardedDataSet_Reset (ShardedDataSet * shardedDataset)
+{
+	BatchDataSet * shard;
+	unsigned long i;
+	unsigned long s;
+	off_t record;
+
+	/* Reset the shards first: CSV ones stop their reading threads, which must not run while their read order changes */
+	for (s=0;s<shardedDataset->shardsCount;s++)
+		shardedDataset->shards[s]->reset (shardedDataset->shards[s]);
+
+	/*	Give each shard its records, on the order they appear on the read order. The position of the shards (0 after the
+		reset) is used to fill their read order, and set back to 0 when done */
+	for (i=0;i<shardedDataset->entriesCount;i++)
+	{
+		record = shardedDataset->readOrder[i];
+		shard = shardedDataset->shards[ShardedDataSet_ShardOf (shardedDataset, record)];
+		shard->readOrder[shard->currentPos++] = shardedDataset->shardOrders[record];
+	}
+	for (s=0;s<shardedDataset->shardsCount;s++)
+		shardedDataset->shards[s]->currentPos = 0;
+
+	/* Call the "superclass" reset function */
+	return super.reset ((BatchDataSet *) shardedDataset);
+}
+
+static int ShardedDataSet_NextEntry (ShardedDataSet * shardedDataset, EntryData ** entry)
+{
+	BatchDataSet * shard;
+
+	/* Check that the dataset hasn't been fully read yet */
+	if (shardedDataset->currentPos >= shardedDataset->entriesCount)
+		return ML_WARN_EOF;
+
+	/* The next record of the shard is this one */
+	shard = shardedDataset->shards[ShardedDataSet_ShardOf (shardedDataset, shardedDataset->readOrder[shardedDataset->currentPos++])];
+	return shard->nextEntry ((DataSet *) shard, entry);
+}
+
+static int ShardedDataSet_NextBatch (ShardedDataSet * shardedDataset, unsigned long maxCount, double ** features, int ** classes, unsigned long * count)
+{
+	BatchDataSet * shard;
+	double * shardFeatures;
+	int * shardClasses;
+	unsigned long shardCount;
+	unsigned long first;
+	unsigned long last;
+	unsigned long run;
+	unsigned long s;
+	off_t record;
+	int ret;
+
+	/* Get room for the whole batch */
+	*count = 0;
+	ret = DataSet_ReserveBatch ((DataSet *) shardedDataset, maxCount);
+	if (ret != ML_OK)
+		return ret;
+
+	/* Check that the dataset hasn't been fully read yet */
+	if (shardedDataset->currentPos >= shardedDataset->entriesCount)
+		return ML_WARN_EOF;
+	maxCount = min (maxCount, shardedDataset->entriesCount - shardedDataset->currentPos);
+
+	/* Read the batch as runs of records of the same shard, each one with a single call to the shard */
+	while (*count < maxCount)
+	{
+		s = ShardedDataSet_ShardOf (shardedDataset, shardedDataset->readOrder[shardedDataset->currentPos]);
+		first = shardedDataset->firstEntries[s];
+		last = shardedDataset->firstEntries[s + 1];
+		for (run=1;*count + run < maxCount;run++)
+		{
+			record = shardedDataset->readOrder[shardedDataset->currentPos + run];
+			if ((unsigned long) record < first || (unsigned long) record >= last)
+				break;
+		}
+
+		shard = shardedDataset->shards[s];
+		ret = shard->nextBatch ((DataSet *) shard, run, &shardFeatures, &shardClasses, &shardCount);
+		if (ret != ML_OK)
+			return ret;
+		if (shardCount != run)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		shardedDataset->currentPos += run;
+
+		/* A batch from a single shard is returned as the shard gave it */
+		if (*count == 0 && run == maxCount)
+		{
+			*features = shardFeatures;
+			*classes = shardClasses;
+			*count = run;
+			return ML_OK;
+		}
+
+		memcpy (&shardedDataset->batchFeatures[shardedDataset->featsCount * *count], shardFeatures, sizeof(double) * shardedDataset->featsCount * run);
+		memcpy (&shardedDataset->batchClasses[*count], shardClasses, sizeof(int) * run);
+		*count += run;
+	}
+	*features = shardedDataset->batchFeatures;
+	*classes = shardedDataset->batchClasses;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void ShardedDataSet_Free (ShardedDataSet * shardedDataset)
+{
+	unsigned long i;
+
+	/* Free the shards */
+	if (shardedDataset->shards != NULL)
+	{
+		for (i=0;i<shardedDataset->shardsCount;i++)
+			if (shardedDataset->shards[i] != NULL)
+				shardedDataset->shards[i]->free ((DataSet *) shardedDataset->shards[i]);
+		free (shardedDataset->shards);
+		shardedDataset->shards = NULL;
+	}
+
+	/* Free the record numbering and the orders */
+	free (shardedDataset->firstEntries);
+	shardedDataset->firstEntries = NULL;
+	free (shardedDataset->shardOrders);
+	shardedDataset->shardOrders = NULL;
+	free (shardedDataset->readOrder);
+	shardedDataset->readOrder = NULL;
+
+	/* Call the "superclass" free function */
+	super.free((DataSet *) shardedDataset);
+}
+
+static ShardedDataSet * ShardedDataSet_Create (unsigned char hasLabels, char delimiter, BatchReadMode readMode, BatchOptions * options)
+{
+	ShardedDataSet * shardedDataset;
+
+	/* malloc memory to store the structure */
+	shardedDataset = (ShardedDataSet *) malloc (sizeof(ShardedDataSet));
+	if (shardedDataset == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Zero memory */
+	memset (shardedDataset, 0, sizeof(ShardedDataSet));
+
+	/* Initialize the structure data and pointers */
+	ShardedDataSet_Init(shardedDataset);
+
+	/* Initialize instance data */
+	shardedDataset->hasLabels = hasLabels;
+	shardedDataset->delimiter = delimiter;
+	shardedDataset->readMode = readMode;
+	if (options != NULL)
+		shardedDataset->options = *options;
+
+	return shardedDataset;
+}
+
+/************************
+* "Protected" Functions	*
+************************/
+void ShardedDataSet_Init (ShardedDataSet * shardedDataset)
+{
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, ShardedDataSet_InitSuper);
+
+	/* Call the initializer for the "superclass" */
+	BatchDataSet_Init((BatchDataSet *) shardedDataset);
+
+	/* Initialize the function pointers. Shuffle and sort are inherited, and reset hands the resulting order to the shards */
+	shardedDataset->load = (int (*)(BatchDataSet *, char *)) ShardedDataSet_Load;
+	shardedDataset->reset = (int (*)(BatchDataSet *)) ShardedDataSet_Reset;
+	shardedDataset->nextEntry = (int(*)(DataSet *, EntryData **)) ShardedDataSet_NextEntry;
+	shardedDataset->nextBatch = (int(*)(DataSet *, unsigned long, double **, int **, unsigned long *)) ShardedDataSet_NextBatch;
+
+	/* Overrides the default free method */
+	shardedDataset->free = (void(*)(DataSet *)) ShardedDataSet_Free;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+ShardedDataSet * ShardedDataSet_New (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char * pattern, BatchOptions * options)
+{
+	ShardedDataSet * shardedDataset;
+
+	shardedDataset = ShardedDataSet_Create (hasLabels, delimiter, readMode, options);
+	if (shardedDataset == NULL)
+		return NULL;
+
+	/* Load data from the files matching the pattern */
+	if (shardedDataset->load((BatchDataSet *) shardedDataset, pattern) != ML_OK)
+	{
+		shardedDataset->free((DataSet *) shardedDataset);
+		return NULL;
+	}
+
+	/* Return the new instance */
+	return shardedDataset;
+}
+
+ShardedDataSet * ShardedDataSet_NewFromList (unsigned char hasLabels, char delimiter, BatchReadMode readMode, char ** paths, unsigned long pathsCount, BatchOptions * options)
+{
+	ShardedDataSet * shardedDataset;
+
+	shardedDataset = ShardedDataSet_Create (hasLabels, delimiter, readMode, options);
+	if (shardedDataset == NULL)
+		return NULL;
+
+	/* Load data from the files */
+	if (ShardedDataSet_LoadList (shardedDataset, paths, pathsCount) != ML_OK)
+	{
+		shardedDataset->free((DataSet *) shardedDataset);
+		return NULL;
+	}
+
+	/* Return the new instance */
+	return shardedDataset;
+}
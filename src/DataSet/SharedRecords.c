@@ -0,0 +1,257 @@
+#include <stdio.h>				/* For sprintf */
+#include <stdlib.h>				/* For malloc/free and realpath */
+#include <string.h>				/* For memcmp and memcpy */
+#ifndef WIN32
+#include <unistd.h>				/* For getpid */
+#include <signal.h>				/* For kill */
+#endif
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/DataSet/SharedRecords.h"
+
+/* Identifies shared blocks of records (and their version). Each part of a block starts on a multiple of SHARED_ALIGN bytes */
+#define SHARED_MAGIC			"MLSHM02"
+#define SHARED_ALIGN			64
+#define SHARED_ALIGNED(size)	(((size) + SHARED_ALIGN - 1) & ~(size_t) (SHARED_ALIGN - 1))
+/* Byte order of the machine that published a shared block of records */
+#define SHARED_BYTE_ORDER		0x0102030405060708ULL
+
+/*	Header of a shared block of records. It's followed by the key of the block, the class of every record and the features:
+	the rows of dense records, or the position of the first value of each record, the values and their columns on sparse ones */
+typedef struct
+{
+	char magic[8];					/* SHARED_MAGIC */
+	uint64_t byteOrder;				/* SHARED_BYTE_ORDER, as written by the machine that published the block */
+	volatile uint64_t complete;		/* Set once the rest of the block was written */
+	volatile uint64_t owner;		/* Id of the process that publishes the block. Written first, when the block is created */
+	uint64_t fileSize;				/* Size of the file the records were loaded from */
+	int64_t fileTime;				/* Modification time of the file */
+	uint64_t checksum;				/* Hash of some pieces of the file */
+	uint64_t keySize;				/* Length of the key (without its '\0') */
+	uint64_t featsCount;			/* Contents of the block */
+	uint64_t classesCount;
+	uint64_t entriesCount;
+	uint64_t nnz;					/* Sparse storage only: number of values */
+}SharedRecordsHeader;
+
+/* Position (in bytes, from the start of a shared block) of each part of the block */
+typedef struct
+{
+	size_t classes;					/* Class of every record */
+	size_t starts;					/* Sparse storage only: position of the first value of every record (and the end of the last one) */
+	size_t features;				/* Rows of dense records, or values of sparse ones */
+	size_t indexes;					/* Sparse storage only: column of every value */
+	size_t size;					/* Size of the whole block */
+}SharedRecordsLayout;
+
+static void SharedRecords_Layout (const SharedRecordsHeader * header, unsigned char sparse, size_t rowStride, SharedRecordsLayout * layout)
+{
+	/* Each part of the block starts on a multiple of SHARED_ALIGN: the key, the classes, and the features */
+	layout->classes = SHARED_ALIGNED (sizeof(SharedRecordsHeader) + (size_t) header->keySize + 1);
+	layout->starts = SHARED_ALIGNED (layout->classes + sizeof(int) * (size_t) header->entriesCount);
+	if (sparse)
+	{
+		layout->features = SHARED_ALIGNED (layout->starts + sizeof(uint64_t) * ((size_t) header->entriesCount + 1));
+		layout->indexes = SHARED_ALIGNED (layout->features + sizeof(double) * (size_t) header->nnz);
+		layout->size = layout->indexes + sizeof(unsigned int) * (size_t) header->nnz;
+	}
+	else
+	{
+		layout->features = layout->starts;
+		layout->indexes = 0;
+		layout->size = layout->features + rowStride * (size_t) header->entriesCount;
+	}
+}
+
+static unsigned char SharedRecords_OwnerGone (const SharedRecordsHeader * header)
+{
+#ifndef WIN32
+	/* Signal 0 isn't sent: it only checks whether the process exists */
+	return (header->owner != 0 && kill ((pid_t) header->owner, 0) != 0 && errno == ESRCH);
+#else
+	return 0;
+#endif
+}
+
+char * SharedRecords_Key (const char * srcPath, const char * params, char * name)
+{
+	char * path;
+	char * key;
+	char * pos;
+	uint64_t hash;
+
+#ifndef WIN32
+	/* The same file may be reached through many paths. Use the canonical one */
+	path = realpath (srcPath, NULL);
+	if (path == NULL)
+		return NULL;
+#else
+	return NULL;
+#endif
+
+	/* The key holds everything that changes the records: the file, how it's read, and the options */
+	key = (char *) malloc (strlen (path) + strlen (params) + 2);
+	if (key == NULL)
+	{
+		free (path);
+		return NULL;
+	}
+	sprintf (key, "%s\n%s", path, params);
+	free (path);
+
+	/* Blocks are named after a hash of the key (FNV-1a). The key itself is kept on the block, to tell collisions apart */
+	hash = 0xCBF29CE484222325ULL;
+	for (pos=key;*pos != '\0';pos++)
+		hash = (hash ^ (unsigned char) *pos) * 0x100000001B3ULL;
+	sprintf (name, "/maclearn-%016llx", (unsigned long long) hash);
+
+	return key;
+}
+
+int SharedRecords_Attach (SharedRecords * records, const char * name, const char * key, const FileStamp * stamp)
+{
+	SharedMem shm;
+	SharedRecordsHeader * header;
+	SharedRecordsLayout layout;
+	unsigned char * block;
+	int ret;
+
+	ret = SharedMem_Open (&shm, name);
+	if (ret != ML_OK)
+		return ret;
+
+	/* The block must be complete, and hold the records of this very file, read with the same options */
+	header = (SharedRecordsHeader *) shm.data;
+	if (shm.size < sizeof(SharedRecordsHeader) || memcmp (header->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC)) != 0 ||
+		header->byteOrder != SHARED_BYTE_ORDER || !header->complete || header->fileSize != stamp->fileSize ||
+		header->fileTime != stamp->fileTime || header->checksum != stamp->checksum || header->keySize != strlen (key) ||
+		shm.size < sizeof(SharedRecordsHeader) + header->keySize || memcmp ((const char *) shm.data + sizeof(SharedRecordsHeader), key, header->keySize) != 0 ||
+		header->featsCount != records->featsCount || header->entriesCount == 0)
+	{
+		SharedMem_Close (&shm);
+		errno = ENOENT;
+		return ML_ERR_FILE;
+	}
+	SharedRecords_Layout (header, records->sparse, records->rowStride, &layout);
+	if (layout.size > shm.size)
+	{
+		SharedMem_Close (&shm);
+		errno = ENOENT;
+		return ML_ERR_FILE;
+	}
+
+	/* Point the records into the block */
+	block = (unsigned char *) shm.data;
+	records->classesCount = (unsigned long) header->classesCount;
+	records->entriesCount = (unsigned long) header->entriesCount;
+	records->classes = (int *) (block + layout.classes);
+	records->rows = records->sparse ? NULL : block + layout.features;
+	records->starts = records->sparse ? (uint64_t *) (block + layout.starts) : NULL;
+	records->values = records->sparse ? (double *) (block + layout.features) : NULL;
+	records->indexes = records->sparse ? (unsigned int *) (block + layout.indexes) : NULL;
+	records->shm = shm;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int SharedRecords_Publish (const SharedRecords * records, const EntryData * entries, const char * name, const char * key, const FileStamp * stamp)
+{
+	SharedMem shm;
+	SharedRecordsHeader header;
+	SharedRecordsLayout layout;
+	unsigned char * block;
+	int * classes;
+	uint64_t * starts;
+	unsigned long i;
+	int ret;
+
+	/* Sparse records are only taken from their entries */
+	if (records->sparse && entries == NULL)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Describe the block */
+	memset (&header, 0, sizeof(SharedRecordsHeader));
+	memcpy (header.magic, SHARED_MAGIC, sizeof(SHARED_MAGIC));
+	header.byteOrder = SHARED_BYTE_ORDER;
+	header.fileSize = stamp->fileSize;
+	header.fileTime = stamp->fileTime;
+	header.checksum = stamp->checksum;
+	header.keySize = strlen (key);
+	header.featsCount = records->featsCount;
+	header.classesCount = records->classesCount;
+	header.entriesCount = records->entriesCount;
+#ifndef WIN32
+	header.owner = (uint64_t) getpid ();
+#endif
+	for (i=0;i<records->entriesCount && records->sparse;i++)
+		header.nnz += entries[i].nnz;
+	SharedRecords_Layout (&header, records->sparse, records->rowStride, &layout);
+
+	/*	Only one process publishes each block. A complete block that wasn't attached to is out of date, so it's replaced, and so
+		is an incomplete one whose publisher is gone. Otherwise another process is still publishing it */
+	ret = SharedMem_Create (&shm, name, layout.size);
+	if (ret != ML_OK && errno == EEXIST && SharedMem_Open (&shm, name) == ML_OK)
+	{
+		if (shm.size >= sizeof(SharedRecordsHeader) && (((SharedRecordsHeader *) shm.data)->complete || SharedRecords_OwnerGone ((SharedRecordsHeader *) shm.data)))
+		{
+			SharedMem_Close (&shm);
+			SharedMem_Remove (name);
+			ret = SharedMem_Create (&shm, name, layout.size);
+		}
+		else
+		{
+			SharedMem_Close (&shm);
+			errno = EEXIST;
+		}
+	}
+	if (ret != ML_OK)
+		return ret;
+
+	/* Tell other processes who is publishing the block, before anything else */
+	block = (unsigned char *) shm.data;
+	((SharedRecordsHeader *) block)->owner = header.owner;
+	__sync_synchronize ();
+
+	/* Copy the key, the classes and the features. Records are stored on their original order */
+	memcpy (block + sizeof(SharedRecordsHeader), key, (size_t) header.keySize + 1);
+	classes = (int *) (block + layout.classes);
+	starts = (uint64_t *) (block + layout.starts);
+	if (entries == NULL)
+	{
+		/* Rows are already a single block, with the same stride */
+		memcpy (classes, records->classes, sizeof(int) * records->entriesCount);
+		memcpy (block + layout.features, records->rows, records->rowStride * records->entriesCount);
+	}
+	else if (records->sparse)
+	{
+		starts[0] = 0;
+		for (i=0;i<records->entriesCount;i++)
+		{
+			classes[i] = entries[i].class;
+			memcpy ((double *) (block + layout.features) + starts[i], entries[i].features, sizeof(double) * entries[i].nnz);
+			memcpy ((unsigned int *) (block + layout.indexes) + starts[i], entries[i].indexes, sizeof(unsigned int) * entries[i].nnz);
+			starts[i + 1] = starts[i] + entries[i].nnz;
+		}
+	}
+	else
+	{
+		for (i=0;i<records->entriesCount;i++)
+		{
+			classes[i] = entries[i].class;
+			memcpy (block + layout.features + records->rowStride * i, entries[i].byteFeatures, records->rowStride);
+		}
+	}
+
+	/* The header goes last. Other processes only attach to blocks marked as complete */
+	memcpy (block, &header, sizeof(SharedRecordsHeader));
+	__sync_synchronize ();
+	((SharedRecordsHeader *) block)->complete = 1;
+	SharedMem_Close (&shm);
+
+	/* Return OK */
+	return ML_OK;
+}
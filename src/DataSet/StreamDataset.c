@@ -0,0 +1,304 @@
+#define EXTEND_DATASET
+#define EXTEND_STREAMDATASET		/* To get "PROTECTED" function prototypes */
+#include <stdlib.h>
+#include <pthread.h>			/* For pthread_once */
+#ifndef WIN32
+#include <unistd.h>				/* For read */
+#else
+#include <io.h>					/* For _read */
+#define read(fd, buf, count)	_read (fd, buf, (unsigned int) (count))
+#endif
+
+#include "MacLearn/DataSet/StreamDataset.h"
+#include "MacLearn/Util/ParseUtil.h"		/* For parseDouble, parseLong, findChar and countChar */
+
+/* Create a local var to save references to "super class" functions */
+static DataSet super;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
+
+/************************
+* "Private" Functions	*
+************************/
+static void StreamDataSet_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	DataSet_Init(&super);
+}
+
+static int StreamDataSet_Fill (StreamDataSet * streamDataset)
+{
+	char * auxBuffer;
+	size_t newSize;
+	long bytesRead;
+
+	/* Move the bytes not yet parsed to the begining of the buffer, to make room for new ones */
+	if (streamDataset->start > 0)
+	{
+		memmove (streamDataset->buffer, &streamDataset->buffer[streamDataset->start], streamDataset->end - streamDataset->start);
+		streamDataset->end -= streamDataset->start;
+		streamDataset->start = 0;
+	}
+
+	/* If the buffer is still full, a single line doesn't fit on it. Grow it, up to the maximum line length */
+	if (streamDataset->end == streamDataset->bufferSize)
+	{
+		if (streamDataset->bufferSize >= STREAMDATASET_MAX_LINE)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+
+		newSize = min (streamDataset->bufferSize * 2, (size_t) STREAMDATASET_MAX_LINE);
+		auxBuffer = (char *) realloc (streamDataset->buffer, newSize);
+		if (auxBuffer == NULL)
+		{
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		streamDataset->buffer = auxBuffer;
+		streamDataset->bufferSize = newSize;
+	}
+
+	/* Read whatever is available. Pipes and sockets may return less than requested, but never 0 unless the stream ended */
+	do
+	{
+		bytesRead = (long) read (streamDataset->fd, &streamDataset->buffer[streamDataset->end], streamDataset->bufferSize - streamDataset->end);
+	}while (bytesRead < 0 && errno == EINTR);
+
+	if (bytesRead < 0)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	if (bytesRead == 0)
+	{
+		streamDataset->eof = 1;
+		return ML_WARN_EOF;
+	}
+
+	streamDataset->end += (size_t) bytesRead;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int StreamDataSet_NextLine (StreamDataSet * streamDataset, const char ** line, const char ** lineEnd)
+{
+	const char * newLine;
+	size_t searchStart;
+	int ret;
+
+	/* Only the bytes read since the last search need to be checked for a '\n' */
+	searchStart = streamDataset->start;
+	for (;;)
+	{
+		newLine = findChar (&streamDataset->buffer[searchStart], &streamDataset->buffer[streamDataset->end], '\n');
+		if (newLine < &streamDataset->buffer[streamDataset->end])
+		{
+			*line = &streamDataset->buffer[streamDataset->start];
+			*lineEnd = newLine;
+			streamDataset->start = (newLine - streamDataset->buffer) + 1;
+			return ML_OK;
+		}
+
+		/* The last line of the stream may not have a '\n' */
+		if (streamDataset->eof)
+		{
+			if (streamDataset->start == streamDataset->end)
+				return ML_WARN_EOF;
+
+			*line = &streamDataset->buffer[streamDataset->start];
+			*lineEnd = &streamDataset->buffer[streamDataset->end];
+			streamDataset->start = streamDataset->end;
+			return ML_OK;
+		}
+
+		/* Wait for more bytes. Fill may move the unparsed bytes to the begining of the buffer */
+		searchStart = streamDataset->end - streamDataset->start;
+		ret = StreamDataSet_Fill (streamDataset);
+		if (ret < ML_OK)
+			return ret;
+		searchStart += streamDataset->start;
+	}
+}
+
+static __inline unsigned char StreamDataSet_IsEmptyLine (const char * line, const char * lineEnd)
+{
+	/* Lines with only blanks (like the '\r' of a '\r\n') don't hold a record */
+	while (line < lineEnd && (*line == ' ' || *line == '\t' || *line == '\r'))
+		line++;
+
+	return line == lineEnd;
+}
+
+static int StreamDataSet_NextEntry (StreamDataSet * streamDataset, EntryData ** entry)
+{
+	const char * line;
+	const char * lineEnd;
+	unsigned long i;
+	long class;
+	int ret;
+
+	/* Skip empty lines */
+	do
+	{
+		ret = StreamDataSet_NextLine (streamDataset, &line, &lineEnd);
+		if (ret != ML_OK)
+			return ret;
+	}while (StreamDataSet_IsEmptyLine (line, lineEnd));
+
+	/* Read this record's feats, each one followed by a delimiter */
+	for (i=0;i<streamDataset->featsCount;i++)
+	{
+		line = parseDouble (line, lineEnd, &streamDataset->entry.features[i]);
+		if (line == NULL || line >= lineEnd || *line != streamDataset->delimiter)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		/* Skip the delimiter */
+		line++;
+	}
+
+	/* Read this record's class. Classes start at 1 */
+	if (parseLong (line, lineEnd, &class) == NULL || class < 1)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	streamDataset->entry.class = (int) class;
+
+	/* A new class makes the data set grow */
+	if ((unsigned long) class > streamDataset->classesCount)
+		streamDataset->classesCount = (unsigned long) class;
+
+	streamDataset->entriesRead++;
+	*entry = &streamDataset->entry;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int StreamDataSet_LoadHeader (StreamDataSet * streamDataset)
+{
+	const char * line;
+	const char * lineEnd;
+	int ret;
+
+	/* The first non empty line (labels or a record) has a delimiter after each feature */
+	do
+	{
+		ret = StreamDataSet_NextLine (streamDataset, &line, &lineEnd);
+		if (ret != ML_OK)
+		{
+			/* An empty stream has no features to read */
+			if (ret == ML_WARN_EOF)
+			{
+				errno = EIO;
+				ret = ML_ERR_FILE;
+			}
+			return ret;
+		}
+	}while (StreamDataSet_IsEmptyLine (line, lineEnd));
+
+	streamDataset->featsCount = countChar (line, lineEnd, streamDataset->delimiter);
+	if (streamDataset->featsCount == 0)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* A line that isn't a header is a record, so it must be read again by nextEntry */
+	if (!streamDataset->hasLabels)
+		streamDataset->start = line - streamDataset->buffer;
+
+	/* Get storage for one record */
+	streamDataset->entry.features = (double *) malloc (sizeof(double) * streamDataset->featsCount);
+	if (streamDataset->entry.features == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void StreamDataSet_Free (StreamDataSet * streamDataset)
+{
+	/* Free the read buffer and the record. The descriptor belongs to the caller */
+	free (streamDataset->buffer);
+	streamDataset->buffer = NULL;
+	free (streamDataset->entry.features);
+	streamDataset->entry.features = NULL;
+
+	/* Call the "superclass" free function */
+	super.free((DataSet *) streamDataset);
+}
+
+/************************
+* "Protected" Functions	*
+************************/
+void StreamDataSet_Init (StreamDataSet * streamDataset)
+{
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, StreamDataSet_InitSuper);
+
+	/* Call the initializer for the "superclass" */
+	DataSet_Init((DataSet *) streamDataset);
+
+	/* Initialize the function pointers. nextBatch uses the default implementation, over nextEntry */
+	streamDataset->nextEntry = (int(*)(DataSet *, EntryData **)) StreamDataSet_NextEntry;
+
+	/* Overrides the default free method */
+	streamDataset->free = (void(*)(DataSet *)) StreamDataSet_Free;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+StreamDataSet * StreamDataSet_New (int fd, unsigned char hasLabels, char delimiter, unsigned long classesCount, size_t bufferSize)
+{
+	StreamDataSet * streamDataset;
+
+	/* malloc memory to store the structure */
+	streamDataset = (StreamDataSet *) malloc (sizeof(StreamDataSet));
+	if (streamDataset == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Zero memory */
+	memset (streamDataset, 0, sizeof(StreamDataSet));
+
+	/* Initialize the structure data and pointers */
+	StreamDataSet_Init(streamDataset);
+
+	/* Initialize instance data */
+	streamDataset->fd = fd;
+	streamDataset->hasLabels = hasLabels;
+	streamDataset->delimiter = delimiter;
+	streamDataset->classesCount = classesCount;
+	streamDataset->bufferSize = min (bufferSize > 0 ? bufferSize : STREAMDATASET_BUFFER_SIZE, (size_t) STREAMDATASET_MAX_LINE);
+
+	/* Get storage for the read buffer */
+	streamDataset->buffer = (char *) malloc (streamDataset->bufferSize);
+	if (streamDataset->buffer == NULL)
+	{
+		errno = ENOMEM;
+		streamDataset->free((DataSet *) streamDataset);
+		return NULL;
+	}
+
+	/* Wait for the first line, to know the number of features */
+	if (StreamDataSet_LoadHeader (streamDataset) != ML_OK)
+	{
+		streamDataset->free((DataSet *) streamDataset);
+		return NULL;
+	}
+
+	/* Return the new instance */
+	return streamDataset;
+}
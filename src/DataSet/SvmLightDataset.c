@@ -0,0 +1,871 @@
+#define EXTEND_CSVDATASET
+#define EXTEND_SVMLIGHTDATASET		/* To get "PROTECTED" function prototypes */
+#include <stdlib.h>
+#include <pthread.h>			/* For pthread_once */
+#include <string.h>
+#include <limits.h>				/* For INT_MIN, INT_MAX and UINT_MAX */
+
+#include "MacLearn/DataSet/SvmLightDataset.h"
+#include "MacLearn/Util/FileMap.h"			/* For FileMap */
+#include "MacLearn/Util/SegmentReader.h"	/* For SegmentReader_Parse */
+#include "MacLearn/Util/ParseUtil.h"		/* For parseDouble and findChar */
+#include "MacLearn/Util/Parallel.h"			/* For Parallel_Run */
+#include "MacLearn/Util/Memory.h"			/* For Memory_Alloc */
+
+/* Minimum size (in bytes) of a chunk of the file parsed by a single thread. Smaller files don't benefit from threading */
+#define MIN_CHUNK_SIZE			(1 << 20)
+/* Initial number of records, and of values, a chunk has room for. Both double as needed */
+#define INITIAL_RECORDS			1024
+#define INITIAL_VALUES			16384
+
+/*	A piece of the file, parsed by a single thread to its own buffers. The highest index and the labels are found on each
+	chunk, and merged once all of them are parsed */
+typedef struct
+{
+	TextSegment;					/* Piece of the file parsed, and the result of parsing it */
+	SvmLightDataSet * svmDataset;	/* Dataset being loaded */
+	unsigned long entriesCount;		/* Number of records on this chunk */
+	unsigned long capacity;			/* Number of records that fit in "recordLabels", "offsets" and "rowNnz" */
+	int * recordLabels;				/* Label of each record */
+	off_t * offsets;				/* INCREMENTAL only: position of each record on the file */
+	unsigned long * rowNnz;			/* FULL only: number of values of each record */
+	double * values;				/* FULL only: non zero values of this chunk */
+	unsigned int * indexes;			/* FULL only: index of each value of this chunk, as found on the file */
+	unsigned long nnz;				/* FULL only: number of values of this chunk */
+	unsigned long valuesCapacity;	/* FULL only: number of values that fit in "values" and "indexes" */
+	unsigned long firstEntry;		/* Index of the first record of this chunk on the whole dataset */
+	unsigned long nnzOffset;		/* FULL only: position of the first value of this chunk on the dataset block */
+	double * data;					/* FULL only: values block of the dataset */
+	unsigned int * dataIndexes;		/* FULL only: columns block of the dataset */
+	EntryData * entries;			/* FULL only: records of the dataset */
+	unsigned long maxIndex;			/* Highest index found */
+	unsigned char indexFound;		/* Whether any index was found */
+	size_t maxLineLength;			/* Size of the longest record, with its line break */
+	int * labels;					/* Distinct labels found, in increasing order */
+	unsigned long labelsCount;		/* Number of distinct labels found */
+	unsigned long labelsCapacity;	/* Number of labels that fit in "labels" */
+}SvmLightChunk;
+
+/* Create a local var to save references to "super class" functions */
+static CSVDataSet super;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
+
+/************************
+* "Private" Functions	*
+************************/
+static void SvmLightDataSet_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	CSVDataSet_Init(&super);
+}
+
+static __inline const char * SvmLightDataSet_SkipBlanks (const char * pos, const char * end)
+{
+	while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+		pos++;
+
+	return pos;
+}
+
+static __inline unsigned char SvmLightDataSet_IsSeparator (const char * pos, const char * end)
+{
+	/* Values end on a blank, a comment or the end of the line */
+	return pos >= end || *pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '#';
+}
+
+static const char * SvmLightDataSet_ParseLabel (const char * pos, const char * end, int * label)
+{
+	double value;
+
+	/* Labels are integers, but may be written as "+1" or "1.0" */
+	pos = parseDouble (pos, end, &value);
+	if (pos == NULL || !SvmLightDataSet_IsSeparator (pos, end) || value < INT_MIN || value > INT_MAX || value != (double) (int) value)
+		return NULL;
+
+	*label = (int) value;
+	return pos;
+}
+
+static const char * SvmLightDataSet_NextPair (const char * pos, const char * end)
+{
+	/* Returns the start of the next "index:value" pair, or "end" if there are no more. "qid:n" pairs aren't features */
+	for (;;)
+	{
+		pos = SvmLightDataSet_SkipBlanks (pos, end);
+		if (pos >= end || *pos == '#')
+			return end;
+		if (end - pos < 4 || strncmp (pos, "qid:", 4) != 0)
+			return pos;
+		while (!SvmLightDataSet_IsSeparator (pos, end))
+			pos++;
+	}
+}
+
+static __inline const char * SvmLightDataSet_ParseIndex (const char * pos, const char * end, unsigned long * index)
+{
+	const char * digitsStart = pos;
+	unsigned long result = 0;
+
+	/* Indexes have no sign, and must fit on the columns of a sparse record */
+	while (pos < end && *pos >= '0' && *pos <= '9')
+	{
+		result = result * 10 + (unsigned long) (*pos++ - '0');
+		if (result > UINT_MAX)
+			return NULL;
+	}
+	if (pos == digitsStart || pos >= end || *pos != ':')
+		return NULL;
+
+	*index = result;
+	return pos + 1;
+}
+
+static int SvmLightDataSet_AddLabel (int ** labels, unsigned long * labelsCount, unsigned long * labelsCapacity, int label)
+{
+	unsigned long first = 0;
+	unsigned long last = *labelsCount;
+	unsigned long middle;
+	int * auxLabels;
+
+	/* Binary search for the label. There are usually very few of them */
+	while (first < last)
+	{
+		middle = first + (last - first) / 2;
+		if ((*labels)[middle] == label)
+			return ML_OK;
+		if ((*labels)[middle] < label)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	/* Insert it, keeping them sorted */
+	if (*labelsCount == *labelsCapacity)
+	{
+		auxLabels = (int *) realloc (*labels, sizeof(int) * max (*labelsCapacity * 2, 16));
+		if (auxLabels == NULL)
+		{
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		*labels = auxLabels;
+		*labelsCapacity = max (*labelsCapacity * 2, 16);
+	}
+	memmove (&(*labels)[first + 1], &(*labels)[first], sizeof(int) * (*labelsCount - first));
+	(*labels)[first] = label;
+	(*labelsCount)++;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static __inline int SvmLightDataSet_Class (SvmLightDataSet * svmDataset, int label)
+{
+	unsigned long first = 0;
+	unsigned long last = svmDataset->labelsCount;
+	unsigned long middle;
+
+	/* Without a map, the labels (maybe shifted) are the classes */
+	if (svmDataset->labels == NULL)
+		return label + svmDataset->labelShift;
+
+	/* Otherwise, the class is the position of the label on the sorted labels, plus 1 (0 if it isn't there) */
+	while (first < last)
+	{
+		middle = first + (last - first) / 2;
+		if (svmDataset->labels[middle] == label)
+			return (int) middle + 1;
+		if (svmDataset->labels[middle] < label)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return 0;
+}
+
+static int SvmLightDataSet_GrowRecords (SvmLightChunk * chunk, unsigned char full)
+{
+	unsigned long capacity;
+	int * auxLabels;
+	void * auxRecords;
+
+	capacity = max (chunk->capacity * 2, INITIAL_RECORDS);
+	auxLabels = (int *) realloc (chunk->recordLabels, sizeof(int) * capacity);
+	if (auxLabels != NULL)
+		chunk->recordLabels = auxLabels;
+	if (full)
+	{
+		auxRecords = realloc (chunk->rowNnz, sizeof(unsigned long) * capacity);
+		if (auxRecords != NULL)
+			chunk->rowNnz = (unsigned long *) auxRecords;
+	}
+	else
+	{
+		auxRecords = realloc (chunk->offsets, sizeof(off_t) * capacity);
+		if (auxRecords != NULL)
+			chunk->offsets = (off_t *) auxRecords;
+	}
+	if (auxLabels == NULL || auxRecords == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	chunk->capacity = capacity;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int SvmLightDataSet_GrowValues (SvmLightChunk * chunk)
+{
+	unsigned long capacity;
+	double * auxValues;
+	unsigned int * auxIndexes;
+
+	capacity = max (chunk->valuesCapacity * 2, INITIAL_VALUES);
+	auxValues = (double *) realloc (chunk->values, sizeof(double) * capacity);
+	if (auxValues != NULL)
+		chunk->values = auxValues;
+	auxIndexes = (unsigned int *) realloc (chunk->indexes, sizeof(unsigned int) * capacity);
+	if (auxIndexes != NULL)
+		chunk->indexes = auxIndexes;
+	if (auxValues == NULL || auxIndexes == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	chunk->valuesCapacity = capacity;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void SvmLightDataSet_ParseChunk (SvmLightChunk * chunk)
+{
+	const char * pos;
+	const char * line;
+	const char * lineEnd;
+	unsigned long index;
+	unsigned long first;
+	unsigned char full;
+	double value;
+	int label;
+
+	/* FULL datasets parse the values. INCREMENTAL ones only need the offsets, the indexes and the labels */
+	full = (chunk->svmDataset->readMode == BD_RM_FULL);
+	for (pos=chunk->start;pos<chunk->end;pos=lineEnd + 1)
+	{
+		/* Empty lines and comments don't hold a record */
+		lineEnd = findChar (pos, chunk->end, '\n');
+		line = SvmLightDataSet_SkipBlanks (pos, lineEnd);
+		if (line >= lineEnd || *line == '#')
+			continue;
+
+		if (chunk->entriesCount == chunk->capacity && SvmLightDataSet_GrowRecords (chunk, full) != ML_OK)
+		{
+			chunk->ret = ML_ERR_OUTOFMEMORY;
+			return;
+		}
+		if ((size_t) (lineEnd - pos) + 1 > chunk->maxLineLength)
+			chunk->maxLineLength = (size_t) (lineEnd - pos) + 1;
+
+		/* Read the label */
+		line = SvmLightDataSet_ParseLabel (line, lineEnd, &label);
+		if (line == NULL)
+		{
+			errno = EIO;
+			chunk->ret = ML_ERR_FILE;
+			return;
+		}
+		if (SvmLightDataSet_AddLabel (&chunk->labels, &chunk->labelsCount, &chunk->labelsCapacity, label) != ML_OK)
+		{
+			chunk->ret = ML_ERR_OUTOFMEMORY;
+			return;
+		}
+
+		/* Read the "index:value" pairs */
+		first = chunk->nnz;
+		for (line=SvmLightDataSet_NextPair (line, lineEnd);line<lineEnd;line=SvmLightDataSet_NextPair (line, lineEnd))
+		{
+			line = SvmLightDataSet_ParseIndex (line, lineEnd, &index);
+			if (line == NULL || index < chunk->svmDataset->indexBase)
+			{
+				errno = EIO;
+				chunk->ret = ML_ERR_FILE;
+				return;
+			}
+			if (index > chunk->maxIndex)
+				chunk->maxIndex = index;
+			chunk->indexFound = 1;
+
+			/* Values are only skipped while indexing */
+			if (!full)
+			{
+				while (!SvmLightDataSet_IsSeparator (line, lineEnd))
+					line++;
+				continue;
+			}
+
+			line = parseDouble (line, lineEnd, &value);
+			if (line == NULL || !SvmLightDataSet_IsSeparator (line, lineEnd))
+			{
+				errno = EIO;
+				chunk->ret = ML_ERR_FILE;
+				return;
+			}
+			if (value == 0)
+				continue;
+
+			if (chunk->nnz == chunk->valuesCapacity && SvmLightDataSet_GrowValues (chunk) != ML_OK)
+			{
+				chunk->ret = ML_ERR_OUTOFMEMORY;
+				return;
+			}
+			chunk->values[chunk->nnz] = value;
+			chunk->indexes[chunk->nnz] = (unsigned int) index;
+			chunk->nnz++;
+		}
+
+		if (full)
+			chunk->rowNnz[chunk->entriesCount] = chunk->nnz - first;
+		else
+			chunk->offsets[chunk->entriesCount] = chunk->offset + (pos - chunk->start);
+		chunk->recordLabels[chunk->entriesCount] = label;
+		chunk->entriesCount++;
+	}
+}
+
+static void SvmLightDataSet_MergeChunk (SvmLightChunk * chunk)
+{
+	SvmLightDataSet * svmDataset = chunk->svmDataset;
+	EntryData * entry;
+	unsigned long offset;
+	unsigned long i;
+
+	/* Copy the values of this chunk to their position on the dataset block, with columns starting at 0 */
+	memcpy (&chunk->data[chunk->nnzOffset], chunk->values, sizeof(double) * chunk->nnz);
+	for (i=0;i<chunk->nnz;i++)
+		chunk->dataIndexes[chunk->nnzOffset + i] = chunk->indexes[i] - svmDataset->indexBase;
+
+	/* Point each record to its values */
+	offset = chunk->nnzOffset;
+	for (i=0;i<chunk->entriesCount;i++)
+	{
+		entry = &chunk->entries[chunk->firstEntry + i];
+		entry->features = &chunk->data[offset];
+		entry->indexes = &chunk->dataIndexes[offset];
+		entry->nnz = chunk->rowNnz[i];
+		entry->type = DS_ET_DOUBLE;
+		entry->class = SvmLightDataSet_Class (svmDataset, chunk->recordLabels[i]);
+		offset += chunk->rowNnz[i];
+	}
+
+	/* The chunk buffers aren't needed anymore */
+	free (chunk->values);
+	free (chunk->indexes);
+	chunk->values = NULL;
+	chunk->indexes = NULL;
+}
+
+static void SvmLightDataSet_FreeChunks (SvmLightChunk * chunks, unsigned long chunksCount)
+{
+	unsigned long i;
+
+	for (i=0;i<chunksCount;i++)
+	{
+		free (chunks[i].recordLabels);
+		free (chunks[i].offsets);
+		free (chunks[i].rowNnz);
+		free (chunks[i].values);
+		free (chunks[i].indexes);
+		free (chunks[i].labels);
+	}
+	free (chunks);
+}
+
+static int SvmLightDataSet_ParseMapped (SvmLightDataSet * svmDataset, FileMap * map, SvmLightChunk ** chunks, unsigned long * chunksCount)
+{
+	const char * pos;
+	const char * end;
+	unsigned long i;
+	unsigned int count;
+	int ret;
+
+	/* Map the whole file to memory */
+	ret = FileMap_Open (map, svmDataset->file, FM_ACCESS_SEQUENTIAL);
+	if (ret != ML_OK)
+		return ret;
+	pos = map->data;
+	end = map->data + map->size;
+
+	/* Split the file in one chunk per processor, as long as each chunk is big enough to be worth a thread */
+	count = Parallel_CpuCount ();
+	if ((unsigned long) (end - pos) / MIN_CHUNK_SIZE < count)
+		count = (unsigned int) ((end - pos) / MIN_CHUNK_SIZE) + 1;
+	*chunks = (SvmLightChunk *) calloc (count, sizeof(SvmLightChunk));
+	if (*chunks == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	*chunksCount = count;
+
+	/* Chunks boundaries are moved forward to the next line break, so no record is split between two chunks */
+	for (i=0;i<count;i++)
+	{
+		(*chunks)[i].svmDataset = svmDataset;
+		(*chunks)[i].start = (i == 0) ? pos : (*chunks)[i-1].end;
+		(*chunks)[i].end = (i == count - 1) ? end : pos + ((end - pos) / count) * (i + 1);
+		if ((*chunks)[i].end < (*chunks)[i].start)
+			(*chunks)[i].end = (*chunks)[i].start;
+		if ((*chunks)[i].end < end)
+			(*chunks)[i].end = min (findChar ((*chunks)[i].end, end, '\n') + 1, end);
+		(*chunks)[i].offset = (off_t) ((*chunks)[i].start - map->data);
+		(*chunks)[i].size = (size_t) ((*chunks)[i].end - (*chunks)[i].start);
+	}
+
+	/* Parse all chunks in parallel */
+	Parallel_Run ((void (*)(void *)) SvmLightDataSet_ParseChunk, *chunks, sizeof(SvmLightChunk), count);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int SvmLightDataSet_ParseSegments (SvmLightDataSet * svmDataset, SvmLightChunk ** chunks, unsigned long * chunksCount)
+{
+	SvmLightChunk chunk;
+
+	/*	The file has no descriptor to be mapped (it's being decompressed by another thread), so it's parsed in segments
+		as they're read, while the following ones are being decompressed */
+	memset (&chunk, 0, sizeof(SvmLightChunk));
+	chunk.svmDataset = svmDataset;
+	return SegmentReader_Parse (svmDataset->file, &chunk, sizeof(SvmLightChunk), (void **) chunks, chunksCount, (void (*)(void *)) SvmLightDataSet_ParseChunk);
+}
+
+static int SvmLightDataSet_MapLabels (SvmLightDataSet * svmDataset)
+{
+	int * found;
+	unsigned long foundCount;
+	unsigned long i;
+
+	/*	Without a map, labels (or labels plus 1) are the classes, so the lowest one must give at least class 1. The highest
+		one gives the number of classes */
+	if (svmDataset->options.labels != BD_LB_MAP)
+	{
+		svmDataset->labelShift = (svmDataset->options.labels == BD_LB_ZERO) ? 1 : 0;
+		if (svmDataset->labels[0] + svmDataset->labelShift < 1)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		svmDataset->classesCount = (unsigned long) (svmDataset->labels[svmDataset->labelsCount - 1] + svmDataset->labelShift);
+		free (svmDataset->labels);
+		svmDataset->labels = NULL;
+		svmDataset->labelsCount = 0;
+		return ML_OK;
+	}
+
+	/*	With a given map, every label found must be on it, and the map replaces them. Otherwise the labels found are the map.
+		Either way the options point to it from now on */
+	if (svmDataset->options.labelMap != NULL)
+	{
+		found = svmDataset->labels;
+		foundCount = svmDataset->labelsCount;
+		svmDataset->labels = (int *) malloc (sizeof(int) * svmDataset->options.labelMapCount);
+		if (svmDataset->labels == NULL)
+		{
+			svmDataset->labels = found;
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		memcpy (svmDataset->labels, svmDataset->options.labelMap, sizeof(int) * svmDataset->options.labelMapCount);
+		svmDataset->labelsCount = svmDataset->options.labelMapCount;
+		for (i=0;i<foundCount;i++)
+		{
+			if (SvmLightDataSet_Class (svmDataset, found[i]) < 1)
+				break;
+		}
+		free (found);
+		if (i < foundCount)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+	}
+	svmDataset->classesCount = svmDataset->labelsCount;
+	svmDataset->options.labelMap = svmDataset->labels;
+	svmDataset->options.labelMapCount = svmDataset->labelsCount;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int SvmLightDataSet_Describe (SvmLightDataSet * svmDataset, SvmLightChunk * chunks, unsigned long chunksCount, unsigned long * nnz, size_t * maxLineLength)
+{
+	unsigned long entriesCount = 0;
+	unsigned long maxIndex = 0;
+	unsigned long labelsCapacity = 0;
+	unsigned long i;
+	unsigned long j;
+	unsigned char indexFound = 0;
+	int ret = ML_OK;
+
+	/* A prefix sum over the records (and values) of each chunk gives their position on the dataset */
+	*nnz = 0;
+	*maxLineLength = 0;
+	for (i=0;i<chunksCount && ret == ML_OK;i++)
+	{
+		ret = chunks[i].ret;
+		chunks[i].firstEntry = entriesCount;
+		chunks[i].nnzOffset = *nnz;
+		entriesCount += chunks[i].entriesCount;
+		*nnz += chunks[i].nnz;
+		maxIndex = max (maxIndex, chunks[i].maxIndex);
+		indexFound |= chunks[i].indexFound;
+		*maxLineLength = max (*maxLineLength, chunks[i].maxLineLength);
+
+		/* Merge the labels found on every chunk */
+		for (j=0;j<chunks[i].labelsCount && ret == ML_OK;j++)
+			ret = SvmLightDataSet_AddLabel (&svmDataset->labels, &svmDataset->labelsCount, &labelsCapacity, chunks[i].labels[j]);
+	}
+	if (ret != ML_OK)
+	{
+		/* errno was set on the thread that failed, so set it again here */
+		errno = (ret == ML_ERR_OUTOFMEMORY) ? ENOMEM : EIO;
+		return ret;
+	}
+
+	/*	Features come from the options, when given, and then no index may be past them. A dataset without records (or without
+		features) is considered an invalid file */
+	svmDataset->featsCount = svmDataset->options.featsCount;
+	if (svmDataset->featsCount == 0 && indexFound)
+		svmDataset->featsCount = maxIndex + 1 - svmDataset->indexBase;
+	if (entriesCount == 0 || svmDataset->featsCount == 0 || (indexFound && maxIndex - svmDataset->indexBase >= svmDataset->featsCount))
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	svmDataset->entriesCount = entriesCount;
+
+	/* Turn the labels found into classes, as told by the options */
+	return SvmLightDataSet_MapLabels (svmDataset);
+}
+
+static int SvmLightDataSet_NextEntry_Full (SvmLightDataSet * svmDataset, EntryData ** entry)
+{
+	/* Check that the dataset hasn't been fully read yet */
+	if (svmDataset->currentPos >= svmDataset->entriesCount)
+		return ML_WARN_EOF;
+
+	/* Return a pointer to the next record on the readOrder array */
+	*entry = &svmDataset->entries[svmDataset->readOrder[svmDataset->currentPos++]];
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int SvmLightDataSet_BuildFull (SvmLightDataSet * svmDataset, SvmLightChunk * chunks, unsigned long chunksCount, unsigned long nnz)
+{
+	double * data;
+	unsigned int * dataIndexes;
+	EntryData * auxEntries;
+	unsigned long i;
+
+	/* Malloc at least one value, so entries[0] always points to the blocks. Values follow the memory policy, like CSV records */
+	data = (double *) Memory_Alloc (sizeof(double) * max (nnz, 1), &svmDataset->options.memory);
+	dataIndexes = (unsigned int *) malloc (sizeof(unsigned int) * max (nnz, 1));
+	auxEntries = (EntryData *) malloc (sizeof(EntryData) * svmDataset->entriesCount);
+	svmDataset->readOrder = (off_t *) malloc (sizeof(off_t) * svmDataset->entriesCount);
+	if (data == NULL || dataIndexes == NULL || auxEntries == NULL || svmDataset->readOrder == NULL)
+	{
+		Memory_Free (data);
+		free (dataIndexes);
+		free (auxEntries);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Copy every chunk to its position, in parallel */
+	for (i=0;i<chunksCount;i++)
+	{
+		chunks[i].data = data;
+		chunks[i].dataIndexes = dataIndexes;
+		chunks[i].entries = auxEntries;
+	}
+	Parallel_Run ((void (*)(void *)) SvmLightDataSet_MergeChunk, chunks, sizeof(SvmLightChunk), (unsigned int) chunksCount);
+
+	/* For fully loaded datasets, the readOrder contains the indexes of the entries array */
+	for (i=0;i<svmDataset->entriesCount;i++)
+		svmDataset->readOrder[i] = i;
+	svmDataset->entries = auxEntries;
+	svmDataset->options.storage = BD_ST_SPARSE;
+
+	/* Update the "nextEntry" pointer to point to the function that handles "full" datasets */
+	svmDataset->nextEntry = (int(*)(DataSet *, EntryData **)) SvmLightDataSet_NextEntry_Full;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int SvmLightDataSet_BuildIncremental (SvmLightDataSet * svmDataset, SvmLightChunk * chunks, unsigned long chunksCount, size_t maxLineLength)
+{
+	unsigned long i;
+
+	/* The offsets of the records of every chunk, one after the other, are the readOrder */
+	svmDataset->readOrder = (off_t *) malloc (sizeof(off_t) * svmDataset->entriesCount);
+	if (svmDataset->readOrder == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	for (i=0;i<chunksCount;i++)
+		memcpy (&svmDataset->readOrder[chunks[i].firstEntry], chunks[i].offsets, sizeof(off_t) * chunks[i].entriesCount);
+
+	/* Records are read from the first one to the end of the last chunk */
+	return CSVDataSet_PrepareIncremental ((CSVDataSet *) svmDataset, maxLineLength, svmDataset->readOrder[0],
+		chunks[chunksCount - 1].offset + (off_t) chunks[chunksCount - 1].size);
+}
+
+static unsigned char SvmLightDataSet_IsLabelMap (const int * labels, unsigned long labelsCount)
+{
+	unsigned long i;
+
+	for (i=1;i<labelsCount;i++)
+	{
+		if (labels[i] <= labels[i - 1])
+			return 0;
+	}
+
+	return labelsCount > 0;
+}
+
+static int SvmLightDataSet_LoadHeader (SvmLightDataSet * svmDataset)
+{
+	/* svmlight files have no header. The features and classes are found while loading the data, so records can't be sampled */
+	if (svmDataset->options.sample > 0 && svmDataset->options.sample < 1)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* FULL datasets are always sparse, and sparse records can't be transformed */
+	if (svmDataset->readMode == BD_RM_FULL && FeatsTransform_IsSet (&svmDataset->options.transform))
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* The labels of a map must be in increasing order, without repeats */
+	if (svmDataset->options.labels > BD_LB_MAP || (svmDataset->options.labels == BD_LB_MAP && svmDataset->options.labelMap != NULL &&
+		!SvmLightDataSet_IsLabelMap (svmDataset->options.labelMap, svmDataset->options.labelMapCount)))
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Features are found while loading, and columns can't be selected, so none can be dropped either */
+	if (svmDataset->options.prune != BD_PR_NONE)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Indexes must fit on the columns of a sparse record */
+	if (svmDataset->options.indexBase > BD_IB_ZERO || svmDataset->options.featsCount > (unsigned long) UINT_MAX)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+	svmDataset->indexBase = (svmDataset->options.indexBase == BD_IB_ZERO) ? 0 : 1;
+
+	return ML_OK;
+}
+
+static int SvmLightDataSet_LoadData (SvmLightDataSet * svmDataset)
+{
+	FileMap map;
+	SvmLightChunk * chunks = NULL;
+	unsigned long chunksCount = 0;
+	unsigned long nnz;
+	size_t maxLineLength;
+	int ret;
+
+	/* Check the read mode, and the storage. Records are always parsed sparse */
+	if ((svmDataset->readMode != BD_RM_FULL && svmDataset->readMode != BD_RM_INCREMENTAL) ||
+		(svmDataset->options.storage != BD_ST_DOUBLE && svmDataset->options.storage != BD_ST_SPARSE))
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Parse (or index) the whole file, in chunks. Compressed files can't be mapped */
+	memset (&map, 0, sizeof(FileMap));
+	if (svmDataset->gzip == NULL)
+		ret = SvmLightDataSet_ParseMapped (svmDataset, &map, &chunks, &chunksCount);
+	else
+		ret = SvmLightDataSet_ParseSegments (svmDataset, &chunks, &chunksCount);
+
+	/* Find out the features and classes, and put the records of every chunk together */
+	if (ret == ML_OK)
+		ret = SvmLightDataSet_Describe (svmDataset, chunks, chunksCount, &nnz, &maxLineLength);
+	if (ret == ML_OK)
+	{
+		if (svmDataset->readMode == BD_RM_FULL)
+			ret = SvmLightDataSet_BuildFull (svmDataset, chunks, chunksCount, nnz);
+		else
+			ret = SvmLightDataSet_BuildIncremental (svmDataset, chunks, chunksCount, maxLineLength);
+	}
+
+	FileMap_Close (&map);
+	SvmLightDataSet_FreeChunks (chunks, chunksCount);
+
+	return ret;
+}
+
+static int SvmLightDataSet_ParseLine (SvmLightDataSet * svmDataset, const char * line, const char * lineEnd, EntryData * entry)
+{
+	unsigned long featsCount;
+	unsigned long index;
+	double value;
+	int label;
+
+	featsCount = svmDataset->featsCount;
+
+	/* Callers that gave room for indexes get the record sparse, others get it expanded */
+	entry->nnz = 0;
+	if (entry->indexes == NULL)
+		memset (entry->features, 0, sizeof(double) * featsCount);
+
+	/* Read the label. Labels not found while loading mean the file changed */
+	line = SvmLightDataSet_ParseLabel (SvmLightDataSet_SkipBlanks (line, lineEnd), lineEnd, &label);
+	if (line == NULL || (entry->class = SvmLightDataSet_Class (svmDataset, label)) < 1)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Read the "index:value" pairs */
+	for (line=SvmLightDataSet_NextPair (line, lineEnd);line<lineEnd;line=SvmLightDataSet_NextPair (line, lineEnd))
+	{
+		line = SvmLightDataSet_ParseIndex (line, lineEnd, &index);
+		if (line == NULL || index < svmDataset->indexBase || index - svmDataset->indexBase >= featsCount)
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+		index -= svmDataset->indexBase;
+
+		line = parseDouble (line, lineEnd, &value);
+		if (line == NULL || !SvmLightDataSet_IsSeparator (line, lineEnd))
+		{
+			errno = EIO;
+			return ML_ERR_FILE;
+		}
+
+		if (entry->indexes == NULL)
+			entry->features[index] = value;
+		else if (value != 0)
+		{
+			/* Only repeated indexes could make a record have more values than features */
+			if (entry->nnz == featsCount)
+			{
+				errno = EIO;
+				return ML_ERR_FILE;
+			}
+			entry->features[entry->nnz] = value;
+			entry->indexes[entry->nnz] = (unsigned int) index;
+			entry->nnz++;
+		}
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void SvmLightDataSet_Free (SvmLightDataSet * svmDataset)
+{
+	/* Free the labels */
+	free (svmDataset->labels);
+	svmDataset->labels = NULL;
+
+	/* Call the "superclass" free function */
+	super.free((DataSet *) svmDataset);
+}
+
+/************************
+* "Protected" Functions	*
+************************/
+void SvmLightDataSet_Init (SvmLightDataSet * svmDataset)
+{
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, SvmLightDataSet_InitSuper);
+
+	/* Call the initializer for the "superclass" */
+	CSVDataSet_Init((CSVDataSet *) svmDataset);
+
+	/* Initialize the function pointers. */
+	svmDataset->loadHeader = (int (*) (struct CSVDataSet *)) SvmLightDataSet_LoadHeader;
+	svmDataset->loadData = (int (*) (struct CSVDataSet *)) SvmLightDataSet_LoadData;
+	svmDataset->parseLine = (int (*) (struct CSVDataSet *, const char *, const char *, EntryData *)) SvmLightDataSet_ParseLine;
+
+	/* Overrides the default free method, to release the labels */
+	svmDataset->free = (void(*)(DataSet *)) SvmLightDataSet_Free;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+SvmLightDataSet * SvmLightDataSet_New (BatchReadMode readMode, char * srcPath)
+{
+	return SvmLightDataSet_NewWithOptions (readMode, srcPath, NULL);
+}
+
+SvmLightDataSet * SvmLightDataSet_NewWithOptions (BatchReadMode readMode, char * srcPath, BatchOptions * options)
+{
+	SvmLightDataSet * svmDataset;
+
+	/* malloc memory to store the structure */
+	svmDataset = (SvmLightDataSet *) malloc (sizeof(SvmLightDataSet));
+	if (svmDataset == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Zero memory */
+	memset (svmDataset, 0, sizeof(SvmLightDataSet));
+
+	/* Initialize the structure data and pointers */
+	SvmLightDataSet_Init(svmDataset);
+
+	/* Initialize instance data */
+	svmDataset->hasLabels = 0;				/* svmlight files have no header */
+	svmDataset->delimiter = ' ';			/* Pairs are separated by blanks */
+	svmDataset->readMode = readMode;
+	if (options != NULL)
+		svmDataset->options = *options;
+
+	/* The index only holds the offsets. The features and labels would still need a full pass */
+	svmDataset->options.index = BD_IX_NONE;
+	/* Shared blocks don't hold the labels, nor the first index, needed to read the records */
+	svmDataset->options.share = BD_SH_NONE;
+	/* Records are always sparse */
+	svmDataset->options.layout = BD_LY_ROWS;
+
+	/* Load data from srcPath */
+	if (svmDataset->load((BatchDataSet *) svmDataset, srcPath) != ML_OK)
+	{
+		svmDataset->free((DataSet *) svmDataset);
+		return NULL;
+	}
+
+	/* Return the new instance */
+	return svmDataset;
+}
+
+const int * SvmLightDataSet_GetLabels (SvmLightDataSet * svmDataset, unsigned long * labelsCount)
+{
+	*labelsCount = svmDataset->labelsCount;
+	return svmDataset->labels;
+}
@@ -1,16 +1,23 @@
 #define EXTEND_FEATINDUCER
 #include <stdio.h>		/* For FILE, printf etc */
 #include <stdlib.h>		/* For malloc/free */
+#include <pthread.h>		/* For pthread_once */
 
 #include "MacLearn/Inducer/BooleanInducer.h"
 
 /* Create a local var to save references to "super class" functions */
 static FeatInducer super;
-static unsigned char superInitialized = 0;
+static pthread_once_t superOnce = PTHREAD_ONCE_INIT;
 
 /************************
 * "Private" Functions	*
 ************************/
+static void BooleanInducer_InitSuper (void)
+{
+	/* Init the local "super" to get pointers to "super" functions */
+	FeatInducer_Init(&super);
+}
+
 /* Utilitary function to skip to the next line in a file */
 static void skipLine (FILE * file)
 {
@@ -358,12 +365,8 @@ static int BooleanInducer_WriteData (BooleanInducer * boolInducer, FILE * out)
 ************************/
 void BooleanInducer_Init (BooleanInducer * boolInducer)
 {
-	/* If the local "super" isn't initialized, init it */
-	if (!superInitialized)
-	{
-		FeatInducer_Init(&super);
-		superInitialized = 1;
-	}
+	/* Init the local "super" only once, even when several threads create objects at the same time */
+	pthread_once (&superOnce, BooleanInducer_InitSuper);
 
 	/* Call the initializer for the "superclass" */
 	FeatInducer_Init((FeatInducer *) boolInducer);
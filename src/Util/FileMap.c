@@ -0,0 +1,81 @@
+#include <stdlib.h>				/* For malloc/free */
+#include <string.h>				/* For memset */
+#include <sys/types.h>
+#include <sys/stat.h>			/* For fstat */
+#ifndef WIN32
+#include <sys/mman.h>			/* For mmap */
+#endif
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/FileMap.h"
+
+int FileMap_Open (FileMap * map, FILE * file, FileMapAccess access)
+{
+	struct stat fileInfo;
+
+	/* Zero the map, so it's always safe to call FileMap_Close */
+	memset (map, 0, sizeof(FileMap));
+
+	/* Find out the size of the file */
+	if (fstat (fileno(file), &fileInfo) != 0)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	map->size = (size_t) fileInfo.st_size;
+
+	/* Nothing to map on an empty file */
+	if (map->size == 0)
+		return ML_OK;
+
+#ifndef WIN32
+	/* Map the file and let the kernel know how it'll be read, so it can tune the read ahead */
+	map->data = (const char *) mmap (NULL, map->size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	if (map->data != MAP_FAILED)
+	{
+		if (access == FM_ACCESS_SEQUENTIAL)
+			madvise ((void *) map->data, map->size, MADV_SEQUENTIAL);
+		else if (access == FM_ACCESS_RANDOM)
+			madvise ((void *) map->data, map->size, MADV_RANDOM);
+		else if (access == FM_ACCESS_WILLNEED)
+			madvise ((void *) map->data, map->size, MADV_WILLNEED);
+		map->mapped = 1;
+		return ML_OK;
+	}
+	map->data = NULL;
+#endif
+
+	/* No mmap available (or it failed). Read the whole file to memory */
+	map->data = (const char *) malloc (map->size);
+	if (map->data == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	rewind (file);
+	if (fread ((void *) map->data, 1, map->size, file) != map->size)
+	{
+		FileMap_Close (map);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+void FileMap_Close (FileMap * map)
+{
+	if (map->data != NULL)
+	{
+#ifndef WIN32
+		if (map->mapped)
+			munmap ((void *) map->data, map->size);
+		else
+#endif
+			free ((void *) map->data);
+	}
+
+	memset (map, 0, sizeof(FileMap));
+}
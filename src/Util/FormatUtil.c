@@ -0,0 +1,388 @@
+#include <string.h>				/* For memcpy and memmove */
+#include <stdint.h>				/* For uint64_t */
+
+#include "MacLearn/Util/FormatUtil.h"
+
+/* Parts of an IEEE 754 double */
+#define DP_SIGNIFICAND_SIZE		52
+#define DP_EXPONENT_BIAS		(0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT			(-DP_EXPONENT_BIAS)
+#define DP_EXPONENT_MASK		0x7FF0000000000000ULL
+#define DP_SIGNIFICAND_MASK		0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT			0x0010000000000000ULL
+
+/* Values written in plain notation have their decimal exponent in this range. Others use exponent notation */
+#define PLAIN_MIN_EXPONENT		-5
+#define PLAIN_MAX_EXPONENT		21
+
+/* A floating point number with a 64 bits significand: f * 2^e */
+typedef struct
+{
+	uint64_t f;
+	int e;
+}DiyFp;
+
+/*	Normalized powers of 10 (10^-348, 10^-340, ..., 10^340), with their binary exponents. Rounded to the closest 64 bits
+	significand */
+static const uint64_t cachedPowersF[] =
+{
+	0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL, 0x8B16FB203055AC76ULL,
+	0xCF42894A5DCE35EAULL, 0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL,
+	0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL, 0xBE5691EF416BD60CULL,
+	0x8DD01FAD907FFC3CULL, 0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+	0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL, 0x823C12795DB6CE57ULL,
+	0xC21094364DFB5637ULL, 0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL,
+	0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL, 0xB23867FB2A35B28EULL,
+	0x84C8D4DFD2C63F3BULL, 0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+	0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL, 0xF3E2F893DEC3F126ULL,
+	0xB5B5ADA8AAFF80B8ULL, 0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL,
+	0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL, 0xA6DFBD9FB8E5B88FULL,
+	0xF8A95FCF88747D94ULL, 0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+	0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL, 0xE45C10C42A2B3B06ULL,
+	0xAA242499697392D3ULL, 0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL,
+	0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL, 0x9C40000000000000ULL,
+	0xE8D4A51000000000ULL, 0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+	0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL, 0xD5D238A4ABE98068ULL,
+	0x9F4F2726179A2245ULL, 0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL,
+	0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL, 0x924D692CA61BE758ULL,
+	0xDA01EE641A708DEAULL, 0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+	0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL, 0xC83553C5C8965D3DULL,
+	0x952AB45CFA97A0B3ULL, 0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL,
+	0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL, 0x88FCF317F22241E2ULL,
+	0xCC20CE9BD35C78A5ULL, 0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+	0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL, 0xBB764C4CA7A44410ULL,
+	0x8BAB8EEFB6409C1AULL, 0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL,
+	0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL, 0x80444B5E7AA7CF85ULL,
+	0xBF21E44003ACDD2DULL, 0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+	0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL, 0xAF87023B9BF0EE6BULL,
+};
+static const short cachedPowersE[] =
+{
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+	-901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+	-582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+	-263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+	56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+	694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+	1013, 1039, 1066,
+};
+
+static const uint64_t pow10[] =
+{
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+	10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+	10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/************************
+* "Private" Functions	*
+************************/
+static __inline DiyFp DiyFp_Multiply (DiyFp x, DiyFp y)
+{
+	DiyFp result;
+	uint64_t a, b, c, d;
+	uint64_t ac, bc, ad, bd;
+	uint64_t tmp;
+
+	/* The high 64 bits of the 128 bits product, rounded */
+	a = x.f >> 32;
+	b = x.f & 0xFFFFFFFFULL;
+	c = y.f >> 32;
+	d = y.f & 0xFFFFFFFFULL;
+	ac = a * c;
+	bc = b * c;
+	ad = a * d;
+	bd = b * d;
+	tmp = (bd >> 32) + (ad & 0xFFFFFFFFULL) + (bc & 0xFFFFFFFFULL);
+	tmp += 1ULL << 31;
+
+	result.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+	result.e = x.e + y.e + 64;
+	return result;
+}
+
+static __inline DiyFp DiyFp_Normalize (DiyFp x)
+{
+	/* Shift the significand until its highest bit is set */
+	while (!(x.f & (1ULL << 63)))
+	{
+		x.f <<= 1;
+		x.e--;
+	}
+
+	return x;
+}
+
+static void FormatUtil_Boundaries (DiyFp v, DiyFp * minus, DiyFp * plus)
+{
+	/* The values halfway to the previous and next doubles. Every number between them reads back as "v" */
+	plus->f = (v.f << 1) + 1;
+	plus->e = v.e - 1;
+	*plus = DiyFp_Normalize (*plus);
+
+	/* The previous double is closer on powers of 2, as the exponent below them is smaller */
+	if (v.f == DP_HIDDEN_BIT)
+	{
+		minus->f = (v.f << 2) - 1;
+		minus->e = v.e - 2;
+	}
+	else
+	{
+		minus->f = (v.f << 1) - 1;
+		minus->e = v.e - 1;
+	}
+	minus->f <<= minus->e - plus->e;
+	minus->e = plus->e;
+}
+
+static DiyFp FormatUtil_CachedPower (int e, int * K)
+{
+	DiyFp power;
+	double dk;
+	int k;
+	unsigned int index;
+
+	/* Find the power of 10 (10^-K) that brings the binary exponent to [-60, -32]. 0.30102999566398114 is log10(2) */
+	dk = (-61 - e) * 0.30102999566398114 + 347;
+	k = (int) dk;
+	if (dk - k > 0.0)
+		k++;
+
+	index = (unsigned int) ((k >> 3) + 1);
+	*K = -(-348 + (int) (index << 3));
+
+	power.f = cachedPowersF[index];
+	power.e = cachedPowersE[index];
+	return power;
+}
+
+static __inline void FormatUtil_Round (char * buffer, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance)
+{
+	/* Move the last digit down while the result gets closer to the exact value, without leaving the safe interval */
+	while (rest < distance && delta - rest >= tenKappa && (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
+	{
+		buffer[length - 1]--;
+		rest += tenKappa;
+	}
+}
+
+static __inline int FormatUtil_CountDigits (uint32_t n)
+{
+	int digits;
+
+	for (digits=1;digits < 10 && n >= pow10[digits];digits++);
+	return digits;
+}
+
+static void FormatUtil_DigitGen (DiyFp W, DiyFp Mp, uint64_t delta, char * buffer, int * length, int * K)
+{
+	DiyFp one;
+	uint64_t distance;
+	uint64_t p2;
+	uint64_t rest;
+	uint32_t p1;
+	int kappa;
+	char d;
+
+	/* Split the upper bound in its integer (p1) and fractional (p2) parts, with a scale of 2^-one.e */
+	one.f = 1ULL << -Mp.e;
+	one.e = Mp.e;
+	distance = Mp.f - W.f;
+	p1 = (uint32_t) (Mp.f >> -one.e);
+	p2 = Mp.f & (one.f - 1);
+	kappa = FormatUtil_CountDigits (p1);
+	*length = 0;
+
+	/* Write the digits of the integer part, stopping as soon as the rest is inside the safe interval */
+	while (kappa > 0)
+	{
+		d = (char) (p1 / pow10[kappa - 1]);
+		p1 %= (uint32_t) pow10[kappa - 1];
+		if (d || *length)
+			buffer[(*length)++] = (char) ('0' + d);
+		kappa--;
+
+		rest = ((uint64_t) p1 << -one.e) + p2;
+		if (rest <= delta)
+		{
+			*K += kappa;
+			FormatUtil_Round (buffer, *length, delta, rest, pow10[kappa] << -one.e, distance);
+			return;
+		}
+	}
+
+	/* And then the ones of the fractional part */
+	for (;;)
+	{
+		p2 *= 10;
+		delta *= 10;
+		d = (char) (p2 >> -one.e);
+		if (d || *length)
+			buffer[(*length)++] = (char) ('0' + d);
+		p2 &= one.f - 1;
+		kappa--;
+		if (p2 < delta)
+		{
+			*K += kappa;
+			FormatUtil_Round (buffer, *length, delta, p2, one.f, distance * (-kappa < 20 ? pow10[-kappa] : 0));
+			return;
+		}
+	}
+}
+
+static void FormatUtil_Grisu2 (uint64_t bits, char * buffer, int * length, int * K)
+{
+	DiyFp v;
+	DiyFp minus;
+	DiyFp plus;
+	DiyFp power;
+	DiyFp W;
+	DiyFp Wp;
+	DiyFp Wm;
+	int biasedExponent;
+
+	/* Decode the double. Subnormals don't have the hidden bit */
+	biasedExponent = (int) ((bits & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+	v.f = bits & DP_SIGNIFICAND_MASK;
+	if (biasedExponent != 0)
+	{
+		v.f += DP_HIDDEN_BIT;
+		v.e = biasedExponent - DP_EXPONENT_BIAS;
+	}
+	else
+		v.e = DP_MIN_EXPONENT + 1;
+
+	/* Scale the value and its boundaries by the same power of 10, and generate the digits of the shortest number between them */
+	FormatUtil_Boundaries (v, &minus, &plus);
+	power = FormatUtil_CachedPower (plus.e, K);
+	W = DiyFp_Multiply (DiyFp_Normalize (v), power);
+	Wp = DiyFp_Multiply (plus, power);
+	Wm = DiyFp_Multiply (minus, power);
+
+	/* The products may be off by one unit, so keep away from the boundaries */
+	Wm.f++;
+	Wp.f--;
+	FormatUtil_DigitGen (W, Wp, Wp.f - Wm.f, buffer, length, K);
+}
+
+static char * FormatUtil_Exponent (char * pos, int exponent)
+{
+	*pos++ = 'e';
+	if (exponent < 0)
+	{
+		*pos++ = '-';
+		exponent = -exponent;
+	}
+
+	if (exponent >= 100)
+	{
+		*pos++ = (char) ('0' + exponent / 100);
+		exponent %= 100;
+		*pos++ = (char) ('0' + exponent / 10);
+	}
+	else if (exponent >= 10)
+		*pos++ = (char) ('0' + exponent / 10);
+	*pos++ = (char) ('0' + exponent % 10);
+
+	return pos;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+char * formatDouble (char * pos, double value)
+{
+	uint64_t bits;
+	char digits[20];
+	int length;
+	int K;
+	int exponent;
+
+	memcpy (&bits, &value, sizeof(double));
+
+	/* Write the sign, and go on with the absolute value */
+	if (bits >> 63)
+	{
+		*pos++ = '-';
+		bits &= ~(1ULL << 63);
+		value = -value;
+	}
+
+	/* Special values */
+	if ((bits & DP_EXPONENT_MASK) == DP_EXPONENT_MASK)
+	{
+		memcpy (pos, (bits & DP_SIGNIFICAND_MASK) ? "nan" : "inf", 3);
+		return pos + 3;
+	}
+	if (bits == 0)
+	{
+		*pos++ = '0';
+		return pos;
+	}
+
+	/* Small integers (like counts or pixel values) are very common, and don't need Grisu */
+	if (value < 1e15 && value == (double) (long) value)
+		return formatLong (pos, (long) value);
+
+	/* The value is digits * 10^K. "exponent" is the one of the first digit */
+	FormatUtil_Grisu2 (bits, digits, &length, &K);
+	exponent = length + K - 1;
+
+	if (exponent >= 0 && exponent < PLAIN_MAX_EXPONENT)
+	{
+		/* 1234e-2 -> 12.34, 1234e2 -> 123400 */
+		if (K >= 0)
+		{
+			memcpy (pos, digits, length);
+			memset (pos + length, '0', K);
+			return pos + length + K;
+		}
+		memcpy (pos, digits, exponent + 1);
+		pos[exponent + 1] = '.';
+		memcpy (pos + exponent + 2, digits + exponent + 1, length - exponent - 1);
+		return pos + length + 1;
+	}
+	else if (exponent < 0 && exponent >= PLAIN_MIN_EXPONENT)
+	{
+		/* 1234e-6 -> 0.001234 */
+		pos[0] = '0';
+		pos[1] = '.';
+		memset (pos + 2, '0', -exponent - 1);
+		memcpy (pos + 1 - exponent, digits, length);
+		return pos + 1 - exponent + length;
+	}
+
+	/* 1234e30 -> 1.234e33 */
+	*pos++ = digits[0];
+	if (length > 1)
+	{
+		*pos++ = '.';
+		memcpy (pos, digits + 1, length - 1);
+		pos += length - 1;
+	}
+	return FormatUtil_Exponent (pos, exponent);
+}
+
+char * formatLong (char * pos, long value)
+{
+	char digits[FORMAT_LONG_MAX];
+	unsigned long absolute;
+	int length;
+
+	/* Digits are generated backwards */
+	absolute = (value < 0) ? 0UL - (unsigned long) value : (unsigned long) value;
+	length = 0;
+	do
+	{
+		digits[length++] = (char) ('0' + absolute % 10);
+		absolute /= 10;
+	}while (absolute != 0);
+
+	if (value < 0)
+		*pos++ = '-';
+	while (length > 0)
+		*pos++ = digits[--length];
+
+	return pos;
+}
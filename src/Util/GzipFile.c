@@ -0,0 +1,759 @@
+#define _GNU_SOURCE				/* For fopencookie */
+#include <stdlib.h>				/* For malloc/free */
+#include <string.h>				/* For memcpy */
+#include <pthread.h>
+#include <zlib.h>
+#ifndef WIN32
+#include <unistd.h>				/* For pread */
+#endif
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/GzipFile.h"
+
+/* Size of each block of decompressed data handed from the inflating thread to the reader */
+#define GZIP_BLOCK_SIZE			(1 << 20)
+/* Number of blocks the thread may inflate ahead of the reader */
+#define GZIP_BLOCKS_COUNT		4
+/* Size of each read from the compressed file */
+#define GZIP_INPUT_SIZE			(1 << 16)
+/* Minimum distance (in decompressed bytes) between two checkpoints of the seek index */
+#define GZIP_SPAN				(1 << 20)
+/* Size of the deflate history. A checkpoint inside a gzip member must keep this many bytes to restart inflating from it */
+#define GZIP_WINDOW				32768
+/* Number of decompressed spans kept by the random reads */
+#define GZIP_CACHED_SPANS		4
+/* Size of the stdio buffer of the stream */
+#define GZIP_STREAM_BUFFER		(1 << 16)
+
+/* A position of the file where inflating may be restarted */
+typedef struct
+{
+	uint64_t out;					/* Position on the decompressed contents */
+	uint64_t in;					/* Position on the compressed file of the first byte that wasn't fully used */
+	int bits;						/* Number of bits of the byte at in - 1 that weren't used yet (0 to 7) */
+	unsigned char * window;			/* Last GZIP_WINDOW decompressed bytes. NULL on the begining of a gzip member */
+}GzipCheckpoint;
+
+/* State of an inflate run, from a checkpoint onwards */
+typedef struct
+{
+	z_stream strm;
+	unsigned char input[GZIP_INPUT_SIZE];	/* Compressed bytes not yet inflated */
+	uint64_t inPos;					/* Position on the compressed file of the next byte to be read into "input" */
+	uint64_t out;					/* Position on the decompressed contents of the next byte to be inflated */
+	unsigned char raw;				/* Started inside a gzip member, so zlib won't read its trailer */
+	unsigned char end;				/* The end of the last gzip member was reached */
+}GzipInflater;
+
+struct GzipFile
+{
+	FILE * file;					/* Compressed file */
+	FILE * stream;					/* Decompressed contents */
+	int fd;							/* Descriptor of the compressed file. Read with pread, so any thread can use it */
+	/* Seek index */
+	pthread_mutex_t lock;			/* Protects the index and the state of the inflating thread */
+	GzipCheckpoint * checkpoints;	/* Checkpoints, in increasing position */
+	size_t checkpointsCount;
+	size_t checkpointsCapacity;
+	uint64_t size;					/* Size of the decompressed contents. Only valid when "complete" is set */
+	unsigned char complete;			/* Determines if the whole file was inflated once, so the index covers all of it */
+	/* Stream reading */
+	pthread_t thread;				/* Thread that inflates the blocks read through the stream */
+	pthread_cond_t filled;			/* Signaled by the thread when a block is ready */
+	pthread_cond_t consumed;		/* Signaled by the reader when a block was fully read, or when the thread must stop */
+	GzipInflater * inflater;		/* Inflate state of the thread */
+	GzipCheckpoint start;			/* Checkpoint where the thread starts inflating */
+	unsigned char * blocks[GZIP_BLOCKS_COUNT];	/* Ring of decompressed blocks */
+	size_t blockSizes[GZIP_BLOCKS_COUNT];
+	unsigned long produced;			/* Number of blocks inflated by the thread */
+	unsigned long used;				/* Number of blocks fully read by the reader */
+	size_t blockOffset;				/* Position of the reader on the current block */
+	uint64_t position;				/* Position of the reader on the decompressed contents */
+	int status;						/* Result of the thread. Any error is reported to the reader after the blocks already inflated */
+	unsigned char running;			/* Determines if the thread was started */
+	unsigned char done;				/* The thread won't inflate more blocks */
+	unsigned char stop;				/* Asks the thread to stop */
+	/* Random reads */
+	pthread_mutex_t cacheLock;		/* Serializes the random reads */
+	GzipInflater * cacheInflater;	/* Inflate state of the random reads */
+	unsigned char * cache[GZIP_CACHED_SPANS];	/* Decompressed spans */
+	size_t cacheCapacity[GZIP_CACHED_SPANS];	/* Size of each cache buffer */
+	size_t cacheSpan[GZIP_CACHED_SPANS];		/* Index of the checkpoint that starts each cached span, plus 1 (0 for empty) */
+	unsigned int cacheNext;			/* Next cache buffer to be replaced */
+};
+
+/************************
+* "Private" Functions	*
+************************/
+static int GzipFile_IsMember (GzipFile * gzip, uint64_t offset)
+{
+	unsigned char magic[2];
+
+	/* Every gzip member starts with 0x1f 0x8b */
+	return pread (gzip->fd, magic, 2, (off_t) offset) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+static int GzipFile_AddCheckpoint (GzipFile * gzip, uint64_t out, uint64_t in, int bits, const unsigned char * history)
+{
+	GzipCheckpoint * auxCheckpoints;
+	GzipCheckpoint * checkpoint;
+	int ret = ML_OK;
+
+	pthread_mutex_lock (&gzip->lock);
+
+	/*	Only positions past the end of the index are saved. Restarted runs go over positions already indexed, and once the
+		index is complete it's read without the lock, so it must not change anymore */
+	if (gzip->complete || (gzip->checkpointsCount > 0 && out < gzip->checkpoints[gzip->checkpointsCount - 1].out + GZIP_SPAN))
+	{
+		pthread_mutex_unlock (&gzip->lock);
+		return ML_OK;
+	}
+
+	if (gzip->checkpointsCount == gzip->checkpointsCapacity)
+	{
+		auxCheckpoints = (GzipCheckpoint *) realloc (gzip->checkpoints, sizeof(GzipCheckpoint) * max (gzip->checkpointsCapacity * 2, 64));
+		if (auxCheckpoints == NULL)
+		{
+			pthread_mutex_unlock (&gzip->lock);
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		gzip->checkpoints = auxCheckpoints;
+		gzip->checkpointsCapacity = max (gzip->checkpointsCapacity * 2, 64);
+	}
+
+	checkpoint = &gzip->checkpoints[gzip->checkpointsCount];
+	checkpoint->out = out;
+	checkpoint->in = in;
+	checkpoint->bits = bits;
+	checkpoint->window = NULL;
+	if (history != NULL)
+	{
+		checkpoint->window = (unsigned char *) malloc (GZIP_WINDOW);
+		if (checkpoint->window == NULL)
+		{
+			errno = ENOMEM;
+			ret = ML_ERR_OUTOFMEMORY;
+		}
+		else
+			memcpy (checkpoint->window, history, GZIP_WINDOW);
+	}
+	if (ret == ML_OK)
+		gzip->checkpointsCount++;
+
+	pthread_mutex_unlock (&gzip->lock);
+
+	return ret;
+}
+
+static int GzipInflater_Start (GzipFile * gzip, GzipInflater * inflater, GzipCheckpoint * checkpoint)
+{
+	unsigned char byte;
+	int ret;
+
+	memset (&inflater->strm, 0, sizeof(z_stream));
+	inflater->out = checkpoint->out;
+	inflater->end = 0;
+
+	/* Checkpoints on the begining of a member read the gzip header */
+	if (checkpoint->window == NULL)
+	{
+		inflater->raw = 0;
+		inflater->inPos = checkpoint->in;
+		ret = inflateInit2 (&inflater->strm, 15 + 16);
+	}
+	else
+	{
+		/*	Checkpoints inside a member restart a raw deflate stream, with the bits of the last byte that weren't
+			used yet and the history needed by the next blocks */
+		inflater->raw = 1;
+		inflater->inPos = checkpoint->in;
+		ret = inflateInit2 (&inflater->strm, -15);
+		if (ret == Z_OK && checkpoint->bits > 0)
+		{
+			if (pread (gzip->fd, &byte, 1, (off_t) (checkpoint->in - 1)) != 1)
+				ret = Z_ERRNO;
+			else
+				ret = inflatePrime (&inflater->strm, checkpoint->bits, byte >> (8 - checkpoint->bits));
+		}
+		if (ret == Z_OK)
+			ret = inflateSetDictionary (&inflater->strm, checkpoint->window, GZIP_WINDOW);
+	}
+
+	if (ret != Z_OK)
+	{
+		inflateEnd (&inflater->strm);
+		errno = (ret == Z_MEM_ERROR) ? ENOMEM : EIO;
+		return (ret == Z_MEM_ERROR) ? ML_ERR_OUTOFMEMORY : ML_ERR_FILE;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int GzipInflater_NextMember (GzipFile * gzip, GzipInflater * inflater, unsigned char index)
+{
+	uint64_t next;
+
+	/* zlib reads the trailer (CRC and size) of the members it read the header of. The others have it skipped here */
+	next = inflater->inPos - inflater->strm.avail_in;
+	if (inflater->raw)
+		next += 8;
+
+	/* Anything but another member after the end of one (i.e. zero padding) is ignored, like gzip does */
+	if (!GzipFile_IsMember (gzip, next))
+	{
+		inflater->end = 1;
+		return ML_OK;
+	}
+
+	if (inflateReset2 (&inflater->strm, 15 + 16) != Z_OK)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	inflater->raw = 0;
+	inflater->inPos = next;
+	inflater->strm.avail_in = 0;
+
+	/* The begining of a member is a checkpoint that doesn't need any history */
+	if (index)
+		return GzipFile_AddCheckpoint (gzip, inflater->out, next, 0, NULL);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static int GzipInflater_Read (GzipFile * gzip, GzipInflater * inflater, unsigned char * dst, size_t size, size_t * produced, unsigned char index)
+{
+	ssize_t bytesRead;
+	uint64_t first;
+	int ret;
+
+	first = inflater->out;
+	inflater->strm.next_out = dst;
+	inflater->strm.avail_out = (uInt) size;
+	while (inflater->strm.avail_out > 0 && !inflater->end)
+	{
+		/* Get more compressed bytes. A file that ends in the middle of a member is truncated */
+		if (inflater->strm.avail_in == 0)
+		{
+			bytesRead = pread (gzip->fd, inflater->input, GZIP_INPUT_SIZE, (off_t) inflater->inPos);
+			if (bytesRead <= 0)
+			{
+				*produced = (size_t) (inflater->out - first);
+				errno = EIO;
+				return ML_ERR_FILE;
+			}
+			inflater->inPos += (uint64_t) bytesRead;
+			inflater->strm.next_in = inflater->input;
+			inflater->strm.avail_in = (uInt) bytesRead;
+		}
+
+		/* When building the index, stop at the end of each deflate block, where a checkpoint may be saved */
+		ret = inflate (&inflater->strm, index ? Z_BLOCK : Z_NO_FLUSH);
+		inflater->out = first + (size - inflater->strm.avail_out);
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+		{
+			*produced = (size_t) (inflater->out - first);
+			errno = (ret == Z_MEM_ERROR) ? ENOMEM : EIO;
+			return (ret == Z_MEM_ERROR) ? ML_ERR_OUTOFMEMORY : ML_ERR_FILE;
+		}
+
+		if (ret == Z_STREAM_END)
+			ret = GzipInflater_NextMember (gzip, inflater, index);
+		else if (index && (inflater->strm.data_type & 128) && !(inflater->strm.data_type & 64) && inflater->out - first >= GZIP_WINDOW)
+		{
+			/* End of a block that isn't the last one, with enough history on this buffer */
+			ret = GzipFile_AddCheckpoint (gzip, inflater->out, inflater->inPos - inflater->strm.avail_in,
+					inflater->strm.data_type & 7, &dst[inflater->out - first - GZIP_WINDOW]);
+		}
+		else
+			ret = ML_OK;
+
+		if (ret != ML_OK)
+		{
+			*produced = (size_t) (inflater->out - first);
+			return ret;
+		}
+	}
+
+	*produced = (size_t) (inflater->out - first);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static void * GzipFile_ThreadMain (GzipFile * gzip)
+{
+	unsigned long block;
+	size_t produced;
+	int ret;
+
+	ret = GzipInflater_Start (gzip, gzip->inflater, &gzip->start);
+
+	pthread_mutex_lock (&gzip->lock);
+	while (ret == ML_OK && !gzip->inflater->end)
+	{
+		/* Wait for a free block */
+		while (gzip->produced - gzip->used == GZIP_BLOCKS_COUNT && !gzip->stop)
+			pthread_cond_wait (&gzip->consumed, &gzip->lock);
+		if (gzip->stop)
+			break;
+		block = gzip->produced % GZIP_BLOCKS_COUNT;
+		pthread_mutex_unlock (&gzip->lock);
+
+		/* Inflate the next block, indexing the file along the way */
+		ret = GzipInflater_Read (gzip, gzip->inflater, gzip->blocks[block], GZIP_BLOCK_SIZE, &produced, 1);
+
+		pthread_mutex_lock (&gzip->lock);
+		gzip->blockSizes[block] = produced;
+		if (produced > 0)
+			gzip->produced++;
+		pthread_cond_signal (&gzip->filled);
+	}
+
+	/* Reaching the end of the file completes the index */
+	if (ret == ML_OK && gzip->inflater->end)
+	{
+		gzip->size = gzip->inflater->out;
+		gzip->complete = 1;
+	}
+	gzip->status = ret;
+	gzip->done = 1;
+	pthread_cond_signal (&gzip->filled);
+	pthread_mutex_unlock (&gzip->lock);
+
+	inflateEnd (&gzip->inflater->strm);
+
+	return NULL;
+}
+
+static void GzipFile_StopThread (GzipFile * gzip)
+{
+	if (!gzip->running)
+		return;
+
+	pthread_mutex_lock (&gzip->lock);
+	gzip->stop = 1;
+	pthread_cond_signal (&gzip->consumed);
+	pthread_mutex_unlock (&gzip->lock);
+
+	pthread_join (gzip->thread, NULL);
+	gzip->running = 0;
+}
+
+static int GzipFile_StartThread (GzipFile * gzip, GzipCheckpoint * checkpoint)
+{
+	/* Throw away whatever was inflated for the old position */
+	GzipFile_StopThread (gzip);
+	gzip->start = *checkpoint;
+	gzip->produced = 0;
+	gzip->used = 0;
+	gzip->blockOffset = 0;
+	gzip->position = checkpoint->out;
+	gzip->status = ML_OK;
+	gzip->done = 0;
+	gzip->stop = 0;
+
+	if (pthread_create (&gzip->thread, NULL, (void * (*)(void *)) GzipFile_ThreadMain, gzip) != 0)
+	{
+		gzip->done = 1;
+		gzip->status = ML_ERR_FILE;
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	gzip->running = 1;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+static ssize_t GzipFile_Consume (GzipFile * gzip, char * buffer, size_t size)
+{
+	unsigned long block;
+	size_t count;
+	size_t total = 0;
+	int status;
+
+	/* Copies the bytes of the blocks inflated by the thread, or just skips them if "buffer" is NULL */
+	while (total < size)
+	{
+		pthread_mutex_lock (&gzip->lock);
+		while (gzip->used == gzip->produced && !gzip->done)
+			pthread_cond_wait (&gzip->filled, &gzip->lock);
+		if (gzip->used == gzip->produced)
+		{
+			/* No more blocks. Errors are only reported if nothing was read on this call */
+			status = gzip->status;
+			pthread_mutex_unlock (&gzip->lock);
+			if (status != ML_OK && total == 0)
+			{
+				errno = (status == ML_ERR_OUTOFMEMORY) ? ENOMEM : EIO;
+				return -1;
+			}
+			break;
+		}
+		block = gzip->used % GZIP_BLOCKS_COUNT;
+		pthread_mutex_unlock (&gzip->lock);
+
+		/* The reader owns every block between "used" and "produced", so it can read them without the lock */
+		count = min (size - total, gzip->blockSizes[block] - gzip->blockOffset);
+		if (buffer != NULL)
+			memcpy (&buffer[total], &gzip->blocks[block][gzip->blockOffset], count);
+		gzip->blockOffset += count;
+		gzip->position += count;
+		total += count;
+
+		/* Give the block back to the thread */
+		if (gzip->blockOffset == gzip->blockSizes[block])
+		{
+			pthread_mutex_lock (&gzip->lock);
+			gzip->used++;
+			gzip->blockOffset = 0;
+			pthread_cond_signal (&gzip->consumed);
+			pthread_mutex_unlock (&gzip->lock);
+		}
+	}
+
+	return (ssize_t) total;
+}
+
+static size_t GzipFile_FindCheckpoint (GzipFile * gzip, uint64_t position)
+{
+	size_t first = 0;
+	size_t last;
+	size_t middle;
+
+	/* Binary search for the last checkpoint at or before "position". The first checkpoint is always at 0 */
+	last = gzip->checkpointsCount - 1;
+	while (first < last)
+	{
+		middle = (first + last + 1) / 2;
+		if (gzip->checkpoints[middle].out <= position)
+			first = middle;
+		else
+			last = middle - 1;
+	}
+
+	return first;
+}
+
+static int GzipFile_Seek (GzipFile * gzip, uint64_t position)
+{
+	GzipCheckpoint checkpoint;
+	ssize_t skipped;
+
+	/* Moving backwards (or far ahead, over an indexed region) restarts inflating from the closest checkpoint */
+	pthread_mutex_lock (&gzip->lock);
+	checkpoint = gzip->checkpoints[GzipFile_FindCheckpoint (gzip, position)];
+	pthread_mutex_unlock (&gzip->lock);
+	if (position < gzip->position || checkpoint.out > gzip->position + GZIP_BLOCK_SIZE * GZIP_BLOCKS_COUNT)
+	{
+		if (GzipFile_StartThread (gzip, &checkpoint) != ML_OK)
+			return -1;
+	}
+
+	/* Skip the decompressed bytes up to the position */
+	while (gzip->position < position)
+	{
+		skipped = GzipFile_Consume (gzip, NULL, (size_t) min (position - gzip->position, (uint64_t) GZIP_SPAN));
+		if (skipped < 0)
+			return -1;
+		if (skipped == 0)
+			break;
+	}
+
+	/* Return OK */
+	return 0;
+}
+
+static ssize_t GzipFile_StreamRead (void * cookie, char * buffer, size_t size)
+{
+	return GzipFile_Consume ((GzipFile *) cookie, buffer, size);
+}
+
+static int GzipFile_StreamSeek (void * cookie, int64_t * offset, int whence)
+{
+	GzipFile * gzip = (GzipFile *) cookie;
+	int64_t position;
+
+	if (whence == SEEK_CUR)
+		position = (int64_t) gzip->position + *offset;
+	else if (whence == SEEK_END)
+	{
+		/* The size is only known after reading the whole file */
+		if (!gzip->complete)
+		{
+			while (GzipFile_Consume (gzip, NULL, GZIP_SPAN) > 0);
+			if (!gzip->complete)
+			{
+				errno = EIO;
+				return -1;
+			}
+		}
+		position = (int64_t) gzip->size + *offset;
+	}
+	else
+		position = *offset;
+
+	if (position < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((uint64_t) position != gzip->position && GzipFile_Seek (gzip, (uint64_t) position) != 0)
+		return -1;
+
+	*offset = (int64_t) gzip->position;
+
+	return 0;
+}
+
+static int GzipFile_StreamClose (void * cookie)
+{
+	GzipFile * gzip = (GzipFile *) cookie;
+	size_t i;
+
+	GzipFile_StopThread (gzip);
+
+	for (i=0;i<gzip->checkpointsCount;i++)
+		free (gzip->checkpoints[i].window);
+	free (gzip->checkpoints);
+	for (i=0;i<GZIP_BLOCKS_COUNT;i++)
+		free (gzip->blocks[i]);
+	for (i=0;i<GZIP_CACHED_SPANS;i++)
+		free (gzip->cache[i]);
+	free (gzip->inflater);
+	free (gzip->cacheInflater);
+	pthread_mutex_destroy (&gzip->lock);
+	pthread_mutex_destroy (&gzip->cacheLock);
+	pthread_cond_destroy (&gzip->filled);
+	pthread_cond_destroy (&gzip->consumed);
+
+	if (gzip->file != NULL)
+		fclose (gzip->file);
+	free (gzip);
+
+	return 0;
+}
+
+#if defined(__GLIBC__)
+static ssize_t GzipFile_CookieRead (void * cookie, char * buffer, size_t size)
+{
+	return GzipFile_StreamRead (cookie, buffer, size);
+}
+
+static int GzipFile_CookieSeek (void * cookie, off64_t * offset, int whence)
+{
+	int64_t position = *offset;
+	int ret;
+
+	ret = GzipFile_StreamSeek (cookie, &position, whence);
+	*offset = position;
+
+	return ret;
+}
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+static int GzipFile_FunRead (void * cookie, char * buffer, int size)
+{
+	return (int) GzipFile_StreamRead (cookie, buffer, (size_t) size);
+}
+
+static fpos_t GzipFile_FunSeek (void * cookie, fpos_t offset, int whence)
+{
+	int64_t position = (int64_t) offset;
+
+	if (GzipFile_StreamSeek (cookie, &position, whence) != 0)
+		return -1;
+
+	return (fpos_t) position;
+}
+#endif
+
+static FILE * GzipFile_OpenStream (GzipFile * gzip)
+{
+#if defined(__GLIBC__)
+	cookie_io_functions_t functions;
+
+	functions.read = GzipFile_CookieRead;
+	functions.write = NULL;
+	functions.seek = GzipFile_CookieSeek;
+	functions.close = GzipFile_StreamClose;
+
+	return fopencookie (gzip, "rb", functions);
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+	return funopen (gzip, GzipFile_FunRead, NULL, GzipFile_FunSeek, GzipFile_StreamClose);
+#else
+	errno = ENOSYS;
+	return NULL;
+#endif
+}
+
+/************************
+* "Public" Functions	*
+************************/
+int GzipFile_IsCompressed (FILE * file)
+{
+	unsigned char magic[2];
+	off_t position;
+	size_t bytesRead;
+
+	position = ftello (file);
+	bytesRead = fread (magic, 1, 2, file);
+	fseeko (file, position, SEEK_SET);
+
+	return bytesRead == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+GzipFile * GzipFile_Open (FILE * file)
+{
+	GzipFile * gzip;
+	unsigned int i;
+	int ret = ML_OK;
+
+	/* malloc memory to store the structure */
+	gzip = (GzipFile *) malloc (sizeof(GzipFile));
+	if (gzip == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Zero memory */
+	memset (gzip, 0, sizeof(GzipFile));
+	pthread_mutex_init (&gzip->lock, NULL);
+	pthread_mutex_init (&gzip->cacheLock, NULL);
+	pthread_cond_init (&gzip->filled, NULL);
+	pthread_cond_init (&gzip->consumed, NULL);
+	gzip->fd = fileno (file);
+
+	/* Get storage for the ring of blocks and the inflate states */
+	gzip->inflater = (GzipInflater *) malloc (sizeof(GzipInflater));
+	gzip->cacheInflater = (GzipInflater *) malloc (sizeof(GzipInflater));
+	if (gzip->inflater == NULL || gzip->cacheInflater == NULL)
+		ret = ML_ERR_OUTOFMEMORY;
+	for (i=0;i<GZIP_BLOCKS_COUNT && ret == ML_OK;i++)
+	{
+		gzip->blocks[i] = (unsigned char *) malloc (GZIP_BLOCK_SIZE);
+		if (gzip->blocks[i] == NULL)
+			ret = ML_ERR_OUTOFMEMORY;
+	}
+
+	/* The begining of the file is always the first checkpoint */
+	if (ret == ML_OK)
+		ret = GzipFile_AddCheckpoint (gzip, 0, 0, 0, NULL);
+
+	/* Create the stream and start inflating */
+	if (ret == ML_OK)
+	{
+		gzip->stream = GzipFile_OpenStream (gzip);
+		if (gzip->stream == NULL)
+			ret = ML_ERR_NOTIMPLEMENTED;
+	}
+	if (ret == ML_OK)
+	{
+		setvbuf (gzip->stream, NULL, _IOFBF, GZIP_STREAM_BUFFER);
+		ret = GzipFile_StartThread (gzip, &gzip->checkpoints[0]);
+	}
+
+	if (ret != ML_OK)
+	{
+		/* The caller keeps the ownership of the file on errors */
+		if (gzip->stream != NULL)
+			fclose (gzip->stream);
+		else
+			GzipFile_StreamClose (gzip);
+		errno = (ret == ML_ERR_OUTOFMEMORY) ? ENOMEM : (ret == ML_ERR_NOTIMPLEMENTED) ? ENOSYS : EIO;
+		return NULL;
+	}
+
+	/* The file is closed with the stream */
+	gzip->file = file;
+
+	/* Return the new instance */
+	return gzip;
+}
+
+FILE * GzipFile_Stream (GzipFile * gzip)
+{
+	return gzip->stream;
+}
+
+ssize_t GzipFile_PRead (GzipFile * gzip, void * buffer, size_t size, uint64_t offset)
+{
+	GzipCheckpoint checkpoint;
+	unsigned char * auxBuffer;
+	size_t total = 0;
+	size_t span;
+	size_t spanSize;
+	size_t produced;
+	size_t count;
+	unsigned int slot;
+	int ret;
+
+	/* Random reads need the index of the whole file */
+	if (!gzip->complete)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock (&gzip->cacheLock);
+	while (total < size && offset < gzip->size)
+	{
+		/* Find the span that holds the position (checkpoints don't change once the index is complete) */
+		span = GzipFile_FindCheckpoint (gzip, offset);
+		checkpoint = gzip->checkpoints[span];
+		spanSize = (size_t) (((span + 1 < gzip->checkpointsCount) ? gzip->checkpoints[span + 1].out : gzip->size) - checkpoint.out);
+
+		/* Look for it on the cache. If it isn't there, inflate it over the oldest cached span */
+		for (slot=0;slot<GZIP_CACHED_SPANS;slot++)
+		{
+			if (gzip->cacheSpan[slot] == span + 1)
+				break;
+		}
+		if (slot == GZIP_CACHED_SPANS)
+		{
+			slot = gzip->cacheNext;
+			gzip->cacheNext = (gzip->cacheNext + 1) % GZIP_CACHED_SPANS;
+			gzip->cacheSpan[slot] = 0;
+			if (gzip->cacheCapacity[slot] < spanSize)
+			{
+				auxBuffer = (unsigned char *) realloc (gzip->cache[slot], spanSize);
+				if (auxBuffer == NULL)
+				{
+					pthread_mutex_unlock (&gzip->cacheLock);
+					errno = ENOMEM;
+					return -1;
+				}
+				gzip->cache[slot] = auxBuffer;
+				gzip->cacheCapacity[slot] = spanSize;
+			}
+
+			ret = GzipInflater_Start (gzip, gzip->cacheInflater, &checkpoint);
+			if (ret == ML_OK)
+			{
+				ret = GzipInflater_Read (gzip, gzip->cacheInflater, gzip->cache[slot], spanSize, &produced, 0);
+				inflateEnd (&gzip->cacheInflater->strm);
+			}
+			if (ret != ML_OK || produced != spanSize)
+			{
+				pthread_mutex_unlock (&gzip->cacheLock);
+				errno = EIO;
+				return -1;
+			}
+			gzip->cacheSpan[slot] = span + 1;
+		}
+
+		/* Copy the requested part of the span */
+		count = (size_t) min ((uint64_t) (size - total), checkpoint.out + spanSize - offset);
+		memcpy ((unsigned char *) buffer + total, &gzip->cache[slot][offset - checkpoint.out], count);
+		total += count;
+		offset += count;
+	}
+	pthread_mutex_unlock (&gzip->cacheLock);
+
+	return (ssize_t) total;
+}
@@ -3,6 +3,7 @@
 #include <time.h>
 #include <stdlib.h>
 #include "MacLearn/Util/MatrixUtil.h"
+#include "MacLearn/Util/Random.h"			/* For Random_Shuffle */
 
 void printULMatrix (char * name, unsigned long * mat, int size1, int size2)
 {
@@ -80,33 +81,8 @@ void printVector (char * name, double * vect, size_t size)
 
 int shuffleVector (void * v, size_t elementSize, size_t elementCount)
 {
-	size_t i;
-	size_t src;
-	void * aux;
-	unsigned char * ucBase;
-
-	/* Recast base to unsigned char so we can do pointer math in windows */
-	ucBase = (unsigned char *) v;
-
-	aux = malloc (elementSize);
-	if (aux == NULL)
-		return 0;
-
-	/* Inicializa o gerador de nmeros aleatrios */
-	srand((unsigned int) time(NULL));
-	for (i=elementCount - 1;i>0;i--)
-	{
-		/* Pega um nmero aleatrio */
-		src = rand()%i;
-
-		/* Troca a posio i com a posio aleatria */
-		memcpy (aux, ucBase + (src * elementSize), elementSize);
-		memcpy ( ucBase + (src * elementSize), ucBase + (i * elementSize), elementSize);
-		memcpy (ucBase + (i * elementSize), aux, elementSize);
-	}
-
-	/* Libera a memria */
-	free (aux);
+	/* Use an unbiased shuffle, seeded by the clock */
+	Random_Shuffle (v, elementSize, elementCount, Random_TimeSeed ());
 
 	/* Return OK */
 	return 1;
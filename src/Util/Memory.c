@@ -0,0 +1,222 @@
+#include <stdlib.h>				/* For posix_memalign and free */
+#include <stdio.h>				/* For fopen */
+#include <string.h>				/* For memset */
+#ifdef WIN32
+#include <malloc.h>				/* For _aligned_malloc */
+#endif
+#ifdef __linux__
+#include <sys/mman.h>			/* For mmap and madvise */
+#include <sys/syscall.h>		/* For SYS_mbind */
+#include <unistd.h>				/* For syscall */
+#endif
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/Memory.h"
+
+/* Nodes read from the system (enough for any machine around), and the bits of each word of a nodes mask */
+#define MEMORY_MAX_NODES		256
+#define MEMORY_MASK_BITS		(8 * sizeof(unsigned long))
+/* NUMA policies of mbind (from <numaif.h>, which comes with libnuma and isn't always installed) */
+#define MEMORY_MPOL_BIND		2
+#define MEMORY_MPOL_INTERLEAVE	3
+
+/* Kept on the cache line before each block returned by Memory_Alloc, to know how to release it */
+typedef struct
+{
+	void * base;				/* Start of the allocation */
+	size_t mapSize;				/* Size of the mapping, or 0 if it was allocated from the heap */
+}MemoryBlock;
+
+/************************
+* "Private" Functions	*
+************************/
+static unsigned int Memory_OnlineNodes (unsigned long * mask)
+{
+	FILE * file;
+	unsigned int first;
+	unsigned int last;
+	unsigned int count = 0;
+	unsigned int i;
+	int c;
+
+	/* The online nodes are a list of ranges, like "0-1" or "0,2-3" */
+	memset (mask, 0, MEMORY_MAX_NODES / 8);
+	file = fopen ("/sys/devices/system/node/online", "r");
+	if (file != NULL)
+	{
+		while (fscanf (file, "%u", &first) == 1)
+		{
+			last = first;
+			c = fgetc (file);
+			if (c == '-' && fscanf (file, "%u", &last) == 1)
+				c = fgetc (file);
+			for (i=first;i<=last && i<MEMORY_MAX_NODES;i++)
+				mask[i / MEMORY_MASK_BITS] |= 1UL << (i % MEMORY_MASK_BITS);
+			if (last >= count)
+				count = min (last + 1, MEMORY_MAX_NODES);
+			if (c != ',')
+				break;
+		}
+		fclose (file);
+	}
+
+	/* Machines without NUMA support have a single node */
+	if (count == 0)
+	{
+		mask[0] = 1;
+		count = 1;
+	}
+	return count;
+}
+
+#ifdef __linux__
+static void * Memory_Map (size_t size, const MemoryPolicy * policy, size_t * mapSize)
+{
+	unsigned long mask[MEMORY_MAX_NODES / MEMORY_MASK_BITS];
+	unsigned char * base = MAP_FAILED;
+	size_t pageSize = (size_t) sysconf (_SC_PAGESIZE);
+	size_t head;
+
+	/* Reserved huge pages. There may be none left (or none at all), so fall back to transparent ones */
+#ifdef MAP_HUGETLB
+	if (policy->pages == MEM_PG_EXPLICIT)
+	{
+		*mapSize = Memory_AlignSize (size, MEMORY_HUGE_PAGE);
+		base = (unsigned char *) mmap (NULL, *mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+#endif
+
+	if (base == MAP_FAILED && policy->pages != MEM_PG_DEFAULT)
+	{
+		/* Transparent huge pages only back whole huge pages, so map one more and trim the mapping to start on one */
+		*mapSize = Memory_AlignSize (size, MEMORY_HUGE_PAGE);
+		base = (unsigned char *) mmap (NULL, *mapSize + MEMORY_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base != MAP_FAILED)
+		{
+			head = Memory_AlignSize ((size_t) base, MEMORY_HUGE_PAGE) - (size_t) base;
+			if (head > 0)
+				munmap (base, head);
+			munmap (base + head + *mapSize, MEMORY_HUGE_PAGE - head);
+			base += head;
+#ifdef MADV_HUGEPAGE
+			madvise (base, *mapSize, MADV_HUGEPAGE);
+#endif
+		}
+	}
+	else if (base == MAP_FAILED)
+	{
+		*mapSize = Memory_AlignSize (size, pageSize);
+		base = (unsigned char *) mmap (NULL, *mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if (base == MAP_FAILED)
+		return NULL;
+
+	/*	Place the pages before anything is written to them. Kernels without NUMA support fail, and the pages just go
+		wherever they're first written */
+#ifdef SYS_mbind
+	if (policy->numa != MEM_NM_DEFAULT)
+	{
+		Memory_OnlineNodes (mask);
+		if (policy->numa == MEM_NM_BIND)
+		{
+			memset (mask, 0, sizeof(mask));
+			mask[policy->node / MEMORY_MASK_BITS] = 1UL << (policy->node % MEMORY_MASK_BITS);
+		}
+		syscall (SYS_mbind, base, *mapSize, (policy->numa == MEM_NM_BIND) ? MEMORY_MPOL_BIND : MEMORY_MPOL_INTERLEAVE,
+			mask, (unsigned long) MEMORY_MAX_NODES + 1, 0UL);
+	}
+#else
+	(void) mask;
+#endif
+
+	return base;
+}
+#endif
+
+/************************
+* "Public" Functions	*
+************************/
+void * Memory_AlignedAlloc (size_t size, size_t alignment)
+{
+	void * ptr;
+
+#ifndef WIN32
+	if (posix_memalign (&ptr, alignment, (size > 0) ? size : 1) != 0)
+		ptr = NULL;
+#else
+	ptr = _aligned_malloc ((size > 0) ? size : 1, alignment);
+#endif
+
+	if (ptr == NULL)
+		errno = ENOMEM;
+	return ptr;
+}
+
+void Memory_AlignedFree (void * ptr)
+{
+#ifndef WIN32
+	free (ptr);
+#else
+	_aligned_free (ptr);
+#endif
+}
+
+void * Memory_Alloc (size_t size, const MemoryPolicy * policy)
+{
+	unsigned long mask[MEMORY_MAX_NODES / MEMORY_MASK_BITS];
+	unsigned char * base = NULL;
+	MemoryBlock * block;
+	size_t mapSize = 0;
+
+	if (policy != NULL && (policy->pages > MEM_PG_EXPLICIT || policy->numa > MEM_NM_BIND ||
+		(policy->numa == MEM_NM_BIND && (policy->node >= Memory_OnlineNodes (mask) ||
+		!(mask[policy->node / MEMORY_MASK_BITS] & (1UL << (policy->node % MEMORY_MASK_BITS)))))))
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/* Blocks with a policy are mapped on their own. If that fails, they come from the heap like any other */
+#ifdef __linux__
+	if (policy != NULL && (policy->pages != MEM_PG_DEFAULT || policy->numa != MEM_NM_DEFAULT))
+		base = (unsigned char *) Memory_Map (size + MEMORY_CACHE_LINE, policy, &mapSize);
+#endif
+	if (base == NULL)
+	{
+		mapSize = 0;
+		base = (unsigned char *) Memory_AlignedAlloc (size + MEMORY_CACHE_LINE, MEMORY_CACHE_LINE);
+		if (base == NULL)
+			return NULL;
+	}
+
+	/* The block starts a cache line after the allocation, right after its description */
+	block = (MemoryBlock *) base;
+	block->base = base;
+	block->mapSize = mapSize;
+	return base + MEMORY_CACHE_LINE;
+}
+
+void Memory_Free (void * ptr)
+{
+	MemoryBlock * block;
+
+	if (ptr == NULL)
+		return;
+
+	block = (MemoryBlock *) ((unsigned char *) ptr - MEMORY_CACHE_LINE);
+#ifdef __linux__
+	if (block->mapSize > 0)
+	{
+		munmap (block->base, block->mapSize);
+		return;
+	}
+#endif
+	Memory_AlignedFree (block->base);
+}
+
+unsigned int Memory_NodesCount (void)
+{
+	unsigned long mask[MEMORY_MAX_NODES / MEMORY_MASK_BITS];
+
+	return Memory_OnlineNodes (mask);
+}
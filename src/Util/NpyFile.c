@@ -0,0 +1,238 @@
+#include <stdlib.h>
+#include <string.h>				/* For memcmp, memcpy and memset */
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/NpyFile.h"
+
+#define NPY_MAGIC				"\x93NUMPY"		/* Identifies a .npy file (6 bytes, without the \0) */
+#define NPY_MAGIC_SIZE			6
+/* Size of the fixed part of the header, for each format version: magic, version (2 bytes) and header length (2 or 4 bytes) */
+#define NPY_PREAMBLE_V1			10
+#define NPY_PREAMBLE_V2			12
+
+/************************
+* "Private" Functions	*
+************************/
+static __inline unsigned char NpyFile_IsLittleEndian (void)
+{
+	static const uint16_t one = 1;
+
+	return *(const unsigned char *) &one;
+}
+
+static const char * NpyFile_FindKey (const char * pos, const char * end, const char * key)
+{
+	size_t length = strlen (key);
+
+	/* Keys are quoted Python strings, followed by ':'. The value starts at the first non blank character after it */
+	for (;pos + length + 2 <= end;pos++)
+	{
+		if ((*pos != '\'' && *pos != '"') || pos[length + 1] != *pos || memcmp (pos + 1, key, length) != 0)
+			continue;
+		for (pos+=length + 2;pos < end && (*pos == ' ' || *pos == '\t');pos++);
+		if (pos >= end || *pos != ':')
+			return NULL;
+		for (pos++;pos < end && (*pos == ' ' || *pos == '\t');pos++);
+		return pos;
+	}
+
+	return NULL;
+}
+
+static int NpyFile_ParseDescr (const char * pos, const char * end, NpyHeader * header)
+{
+	char byteOrder;
+	char kind;
+
+	/* A quoted type string, like '<f8': byte order, kind and size */
+	if (end - pos < 5 || (*pos != '\'' && *pos != '"') || pos[4] != *pos)
+		return 0;
+	byteOrder = pos[1];
+	kind = pos[2];
+
+	if (kind == 'f' && pos[3] == '8')
+		header->type = NPY_ET_FLOAT64;
+	else if (kind == 'f' && pos[3] == '4')
+		header->type = NPY_ET_FLOAT32;
+	else if (kind == 'u' && pos[3] == '1')
+		header->type = NPY_ET_UINT8;
+	else if (kind == 'i' && pos[3] == '4')
+		header->type = NPY_ET_INT32;
+	else if (kind == 'i' && pos[3] == '8')
+		header->type = NPY_ET_INT64;
+	else
+		return 0;
+	header->elementSize = (size_t) (pos[3] - '0');
+
+	/* Single byte elements have no byte order. Others must be in the byte order of this machine */
+	if (byteOrder == '|' || byteOrder == '=')
+		return header->elementSize == 1 || byteOrder == '=';
+	return byteOrder == (NpyFile_IsLittleEndian () ? '<' : '>');
+}
+
+static int NpyFile_ParseShape (const char * pos, const char * end, NpyHeader * header)
+{
+	uint64_t value;
+	const char * digitsStart;
+
+	/* A Python tuple of integers, like "(100, 784)", "(100,)" or "()" */
+	if (pos >= end || *pos++ != '(')
+		return 0;
+
+	header->dimsCount = 0;
+	header->elementsCount = 1;
+	for (;;)
+	{
+		while (pos < end && (*pos == ' ' || *pos == '\t'))
+			pos++;
+		if (pos < end && *pos == ')')
+			return 1;
+
+		/* Read the size of the next dimension */
+		value = 0;
+		digitsStart = pos;
+		while (pos < end && *pos >= '0' && *pos <= '9')
+		{
+			if (value > (UINT64_MAX - 9) / 10)
+				return 0;
+			value = value * 10 + (uint64_t) (*pos++ - '0');
+		}
+		if (pos == digitsStart || header->dimsCount == NPY_MAX_DIMS)
+			return 0;
+
+		/* Python 2 long integers have a trailing 'L' */
+		if (pos < end && *pos == 'L')
+			pos++;
+
+		/* Keep the number of elements, avoiding overflows */
+		if (value != 0 && header->elementsCount > UINT64_MAX / value)
+			return 0;
+		header->elementsCount *= value;
+		header->shape[header->dimsCount++] = value;
+
+		while (pos < end && (*pos == ' ' || *pos == '\t'))
+			pos++;
+		if (pos < end && *pos == ',')
+			pos++;
+		else if (pos >= end || *pos != ')')
+			return 0;
+	}
+}
+
+/************************
+* "Public" Functions	*
+************************/
+int NpyFile_ReadHeader (const char * data, size_t size, NpyHeader * header)
+{
+	const unsigned char * preamble = (const unsigned char *) data;
+	const char * text;
+	const char * end;
+	const char * value;
+	size_t textLength;
+
+	memset (header, 0, sizeof(NpyHeader));
+
+	/* Check the magic, and find out the length of the header text (always little endian) on each format version */
+	if (size < NPY_PREAMBLE_V1 || memcmp (data, NPY_MAGIC, NPY_MAGIC_SIZE) != 0)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	if (preamble[6] == 1)
+	{
+		textLength = (size_t) preamble[8] | ((size_t) preamble[9] << 8);
+		header->dataOffset = NPY_PREAMBLE_V1 + textLength;
+	}
+	else if ((preamble[6] == 2 || preamble[6] == 3) && size >= NPY_PREAMBLE_V2)
+	{
+		textLength = (size_t) preamble[8] | ((size_t) preamble[9] << 8) | ((size_t) preamble[10] << 16) | ((size_t) preamble[11] << 24);
+		header->dataOffset = NPY_PREAMBLE_V2 + textLength;
+	}
+	else
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	if (header->dataOffset > size)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	text = data + header->dataOffset - textLength;
+	end = data + header->dataOffset;
+
+	/* Read the three keys of the dictionary */
+	value = NpyFile_FindKey (text, end, "descr");
+	if (value == NULL || !NpyFile_ParseDescr (value, end, header))
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	value = NpyFile_FindKey (text, end, "fortran_order");
+	if (value == NULL || ((end - value < 4 || memcmp (value, "True", 4) != 0) && (end - value < 5 || memcmp (value, "False", 5) != 0)))
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+	header->fortranOrder = (*value == 'T');
+	value = NpyFile_FindKey (text, end, "shape");
+	if (value == NULL || !NpyFile_ParseShape (value, end, header))
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Check that all the elements fit in the file */
+	if (header->elementsCount > (size - header->dataOffset) / header->elementSize)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int NpyFile_WriteHeader (FILE * file, NpyElementType type, unsigned char dimsCount, const uint64_t * shape)
+{
+	static const char * descrs[] = {"f8", "f4", "u1", "i4", "i8"};
+	char buffer[NPY_HEADER_SIZE + NPY_MAX_DIMS * 22];
+	char * pos;
+	unsigned char i;
+
+	if (type < NPY_ET_FLOAT64 || type > NPY_ET_INT64 || dimsCount > NPY_MAX_DIMS)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Fill the dictionary. Arrays of up to 2 dimensions always fit in NPY_HEADER_SIZE. The buffer has room for any shape */
+	memcpy (buffer, NPY_MAGIC, NPY_MAGIC_SIZE);
+	buffer[6] = 1;
+	buffer[7] = 0;
+	pos = &buffer[NPY_PREAMBLE_V1];
+	pos += sprintf (pos, "{'descr': '%c%s', 'fortran_order': False, 'shape': (", (type == NPY_ET_UINT8) ? '|' : (NpyFile_IsLittleEndian () ? '<' : '>'), descrs[type - NPY_ET_FLOAT64]);
+	for (i=0;i<dimsCount;i++)
+		pos += sprintf (pos, (i == 0) ? "%lu" : ", %lu", (unsigned long) shape[i]);
+	pos += sprintf (pos, (dimsCount == 1) ? ",), }" : "), }");
+	if (pos - buffer >= NPY_HEADER_SIZE)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Pad it with spaces, and end it with a line break, as NumPy does */
+	memset (pos, ' ', (size_t) (&buffer[NPY_HEADER_SIZE - 1] - pos));
+	buffer[NPY_HEADER_SIZE - 1] = '\n';
+	buffer[8] = (char) ((NPY_HEADER_SIZE - NPY_PREAMBLE_V1) & 0xFF);
+	buffer[9] = (char) ((NPY_HEADER_SIZE - NPY_PREAMBLE_V1) >> 8);
+
+	if (fwrite (buffer, 1, NPY_HEADER_SIZE, file) != NPY_HEADER_SIZE)
+	{
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
@@ -0,0 +1,82 @@
+#include <stdlib.h>				/* For malloc/free */
+#include <pthread.h>
+#ifndef WIN32
+#include <unistd.h>				/* For sysconf */
+#endif
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/Parallel.h"
+
+/* Arguments passed to each worker thread */
+typedef struct
+{
+	void (*function)(void * task);
+	void * task;
+}ParallelWorker;
+
+/************************
+* "Private" Functions	*
+************************/
+static void * Parallel_ThreadMain (void * arg)
+{
+	ParallelWorker * worker = (ParallelWorker *) arg;
+
+	worker->function (worker->task);
+
+	return NULL;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+unsigned int Parallel_CpuCount (void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long count;
+
+	count = sysconf (_SC_NPROCESSORS_ONLN);
+	if (count > 0)
+		return (unsigned int) count;
+#endif
+
+	return 1;
+}
+
+void Parallel_Run (void (*function)(void * task), void * tasks, size_t taskSize, unsigned int tasksCount)
+{
+	pthread_t * threads;
+	ParallelWorker * workers;
+	unsigned int i;
+	unsigned int started = 1;
+
+	/* Nothing to be done on an empty list */
+	if (tasksCount == 0)
+		return;
+
+	threads = (pthread_t *) malloc (sizeof(pthread_t) * tasksCount);
+	workers = (ParallelWorker *) malloc (sizeof(ParallelWorker) * tasksCount);
+
+	/* Start a thread for every task but the first one, which is run by the calling thread */
+	if (threads != NULL && workers != NULL)
+	{
+		for (;started<tasksCount;started++)
+		{
+			workers[started].function = function;
+			workers[started].task = (unsigned char *) tasks + (taskSize * started);
+			if (pthread_create (&threads[started], NULL, Parallel_ThreadMain, &workers[started]) != 0)
+				break;
+		}
+	}
+
+	/* Run the first task and any task that couldn't get its own thread */
+	function (tasks);
+	for (i=started;i<tasksCount;i++)
+		function ((unsigned char *) tasks + (taskSize * i));
+
+	/* Wait for all threads to finish */
+	for (i=1;i<started;i++)
+		pthread_join (threads[i], NULL);
+
+	free (threads);
+	free (workers);
+}
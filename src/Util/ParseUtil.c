@@ -0,0 +1,254 @@
+#include <string.h>		/* For memchr */
+#include <stdint.h>		/* For uint64_t */
+#include <math.h>		/* For HUGE_VAL and NAN */
+
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
+#include "MacLearn/Util/ParseUtil.h"
+
+/* Maximum number of significant digits accumulated on the mantissa. More than that won't fit on 64 bits */
+#define MAX_MANTISSA_DIGITS		19
+/* Largest integer that a double can represent exactly (2^53) */
+#define MAX_EXACT_MANTISSA		9007199254740992ULL
+
+/* Powers of 10 that are exactly representable as a double */
+static const double exactPowers[] = {	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+										1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+/************************
+* "Private" Functions	*
+************************/
+static __inline const char * skipBlanks (const char * pos, const char * end)
+{
+	while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+		pos++;
+
+	return pos;
+}
+
+static __inline const char * matchWord (const char * pos, const char * end, const char * word)
+{
+	/* "word" is lowercase, and matches in any case */
+	for (;*word != '\0';word++, pos++)
+	{
+		if (pos >= end || (*pos | 0x20) != *word)
+			return NULL;
+	}
+
+	return pos;
+}
+
+static const char * parseSpecial (const char * pos, const char * end, unsigned char negative, double * value)
+{
+	const char * wordEnd;
+
+	/* Infinity, written as "inf" or "infinity" */
+	wordEnd = matchWord (pos, end, "inf");
+	if (wordEnd != NULL)
+	{
+		*value = negative ? -HUGE_VAL : HUGE_VAL;
+		pos = matchWord (wordEnd, end, "inity");
+		return pos != NULL ? pos : wordEnd;
+	}
+
+	/* Not a number, written as "nan", optionally followed by letters, digits and '_' between parentheses */
+	wordEnd = matchWord (pos, end, "nan");
+	if (wordEnd == NULL)
+		return NULL;
+	*value = negative ? -NAN : NAN;
+	if (wordEnd < end && *wordEnd == '(')
+	{
+		for (pos=wordEnd + 1;pos < end && ((*pos >= '0' && *pos <= '9') || ((*pos | 0x20) >= 'a' && (*pos | 0x20) <= 'z') || *pos == '_');pos++);
+		if (pos < end && *pos == ')')
+			return pos + 1;
+	}
+
+	return wordEnd;
+}
+
+static long double powerOf10 (int exponent)
+{
+	long double result = 1;
+	long double base = 10;
+	unsigned int n;
+
+	/* Exponentiation by squaring. Long double keeps enough precision for values outside the exact range */
+	n = (unsigned int) (exponent < 0 ? -exponent : exponent);
+	while (n)
+	{
+		if (n & 1)
+			result *= base;
+		base *= base;
+		n >>= 1;
+	}
+
+	return exponent < 0 ? 1 / result : result;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+const char * findChar (const char * pos, const char * end, char c)
+{
+	const char * found;
+
+	/* memchr is already vectorized by the C library, there's no gain in rewriting it */
+	found = (const char *) memchr (pos, c, end - pos);
+
+	return found != NULL ? found : end;
+}
+
+size_t countChar (const char * pos, const char * end, char c)
+{
+	size_t count = 0;
+
+#ifdef __SSE2__
+	__m128i pattern;
+	__m128i block;
+
+	/* Compare 16 bytes at a time, counting the bits set on the comparison mask */
+	pattern = _mm_set1_epi8 (c);
+	while (end - pos >= 16)
+	{
+		block = _mm_loadu_si128 ((const __m128i *) pos);
+		count += __builtin_popcount (_mm_movemask_epi8 (_mm_cmpeq_epi8 (block, pattern)));
+		pos += 16;
+	}
+#endif
+
+	/* Process the remaining bytes (or all of them, if SSE2 isn't available) */
+	while (pos < end)
+		count += (*pos++ == c);
+
+	return count;
+}
+
+const char * parseDouble (const char * pos, const char * end, double * value)
+{
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	int expValue;
+	unsigned char negative = 0;
+	unsigned char expNegative;
+	unsigned char hasDigits = 0;
+	const char * expStart;
+	long double result;
+
+	pos = skipBlanks (pos, end);
+
+	/* Read the sign */
+	if (pos < end && (*pos == '-' || *pos == '+'))
+		negative = (*pos++ == '-');
+
+	/* Infinities and NaNs are read as strtod (and fscanf) reads them */
+	if (pos < end && ((*pos | 0x20) == 'i' || (*pos | 0x20) == 'n'))
+		return parseSpecial (pos, end, negative, value);
+
+	/* Read the integer part. Digits that don't fit on the mantissa only update the exponent */
+	while (pos < end && *pos >= '0' && *pos <= '9')
+	{
+		if (digits < MAX_MANTISSA_DIGITS)
+		{
+			mantissa = mantissa * 10 + (*pos - '0');
+			digits += (mantissa != 0);
+		}
+		else
+			exponent++;
+		hasDigits = 1;
+		pos++;
+	}
+
+	/* Read the fractional part */
+	if (pos < end && *pos == '.')
+	{
+		pos++;
+		while (pos < end && *pos >= '0' && *pos <= '9')
+		{
+			if (digits < MAX_MANTISSA_DIGITS)
+			{
+				mantissa = mantissa * 10 + (*pos - '0');
+				digits += (mantissa != 0);
+				exponent--;
+			}
+			hasDigits = 1;
+			pos++;
+		}
+	}
+
+	/* A number must have at least one digit */
+	if (!hasDigits)
+		return NULL;
+
+	/* Read the exponent, if any. If it's malformed, it isn't part of the number */
+	if (pos < end && (*pos == 'e' || *pos == 'E'))
+	{
+		expStart = pos++;
+		expNegative = 0;
+		if (pos < end && (*pos == '-' || *pos == '+'))
+			expNegative = (*pos++ == '-');
+
+		if (pos < end && *pos >= '0' && *pos <= '9')
+		{
+			expValue = 0;
+			while (pos < end && *pos >= '0' && *pos <= '9')
+			{
+				/* Saturate absurd exponents, they'll end up as 0 or inf anyway */
+				if (expValue < 100000)
+					expValue = expValue * 10 + (*pos - '0');
+				pos++;
+			}
+			exponent += expNegative ? -expValue : expValue;
+		}
+		else
+			pos = expStart;
+	}
+
+	/* Fast path: both the mantissa and the power of 10 are exact, so a single operation gives a correctly rounded result */
+	if (mantissa <= MAX_EXACT_MANTISSA && exponent >= -22 && exponent <= 22)
+	{
+		if (exponent < 0)
+			*value = (double) mantissa / exactPowers[-exponent];
+		else
+			*value = (double) mantissa * exactPowers[exponent];
+	}
+	else
+	{
+		/* Slow path: use extended precision to keep the rounding error below the double precision */
+		result = (long double) mantissa * powerOf10 (exponent);
+		*value = (double) result;
+	}
+
+	if (negative)
+		*value = -*value;
+
+	return pos;
+}
+
+const char * parseLong (const char * pos, const char * end, long * value)
+{
+	long result = 0;
+	unsigned char negative = 0;
+	const char * digitsStart;
+
+	pos = skipBlanks (pos, end);
+
+	/* Read the sign */
+	if (pos < end && (*pos == '-' || *pos == '+'))
+		negative = (*pos++ == '-');
+
+	/* Read the digits */
+	digitsStart = pos;
+	while (pos < end && *pos >= '0' && *pos <= '9')
+		result = result * 10 + (*pos++ - '0');
+
+	/* A number must have at least one digit */
+	if (pos == digitsStart)
+		return NULL;
+
+	*value = negative ? -result : result;
+
+	return pos;
+}
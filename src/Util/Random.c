@@ -0,0 +1,287 @@
+#include <stdlib.h>				/* For malloc/free */
+#include <string.h>				/* For memcpy */
+#include <time.h>				/* For time */
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/Random.h"
+#include "MacLearn/Util/Parallel.h"			/* For Parallel_Run */
+
+/* Increment of the SplitMix64 counter (2^64 / golden ratio) */
+#define RANDOM_GAMMA				0x9E3779B97F4A7C15ULL
+
+/* Arrays with less elements than this are shuffled on a single thread */
+#define PARALLEL_SHUFFLE_MIN		(1 << 20)
+/* Number of elements on each bucket of the parallel shuffle. Small enough for a bucket to be shuffled inside the cache */
+#define SHUFFLE_BUCKET_SIZE			(1 << 16)
+
+/* Work of a single thread of the parallel shuffle */
+typedef struct
+{
+	off_t * v;						/* Array being shuffled */
+	off_t * aux;					/* Array where the elements are distributed to their buckets */
+	size_t first;					/* First element of "v" distributed by this task */
+	size_t last;					/* Element after the last one distributed by this task */
+	size_t * offsets;				/* Position on "aux" where this task writes the next element of each bucket */
+	size_t * bucketStart;			/* Position of the first element of each bucket on "aux" (bucketsCount + 1 elements) */
+	size_t bucketsCount;			/* Number of buckets */
+	unsigned int task;				/* Index of this task */
+	unsigned int tasksCount;		/* Number of tasks. Task "t" shuffles the buckets "b" where b % tasksCount == t */
+	uint64_t seed;					/* Seed of the whole shuffle */
+}ShuffleTask;
+
+/************************
+* "Private" Functions	*
+************************/
+static __inline uint64_t Random_Mix (uint64_t z)
+{
+	/* SplitMix64 finalizer. Every bit of the input affects every bit of the output */
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static __inline uint64_t Random_Scale (uint64_t value, uint64_t bound)
+{
+	/* Maps a 64 bits number to [0, bound) using the high half of the product, which avoids a division */
+#ifdef __SIZEOF_INT128__
+	return (uint64_t) (((unsigned __int128) value * bound) >> 64);
+#else
+	return value % bound;
+#endif
+}
+
+static __inline size_t Random_Bucket (uint64_t seed, size_t element, size_t bucketsCount)
+{
+	/* The bucket of each element depends only on the seed and its position, so it can be computed again later */
+	return (size_t) Random_Scale (Random_At (seed, element), bucketsCount);
+}
+
+static void Random_ShuffleOffsetsSerial (off_t * v, size_t count, Random * random)
+{
+	size_t i;
+	size_t j;
+	off_t aux;
+
+	if (count < 2)
+		return;
+
+	/* Fisher-Yates: swap each position with a random one before it (or itself) */
+	for (i=count - 1;i>0;i--)
+	{
+		j = (size_t) Random_Below (random, i + 1);
+		aux = v[i];
+		v[i] = v[j];
+		v[j] = aux;
+	}
+}
+
+static void Random_CountBuckets (ShuffleTask * task)
+{
+	size_t i;
+
+	/* Count the elements of this task's slice that go to each bucket */
+	memset (task->offsets, 0, sizeof(size_t) * task->bucketsCount);
+	for (i=task->first;i<task->last;i++)
+		task->offsets[Random_Bucket (task->seed, i, task->bucketsCount)]++;
+}
+
+static void Random_DistributeBuckets (ShuffleTask * task)
+{
+	size_t i;
+
+	/* Send each element to its bucket. Offsets were turned into positions by the prefix sum */
+	for (i=task->first;i<task->last;i++)
+		task->aux[task->offsets[Random_Bucket (task->seed, i, task->bucketsCount)]++] = task->v[i];
+}
+
+static void Random_ShuffleBuckets (ShuffleTask * task)
+{
+	Random random;
+	size_t b;
+	size_t start;
+	size_t size;
+
+	/* Shuffle each bucket with its own sequence, and copy it back to its final position */
+	for (b=task->task;b<task->bucketsCount;b+=task->tasksCount)
+	{
+		start = task->bucketStart[b];
+		size = task->bucketStart[b + 1] - start;
+		Random_Seed (&random, Random_At (~task->seed, b));
+		if (size > 1)
+			Random_ShuffleOffsetsSerial (&task->aux[start], size, &random);
+		memcpy (&task->v[start], &task->aux[start], sizeof(off_t) * size);
+	}
+}
+
+/************************
+* "Public" Functions	*
+************************/
+void Random_Seed (Random * random, uint64_t seed)
+{
+	random->seed = seed;
+	random->counter = 0;
+}
+
+uint64_t Random_TimeSeed (void)
+{
+	static uint64_t calls = 0;
+
+	/* Calls on the same second still get different seeds, even from different threads */
+	return Random_At ((uint64_t) time (NULL), __sync_fetch_and_add (&calls, 1));
+}
+
+uint64_t Random_At (uint64_t seed, uint64_t counter)
+{
+	return Random_Mix (seed + (counter + 1) * RANDOM_GAMMA);
+}
+
+uint64_t Random_Next (Random * random)
+{
+	return Random_At (random->seed, random->counter++);
+}
+
+uint64_t Random_Below (Random * random, uint64_t bound)
+{
+	uint64_t value;
+	uint64_t threshold;
+
+	/* Lemire's method: reject the few values that would make some results more likely than others */
+	value = Random_Next (random);
+#ifdef __SIZEOF_INT128__
+	if ((uint64_t) ((unsigned __int128) value * bound) < bound)
+	{
+		threshold = (0 - bound) % bound;
+		while ((uint64_t) ((unsigned __int128) value * bound) < threshold)
+			value = Random_Next (random);
+	}
+#else
+	threshold = (0 - bound) % bound;
+	while (value < threshold)
+		value = Random_Next (random);
+#endif
+
+	return Random_Scale (value, bound);
+}
+
+int Random_ShuffleOffsets (off_t * v, size_t count, uint64_t seed)
+{
+	Random random;
+	ShuffleTask * tasks;
+	off_t * aux;
+	size_t * offsets;
+	size_t * bucketStart;
+	size_t bucketsCount;
+	size_t position;
+	size_t size;
+	size_t b;
+	unsigned int tasksCount;
+	unsigned int t;
+
+	/* Small arrays are shuffled in place, on the calling thread */
+	if (count < PARALLEL_SHUFFLE_MIN)
+	{
+		Random_Seed (&random, seed);
+		Random_ShuffleOffsetsSerial (v, count, &random);
+		return ML_OK;
+	}
+
+	/*	Large ones send each element to a random bucket, and then shuffle each bucket (Sanders' algorithm).
+		The number of buckets depends only on the number of elements, so the result doesn't depend on the number of threads */
+	bucketsCount = (count + SHUFFLE_BUCKET_SIZE - 1) / SHUFFLE_BUCKET_SIZE;
+	tasksCount = Parallel_CpuCount ();
+
+	aux = (off_t *) malloc (sizeof(off_t) * count);
+	tasks = (ShuffleTask *) malloc (sizeof(ShuffleTask) * tasksCount);
+	offsets = (size_t *) malloc (sizeof(size_t) * bucketsCount * tasksCount);
+	bucketStart = (size_t *) malloc (sizeof(size_t) * (bucketsCount + 1));
+	if (aux == NULL || tasks == NULL || offsets == NULL || bucketStart == NULL)
+	{
+		free (aux);
+		free (tasks);
+		free (offsets);
+		free (bucketStart);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Each task distributes a slice of the array */
+	for (t=0;t<tasksCount;t++)
+	{
+		tasks[t].v = v;
+		tasks[t].aux = aux;
+		tasks[t].first = (count / tasksCount) * t;
+		tasks[t].last = (t == tasksCount - 1) ? count : (count / tasksCount) * (t + 1);
+		tasks[t].offsets = &offsets[bucketsCount * t];
+		tasks[t].bucketStart = bucketStart;
+		tasks[t].bucketsCount = bucketsCount;
+		tasks[t].task = t;
+		tasks[t].tasksCount = tasksCount;
+		tasks[t].seed = seed;
+	}
+
+	/* Count the size of each bucket on each slice */
+	Parallel_Run ((void (*)(void *)) Random_CountBuckets, tasks, sizeof(ShuffleTask), tasksCount);
+
+	/* A prefix sum (by bucket, then by task) gives the position where each task writes to each bucket */
+	position = 0;
+	for (b=0;b<bucketsCount;b++)
+	{
+		bucketStart[b] = position;
+		for (t=0;t<tasksCount;t++)
+		{
+			size = offsets[bucketsCount * t + b];
+			offsets[bucketsCount * t + b] = position;
+			position += size;
+		}
+	}
+	bucketStart[bucketsCount] = position;
+
+	/* Distribute the elements and shuffle the buckets */
+	Parallel_Run ((void (*)(void *)) Random_DistributeBuckets, tasks, sizeof(ShuffleTask), tasksCount);
+	Parallel_Run ((void (*)(void *)) Random_ShuffleBuckets, tasks, sizeof(ShuffleTask), tasksCount);
+
+	free (aux);
+	free (tasks);
+	free (offsets);
+	free (bucketStart);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+void Random_Shuffle (void * v, size_t elementSize, size_t count, uint64_t seed)
+{
+	Random random;
+	unsigned char * ucBase;
+	unsigned char aux;
+	size_t i;
+	size_t j;
+	size_t k;
+
+	/* off_t arrays have their own swap */
+	if (elementSize == sizeof(off_t))
+	{
+		Random_Seed (&random, seed);
+		Random_ShuffleOffsetsSerial ((off_t *) v, count, &random);
+		return;
+	}
+
+	/* Recast base to unsigned char so we can do pointer math in windows */
+	ucBase = (unsigned char *) v;
+
+	if (count < 2)
+		return;
+
+	/* Fisher-Yates, swapping the elements byte by byte */
+	Random_Seed (&random, seed);
+	for (i=count - 1;i>0;i--)
+	{
+		j = (size_t) Random_Below (&random, i + 1);
+		for (k=0;k<elementSize;k++)
+		{
+			aux = ucBase[i * elementSize + k];
+			ucBase[i * elementSize + k] = ucBase[j * elementSize + k];
+			ucBase[j * elementSize + k] = aux;
+		}
+	}
+}
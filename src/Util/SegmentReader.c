@@ -0,0 +1,167 @@
+#include <stdlib.h>				/* For malloc/free */
+#include <string.h>				/* For memcpy and memchr */
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/SegmentReader.h"
+#include "MacLearn/Util/Parallel.h"		/* For Parallel_Run */
+
+/* Size (in bytes) of the segments. A segment only grows past it to hold a longer line */
+#define SEGMENT_SIZE			(4 << 20)
+/* Initial number of chunks. Doubles as needed */
+#define INITIAL_CHUNKS			16
+
+/* Position on a file read in segments */
+typedef struct
+{
+	FILE * file;					/* File being read */
+	char * carry;					/* Incomplete line at the end of the last segment, which starts the next one */
+	size_t carrySize;				/* Number of bytes of "carry" */
+	off_t offset;					/* Position of the next segment on the file */
+	unsigned char eof;				/* Whether the file was read to its end */
+}SegmentReader;
+
+static int SegmentReader_Read (SegmentReader * reader, TextSegment * segment)
+{
+	char * text;
+	char * auxText;
+	size_t size;
+	size_t capacity;
+	size_t bytesRead;
+	size_t lineEnd;
+
+	/* A segment starts with the incomplete line left by the previous one */
+	capacity = reader->carrySize + SEGMENT_SIZE;
+	text = (char *) malloc (capacity);
+	if (text == NULL)
+	{
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	if (reader->carrySize > 0)
+		memcpy (text, reader->carry, reader->carrySize);
+	size = reader->carrySize;
+
+	/* Read until the segment has at least one whole line, or the file ends */
+	for (;;)
+	{
+		bytesRead = fread (&text[size], 1, capacity - size, reader->file);
+		size += bytesRead;
+		if (size < capacity)
+		{
+			if (ferror (reader->file))
+			{
+				free (text);
+				errno = EIO;
+				return ML_ERR_FILE;
+			}
+			reader->eof = 1;
+			break;
+		}
+		if (memchr (&text[size - bytesRead], '\n', bytesRead) != NULL)
+			break;
+
+		/* A single line is longer than the segment */
+		auxText = (char *) realloc (text, capacity * 2);
+		if (auxText == NULL)
+		{
+			free (text);
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		text = auxText;
+		capacity *= 2;
+	}
+
+	/* Cut the segment after its last line break. What's left is carried to the next segment */
+	lineEnd = size;
+	if (!reader->eof)
+	{
+		while (text[lineEnd - 1] != '\n')
+			lineEnd--;
+	}
+	reader->carrySize = size - lineEnd;
+	if (reader->carrySize > 0)
+	{
+		auxText = (char *) realloc (reader->carry, reader->carrySize);
+		if (auxText == NULL)
+		{
+			free (text);
+			errno = ENOMEM;
+			return ML_ERR_OUTOFMEMORY;
+		}
+		reader->carry = auxText;
+		memcpy (reader->carry, &text[lineEnd], reader->carrySize);
+	}
+
+	segment->start = text;
+	segment->end = text + lineEnd;
+	segment->offset = reader->offset;
+	segment->size = lineEnd;
+	reader->offset += (off_t) lineEnd;
+
+	/* Return OK */
+	return ML_OK;
+}
+
+int SegmentReader_Parse (FILE * file, const void * chunk, size_t chunkSize, void ** chunks, unsigned long * chunksCount, void (*parse)(void * chunk))
+{
+	SegmentReader reader;
+	TextSegment * segment;
+	void * auxChunks;
+	unsigned long chunksCapacity = 0;
+	unsigned long first;
+	unsigned long i;
+	unsigned int batchSize;
+	int ret = ML_OK;
+
+	memset (&reader, 0, sizeof(SegmentReader));
+	reader.file = file;
+	*chunks = NULL;
+	*chunksCount = 0;
+
+	/* One segment per processor is read and parsed at a time */
+	batchSize = Parallel_CpuCount ();
+	while (!reader.eof && ret == ML_OK)
+	{
+		first = *chunksCount;
+		while (!reader.eof && *chunksCount - first < batchSize && ret == ML_OK)
+		{
+			if (*chunksCount == chunksCapacity)
+			{
+				auxChunks = realloc (*chunks, chunkSize * max (chunksCapacity * 2, INITIAL_CHUNKS));
+				if (auxChunks == NULL)
+				{
+					errno = ENOMEM;
+					ret = ML_ERR_OUTOFMEMORY;
+					break;
+				}
+				*chunks = auxChunks;
+				chunksCapacity = max (chunksCapacity * 2, INITIAL_CHUNKS);
+			}
+			segment = (TextSegment *) ((char *) *chunks + chunkSize * *chunksCount);
+			memcpy (segment, chunk, chunkSize);
+			ret = SegmentReader_Read (&reader, segment);
+			if (ret == ML_OK)
+				(*chunksCount)++;
+		}
+
+		Parallel_Run (parse, (char *) *chunks + chunkSize * first, chunkSize, (unsigned int) (*chunksCount - first));
+
+		/* The text of the segments isn't needed anymore */
+		for (i=first;i<*chunksCount;i++)
+		{
+			segment = (TextSegment *) ((char *) *chunks + chunkSize * i);
+			free ((void *) segment->start);
+			segment->start = segment->end = NULL;
+			if (ret == ML_OK && segment->ret != ML_OK)
+			{
+				/* errno was set on the thread that failed, so set it again here */
+				ret = segment->ret;
+				errno = (ret == ML_ERR_OUTOFMEMORY) ? ENOMEM : (ret == ML_ERR_PARAM) ? EINVAL : EIO;
+			}
+		}
+	}
+	free (reader.carry);
+
+	return ret;
+}
@@ -0,0 +1,143 @@
+#include <string.h>				/* For memset and strlen */
+#include <sys/types.h>
+#include <sys/stat.h>			/* For fstat */
+#ifndef WIN32
+#include <sys/mman.h>			/* For shm_open and mmap */
+#include <fcntl.h>				/* For O_* constants and posix_fallocate */
+#include <unistd.h>				/* For close */
+#endif
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/SharedMem.h"
+
+int SharedMem_Create (SharedMem * shm, const char * name, size_t size)
+{
+#ifndef WIN32
+	int fd;
+	int ret;
+
+	/* Zero the block, so it's always safe to call SharedMem_Close */
+	memset (shm, 0, sizeof(SharedMem));
+	if (strlen (name) >= SHAREDMEM_NAME_SIZE || size == 0)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	/* Only one process may create (and fill) each block */
+	fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+	{
+		if (errno != EEXIST)
+			errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	/* Reserve all of the memory now. Otherwise writing to a page that doesn't fit raises a SIGBUS */
+	ret = posix_fallocate (fd, 0, (off_t) size);
+	if (ret == EINVAL || ret == EOPNOTSUPP)
+		ret = (ftruncate (fd, (off_t) size) == 0) ? 0 : errno;
+	if (ret != 0)
+	{
+		close (fd);
+		shm_unlink (name);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	shm->data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (shm->data == MAP_FAILED)
+	{
+		shm->data = NULL;
+		shm_unlink (name);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	shm->size = size;
+	strcpy (shm->name, name);
+
+	/* Return OK */
+	return ML_OK;
+#else
+	memset (shm, 0, sizeof(SharedMem));
+	errno = ENOSYS;
+	return ML_ERR_NOTIMPLEMENTED;
+#endif
+}
+
+int SharedMem_Open (SharedMem * shm, const char * name)
+{
+#ifndef WIN32
+	struct stat fileInfo;
+	int fd;
+
+	/* Zero the block, so it's always safe to call SharedMem_Close */
+	memset (shm, 0, sizeof(SharedMem));
+	if (strlen (name) >= SHAREDMEM_NAME_SIZE)
+	{
+		errno = EINVAL;
+		return ML_ERR_PARAM;
+	}
+
+	fd = shm_open (name, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		errno = ENOENT;
+		return ML_ERR_FILENOTFOUND;
+	}
+
+	/* The size of the block is the size of its file */
+	if (fstat (fd, &fileInfo) != 0 || fileInfo.st_size == 0)
+	{
+		close (fd);
+		errno = EIO;
+		return ML_ERR_FILE;
+	}
+
+	shm->data = mmap (NULL, (size_t) fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (shm->data == MAP_FAILED)
+	{
+		shm->data = NULL;
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+	shm->size = (size_t) fileInfo.st_size;
+	strcpy (shm->name, name);
+
+	/* Return OK */
+	return ML_OK;
+#else
+	memset (shm, 0, sizeof(SharedMem));
+	errno = ENOSYS;
+	return ML_ERR_NOTIMPLEMENTED;
+#endif
+}
+
+void SharedMem_Close (SharedMem * shm)
+{
+#ifndef WIN32
+	if (shm->data != NULL)
+		munmap (shm->data, shm->size);
+#endif
+
+	memset (shm, 0, sizeof(SharedMem));
+}
+
+int SharedMem_Remove (const char * name)
+{
+#ifndef WIN32
+	if (shm_unlink (name) != 0)
+	{
+		errno = ENOENT;
+		return ML_ERR_FILENOTFOUND;
+	}
+
+	/* Return OK */
+	return ML_OK;
+#else
+	errno = ENOSYS;
+	return ML_ERR_NOTIMPLEMENTED;
+#endif
+}
@@ -0,0 +1,183 @@
+#include <stdlib.h>				/* For malloc/free */
+#include <string.h>				/* For memcpy and memcmp */
+
+#include "MacLearn/MacLearn.h"
+#include "MacLearn/Util/StringTable.h"
+
+/* Number of slots of an empty table */
+#define INITIAL_SLOTS			16
+/* Size (in bytes) of the pool of an empty table */
+#define INITIAL_POOL			256
+
+/************************
+* "Private" Functions	*
+************************/
+static __inline uint32_t StringTable_Hash (const char * key, size_t length)
+{
+	uint32_t hash;
+	size_t i;
+
+	/* FNV-1a. Keys are short (nominal values, labels), so a simple byte at a time hash is enough */
+	hash = 2166136261U;
+	for (i=0;i<length;i++)
+	{
+		hash ^= (unsigned char) key[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static __inline size_t StringTable_Slot (const StringTable * table, const char * key, size_t length, uint32_t hash)
+{
+	const StringTableKey * tableKey;
+	size_t slot;
+	size_t mask;
+
+	/* Linear probing, until the key or an empty slot is found. There's always an empty slot */
+	mask = table->slotsCount - 1;
+	for (slot=hash & mask;table->slots[slot] != 0;slot=(slot + 1) & mask)
+	{
+		tableKey = &table->keys[table->slots[slot] - 1];
+		if (tableKey->hash == hash && tableKey->length == length && memcmp (&table->pool[tableKey->offset], key, length) == 0)
+			break;
+	}
+
+	return slot;
+}
+
+static int StringTable_Grow (StringTable * table)
+{
+	StringTableKey * auxKeys;
+	unsigned long * auxSlots;
+	unsigned long * oldSlots;
+	size_t oldCount;
+	size_t i;
+	size_t slot;
+	size_t mask;
+
+	/* Double the number of slots, and put every key on its new slot */
+	auxSlots = (unsigned long *) calloc (table->slotsCount * 2, sizeof(unsigned long));
+	auxKeys = (StringTableKey *) realloc (table->keys, sizeof(StringTableKey) * table->slotsCount);
+	if (auxKeys != NULL)
+		table->keys = auxKeys;
+	if (auxSlots == NULL || auxKeys == NULL)
+	{
+		free (auxSlots);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	oldSlots = table->slots;
+	oldCount = table->slotsCount;
+	table->slots = auxSlots;
+	table->slotsCount = oldCount * 2;
+	mask = table->slotsCount - 1;
+	for (i=0;i<oldCount;i++)
+	{
+		if (oldSlots[i] == 0)
+			continue;
+		for (slot=table->keys[oldSlots[i] - 1].hash & mask;table->slots[slot] != 0;slot=(slot + 1) & mask);
+		table->slots[slot] = oldSlots[i];
+	}
+	free (oldSlots);
+
+	/* Return OK */
+	return ML_OK;
+}
+
+/************************
+* "Public" Functions	*
+************************/
+int StringTable_Init (StringTable * table)
+{
+	memset (table, 0, sizeof(StringTable));
+
+	/* Keys are allocated along with the slots. At most half the slots are used */
+	table->slotsCount = INITIAL_SLOTS;
+	table->slots = (unsigned long *) calloc (table->slotsCount, sizeof(unsigned long));
+	table->keys = (StringTableKey *) malloc (sizeof(StringTableKey) * (table->slotsCount / 2));
+	table->poolCapacity = INITIAL_POOL;
+	table->pool = (char *) malloc (table->poolCapacity);
+	if (table->slots == NULL || table->keys == NULL || table->pool == NULL)
+	{
+		StringTable_Free (table);
+		errno = ENOMEM;
+		return ML_ERR_OUTOFMEMORY;
+	}
+
+	/* Return OK */
+	return ML_OK;
+}
+
+void StringTable_Free (StringTable * table)
+{
+	free (table->keys);
+	free (table->slots);
+	free (table->pool);
+	memset (table, 0, sizeof(StringTable));
+}
+
+long StringTable_Intern (StringTable * table, const char * key, size_t length)
+{
+	StringTableKey * tableKey;
+	char * auxPool;
+	size_t capacity;
+	size_t slot;
+	uint32_t hash;
+
+	/* Strings already interned keep their code */
+	hash = StringTable_Hash (key, length);
+	slot = StringTable_Slot (table, key, length, hash);
+	if (table->slots[slot] != 0)
+		return (long) (table->slots[slot] - 1);
+
+	/* Make room for the new string on the pool */
+	if (table->poolSize + length > table->poolCapacity)
+	{
+		capacity = max (table->poolCapacity * 2, table->poolSize + length);
+		auxPool = (char *) realloc (table->pool, capacity);
+		if (auxPool == NULL)
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+		table->pool = auxPool;
+		table->poolCapacity = capacity;
+	}
+
+	/* Give it the next code */
+	tableKey = &table->keys[table->count];
+	tableKey->offset = table->poolSize;
+	tableKey->length = length;
+	tableKey->hash = hash;
+	memcpy (&table->pool[table->poolSize], key, length);
+	table->poolSize += length;
+	table->slots[slot] = ++table->count;
+
+	/* Keep at least half of the slots empty, so probe sequences stay short */
+	if (table->count * 2 >= table->slotsCount && StringTable_Grow (table) != ML_OK)
+	{
+		/* Forget the new string. The table remains valid */
+		table->slots[slot] = 0;
+		table->count--;
+		table->poolSize -= length;
+		return -1;
+	}
+
+	return (long) (table->count - 1);
+}
+
+long StringTable_Find (const StringTable * table, const char * key, size_t length)
+{
+	size_t slot;
+
+	slot = StringTable_Slot (table, key, length, StringTable_Hash (key, length));
+	return (long) table->slots[slot] - 1;
+}
+
+const char * StringTable_Key (const StringTable * table, unsigned long code, size_t * length)
+{
+	*length = table->keys[code].length;
+	return &table->pool[table->keys[code].offset];
+}